@@ -289,4 +289,33 @@ class TestCaseCreaterepo_emptyrepo(BaseTestCase):
                                 "[a-z0-9]+-comps.xml$",
                                 "[a-z0-9]+-comps.xml.xz$",
                                 ],
-                               additional_files_allowed=False)
\ No newline at end of file
+                               additional_files_allowed=False)
+
+class TestCaseCreaterepo_prefetch(BaseTestCase):
+    """Repo with 3 packages created with and without --prefetch"""
+
+    def setup(self):
+        self.indir_addpkg(PACKAGES[0])
+        self.indir_addpkg(PACKAGES[1])
+        self.indir_addpkg(PACKAGES[2])
+
+    def test_01_createrepo_prefetch(self):
+        """--prefetch produces the same repo as a run without it"""
+        res = self.assert_run_cr(self.indir, c=True, outdir="noprefetch")
+        pres = self.assert_run_cr(self.indir, "--prefetch 2 --workers 2",
+                                  c=True, outdir="prefetch")
+        self.assert_repo_sanity(pres.outdir)
+        cmpres = self.compare_repos(res.outdir, pres.outdir)
+        self.assertFalse(cmpres.rc)
+
+    def test_02_createrepo_prefetch_update(self):
+        """--prefetch with --update (reused packages are not prefetched)"""
+        self.assert_run_cr(self.indir, c=True, outdir="noprefetch")
+        self.assert_run_cr(self.indir, c=True, outdir="prefetch")
+        res = self.assert_run_cr(self.indir, "--update",
+                                 c=True, outdir="noprefetch")
+        pres = self.assert_run_cr(self.indir, "--update --prefetch 2 --workers 2",
+                                  c=True, outdir="prefetch")
+        self.assert_repo_sanity(pres.outdir)
+        cmpres = self.compare_repos(res.outdir, pres.outdir)
+        self.assertFalse(cmpres.rc)
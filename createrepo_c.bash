@@ -56,19 +56,24 @@ _cr_createrepo()
             _cr_compress_type "$1" "$2"
             return 0
             ;;
+        --prefetch-engine)
+            COMPREPLY=( $( compgen -W 'auto threads io_uring' -- "$2" ) )
+            return 0
+            ;;
     esac
 
     if [[ $2 == -* ]] ; then
         COMPREPLY=( $( compgen -W '--help --version --quiet --verbose
             --excludes --basedir --baseurl --groupfile --checksum
             --pretty --database --no-database --update --update-md-path
-            --skip-stat --pkglist --includepkg --outputdir
+            --skip-stat --xml-passthrough --pkglist --includepkg --outputdir
             --skip-symlinks --changelog-limit --unique-md-filenames
             --simple-md-filenames --retain-old-md --distro --content --repo
-            --revision --read-pkgs-list --workers --xz
+            --revision --read-pkgs-list --workers --prefetch
+            --prefetch-engine --xz
             --compress-type --keep-all-metadata --compatibility
             --retain-old-md-by-age --cachedir --local-sqlite
-            --cut-dirs --location-prefix
+            --cut-dirs --location-prefix --stats-file --snapshot
             --deltas --oldpackagedirs
             --num-deltas --max-delta-rpm-size' -- "$2" ) )
     else
@@ -89,7 +94,7 @@ _cr_mergerepo()
             COMPREPLY=( $( compgen -f -o plusdirs -- "$2" ) )
             return 0
             ;;
-        -r|--repo|-o|--outputdir|--noarch-repo)
+        -r|--repo|-o|--outputdir|--noarch-repo|--cache-dir)
             COMPREPLY=( $( compgen -d -- "$2" ) )
             return 0
             ;;
@@ -107,8 +112,8 @@ _cr_mergerepo()
         COMPREPLY=( $( compgen -W '--version --help --repo --archlist --database
             --no-database --verbose --outputdir --nogroups --noupdateinfo
             --compress-type --method --all --noarch-repo --unique-md-filenames
-            --simple-md-filenames --omit-baseurl --koji --groupfile
-            --blocked' -- "$2" ) )
+            --simple-md-filenames --omit-baseurl --cache-dir --koji
+            --groupfile --blocked' -- "$2" ) )
     else
         COMPREPLY=( $( compgen -d -- "$2" ) )
     fi
@@ -176,6 +181,48 @@ _cr_sqliterepo()
 } &&
 complete -F _cr_sqliterepo -o filenames sqliterepo_c
 
+_cr_repodiff()
+{
+    COMPREPLY=()
+
+    case $3 in
+        -h|--help|-V|--version)
+            return 0
+            ;;
+    esac
+
+    if [[ $2 == -* ]] ; then
+        COMPREPLY=( $( compgen -W '--help --version --quiet --verbose
+            --primary --simple --no-summary ' -- "$2" ) )
+    else
+        COMPREPLY=( $( compgen -f -- "$2" ) )
+    fi
+} &&
+complete -F _cr_repodiff -o filenames repodiff_c
+
+_cr_mdserver()
+{
+    COMPREPLY=()
+
+    case $3 in
+        -h|--help|-V|--version)
+            return 0
+            ;;
+        -s|--socket|-c|--cache-dir)
+            COMPREPLY=( $( compgen -f -- "$2" ) )
+            return 0
+            ;;
+    esac
+
+    if [[ $2 == -* ]] ; then
+        COMPREPLY=( $( compgen -W '--help --version --quiet --verbose
+            --socket --cache-dir ' -- "$2" ) )
+    else
+        COMPREPLY=( $( compgen -d -- "$2" ) )
+    fi
+} &&
+complete -F _cr_mdserver -o filenames mdserver_c
+
 # Local variables:
 # mode: shell-script
 # sh-basic-offset: 4
@@ -200,6 +200,8 @@ ln -sr %{buildroot}%{_bindir}/modifyrepo_c %{buildroot}%{_bindir}/modifyrepo
 %{_mandir}/man8/mergerepo_c.8*
 %{_mandir}/man8/modifyrepo_c.8*
 %{_mandir}/man8/sqliterepo_c.8*
+%{_mandir}/man8/repodiff_c.8*
+%{_mandir}/man8/mdserver_c.8*
 %{bash_completion}
 %{_bindir}/createrepo_c
 %{_bindir}/mergerepo_c
@@ -208,6 +210,8 @@ ln -sr %{buildroot}%{_bindir}/modifyrepo_c %{buildroot}%{_bindir}/modifyrepo
 %{_bindir}/mergerepo
 %{_bindir}/modifyrepo
 %{_bindir}/sqliterepo_c
+%{_bindir}/repodiff_c
+%{_bindir}/mdserver_c
 
 %files libs
 %license COPYING
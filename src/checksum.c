@@ -23,19 +23,42 @@
 #include <string.h>
 #include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
 #include <openssl/evp.h>
+#include <openssl/opensslv.h>
 #include "error.h"
 #include "checksum.h"
 
 #define ERR_DOMAIN              CREATEREPO_C_ERROR
 #define MAX_CHECKSUM_NAME_LEN   7
-#define BUFFER_SIZE             2048
+
+/* I/O engine used by cr_checksum_file()
+ * Regular files bigger than MMAP_THRESHOLD are mapped into memory and
+ * hashed directly from the page cache (no copy to userspace buffer).
+ * Smaller files (and everything that cannot be mapped) are read by
+ * large page aligned read() calls.
+ */
+#define MMAP_THRESHOLD          (4 * 1024 * 1024)
+#define MMAP_BLOCK_SIZE         (1024 * 1024)
+#define READ_BUFFER_SIZE        (256 * 1024)
+#define READ_BUFFER_ALIGNMENT   4096
 
 struct _cr_ChecksumCtx {
     EVP_MD_CTX      *ctx;
     cr_ChecksumType type;
 };
 
+struct _cr_ChecksumMultiCtx {
+    EVP_MD_CTX      **ctx;
+    cr_ChecksumType *types;
+    size_t          count;
+};
+
 cr_ChecksumType
 cr_checksum_type(const char *name)
 {
@@ -106,74 +129,224 @@ cr_checksum_name_str(cr_ChecksumType type)
     }
 }
 
-char *
-cr_checksum_file(const char *filename,
-                 cr_ChecksumType type,
-                 GError **err)
+static const EVP_MD *
+cr_checksum_evp_md_fetch(cr_ChecksumType type)
 {
-    FILE *f;
-    int rc;
-    unsigned int len;
-    ssize_t readed;
-    char buf[BUFFER_SIZE];
-    unsigned char raw_checksum[EVP_MAX_MD_SIZE];
-    char *checksum;
-    EVP_MD_CTX *ctx;
-    const EVP_MD *ctx_type;
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    // OpenSSL 3 does an implicit (slow) algorithm fetch on every
+    // EVP_DigestInit_ex() with the legacy EVP_sha*() getters.
+    // Explicitly fetched digest is resolved only once.
+    const char *name = NULL;
+    switch (type) {
+        case CR_CHECKSUM_MD5:    name = "MD5";    break;
+        case CR_CHECKSUM_SHA:    name = "SHA1";   break;
+        case CR_CHECKSUM_SHA1:   name = "SHA1";   break;
+        case CR_CHECKSUM_SHA224: name = "SHA224"; break;
+        case CR_CHECKSUM_SHA256: name = "SHA256"; break;
+        case CR_CHECKSUM_SHA384: name = "SHA384"; break;
+        case CR_CHECKSUM_SHA512: name = "SHA512"; break;
+        default: break;
+    }
+
+    if (name) {
+        EVP_MD *md = EVP_MD_fetch(NULL, name, NULL);
+        if (md)
+            return md;
+    }
+#endif
 
     switch (type) {
-        //case CR_CHECKSUM_MD2:    ctx_type = EVP_md2();    break;
-        case CR_CHECKSUM_MD5:    ctx_type = EVP_md5();    break;
-        case CR_CHECKSUM_SHA:    ctx_type = EVP_sha1();   break;
-        case CR_CHECKSUM_SHA1:   ctx_type = EVP_sha1();   break;
-        case CR_CHECKSUM_SHA224: ctx_type = EVP_sha224(); break;
-        case CR_CHECKSUM_SHA256: ctx_type = EVP_sha256(); break;
-        case CR_CHECKSUM_SHA384: ctx_type = EVP_sha384(); break;
-        case CR_CHECKSUM_SHA512: ctx_type = EVP_sha512(); break;
+        //case CR_CHECKSUM_MD2:    return EVP_md2();
+        case CR_CHECKSUM_MD5:    return EVP_md5();
+        case CR_CHECKSUM_SHA:    return EVP_sha1();
+        case CR_CHECKSUM_SHA1:   return EVP_sha1();
+        case CR_CHECKSUM_SHA224: return EVP_sha224();
+        case CR_CHECKSUM_SHA256: return EVP_sha256();
+        case CR_CHECKSUM_SHA384: return EVP_sha384();
+        case CR_CHECKSUM_SHA512: return EVP_sha512();
         case CR_CHECKSUM_UNKNOWN:
         default:
-            g_set_error(err, ERR_DOMAIN, CRE_UNKNOWNCHECKSUMTYPE,
-                        "Unknown checksum type");
             return NULL;
     }
+}
+
+static const EVP_MD *
+cr_checksum_evp_md(cr_ChecksumType type)
+{
+    static gsize md_cache[CR_CHECKSUM_SENTINEL];
+
+    if (type <= CR_CHECKSUM_UNKNOWN || type >= CR_CHECKSUM_SENTINEL)
+        return NULL;
+
+    if (g_once_init_enter(&md_cache[type])) {
+        const EVP_MD *md = cr_checksum_evp_md_fetch(type);
+        g_debug("%s: %s digest ready", __func__, cr_checksum_name_str(type));
+        g_once_init_leave(&md_cache[type], (gsize) md);
+    }
+
+    return (const EVP_MD *) md_cache[type];
+}
+
+static void
+cr_checksum_thread_ctx_free(gpointer ctx)
+{
+    EVP_MD_CTX_destroy((EVP_MD_CTX *) ctx);
+}
+
+/** EVP context reused by cr_checksum_buffers() calls from the same thread
+ */
+static GPrivate thread_md_ctx = G_PRIVATE_INIT(cr_checksum_thread_ctx_free);
+
+static char *
+cr_checksum_hexdigest(const unsigned char *raw_checksum, unsigned int len)
+{
+    char *checksum = g_malloc0(sizeof(char) * (len * 2 + 1));
+    for (size_t x = 0; x < len; x++)
+        sprintf(checksum+(x*2), "%02x", raw_checksum[x]);
+    return checksum;
+}
+
+/** Feed the whole file into the digests via mmap().
+ * The mapping is processed by MMAP_BLOCK_SIZE blocks, so when more
+ * digests are calculated, the data are still in the CPU cache for
+ * the next ones.
+ * @return      TRUE if the file was hashed, FALSE if it cannot be mapped
+ *              (caller should fall back to the read() engine).
+ */
+static gboolean
+cr_checksum_fd_mmap(cr_ChecksumMultiCtx *ctx, int fd, size_t size, GError **err)
+{
+    const unsigned char *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        g_debug("%s: mmap() failed (%s), using read()",
+                __func__, g_strerror(errno));
+        return FALSE;
+    }
+
+#ifdef MADV_SEQUENTIAL
+    madvise((void *) map, size, MADV_SEQUENTIAL);
+#endif
+
+    for (size_t off = 0; off < size; off += MMAP_BLOCK_SIZE) {
+        size_t len = MIN(MMAP_BLOCK_SIZE, size - off);
+        if (cr_checksum_multi_update(ctx, map + off, len, err) != CRE_OK)
+            break;
+    }
+
+    munmap((void *) map, size);
+    return TRUE;
+}
+
+/** Feed the file into the digests by big page aligned read() calls.
+ * @param size  Size of the file or -1 if unknown.
+ * @return      cr_Error code
+ */
+static int
+cr_checksum_fd_read(cr_ChecksumMultiCtx *ctx, int fd, gint64 size, GError **err)
+{
+    int ret = CRE_OK;
+    ssize_t readed;
+    size_t buf_len = READ_BUFFER_SIZE;
+    void *buf = NULL;
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    // Don't allocate the full buffer for small files
+    if (size >= 0 && size < READ_BUFFER_SIZE)
+        buf_len = ((size / READ_BUFFER_ALIGNMENT) + 1) * READ_BUFFER_ALIGNMENT;
+
+    if (posix_memalign(&buf, READ_BUFFER_ALIGNMENT, buf_len)) {
+        g_set_error(err, ERR_DOMAIN, CRE_MEMORY,
+                    "Cannot allocate memory");
+        return CRE_MEMORY;
+    }
 
-    f = fopen(filename, "rb");
-    if (!f) {
+    while (1) {
+        readed = read(fd, buf, buf_len);
+        if (readed == 0)
+            break;
+        if (readed < 0) {
+            if (errno == EINTR)
+                continue;
+            g_set_error(err, ERR_DOMAIN, CRE_IO,
+                        "Error while reading a file: %s", g_strerror(errno));
+            ret = CRE_IO;
+            break;
+        }
+        ret = cr_checksum_multi_update(ctx, buf, readed, err);
+        if (ret != CRE_OK)
+            break;
+    }
+
+    free(buf);
+    return ret;
+}
+
+char **
+cr_checksum_file_multi(const char *filename,
+                       const cr_ChecksumType *types,
+                       size_t count,
+                       GError **err)
+{
+    int fd;
+    struct stat st;
+    gint64 size = -1;
+    cr_ChecksumMultiCtx *ctx;
+    GError *tmp_err = NULL;
+
+    assert(filename);
+    assert(!err || *err == NULL);
+
+    ctx = cr_checksum_multi_new(types, count, err);
+    if (!ctx)
+        return NULL;
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0) {
         g_set_error(err, ERR_DOMAIN, CRE_IO,
                     "Cannot open a file: %s", g_strerror(errno));
+        cr_checksum_multi_free(ctx);
         return NULL;
     }
 
-    ctx = EVP_MD_CTX_create();
-    rc = EVP_DigestInit_ex(ctx, ctx_type, NULL);
-    if (!rc) {
-        g_set_error(err, ERR_DOMAIN, CRE_OPENSSL,
-                    "EVP_DigestInit_ex() failed");
-        EVP_MD_CTX_destroy(ctx);
-        fclose(f);
-        return NULL;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+        size = (gint64) st.st_size;
+
+    // Select the I/O engine by the file size
+    if (size < MMAP_THRESHOLD
+        || (guint64) size > (guint64) G_MAXSIZE
+        || !cr_checksum_fd_mmap(ctx, fd, (size_t) size, &tmp_err))
+    {
+        cr_checksum_fd_read(ctx, fd, size, &tmp_err);
     }
 
-    while ((readed = fread(buf, 1, BUFFER_SIZE, f)) == BUFFER_SIZE)
-        EVP_DigestUpdate(ctx, buf, readed);
+    close(fd);
 
-    if (feof(f)) {
-        EVP_DigestUpdate(ctx, buf, readed);
-    } else {
-        g_set_error(err, ERR_DOMAIN, CRE_IO,
-                    "Error while reading a file: %s", g_strerror(errno));
-        EVP_MD_CTX_destroy(ctx);
-        fclose(f);
+    if (tmp_err) {
+        g_propagate_error(err, tmp_err);
+        cr_checksum_multi_free(ctx);
         return NULL;
     }
 
-    fclose(f);
+    return cr_checksum_multi_final(ctx, err);
+}
 
-    EVP_DigestFinal_ex(ctx, raw_checksum, &len);
-    EVP_MD_CTX_destroy(ctx);
-    checksum = g_malloc0(sizeof(char) * (len * 2 + 1));
-    for (size_t x = 0; x < len; x++)
-        sprintf(checksum+(x*2), "%02x", raw_checksum[x]);
+char *
+cr_checksum_file(const char *filename,
+                 cr_ChecksumType type,
+                 GError **err)
+{
+    char *checksum;
+    char **checksums;
+
+    checksums = cr_checksum_file_multi(filename, &type, 1, err);
+    if (!checksums)
+        return NULL;
+
+    checksum = checksums[0];
+    g_free(checksums);
 
     return checksum;
 }
@@ -187,20 +360,11 @@ cr_checksum_new(cr_ChecksumType type, GError **err)
 
     assert(!err || *err == NULL);
 
-    switch (type) {
-        //case CR_CHECKSUM_MD2:    ctx_type = EVP_md2();    break;
-        case CR_CHECKSUM_MD5:    ctx_type = EVP_md5();    break;
-        case CR_CHECKSUM_SHA:    ctx_type = EVP_sha1();   break;
-        case CR_CHECKSUM_SHA1:   ctx_type = EVP_sha1();   break;
-        case CR_CHECKSUM_SHA224: ctx_type = EVP_sha224(); break;
-        case CR_CHECKSUM_SHA256: ctx_type = EVP_sha256(); break;
-        case CR_CHECKSUM_SHA384: ctx_type = EVP_sha384(); break;
-        case CR_CHECKSUM_SHA512: ctx_type = EVP_sha512(); break;
-        case CR_CHECKSUM_UNKNOWN:
-        default:
-            g_set_error(err, ERR_DOMAIN, CRE_UNKNOWNCHECKSUMTYPE,
-                        "Unknown checksum type");
-            return NULL;
+    ctx_type = cr_checksum_evp_md(type);
+    if (!ctx_type) {
+        g_set_error(err, ERR_DOMAIN, CRE_UNKNOWNCHECKSUMTYPE,
+                    "Unknown checksum type");
+        return NULL;
     }
 
     ctx = EVP_MD_CTX_create();
@@ -265,11 +429,186 @@ cr_checksum_final(cr_ChecksumCtx *ctx, GError **err)
 
     EVP_MD_CTX_destroy(ctx->ctx);
 
-    checksum = g_malloc0(sizeof(char) * (len * 2 + 1));
-    for (size_t x = 0; x < len; x++)
-        sprintf(checksum+(x*2), "%02x", raw_checksum[x]);
+    checksum = cr_checksum_hexdigest(raw_checksum, len);
 
     g_free(ctx);
 
     return checksum;
 }
+
+void
+cr_checksum_multi_free(cr_ChecksumMultiCtx *ctx)
+{
+    if (!ctx)
+        return;
+
+    for (size_t x = 0; x < ctx->count; x++)
+        if (ctx->ctx[x])
+            EVP_MD_CTX_destroy(ctx->ctx[x]);
+
+    g_free(ctx->ctx);
+    g_free(ctx->types);
+    g_free(ctx);
+}
+
+cr_ChecksumMultiCtx *
+cr_checksum_multi_new(const cr_ChecksumType *types,
+                      size_t count,
+                      GError **err)
+{
+    cr_ChecksumMultiCtx *ctx;
+
+    assert(types || count == 0);
+    assert(!err || *err == NULL);
+
+    if (count == 0) {
+        g_set_error(err, ERR_DOMAIN, CRE_BADARG,
+                    "No checksum type specified");
+        return NULL;
+    }
+
+    ctx = g_malloc0(sizeof(cr_ChecksumMultiCtx));
+    ctx->ctx   = g_new0(EVP_MD_CTX *, count);
+    ctx->types = g_new0(cr_ChecksumType, count);
+    ctx->count = count;
+
+    for (size_t x = 0; x < count; x++) {
+        const EVP_MD *ctx_type = cr_checksum_evp_md(types[x]);
+
+        ctx->types[x] = types[x];
+
+        if (!ctx_type) {
+            g_set_error(err, ERR_DOMAIN, CRE_UNKNOWNCHECKSUMTYPE,
+                        "Unknown checksum type");
+            cr_checksum_multi_free(ctx);
+            return NULL;
+        }
+
+        ctx->ctx[x] = EVP_MD_CTX_create();
+        if (!ctx->ctx[x]) {
+            g_set_error(err, ERR_DOMAIN, CRE_OPENSSL,
+                        "EVP_MD_CTX_create() failed");
+            cr_checksum_multi_free(ctx);
+            return NULL;
+        }
+
+        if (!EVP_DigestInit_ex(ctx->ctx[x], ctx_type, NULL)) {
+            g_set_error(err, ERR_DOMAIN, CRE_OPENSSL,
+                        "EVP_DigestInit_ex() failed");
+            cr_checksum_multi_free(ctx);
+            return NULL;
+        }
+    }
+
+    return ctx;
+}
+
+int
+cr_checksum_multi_update(cr_ChecksumMultiCtx *ctx,
+                         const void *buf,
+                         size_t len,
+                         GError **err)
+{
+    assert(ctx);
+    assert(!err || *err == NULL);
+
+    if (len == 0)
+        return CRE_OK;
+
+    for (size_t x = 0; x < ctx->count; x++) {
+        if (!EVP_DigestUpdate(ctx->ctx[x], buf, len)) {
+            g_set_error(err, ERR_DOMAIN, CRE_OPENSSL,
+                        "EVP_DigestUpdate() failed");
+            return CRE_OPENSSL;
+        }
+    }
+
+    return CRE_OK;
+}
+
+char **
+cr_checksum_multi_final(cr_ChecksumMultiCtx *ctx, GError **err)
+{
+    unsigned int len;
+    unsigned char raw_checksum[EVP_MAX_MD_SIZE];
+    char **checksums;
+
+    assert(ctx);
+    assert(!err || *err == NULL);
+
+    checksums = g_new0(char *, ctx->count + 1);
+
+    for (size_t x = 0; x < ctx->count; x++) {
+        if (!EVP_DigestFinal_ex(ctx->ctx[x], raw_checksum, &len)) {
+            g_set_error(err, ERR_DOMAIN, CRE_OPENSSL,
+                        "EVP_DigestFinal_ex() failed");
+            g_strfreev(checksums);
+            cr_checksum_multi_free(ctx);
+            return NULL;
+        }
+        checksums[x] = cr_checksum_hexdigest(raw_checksum, len);
+    }
+
+    cr_checksum_multi_free(ctx);
+
+    return checksums;
+}
+
+char *
+cr_checksum_buffers(cr_ChecksumType type,
+                    const void * const *bufs,
+                    const size_t *lens,
+                    size_t count,
+                    GError **err)
+{
+    unsigned int len;
+    unsigned char raw_checksum[EVP_MAX_MD_SIZE];
+    const EVP_MD *md;
+    EVP_MD_CTX *ctx;
+
+    assert(bufs || count == 0);
+    assert(lens || count == 0);
+    assert(!err || *err == NULL);
+
+    md = cr_checksum_evp_md(type);
+    if (!md) {
+        g_set_error(err, ERR_DOMAIN, CRE_UNKNOWNCHECKSUMTYPE,
+                    "Unknown checksum type");
+        return NULL;
+    }
+
+    ctx = g_private_get(&thread_md_ctx);
+    if (!ctx) {
+        ctx = EVP_MD_CTX_create();
+        if (!ctx) {
+            g_set_error(err, ERR_DOMAIN, CRE_OPENSSL,
+                        "EVP_MD_CTX_create() failed");
+            return NULL;
+        }
+        g_private_set(&thread_md_ctx, ctx);
+    }
+
+    if (!EVP_DigestInit_ex(ctx, md, NULL)) {
+        g_set_error(err, ERR_DOMAIN, CRE_OPENSSL,
+                    "EVP_DigestInit_ex() failed");
+        return NULL;
+    }
+
+    for (size_t x = 0; x < count; x++) {
+        if (!bufs[x] || !lens[x])
+            continue;
+        if (!EVP_DigestUpdate(ctx, bufs[x], lens[x])) {
+            g_set_error(err, ERR_DOMAIN, CRE_OPENSSL,
+                        "EVP_DigestUpdate() failed");
+            return NULL;
+        }
+    }
+
+    if (!EVP_DigestFinal_ex(ctx, raw_checksum, &len)) {
+        g_set_error(err, ERR_DOMAIN, CRE_OPENSSL,
+                    "EVP_DigestFinal_ex() failed");
+        return NULL;
+    }
+
+    return cr_checksum_hexdigest(raw_checksum, len);
+}
@@ -35,6 +35,10 @@ extern "C" {
  */
 typedef struct _cr_ChecksumCtx cr_ChecksumCtx;
 
+/** Checksum context which calculates several checksums at once.
+ */
+typedef struct _cr_ChecksumMultiCtx cr_ChecksumMultiCtx;
+
 /**
  * Enum of supported checksum types.
  * Note: SHA is just a "nickname" for the SHA1. This
@@ -67,6 +71,8 @@ const char *cr_checksum_name_str(cr_ChecksumType type);
 cr_ChecksumType cr_checksum_type(const char *name);
 
 /** Compute file checksum.
+ * Big regular files are mmap()ed and hashed directly from the page cache,
+ * smaller ones are read by large page aligned read() calls.
  * @param filename      filename
  * @param type          type of checksum
  * @param err           GError **
@@ -104,6 +110,74 @@ int cr_checksum_update(cr_ChecksumCtx *ctx,
  */
 char *cr_checksum_final(cr_ChecksumCtx *ctx, GError **err);
 
+/** Compute several checksums of a file by a single read of its content.
+ * @param filename      filename
+ * @param types         array of checksum types
+ * @param count         number of items in the types array
+ * @param err           GError **
+ * @return              malloced NULL terminated array of checksum strings
+ *                      in the same order as the types (free it by
+ *                      g_strfreev()) or NULL on error
+ */
+char **cr_checksum_file_multi(const char *filename,
+                              const cr_ChecksumType *types,
+                              size_t count,
+                              GError **err);
+
+/** Create new multi checksum context.
+ * @param types     Array of checksum algorithms to calculate.
+ * @param count     Number of items in the types array.
+ * @param err       GError **
+ * @return          cr_ChecksumMultiCtx or NULL on error
+ */
+cr_ChecksumMultiCtx *cr_checksum_multi_new(const cr_ChecksumType *types,
+                                           size_t count,
+                                           GError **err);
+
+/** Feeds data into all checksums of the context.
+ * @param ctx       Multi checksum context.
+ * @param buf       Pointer to the data.
+ * @param len       Length of the data.
+ * @param err       GError **
+ * @return          cr_Error code.
+ */
+int cr_checksum_multi_update(cr_ChecksumMultiCtx *ctx,
+                             const void *buf,
+                             size_t len,
+                             GError **err);
+
+/** Finalize checksum calculation, return checksum strings and frees
+ * all context resources.
+ * @param ctx       Multi checksum context.
+ * @param err       GError **
+ * @return          NULL terminated array of checksum strings in the same
+ *                  order as the types passed to cr_checksum_multi_new()
+ *                  (free it by g_strfreev()) or NULL on error.
+ */
+char **cr_checksum_multi_final(cr_ChecksumMultiCtx *ctx, GError **err);
+
+/** Frees multi checksum context without calculating the result.
+ * @param ctx       Multi checksum context.
+ */
+void cr_checksum_multi_free(cr_ChecksumMultiCtx *ctx);
+
+/** Compute checksum of data scattered in several buffers.
+ * This is a fast path for small data (e.g. cache keys). It doesn't
+ * allocate any checksum context, a per-thread context is reused
+ * by all calls from the same thread.
+ * @param type      Checksum algorithm.
+ * @param bufs      Array of pointers to the data. NULL items are skipped.
+ * @param lens      Array of lengths of the data.
+ * @param count     Number of buffers.
+ * @param err       GError **
+ * @return          Malloced checksum string or NULL on error.
+ */
+char *cr_checksum_buffers(cr_ChecksumType type,
+                          const void * const *bufs,
+                          const size_t *lens,
+                          size_t count,
+                          GError **err);
+
 /** @} */
 
 #ifdef __cplusplus
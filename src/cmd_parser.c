@@ -19,6 +19,7 @@
 
 #include <glib.h>
 #include <glib/gstdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 #include <errno.h>
@@ -42,6 +43,8 @@ struct CmdOptions _cmd_options = {
         .changelog_limit            = DEFAULT_CHANGELOG_LIMIT,
         .checksum                   = NULL,
         .workers                    = DEFAULT_WORKERS,
+        .prefetch                   = 0,
+        .prefetch_engine_type       = CR_PREFETCH_AUTO,
         .unique_md_filenames        = DEFAULT_UNIQUE_MD_FILENAMES,
         .checksum_type              = CR_CHECKSUM_SHA256,
         .retain_old                 = 0,
@@ -65,6 +68,7 @@ struct CmdOptions _cmd_options = {
 
         .zck_compression            = FALSE,
         .zck_dict_dir               = NULL,
+        .zck_train_dict_dir         = NULL,
     };
 
 
@@ -109,6 +113,11 @@ static GOptionEntry cmd_entries[] =
       "Skip the stat() call on a --update, assumes if the filename is the same "
       "then the file is still the same (only use this if you're fairly "
       "trusting or gullible).", NULL },
+    { "xml-passthrough", 0, 0, G_OPTION_ARG_NONE, &(_cmd_options.xml_passthrough),
+      "On a --update, copy filelists and other xml of the unchanged packages "
+      "from the existing metadata instead of regenerating them. The existing "
+      "files have to be decompressed and scanned first, so this only pays off "
+      "when most of the packages are unchanged.", NULL },
     { "split", 0, 0, G_OPTION_ARG_NONE, &(_cmd_options.split),
       "Run in split media mode. Rather than pass a single directory, take a set of"
       "directories corresponding to different volumes in a media set. "
@@ -149,6 +158,14 @@ static GOptionEntry cmd_entries[] =
       "READ_PKGS_LIST" },
     { "workers", 0, 0, G_OPTION_ARG_INT, &(_cmd_options.workers),
       "Number of workers to spawn to read rpms.", NULL },
+    { "prefetch", 0, 0, G_OPTION_ARG_INT, &(_cmd_options.prefetch),
+      "Read ahead NUM packages queued for the workers, so the workers don't "
+      "have to wait for a slow (e.g. network) storage. "
+      "With this option the number of workers can match the number "
+      "of CPU cores. (Default: 0 - disabled)", "NUM" },
+    { "prefetch-engine", 0, 0, G_OPTION_ARG_STRING, &(_cmd_options.prefetch_engine),
+      "Engine used by --prefetch (\"auto\", \"threads\" or \"io_uring\"). "
+      "(Default: auto)", "ENGINE" },
     { "xz", 0, 0, G_OPTION_ARG_NONE, &(_cmd_options.xz_compression),
       "Use xz for repodata compression.", NULL },
     { "compress-type", 0, 0, G_OPTION_ARG_STRING, &(_cmd_options.compress_type),
@@ -161,6 +178,10 @@ static GOptionEntry cmd_entries[] =
       "Generate zchunk files as well as the standard repodata.", NULL },
     { "zck-dict-dir", 0, 0, G_OPTION_ARG_FILENAME, &(_cmd_options.zck_dict_dir),
       "Directory containing compression dictionaries for use by zchunk", "ZCK_DICT_DIR" },
+    { "zck-train-dict-dir", 0, 0, G_OPTION_ARG_FILENAME, &(_cmd_options.zck_train_dict_dir),
+      "Train new zchunk dictionaries from the chunks of this repository "
+      "and store them into this directory (must differ from --zck-dict-dir).",
+      "ZCK_TRAIN_DICT_DIR" },
 #endif
     { "keep-all-metadata", 0, 0, G_OPTION_ARG_NONE, &(_cmd_options.keep_all_metadata),
       "Keep groupfile and updateinfo from source repo during update.", NULL },
@@ -199,6 +220,16 @@ static GOptionEntry cmd_entries[] =
       "Checksum type to be used in repomd.xml", "CHECKSUM_TYPE"},
     { "error-exit-val", 0, 0, G_OPTION_ARG_NONE, &(_cmd_options.error_exit_val),
       "Exit with retval 2 if there were any errors during processing", NULL },
+    { "stats-file", 0, 0, G_OPTION_ARG_FILENAME, &(_cmd_options.stats_file),
+      "Write timing of the individual phases and per-worker statistics "
+      "(packages/s, bytes read, time spent waiting for the ordered writes, "
+      "cache hit ratio for --update) as a JSON report into this file.",
+      "STATS_FILE" },
+    { "snapshot", 0, 0, G_OPTION_ARG_NONE, &(_cmd_options.snapshot),
+      "Generate also a compact binary snapshot of the metadata. "
+      "The snapshot can be memory mapped. With --update, the snapshot "
+      "of the previous run is used instead of the XML files if its "
+      "checksum matches repomd.xml.", NULL },
     { NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL, NULL },
 };
 
@@ -352,6 +383,25 @@ check_arguments(struct CmdOptions *options,
         options->workers = DEFAULT_WORKERS;
     }
 
+    // Check prefetch
+    if (options->prefetch < 0) {
+        g_set_error(err, ERR_DOMAIN, CRE_BADARG,
+                    "--prefetch value must be a positive integer");
+        return FALSE;
+    }
+
+    if (options->prefetch_engine) {
+        cr_PrefetchEngine engine;
+        engine = cr_prefetch_engine_from_str(options->prefetch_engine);
+        if (engine == CR_PREFETCH_SENTINEL) {
+            g_set_error(err, ERR_DOMAIN, CRE_BADARG,
+                        "Unknown prefetch engine \"%s\"",
+                        options->prefetch_engine);
+            return FALSE;
+        }
+        options->prefetch_engine_type = engine;
+    }
+
     // Check changelog_limit
     if ((options->changelog_limit < -1)) {
         g_warning("Wrong changelog limit \"%d\" - Using 10", options->changelog_limit);
@@ -587,8 +637,40 @@ check_arguments(struct CmdOptions *options,
                     "Cannot use --zck-dict-dir without setting --zck");
         return FALSE;
     }
+    if (options->zck_train_dict_dir && !options->zck_compression) {
+        g_set_error(err, ERR_DOMAIN, CRE_BADARG,
+                    "Cannot use --zck-train-dict-dir without setting --zck");
+        return FALSE;
+    }
     if (options->zck_dict_dir)
         options->zck_dict_dir = cr_normalize_dir_path(options->zck_dict_dir);
+    if (options->zck_train_dict_dir) {
+        gchar *train_dir = cr_normalize_dir_path(options->zck_train_dict_dir);
+        g_free(options->zck_train_dict_dir);
+        options->zck_train_dict_dir = train_dir;
+    }
+
+    // Never overwrite the dictionaries the current run compresses with
+    if (options->zck_train_dict_dir && options->zck_dict_dir) {
+        char *dict_real = realpath(options->zck_dict_dir, NULL);
+        char *train_real = realpath(options->zck_train_dict_dir, NULL);
+        gboolean same;
+
+        if (dict_real && train_real)
+            same = !g_strcmp0(dict_real, train_real);
+        else
+            same = !g_strcmp0(options->zck_dict_dir,
+                              options->zck_train_dict_dir);
+        free(dict_real);
+        free(train_real);
+
+        if (same) {
+            g_set_error(err, ERR_DOMAIN, CRE_BADARG,
+                        "--zck-train-dict-dir must not be the same "
+                        "directory as --zck-dict-dir");
+            return FALSE;
+        }
+    }
 
     return TRUE;
 }
@@ -604,12 +686,15 @@ free_options(struct CmdOptions *options)
     g_free(options->pkglist);
     g_free(options->checksum);
     g_free(options->compress_type);
+    g_free(options->prefetch_engine);
     g_free(options->groupfile);
     g_free(options->groupfile_fullpath);
     g_free(options->revision);
     g_free(options->retain_old_md_by_age);
     g_free(options->cachedir);
     g_free(options->checksum_cachedir);
+    g_free(options->stats_file);
+    g_free(options->zck_train_dict_dir);
 
     g_strfreev(options->excludes);
     g_strfreev(options->includepkg);
@@ -23,6 +23,7 @@
 #include <glib.h>
 #include "checksum.h"
 #include "compression_wrapper.h"
+#include "prefetch.h"
 
 
 /**
@@ -46,6 +47,8 @@ struct CmdOptions {
     char **update_md_paths;     /*!< list of paths to repositories which should
                                      be used for update */
     gboolean skip_stat;         /*!< skip stat() call during --update */
+    gboolean xml_passthrough;   /*!< copy filelists and other xml
+                                     of the reused packages */
     gboolean split;             /*!< generate split media */
     gboolean version;           /*!< print program version */
     gboolean database;          /*!< create sqlite database metadata */
@@ -70,9 +73,15 @@ struct CmdOptions {
                                              time for timestamps */
     char *read_pkgs_list;       /*!< output the paths to pkgs actually read */
     gint workers;               /*!< number of threads to spawn */
+    gint prefetch;              /*!< number of packages to read ahead
+                                     (0 - disabled) */
+    char *prefetch_engine;      /*!< engine used for prefetching */
     gboolean xz_compression;    /*!< use xz for repodata compression */
     gboolean zck_compression;   /*!< generate zchunk files */
     char *zck_dict_dir;         /*!< directory with zchunk dictionaries */
+    char *zck_train_dict_dir;   /*!< directory to store zchunk dictionaries
+                                     trained from this repo into
+                                     (NULL - no training) */
     gboolean keep_all_metadata; /*!< keep groupfile and updateinfo from source
                                      repo during update */
     gboolean ignore_lock;       /*!< Ignore existing .repodata/ - remove it,
@@ -110,6 +119,9 @@ struct CmdOptions {
                                      during repodata generation. */
     gchar *repomd_checksum;     /*!< Checksum type for entries in repomd.xml */
     gboolean error_exit_val;        /*!< exit 2 on processing errors */
+    char *stats_file;           /*!< Path where to write the JSON report
+                                     with run statistics */
+    gboolean snapshot;          /*!< Generate binary snapshot */
 
     /* Items filled by check_arguments() */
 
@@ -126,6 +138,7 @@ struct CmdOptions {
     cr_ChecksumType repomd_checksum_type;   /*!< checksum type */
     cr_CompressionType compression_type;    /*!< compression type */
     cr_CompressionType general_compression_type; /*!< compression type */
+    cr_PrefetchEngine prefetch_engine_type; /*!< prefetch engine */
     gint64 md_max_age;          /*!< Max age of files in repodata/.
                                      Older files will be removed
                                      during --update.
@@ -86,6 +86,12 @@ LZMA_CHECK_SHA256
 #define XZ_DECODER_FLAGS        0
 #define XZ_BUFFER_SIZE          (1024*32)
 
+/* Number of threads of the XZ encoder, 0 is the default */
+static volatile gint xz_threads = 0;
+
+/* Override of xz_threads for files opened by the current thread */
+static GPrivate thread_xz_threads;
+
 #if ZLIB_VERNUM < 0x1240
 // XXX: Zlib has gzbuffer since 1.2.4
 #define gzbuffer(a,b) 0
@@ -281,6 +287,20 @@ cr_compression_suffix(cr_CompressionType comtype)
 }
 
 
+void
+cr_set_xz_threads(unsigned int threads)
+{
+    g_atomic_int_set(&xz_threads, (gint) threads);
+}
+
+
+void
+cr_set_thread_xz_threads(unsigned int threads)
+{
+    g_private_set(&thread_xz_threads, GUINT_TO_POINTER(threads));
+}
+
+
 static const char *
 cr_gz_strerror(gzFile f)
 {
@@ -512,19 +532,25 @@ cr_sopen(const char *filename,
                     .check = XZ_CHECK,
                 };
 
-                // Detect how many threads the CPU supports.
-                mt.threads = lzma_cputhreads();
-
-                // If the number of CPU cores/threads cannot be detected,
-                // use one thread.
+                mt.threads = GPOINTER_TO_UINT(g_private_get(&thread_xz_threads));
                 if (mt.threads == 0)
-                    mt.threads = 1;
-
-                // If the number of CPU cores/threads exceeds threads_max,
-                // limit the number of threads to keep memory usage lower.
-                const uint32_t threads_max = 2;
-                if (mt.threads > threads_max)
-                    mt.threads = threads_max;
+                    mt.threads = (uint32_t) g_atomic_int_get(&xz_threads);
+
+                if (mt.threads == 0) {
+                    // Detect how many threads the CPU supports.
+                    mt.threads = lzma_cputhreads();
+
+                    // If the number of CPU cores/threads cannot be detected,
+                    // use one thread.
+                    if (mt.threads == 0)
+                        mt.threads = 1;
+
+                    // If the number of CPU cores/threads exceeds threads_max,
+                    // limit the number of threads to keep memory usage lower.
+                    const uint32_t threads_max = 2;
+                    if (mt.threads > threads_max)
+                        mt.threads = threads_max;
+                }
 
                 if (mt.threads > 1)
                     // Initialize the threaded encoder
@@ -110,6 +110,20 @@ cr_CompressionType cr_detect_compression(const char* filename, GError **err);
  */
 cr_CompressionType cr_compression_type(const char *name);
 
+/** Set number of threads used by the XZ encoder. Has effect only
+ * if createrepo_c is built with ENABLE_THREADED_XZ_ENCODER.
+ * The setting is global, set it before the files are opened.
+ * @param threads   Number of threads or 0 for the default
+ *                  (number of CPUs, at most 2)
+ */
+void cr_set_xz_threads(unsigned int threads);
+
+/** Set number of threads used by the XZ encoder for files opened by
+ * the calling thread only. Overrides cr_set_xz_threads().
+ * @param threads   Number of threads or 0 to remove the override
+ */
+void cr_set_thread_xz_threads(unsigned int threads);
+
 /** Open/Create the specified file.
  * @param FILENAME      filename
  * @param MODE          open mode
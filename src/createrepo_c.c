@@ -45,6 +45,8 @@
 #include "parsepkg.h"
 #include "repomd.h"
 #include "sqlite.h"
+#include "stats.h"
+#include "string_pool.h"
 #include "threads.h"
 #include "version.h"
 #include "xml_dump.h"
@@ -116,6 +118,9 @@ task_cmp(gconstpointer a_p, gconstpointer b_p, G_GNUC_UNUSED gpointer user_data)
  *                          will be processed will be appended to.
  * @param output_pkg_list   File where relative paths of processed packages
  *                          will be writen to.
+ * @param prefetcher        Prefetcher which gets the packages registered
+ *                          in the same order as they are pushed into
+ *                          the pool (can be NULL).
  * @return                  Number of packages that are going to be processed
  */
 static long
@@ -125,7 +130,8 @@ fill_pool(GThreadPool *pool,
           GSList **current_pkglist,
           FILE *output_pkg_list,
           long *package_count,
-          int  media_id)
+          int  media_id,
+          cr_Prefetcher *prefetcher)
 {
     GQueue queue = G_QUEUE_INIT;
     struct PoolTask *task;
@@ -261,6 +267,8 @@ fill_pool(GThreadPool *pool,
     while ((task = g_queue_pop_head(&queue)) != NULL) {
         task->id = *package_count;
         task->media_id = media_id;
+        if (prefetcher)
+            cr_prefetcher_add(prefetcher, task->full_path);
         g_thread_pool_push(pool, task, NULL);
         ++*package_count;
     }
@@ -269,6 +277,61 @@ fill_pool(GThreadPool *pool,
 }
 
 
+/** Copy the filename index of the old metadata for prefetch_filter().
+ * The filter runs in the prefetcher threads, so it gets a table of its
+ * own which is never modified while they run. The packages themselves
+ * stay owned by the old metadata.
+ */
+static GHashTable *
+prefetch_old_pkgs_new(cr_Metadata *old_metadata)
+{
+    GHashTableIter iter;
+    gpointer key, value;
+    GHashTable *pkgs = g_hash_table_new(g_str_hash, g_str_equal);
+
+    g_hash_table_iter_init(&iter, cr_metadata_hashtable(old_metadata));
+    while (g_hash_table_iter_next(&iter, &key, &value))
+        g_hash_table_insert(pkgs, key, value);
+
+    return pkgs;
+}
+
+
+/** Prefetch filter. Packages whose old metadata will be reused
+ * (see cr_dumper_thread()) are not read by the dumper, so there is
+ * no point in prefetching them.
+ */
+static gboolean
+prefetch_filter(const char *path, void *user_data)
+{
+    struct UserData *udata = user_data;
+    cr_Package *md;
+    struct stat stat_buf;
+
+    if (udata->prefetch_old_pkgs)
+        md = g_hash_table_lookup(udata->prefetch_old_pkgs,
+                                 cr_get_filename(path));
+    else if (udata->old_metadata)
+        // Lazily loaded - cr_metadata_get() is thread safe
+        md = cr_metadata_get(udata->old_metadata, cr_get_filename(path), NULL);
+    else
+        return TRUE;
+
+    if (!md)
+        return TRUE;
+
+    if (udata->skip_stat)
+        return FALSE;
+
+    if (stat(path, &stat_buf) == -1)
+        return FALSE;
+
+    return !(stat_buf.st_mtime == md->time_file
+             && stat_buf.st_size == md->size_package
+             && !g_strcmp0(udata->checksum_type_str, md->checksum_type));
+}
+
+
 /** Prepare cache dir for checksums.
  * Called only if --cachedir options is used.
  * It tries to create cache directory if it doesn't exist yet.
@@ -322,6 +385,191 @@ prepare_cache_dir(struct CmdOptions *cmd_options,
 }
 
 
+/** State of the post-dump phase. All work done after the xml files
+ * are written (filling of the repomd records, compression of the sqlite
+ * databases, groupfile and updateinfo, renaming of the files) is
+ * a graph of tasks, every task starts as soon as its inputs are ready.
+ */
+typedef struct {
+    cr_TaskGraph *graph;
+    GSList *jobs;                   // List of PostDumpJob
+    cr_Stats *stats;
+    cr_ChecksumType checksum_type;
+} PostDump;
+
+/** A single task of the post-dump phase.
+ */
+typedef struct {
+    const char *name;               // Name of the task (and stats phase)
+    cr_TaskGraphTask *task;
+    PostDump *pd;
+    cr_RepomdRecord *rec;           // Filled (or renamed) record
+
+    // Compression of a file of an existing record
+    cr_RepomdRecord *crec;          // Record of the compressed file
+    cr_CompressionType comtype;
+    const char *zck_dict_dir;
+
+    // Sqlite database (rec is the record of the compressed db)
+    cr_SqliteDb *db;
+    cr_RepomdRecord *xml_rec;       // Record of the related xml file
+    const char *db_filename;        // Path of the uncompressed db
+    unsigned int xz_threads;        // Threads of the xz encoder, 0 default
+
+    // Binary snapshot (rec is the record of the snapshot)
+    cr_SnapshotWriter *snapshot;
+} PostDumpJob;
+
+static PostDumpJob *
+post_dump_add(PostDump *pd,
+              const char *name,
+              cr_TaskGraphFunc func,
+              cr_RepomdRecord *rec)
+{
+    PostDumpJob *job = g_new0(PostDumpJob, 1);
+    job->name = name;
+    job->pd = pd;
+    job->rec = rec;
+    job->task = cr_taskgraph_add(pd->graph, name, func, job);
+    pd->jobs = g_slist_prepend(pd->jobs, job);
+    return job;
+}
+
+static void
+post_dump_depends(PostDumpJob *job, PostDumpJob *dependency)
+{
+    if (job && dependency)
+        cr_taskgraph_depends(job->task, dependency->task);
+}
+
+static gboolean
+post_dump_fill(gpointer data, GError **err)
+{
+    PostDumpJob *job = data;
+    int ret;
+
+    cr_stats_phase_begin(job->pd->stats, job->name);
+    ret = cr_repomd_record_fill(job->rec, job->pd->checksum_type, err);
+    cr_stats_phase_end(job->pd->stats, job->name);
+
+    return ret == CRE_OK;
+}
+
+static gboolean
+post_dump_compress_and_fill(gpointer data, GError **err)
+{
+    PostDumpJob *job = data;
+    int ret;
+
+    cr_stats_phase_begin(job->pd->stats, job->name);
+    ret = cr_repomd_record_compress_and_fill(job->rec,
+                                             job->crec,
+                                             job->pd->checksum_type,
+                                             job->comtype,
+                                             job->zck_dict_dir,
+                                             err);
+    cr_stats_phase_end(job->pd->stats, job->name);
+
+    if (ret != CRE_OK)
+        g_prefix_error(err, "Cannot process %s: ", job->rec->location_real);
+    return ret == CRE_OK;
+}
+
+static gboolean
+post_dump_sqlite_index(gpointer data, GError **err)
+{
+    PostDumpJob *job = data;
+    int ret;
+
+    cr_stats_phase_begin(job->pd->stats, job->name);
+    ret = cr_db_index(job->db, err);
+    cr_stats_phase_end(job->pd->stats, job->name);
+
+    return ret == CRE_OK;
+}
+
+static gboolean
+post_dump_sqlite(gpointer data, GError **err)
+{
+    PostDumpJob *job = data;
+    cr_ContentStat *stat;
+    gchar *dst;
+    int ret;
+
+    cr_stats_phase_begin(job->pd->stats, job->name);
+
+    // The db refers to the checksum of its xml file
+    ret = cr_db_dbinfo_update(job->db, job->xml_rec->checksum, err);
+    if (ret == CRE_OK)
+        ret = cr_db_close(job->db, err);
+    else
+        cr_db_close(job->db, NULL);
+    job->db = NULL;
+
+    if (ret == CRE_OK) {
+        stat = cr_contentstat_new(job->pd->checksum_type, NULL);
+        dst = g_strdup(job->rec->location_real);
+        cr_set_thread_xz_threads(job->xz_threads);
+        ret = cr_compress_file_with_stat(job->db_filename, &dst, job->comtype,
+                                         stat, NULL, FALSE, err);
+        cr_set_thread_xz_threads(0);
+        if (ret == CRE_OK) {
+            remove(job->db_filename);
+            cr_repomd_record_load_contentstat(job->rec, stat);
+            ret = cr_repomd_record_fill(job->rec, job->pd->checksum_type, err);
+        }
+        cr_contentstat_free(stat, NULL);
+        g_free(dst);
+    }
+
+    cr_stats_phase_end(job->pd->stats, job->name);
+    return ret == CRE_OK;
+}
+
+static gboolean
+post_dump_snapshot(gpointer data, GError **err)
+{
+    PostDumpJob *job = data;
+    gboolean ret;
+
+    cr_stats_phase_begin(job->pd->stats, job->name);
+    ret = cr_snapshot_writer_write(job->snapshot,
+                                   job->rec->location_real,
+                                   err)
+          && cr_repomd_record_fill(job->rec,
+                                   job->pd->checksum_type,
+                                   err) == CRE_OK;
+    cr_stats_phase_end(job->pd->stats, job->name);
+
+    return ret;
+}
+
+static gboolean
+post_dump_rename(gpointer data, GError **err)
+{
+    PostDumpJob *job = data;
+    return cr_repomd_record_rename_file(job->rec, err) == CRE_OK;
+}
+
+/** Rename the record's file when all tasks which use the file are done.
+ */
+static void
+post_dump_add_rename(PostDump *pd,
+                     cr_RepomdRecord *rec,
+                     PostDumpJob *dep1,
+                     PostDumpJob *dep2)
+{
+    PostDumpJob *job;
+
+    if (!rec)
+        return;
+
+    job = post_dump_add(pd, "rename", post_dump_rename, rec);
+    post_dump_depends(job, dep1);
+    post_dump_depends(job, dep2);
+}
+
+
 int
 main(int argc, char **argv)
 {
@@ -470,6 +718,10 @@ main(int argc, char **argv)
 
     // Thread pool - Creation
     struct UserData user_data = {0};
+    if (cmd_options->stats_file) {
+        user_data.stats = cr_stats_new();
+        cr_stats_set_int(user_data.stats, "workers", cmd_options->workers);
+    }
     g_thread_init(NULL);
     GThreadPool *pool = g_thread_pool_new(cr_dumper_thread,
                                           &user_data,
@@ -478,10 +730,29 @@ main(int argc, char **argv)
                                           NULL);
     g_debug("Thread pool ready");
 
+    // Prefetcher - Creation
+    if (cmd_options->prefetch) {
+        user_data.prefetcher = cr_prefetcher_new(cmd_options->prefetch_engine_type,
+                                                 cmd_options->prefetch,
+                                                 cmd_options->workers,
+                                                 prefetch_filter,
+                                                 &user_data,
+                                                 &tmp_err);
+        if (!user_data.prefetcher) {
+            g_critical("Cannot initialize prefetching: %s", tmp_err->message);
+            g_clear_error(&tmp_err);
+            exit(EXIT_FAILURE);
+        }
+        g_debug("Prefetcher ready (%s engine, %d packages ahead)",
+                cr_prefetcher_engine_name(user_data.prefetcher),
+                cmd_options->prefetch);
+    }
+
     long package_count = 0;
     GSList *current_pkglist = NULL;
     /* ^^^ List with basenames of files which will be processed */
 
+    cr_stats_phase_begin(user_data.stats, "walk");
     for (int media_id = 1; media_id < argc; media_id++ ) {
         gchar *tmp_in_dir = cr_normalize_dir_path(argv[media_id]);
         // Thread pool - Fill with tasks
@@ -491,10 +762,14 @@ main(int argc, char **argv)
                   &current_pkglist,
                   output_pkg_list,
                   &package_count,
-                  media_id);
+                  media_id,
+                  user_data.prefetcher);
         g_free(tmp_in_dir);
     }
 
+    cr_stats_phase_end(user_data.stats, "walk");
+    cr_stats_set_int(user_data.stats, "package_count", package_count);
+
     g_debug("Package count: %ld", package_count);
     g_message("Directory walk done - %ld packages", package_count);
 
@@ -504,15 +779,28 @@ main(int argc, char **argv)
 
     // Load old metadata if --update
     cr_Metadata *old_metadata = NULL;
+    cr_StringPool *old_metadata_pool = NULL;
     struct cr_MetadataLocation *old_metadata_location = NULL;
+    gchar *old_zck_paths[3] = { NULL, NULL, NULL };
 
     if (!package_count)
         g_debug("No packages found - skipping metadata loading");
 
     if (package_count && cmd_options->update) {
         int ret;
+        cr_stats_phase_begin(user_data.stats, "old_metadata");
         old_metadata = cr_metadata_new(CR_HT_KEY_FILENAME, 1, current_pkglist);
         cr_metadata_set_dupaction(old_metadata, CR_HT_DUPACT_REMOVEALL);
+        // Only the packages which are still in the repo and unchanged
+        // are parsed (by the dumper). The snapshot is loaded as a whole.
+        cr_metadata_set_lazy(old_metadata, !cmd_options->snapshot);
+        // Filelists and other of the unchanged packages are copied
+        cr_metadata_set_keep_xml(old_metadata, cmd_options->xml_passthrough);
+        // Snapshot written by a previous --snapshot run
+        cr_metadata_set_use_snapshot(old_metadata, cmd_options->snapshot);
+        // Strings repeated across the old packages are stored only once
+        old_metadata_pool = cr_string_pool_new();
+        cr_string_pool_set_default(old_metadata_pool);
 
         if (cmd_options->outputdir)
             old_metadata_location = cr_locate_metadata(out_dir, TRUE, NULL);
@@ -553,8 +841,22 @@ main(int argc, char **argv)
             }
         }
 
-        g_message("Loaded information about %d packages",
-                  g_hash_table_size(cr_metadata_hashtable(old_metadata)));
+        cr_string_pool_set_default(NULL);
+
+        cr_StringPoolStats pool_stats;
+        cr_string_pool_get_stats(old_metadata_pool, &pool_stats);
+        g_debug("String pool: %"G_GINT64_FORMAT" unique strings "
+                "(%"G_GINT64_FORMAT" bytes), %"G_GINT64_FORMAT" bytes saved",
+                pool_stats.strings, pool_stats.bytes,
+                pool_stats.saved_bytes - pool_stats.overhead);
+        cr_stats_set_int(user_data.stats, "string_pool_strings",
+                         pool_stats.strings);
+        cr_stats_set_int(user_data.stats, "string_pool_saved_bytes",
+                         pool_stats.saved_bytes - pool_stats.overhead);
+
+        g_message("Loaded information about %u packages",
+                  cr_metadata_count(old_metadata));
+        cr_stats_phase_end(user_data.stats, "old_metadata");
     }
 
     g_slist_free(current_pkglist);
@@ -625,6 +927,16 @@ main(int argc, char **argv)
         }
     }
 
+    // Remember the previous zchunk files
+    if (cmd_options->zck_compression && old_metadata_location) {
+        char *hrefs[] = { old_metadata_location->pri_zck_href,
+                          old_metadata_location->fil_zck_href,
+                          old_metadata_location->oth_zck_href };
+        for (int x = 0; x < 3; x++)
+            if (hrefs[x] && g_file_test(hrefs[x], G_FILE_TEST_IS_REGULAR))
+                old_zck_paths[x] = g_strdup(hrefs[x]);
+    }
+
     cr_metadatalocation_free(old_metadata_location);
     old_metadata_location = NULL;
 
@@ -964,6 +1276,24 @@ main(int argc, char **argv)
         cr_xmlfile_set_num_of_pkgs(oth_cr_zck, package_count, NULL);
     }
 
+    // Zchunk writers - chunks are compressed out of the dumper threads
+    if (cmd_options->zck_compression) {
+        gboolean train = cmd_options->zck_train_dict_dir != NULL;
+        user_data.pri_zck = cr_zck_writer_new(pri_cr_zck, "primary",
+                                              train, &tmp_err);
+        if (!tmp_err)
+            user_data.fil_zck = cr_zck_writer_new(fil_cr_zck, "filelists",
+                                                  train, &tmp_err);
+        if (!tmp_err)
+            user_data.oth_zck = cr_zck_writer_new(oth_cr_zck, "other",
+                                                  train, &tmp_err);
+        if (tmp_err) {
+            g_critical("%s", tmp_err->message);
+            g_clear_error(&tmp_err);
+            exit(EXIT_FAILURE);
+        }
+    }
+
     // Thread pool - User data initialization
     user_data.pri_f             = pri_cr_file;
     user_data.fil_f             = fil_cr_file;
@@ -971,9 +1301,6 @@ main(int argc, char **argv)
     user_data.pri_db            = pri_db;
     user_data.fil_db            = fil_db;
     user_data.oth_db            = oth_db;
-    user_data.pri_zck           = pri_cr_zck;
-    user_data.fil_zck           = fil_cr_zck;
-    user_data.oth_zck           = oth_cr_zck;
     user_data.changelog_limit   = cmd_options->changelog_limit;
     user_data.location_base     = cmd_options->location_base;
     user_data.checksum_type_str = cr_checksum_name_str(cmd_options->checksum_type);
@@ -984,6 +1311,7 @@ main(int argc, char **argv)
     user_data.package_count     = package_count;
     user_data.skip_stat         = cmd_options->skip_stat;
     user_data.old_metadata      = old_metadata;
+    user_data.xml_passthrough   = cmd_options->xml_passthrough;
     user_data.mutex_pri         = g_mutex_new();
     user_data.mutex_fil         = g_mutex_new();
     user_data.mutex_oth         = g_mutex_new();
@@ -1002,15 +1330,79 @@ main(int argc, char **argv)
     user_data.cut_dirs          = cmd_options->cut_dirs;
     user_data.location_prefix   = cmd_options->location_prefix;
     user_data.had_errors        = 0;
+    if (cmd_options->snapshot)
+        user_data.snapshot      = cr_snapshot_writer_new();
+
+    // The prefetcher doesn't read anything before the first worker
+    // advances it, so the copy is complete before the filter uses it.
+    // Lazily loaded metadata have nothing to copy, the filter gets
+    // the packages from them directly.
+    if (user_data.prefetcher && old_metadata && cmd_options->snapshot)
+        user_data.prefetch_old_pkgs = prefetch_old_pkgs_new(old_metadata);
 
     g_debug("Thread pool user data ready");
 
     // Start pool
+    cr_stats_phase_begin(user_data.stats, "dump");
     g_thread_pool_set_max_threads(pool, cmd_options->workers, NULL);
     g_message("Pool started (with %d workers)", cmd_options->workers);
 
     // Wait until pool is finished
     g_thread_pool_free(pool, FALSE, TRUE);
+    cr_stats_phase_end(user_data.stats, "dump");
+
+    cr_prefetcher_free(user_data.prefetcher);
+    user_data.prefetcher = NULL;
+    if (user_data.prefetch_old_pkgs)
+        g_hash_table_destroy(user_data.prefetch_old_pkgs);
+    user_data.prefetch_old_pkgs = NULL;
+
+    if (cmd_options->zck_compression) {
+        cr_ZckWriter *zck_writers[] = {
+            user_data.pri_zck, user_data.fil_zck, user_data.oth_zck
+        };
+        const char *zck_dict_names[] = {
+            "primary.xml", "filelists.xml", "other.xml"
+        };
+
+        // Wait until all chunks are compressed
+        for (int x = 0; x < 3; x++) {
+            if (!cr_zck_writer_finish(zck_writers[x], &tmp_err)) {
+                g_critical("%s", tmp_err->message);
+                user_data.had_errors = TRUE;
+                g_clear_error(&tmp_err);
+            }
+        }
+
+        if (cmd_options->zck_train_dict_dir) {
+            cr_stats_phase_begin(user_data.stats, "zck_train_dict");
+            if (g_mkdir_with_parents(cmd_options->zck_train_dict_dir, 0755))
+                g_warning("Cannot create %s: %s",
+                          cmd_options->zck_train_dict_dir, g_strerror(errno));
+            for (int x = 0; x < 3; x++) {
+                gchar *dict_name = g_strconcat(zck_dict_names[x], ".zdict", NULL);
+                gchar *dict_path = g_build_filename(cmd_options->zck_train_dict_dir,
+                                                    dict_name, NULL);
+                if (cr_zck_writer_train_dict(zck_writers[x], dict_path,
+                                             &tmp_err) != CRE_OK) {
+                    g_warning("Zchunk dictionary not trained: %s",
+                              tmp_err->message);
+                    g_clear_error(&tmp_err);
+                } else {
+                    g_message("Zchunk dictionary %s trained", dict_path);
+                }
+                g_free(dict_name);
+                g_free(dict_path);
+            }
+            cr_stats_phase_end(user_data.stats, "zck_train_dict");
+        }
+
+        for (int x = 0; x < 3; x++)
+            cr_zck_writer_free(zck_writers[x]);
+        user_data.pri_zck = NULL;
+        user_data.fil_zck = NULL;
+        user_data.oth_zck = NULL;
+    }
 
     // if there were any errors, exit nonzero
     if ( cmd_options->error_exit_val && user_data.had_errors ) {
@@ -1021,6 +1413,7 @@ main(int argc, char **argv)
 
     cr_xml_dump_cleanup();
 
+    cr_stats_phase_begin(user_data.stats, "xml_close");
     cr_xmlfile_close(pri_cr_file, NULL);
     cr_xmlfile_close(fil_cr_file, NULL);
     cr_xmlfile_close(oth_cr_file, NULL);
@@ -1047,6 +1440,40 @@ main(int argc, char **argv)
         exit(EXIT_FAILURE);
     }
 
+    if (cmd_options->zck_compression) {
+        // Report how many chunks the clients of the previous version
+        // of the repository don't have to download
+        gchar *new_zck_paths[] = {
+            pri_zck_filename, fil_zck_filename, oth_zck_filename
+        };
+        const char *stats_keys[] = {
+            "primary_zck_reused_chunks",
+            "filelists_zck_reused_chunks",
+            "other_zck_reused_chunks",
+        };
+        for (int x = 0; x < 3; x++) {
+            gint64 reused, total;
+            if (!old_zck_paths[x])
+                continue;
+            if (cr_zck_count_reused_chunks(old_zck_paths[x],
+                                           new_zck_paths[x],
+                                           &reused, &total,
+                                           &tmp_err) != CRE_OK) {
+                g_debug("Cannot compare zchunk files: %s", tmp_err->message);
+                g_clear_error(&tmp_err);
+                continue;
+            }
+            g_message("%s: %" G_GINT64_FORMAT " of %" G_GINT64_FORMAT
+                      " chunks unchanged", cr_get_filename(new_zck_paths[x]),
+                      reused, total);
+            cr_stats_set_int(user_data.stats, stats_keys[x], reused);
+        }
+    }
+    for (int x = 0; x < 3; x++)
+        g_free(old_zck_paths[x]);
+
+    cr_stats_phase_end(user_data.stats, "xml_close");
+
     g_queue_free(user_data.buffer);
     g_mutex_free(user_data.mutex_buffer);
     g_cond_free(user_data.cond_pri);
@@ -1059,6 +1486,7 @@ main(int argc, char **argv)
 
     // Create repomd records for each file
     g_debug("Generating repomd.xml");
+    cr_stats_phase_begin(user_data.stats, "repomd_records");
 
     cr_Repomd *repomd_obj = cr_repomd_new();
 
@@ -1078,6 +1506,7 @@ main(int argc, char **argv)
     cr_RepomdRecord *updateinfo_zck_rec       = NULL;
     cr_RepomdRecord *prestodelta_rec          = NULL;
     cr_RepomdRecord *prestodelta_zck_rec      = NULL;
+    cr_RepomdRecord *snapshot_rec             = NULL;
 
     // XML
     cr_repomd_record_load_contentstat(pri_xml_rec, pri_stat);
@@ -1088,71 +1517,55 @@ main(int argc, char **argv)
     cr_contentstat_free(fil_stat, NULL);
     cr_contentstat_free(oth_stat, NULL);
 
-    GThreadPool *fill_pool = g_thread_pool_new(cr_repomd_record_fill_thread,
-                                               NULL, 3, FALSE, NULL);
-
-    cr_RepomdRecordFillTask *pri_fill_task;
-    cr_RepomdRecordFillTask *fil_fill_task;
-    cr_RepomdRecordFillTask *oth_fill_task;
-
-    pri_fill_task = cr_repomdrecordfilltask_new(pri_xml_rec,
-                                                cmd_options->repomd_checksum_type,
-                                                NULL);
-    g_thread_pool_push(fill_pool, pri_fill_task, NULL);
-
-    fil_fill_task = cr_repomdrecordfilltask_new(fil_xml_rec,
-                                                cmd_options->repomd_checksum_type,
-                                                NULL);
-    g_thread_pool_push(fill_pool, fil_fill_task, NULL);
-
-    oth_fill_task = cr_repomdrecordfilltask_new(oth_xml_rec,
-                                                cmd_options->repomd_checksum_type,
-                                                NULL);
-    g_thread_pool_push(fill_pool, oth_fill_task, NULL);
+    // All the post-dump work is a single graph of tasks
+    PostDump post_dump = { 0 };
+    post_dump.graph = cr_taskgraph_new();
+    post_dump.stats = user_data.stats;
+    post_dump.checksum_type = cmd_options->repomd_checksum_type;
+
+    PostDumpJob *pri_xml_job, *fil_xml_job, *oth_xml_job;
+    PostDumpJob *pri_db_job = NULL, *fil_db_job = NULL, *oth_db_job = NULL;
+    PostDumpJob *pri_idx_job, *fil_idx_job, *oth_idx_job;
+    PostDumpJob *pri_zck_job = NULL, *fil_zck_job = NULL, *oth_zck_job = NULL;
+    PostDumpJob *groupfile_job = NULL, *groupfile_zck_job = NULL;
+    PostDumpJob *updateinfo_job = NULL, *updateinfo_zck_job = NULL;
+    PostDumpJob *snapshot_job = NULL;
+    gchar *snapshot_filename = NULL;
+
+    pri_xml_job = post_dump_add(&post_dump, "primary_xml", post_dump_fill, pri_xml_rec);
+    fil_xml_job = post_dump_add(&post_dump, "filelists_xml", post_dump_fill, fil_xml_rec);
+    oth_xml_job = post_dump_add(&post_dump, "other_xml", post_dump_fill, oth_xml_rec);
 
     // Groupfile
     if (groupfile) {
         groupfile_rec = cr_repomd_record_new("group", groupfile);
         compressed_groupfile_rec = cr_repomd_record_new("group_gz", groupfile);
-        cr_repomd_record_compress_and_fill(groupfile_rec,
-                                          compressed_groupfile_rec,
-                                          cmd_options->repomd_checksum_type,
-                                          groupfile_compression,
-                                          NULL,
-                                          &tmp_err);
-        if (tmp_err) {
-            g_critical("Cannot process groupfile %s: %s",
-                       groupfile, tmp_err->message);
-            g_clear_error(&tmp_err);
-            exit(EXIT_FAILURE);
-        }
+        groupfile_job = post_dump_add(&post_dump, "group",
+                                      post_dump_compress_and_fill,
+                                      groupfile_rec);
+        groupfile_job->crec = compressed_groupfile_rec;
+        groupfile_job->comtype = groupfile_compression;
     }
 
-
     // Updateinfo
     if (updateinfo) {
         updateinfo_rec = cr_repomd_record_new("updateinfo", updateinfo);
-        cr_repomd_record_fill(updateinfo_rec,
-                              cmd_options->repomd_checksum_type,
-                              &tmp_err);
-        if (tmp_err) {
-            g_critical("Cannot process updateinfo %s: %s",
-                       updateinfo, tmp_err->message);
-            g_clear_error(&tmp_err);
-            exit(EXIT_FAILURE);
-        }
+        updateinfo_job = post_dump_add(&post_dump, "updateinfo",
+                                       post_dump_fill, updateinfo_rec);
     }
 
-    // Wait till repomd record fill task of xml files ends.
-    g_thread_pool_free(fill_pool, FALSE, TRUE);
-
-    cr_repomdrecordfilltask_free(pri_fill_task, NULL);
-    cr_repomdrecordfilltask_free(fil_fill_task, NULL);
-    cr_repomdrecordfilltask_free(oth_fill_task, NULL);
+    // Binary snapshot
+    if (user_data.snapshot) {
+        snapshot_filename = g_strconcat(tmp_out_repo, CR_SNAPSHOT_FILENAME, NULL);
+        snapshot_rec = cr_repomd_record_new(CR_SNAPSHOT_RECORD_TYPE,
+                                            snapshot_filename);
+        snapshot_job = post_dump_add(&post_dump, "snapshot",
+                                     post_dump_snapshot, snapshot_rec);
+        snapshot_job->snapshot = user_data.snapshot;
+    }
 
     // Sqlite db
     if (!cmd_options->no_database) {
-
         gchar *pri_db_name = g_strconcat(tmp_out_repo, "/primary.sqlite",
                                          sqlite_compression_suffix, NULL);
         gchar *fil_db_name = g_strconcat(tmp_out_repo, "/filelists.sqlite",
@@ -1160,53 +1573,6 @@ main(int argc, char **argv)
         gchar *oth_db_name = g_strconcat(tmp_out_repo, "/other.sqlite",
                                          sqlite_compression_suffix, NULL);
 
-        cr_db_dbinfo_update(pri_db, pri_xml_rec->checksum, NULL);
-        cr_db_dbinfo_update(fil_db, fil_xml_rec->checksum, NULL);
-        cr_db_dbinfo_update(oth_db, oth_xml_rec->checksum, NULL);
-
-        cr_db_close(pri_db, NULL);
-        cr_db_close(fil_db, NULL);
-        cr_db_close(oth_db, NULL);
-
-
-        // Compress dbs
-        GThreadPool *compress_pool =  g_thread_pool_new(cr_compressing_thread,
-                                                        NULL, 3, FALSE, NULL);
-
-        cr_CompressionTask *pri_db_task;
-        cr_CompressionTask *fil_db_task;
-        cr_CompressionTask *oth_db_task;
-
-        pri_db_task = cr_compressiontask_new(pri_db_filename,
-                                             pri_db_name,
-                                             sqlite_compression,
-                                             cmd_options->repomd_checksum_type,
-                                             NULL, FALSE, 1, NULL);
-        g_thread_pool_push(compress_pool, pri_db_task, NULL);
-
-        fil_db_task = cr_compressiontask_new(fil_db_filename,
-                                             fil_db_name,
-                                             sqlite_compression,
-                                             cmd_options->repomd_checksum_type,
-                                             NULL, FALSE, 1, NULL);
-        g_thread_pool_push(compress_pool, fil_db_task, NULL);
-
-        oth_db_task = cr_compressiontask_new(oth_db_filename,
-                                             oth_db_name,
-                                             sqlite_compression,
-                                             cmd_options->repomd_checksum_type,
-                                             NULL, FALSE, 1, NULL);
-        g_thread_pool_push(compress_pool, oth_db_task, NULL);
-
-        g_thread_pool_free(compress_pool, FALSE, TRUE);
-
-        if (!cmd_options->local_sqlite) {
-            cr_rm(pri_db_filename, CR_RM_FORCE, NULL, NULL);
-            cr_rm(fil_db_filename, CR_RM_FORCE, NULL, NULL);
-            cr_rm(oth_db_filename, CR_RM_FORCE, NULL, NULL);
-        }
-
-        // Prepare repomd records
         pri_db_rec = cr_repomd_record_new("primary_db", pri_db_name);
         fil_db_rec = cr_repomd_record_new("filelists_db", fil_db_name);
         oth_db_rec = cr_repomd_record_new("other_db", oth_db_name);
@@ -1215,46 +1581,54 @@ main(int argc, char **argv)
         g_free(fil_db_name);
         g_free(oth_db_name);
 
-        cr_repomd_record_load_contentstat(pri_db_rec, pri_db_task->stat);
-        cr_repomd_record_load_contentstat(fil_db_rec, fil_db_task->stat);
-        cr_repomd_record_load_contentstat(oth_db_rec, oth_db_task->stat);
-
-        cr_compressiontask_free(pri_db_task, NULL);
-        cr_compressiontask_free(fil_db_task, NULL);
-        cr_compressiontask_free(oth_db_task, NULL);
-
-        fill_pool = g_thread_pool_new(cr_repomd_record_fill_thread,
-                                      NULL, 3, FALSE, NULL);
-
-        cr_RepomdRecordFillTask *pri_db_fill_task;
-        cr_RepomdRecordFillTask *fil_db_fill_task;
-        cr_RepomdRecordFillTask *oth_db_fill_task;
-
-        pri_db_fill_task = cr_repomdrecordfilltask_new(pri_db_rec,
-                                                       cmd_options->repomd_checksum_type,
-                                                       NULL);
-        g_thread_pool_push(fill_pool, pri_db_fill_task, NULL);
-
-        fil_db_fill_task = cr_repomdrecordfilltask_new(fil_db_rec,
-                                                       cmd_options->repomd_checksum_type,
-                                                       NULL);
-        g_thread_pool_push(fill_pool, fil_db_fill_task, NULL);
-
-        oth_db_fill_task = cr_repomdrecordfilltask_new(oth_db_rec,
-                                                       cmd_options->repomd_checksum_type,
-                                                       NULL);
-        g_thread_pool_push(fill_pool, oth_db_fill_task, NULL);
-
-        g_thread_pool_free(fill_pool, FALSE, TRUE);
-
-        cr_repomdrecordfilltask_free(pri_db_fill_task, NULL);
-        cr_repomdrecordfilltask_free(fil_db_fill_task, NULL);
-        cr_repomdrecordfilltask_free(oth_db_fill_task, NULL);
+        // Indexes are built while the checksums of the xml files
+        // are calculated
+        pri_idx_job = post_dump_add(&post_dump, "primary_db_index",
+                                    post_dump_sqlite_index, NULL);
+        pri_idx_job->db = pri_db;
+        fil_idx_job = post_dump_add(&post_dump, "filelists_db_index",
+                                    post_dump_sqlite_index, NULL);
+        fil_idx_job->db = fil_db;
+        oth_idx_job = post_dump_add(&post_dump, "other_db_index",
+                                    post_dump_sqlite_index, NULL);
+        oth_idx_job->db = oth_db;
+
+        // A db can be closed when the checksum of its xml file is known,
+        // its compression starts right after that
+        pri_db_job = post_dump_add(&post_dump, "primary_db", post_dump_sqlite, pri_db_rec);
+        pri_db_job->db = pri_db;
+        pri_db_job->xml_rec = pri_xml_rec;
+        pri_db_job->db_filename = pri_db_filename;
+        pri_db_job->comtype = sqlite_compression;
+        post_dump_depends(pri_db_job, pri_xml_job);
+        post_dump_depends(pri_db_job, pri_idx_job);
+
+        fil_db_job = post_dump_add(&post_dump, "filelists_db", post_dump_sqlite, fil_db_rec);
+        fil_db_job->db = fil_db;
+        fil_db_job->xml_rec = fil_xml_rec;
+        fil_db_job->db_filename = fil_db_filename;
+        fil_db_job->comtype = sqlite_compression;
+        post_dump_depends(fil_db_job, fil_xml_job);
+        post_dump_depends(fil_db_job, fil_idx_job);
+
+        oth_db_job = post_dump_add(&post_dump, "other_db", post_dump_sqlite, oth_db_rec);
+        oth_db_job->db = oth_db;
+        oth_db_job->xml_rec = oth_xml_rec;
+        oth_db_job->db_filename = oth_db_filename;
+        oth_db_job->comtype = sqlite_compression;
+        post_dump_depends(oth_db_job, oth_xml_job);
+        post_dump_depends(oth_db_job, oth_idx_job);
+
+        // The dbs are compressed at the same time, split the threads
+        // of the xz encoder among them, but never go below the 2 threads
+        // the encoder uses by default. Other compressions keep the default.
+        pri_db_job->xz_threads = MAX(cmd_options->workers / 3, 2);
+        fil_db_job->xz_threads = pri_db_job->xz_threads;
+        oth_db_job->xz_threads = pri_db_job->xz_threads;
     }
 
     // Zchunk
     if (cmd_options->zck_compression) {
-        // Prepare repomd records
         pri_zck_rec = cr_repomd_record_new("primary_zck", pri_zck_filename);
         fil_zck_rec = cr_repomd_record_new("filelists_zck", fil_zck_filename);
         oth_zck_rec = cr_repomd_record_new("other_zck", oth_zck_filename);
@@ -1263,49 +1637,21 @@ main(int argc, char **argv)
         cr_repomd_record_load_zck_contentstat(fil_zck_rec, fil_zck_stat);
         cr_repomd_record_load_zck_contentstat(oth_zck_rec, oth_zck_stat);
 
-        fill_pool = g_thread_pool_new(cr_repomd_record_fill_thread,
-                                      NULL, 3, FALSE, NULL);
-
-        cr_RepomdRecordFillTask *pri_zck_fill_task;
-        cr_RepomdRecordFillTask *fil_zck_fill_task;
-        cr_RepomdRecordFillTask *oth_zck_fill_task;
-
-        pri_zck_fill_task = cr_repomdrecordfilltask_new(pri_zck_rec,
-                                                       cmd_options->repomd_checksum_type,
-                                                       NULL);
-        g_thread_pool_push(fill_pool, pri_zck_fill_task, NULL);
-
-        fil_zck_fill_task = cr_repomdrecordfilltask_new(fil_zck_rec,
-                                                       cmd_options->repomd_checksum_type,
-                                                       NULL);
-        g_thread_pool_push(fill_pool, fil_zck_fill_task, NULL);
-
-        oth_zck_fill_task = cr_repomdrecordfilltask_new(oth_zck_rec,
-                                                       cmd_options->repomd_checksum_type,
-                                                       NULL);
-        g_thread_pool_push(fill_pool, oth_zck_fill_task, NULL);
-
-        g_thread_pool_free(fill_pool, FALSE, TRUE);
-
-        cr_repomdrecordfilltask_free(pri_zck_fill_task, NULL);
-        cr_repomdrecordfilltask_free(fil_zck_fill_task, NULL);
-        cr_repomdrecordfilltask_free(oth_zck_fill_task, NULL);
+        pri_zck_job = post_dump_add(&post_dump, "primary_zck", post_dump_fill, pri_zck_rec);
+        fil_zck_job = post_dump_add(&post_dump, "filelists_zck", post_dump_fill, fil_zck_rec);
+        oth_zck_job = post_dump_add(&post_dump, "other_zck", post_dump_fill, oth_zck_rec);
 
         // Group file
         if (groupfile && groupfile_compression != CR_CW_ZCK_COMPRESSION) {
             compressed_groupfile_zck_rec = cr_repomd_record_new("group_gz_zck", groupfile);
-            cr_repomd_record_compress_and_fill(groupfile_rec,
-                                          compressed_groupfile_zck_rec,
-                                          cmd_options->repomd_checksum_type,
-                                          CR_CW_ZCK_COMPRESSION,
-                                          cmd_options->zck_dict_dir,
-                                          &tmp_err);
-            if (tmp_err) {
-                g_critical("Cannot process groupfile %s: %s",
-                           groupfile, tmp_err->message);
-                g_clear_error(&tmp_err);
-                exit(EXIT_FAILURE);
-            }
+            // Both compressions fill the groupfile_rec, run them one by one
+            groupfile_zck_job = post_dump_add(&post_dump, "group_zck",
+                                              post_dump_compress_and_fill,
+                                              groupfile_rec);
+            groupfile_zck_job->crec = compressed_groupfile_zck_rec;
+            groupfile_zck_job->comtype = CR_CW_ZCK_COMPRESSION;
+            groupfile_zck_job->zck_dict_dir = cmd_options->zck_dict_dir;
+            post_dump_depends(groupfile_zck_job, groupfile_job);
         }
 
         // Updateinfo
@@ -1320,21 +1666,52 @@ main(int argc, char **argv)
             /* Only create updateinfo_zck if updateinfo isn't already zchunk */
             if (com_type != CR_CW_ZCK_COMPRESSION) {
                 updateinfo_zck_rec = cr_repomd_record_new("updateinfo_zck", updateinfo);
-                cr_repomd_record_compress_and_fill(updateinfo_rec,
-                                      updateinfo_zck_rec,
-                                      cmd_options->repomd_checksum_type,
-                                      CR_CW_ZCK_COMPRESSION,
-                                      cmd_options->zck_dict_dir,
-                                      &tmp_err);
-                if (tmp_err) {
-                    g_critical("Cannot process updateinfo %s: %s",
-                               updateinfo, tmp_err->message);
-                    g_clear_error(&tmp_err);
-                    exit(EXIT_FAILURE);
-                }
+                updateinfo_zck_job = post_dump_add(&post_dump, "updateinfo_zck",
+                                                   post_dump_compress_and_fill,
+                                                   updateinfo_rec);
+                updateinfo_zck_job->crec = updateinfo_zck_rec;
+                updateinfo_zck_job->comtype = CR_CW_ZCK_COMPRESSION;
+                updateinfo_zck_job->zck_dict_dir = cmd_options->zck_dict_dir;
+                post_dump_depends(updateinfo_zck_job, updateinfo_job);
             }
         }
     }
+
+    // Add checksums into files names
+    if (cmd_options->unique_md_filenames) {
+        post_dump_add_rename(&post_dump, pri_xml_rec, pri_xml_job, pri_db_job);
+        post_dump_add_rename(&post_dump, fil_xml_rec, fil_xml_job, fil_db_job);
+        post_dump_add_rename(&post_dump, oth_xml_rec, oth_xml_job, oth_db_job);
+        post_dump_add_rename(&post_dump, pri_db_rec, pri_db_job, NULL);
+        post_dump_add_rename(&post_dump, fil_db_rec, fil_db_job, NULL);
+        post_dump_add_rename(&post_dump, oth_db_rec, oth_db_job, NULL);
+        post_dump_add_rename(&post_dump, pri_zck_rec, pri_zck_job, NULL);
+        post_dump_add_rename(&post_dump, fil_zck_rec, fil_zck_job, NULL);
+        post_dump_add_rename(&post_dump, oth_zck_rec, oth_zck_job, NULL);
+        // The compressions read the original files
+        post_dump_add_rename(&post_dump, groupfile_rec, groupfile_job, groupfile_zck_job);
+        post_dump_add_rename(&post_dump, compressed_groupfile_rec, groupfile_job, NULL);
+        post_dump_add_rename(&post_dump, compressed_groupfile_zck_rec, groupfile_zck_job, NULL);
+        post_dump_add_rename(&post_dump, updateinfo_rec, updateinfo_job, updateinfo_zck_job);
+        post_dump_add_rename(&post_dump, updateinfo_zck_rec, updateinfo_zck_job, NULL);
+        post_dump_add_rename(&post_dump, snapshot_rec, snapshot_job, NULL);
+    }
+
+    if (!cr_taskgraph_run(post_dump.graph, cmd_options->workers, &tmp_err)) {
+        g_critical("Cannot prepare repomd records: %s", tmp_err->message);
+        g_clear_error(&tmp_err);
+        exit(EXIT_FAILURE);
+    }
+
+    cr_taskgraph_free(post_dump.graph);
+    cr_slist_free_full(post_dump.jobs, g_free);
+    g_free(snapshot_filename);
+    if (user_data.snapshot) {
+        cr_snapshot_writer_free(user_data.snapshot);
+        user_data.snapshot = NULL;
+    }
+    cr_stats_phase_end(user_data.stats, "repomd_records");
+
     cr_contentstat_free(pri_zck_stat, NULL);
     cr_contentstat_free(fil_zck_stat, NULL);
     cr_contentstat_free(oth_zck_stat, NULL);
@@ -1342,6 +1719,7 @@ main(int argc, char **argv)
 #ifdef CR_DELTA_RPM_SUPPORT
     // Delta generation
     if (cmd_options->deltas) {
+        cr_stats_phase_begin(user_data.stats, "deltas");
         gchar *filename, *outdeltadir = NULL;
         gchar *prestodelta_xml_filename = NULL;
         gchar *prestodelta_zck_filename = NULL;
@@ -1473,25 +1851,15 @@ deltaerror:
         cr_contentstat_free(prestodelta_zck_stat, NULL);
         cr_slist_free_full(user_data.deltatargetpackages,
                        (GDestroyNotify) cr_deltatargetpackage_free);
+        cr_stats_phase_end(user_data.stats, "deltas");
     }
 #endif
 
-    // Add checksums into files names
+    cr_stats_phase_begin(user_data.stats, "repomd_xml");
+
+    // Add checksums into names of the delta files (the other files
+    // were renamed by the post-dump tasks)
     if (cmd_options->unique_md_filenames) {
-        cr_repomd_record_rename_file(pri_xml_rec, NULL);
-        cr_repomd_record_rename_file(fil_xml_rec, NULL);
-        cr_repomd_record_rename_file(oth_xml_rec, NULL);
-        cr_repomd_record_rename_file(pri_db_rec, NULL);
-        cr_repomd_record_rename_file(fil_db_rec, NULL);
-        cr_repomd_record_rename_file(oth_db_rec, NULL);
-        cr_repomd_record_rename_file(pri_zck_rec, NULL);
-        cr_repomd_record_rename_file(fil_zck_rec, NULL);
-        cr_repomd_record_rename_file(oth_zck_rec, NULL);
-        cr_repomd_record_rename_file(groupfile_rec, NULL);
-        cr_repomd_record_rename_file(compressed_groupfile_rec, NULL);
-        cr_repomd_record_rename_file(compressed_groupfile_zck_rec, NULL);
-        cr_repomd_record_rename_file(updateinfo_rec, NULL);
-        cr_repomd_record_rename_file(updateinfo_zck_rec, NULL);
         cr_repomd_record_rename_file(prestodelta_rec, NULL);
         cr_repomd_record_rename_file(prestodelta_zck_rec, NULL);
     }
@@ -1509,6 +1877,7 @@ deltaerror:
         cr_repomd_record_set_timestamp(compressed_groupfile_rec, revision);
         cr_repomd_record_set_timestamp(updateinfo_rec, revision);
         cr_repomd_record_set_timestamp(prestodelta_rec, revision);
+        cr_repomd_record_set_timestamp(snapshot_rec, revision);
     }
 
     // Gen xml
@@ -1528,6 +1897,7 @@ deltaerror:
     cr_repomd_set_record(repomd_obj, updateinfo_zck_rec);
     cr_repomd_set_record(repomd_obj, prestodelta_rec);
     cr_repomd_set_record(repomd_obj, prestodelta_zck_rec);
+    cr_repomd_set_record(repomd_obj, snapshot_rec);
 
     int i = 0;
     while (cmd_options->repo_tags && cmd_options->repo_tags[i])
@@ -1573,9 +1943,11 @@ deltaerror:
     fclose(frepomd);
     g_free(repomd_xml);
     g_free(repomd_path);
+    cr_stats_phase_end(user_data.stats, "repomd_xml");
 
 
     // Final move
+    cr_stats_phase_begin(user_data.stats, "final_move");
     // Copy selected metadata from the old repository
     cr_RetentionType retentiontype = CR_RETENTION_DEFAULT;
     gint64 retentionval = (gint64) cmd_options->retain_old;
@@ -1653,6 +2025,17 @@ deltaerror:
             g_clear_error(&tmp_err);
         }
     }
+    cr_stats_phase_end(user_data.stats, "final_move");
+
+    // Write statistics
+    if (user_data.stats) {
+        if (!cr_stats_write_json(user_data.stats, cmd_options->stats_file,
+                                 &tmp_err)) {
+            g_warning("%s", tmp_err->message);
+            g_clear_error(&tmp_err);
+        }
+        cr_stats_free(user_data.stats);
+    }
 
 
     // Clean up
@@ -1660,8 +2043,9 @@ deltaerror:
 
     if (old_metadata)
         cr_metadata_free(old_metadata);
+    // Must outlive all packages of the old metadata
+    cr_string_pool_free(old_metadata_pool);
 
-    g_free(user_data.prev_srpm);
     g_free(user_data.cur_srpm);
     g_free(old_repodata_path);
     g_free(in_repo);
@@ -45,14 +45,19 @@ extern "C" {
 #include "error.h"
 #include "load_metadata.h"
 #include "locate_metadata.h"
+#include "mdserver.h"
 #include "misc.h"
 #include "package.h"
 #include "parsehdr.h"
 #include "parsepkg.h"
+#include "repodiff.h"
 #include "repomd.h"
+#include "snapshot.h"
 #include "sqlite.h"
+#include "string_pool.h"
 #include "threads.h"
 #include "updateinfo.h"
+#include "updateinfo_writer.h"
 #include "version.h"
 #include "xml_dump.h"
 #include "xml_file.h"
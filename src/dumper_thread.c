@@ -33,11 +33,35 @@
 #include "error.h"
 #include "misc.h"
 #include "parsepkg.h"
+#include "stats.h"
 #include "xml_dump.h"
 
 #define MAX_TASK_BUFFER_LEN         20
 #define CACHEDCHKSUM_BUFFER_LEN     2048
 
+/** XML chunks generated by a worker thread. The chunks of the package
+ * which is written directly (not through the task buffer) are only
+ * borrowed from here and they stay allocated for the next package.
+ */
+static void
+thread_xml_buffers_free(gpointer buffers)
+{
+    cr_xml_buffers_free((struct cr_XmlBuffers *) buffers);
+}
+
+static GPrivate thread_xml_buffers = G_PRIVATE_INIT(thread_xml_buffers_free);
+
+static struct cr_XmlBuffers *
+get_thread_xml_buffers(void)
+{
+    struct cr_XmlBuffers *buffers = g_private_get(&thread_xml_buffers);
+    if (!buffers) {
+        buffers = cr_xml_buffers_new();
+        g_private_set(&thread_xml_buffers, buffers);
+    }
+    return buffers;
+}
+
 struct BufferedTask {
     long id;                        // ID of the task
     struct cr_XmlStruct res;        // XML for primary, filelists and other
@@ -62,25 +86,41 @@ buf_task_sort_func(gconstpointer a, gconstpointer b, G_GNUC_UNUSED gpointer data
 }
 
 
+/** Current time if the statistics are enabled, 0 otherwise.
+ */
+static inline gint64
+stats_now(cr_WorkerStats *ws)
+{
+    return ws ? g_get_monotonic_time() : 0;
+}
+
 static void
 write_pkg(long id,
           struct cr_XmlStruct res,
           cr_Package *pkg,
-          struct UserData *udata)
+          struct UserData *udata,
+          cr_WorkerStats *ws)
 {
     GError *tmp_err = NULL;
+    gint64 t_wait, t_write;
 
     // Write primary data
+    t_wait = stats_now(ws);
     g_mutex_lock(udata->mutex_pri);
     while (udata->id_pri != id)
         g_cond_wait (udata->cond_pri, udata->mutex_pri);
+    t_write = stats_now(ws);
+    if (ws)
+        ws->time_wait_pri += t_write - t_wait;
 
-    g_free(udata->prev_srpm);
-    udata->prev_srpm = udata->cur_srpm;
-    udata->cur_srpm = g_strdup(pkg->rpm_sourcerpm);
+    // Copy the srpm name only when it changes (packages built from
+    // the same srpm usually come one after another)
     gboolean new_pkg = FALSE;
-    if (g_strcmp0(udata->prev_srpm, udata->cur_srpm) != 0)
+    if (g_strcmp0(udata->cur_srpm, pkg->rpm_sourcerpm) != 0) {
         new_pkg = TRUE;
+        g_free(udata->cur_srpm);
+        udata->cur_srpm = g_strdup(pkg->rpm_sourcerpm);
+    }
 
     ++udata->id_pri;
     cr_xmlfile_add_chunk(udata->pri_f, (const char *) res.primary, &tmp_err);
@@ -100,19 +140,15 @@ write_pkg(long id,
             g_clear_error(&tmp_err);
         }
     }
-    if (udata->pri_zck) {
-        if (new_pkg) {
-            cr_end_chunk(udata->pri_zck->f, &tmp_err);
-            if (tmp_err) {
-                g_critical("Unable to end primary zchunk: %s", tmp_err->message);
-                udata->had_errors = TRUE;
-                g_clear_error(&tmp_err);
-            }
-        }
-        cr_xmlfile_add_chunk(udata->pri_zck, (const char *) res.primary, &tmp_err);
-        if (tmp_err) {
-            g_critical("Cannot add primary zchunk:\n%s\nError: %s",
-                       res.primary, tmp_err->message);
+    if (udata->pri_zck)
+        // Compression runs in the writer's thread
+        cr_zck_writer_add(udata->pri_zck, (const char *) res.primary, new_pkg);
+
+    if (udata->snapshot) {
+        // Packages are added in the same order as into the primary.xml
+        if (!cr_snapshot_writer_add_pkg(udata->snapshot, pkg, &tmp_err)) {
+            g_critical("Cannot add %s (%s) to snapshot: %s",
+                       pkg->name, pkg->pkgId, tmp_err->message);
             udata->had_errors = TRUE;
             g_clear_error(&tmp_err);
         }
@@ -120,11 +156,17 @@ write_pkg(long id,
 
     g_cond_broadcast(udata->cond_pri);
     g_mutex_unlock(udata->mutex_pri);
+    t_wait = stats_now(ws);
+    if (ws)
+        ws->time_write += t_wait - t_write;
 
     // Write fielists data
     g_mutex_lock(udata->mutex_fil);
     while (udata->id_fil != id)
         g_cond_wait (udata->cond_fil, udata->mutex_fil);
+    t_write = stats_now(ws);
+    if (ws)
+        ws->time_wait_fil += t_write - t_wait;
     ++udata->id_fil;
     cr_xmlfile_add_chunk(udata->fil_f, (const char *) res.filelists, &tmp_err);
     if (tmp_err) {
@@ -143,31 +185,22 @@ write_pkg(long id,
             g_clear_error(&tmp_err);
         }
     }
-    if (udata->fil_zck) {
-        if (new_pkg) {
-            cr_end_chunk(udata->fil_zck->f, &tmp_err);
-            if (tmp_err) {
-                g_critical("Unable to end filelists zchunk: %s", tmp_err->message);
-                udata->had_errors = TRUE;
-                g_clear_error(&tmp_err);
-            }
-        }
-        cr_xmlfile_add_chunk(udata->fil_zck, (const char *) res.filelists, &tmp_err);
-        if (tmp_err) {
-            g_critical("Cannot add filelists zchunk:\n%s\nError: %s",
-                       res.filelists, tmp_err->message);
-            udata->had_errors = TRUE;
-            g_clear_error(&tmp_err);
-        }
-    }
+    if (udata->fil_zck)
+        cr_zck_writer_add(udata->fil_zck, (const char *) res.filelists, new_pkg);
 
     g_cond_broadcast(udata->cond_fil);
     g_mutex_unlock(udata->mutex_fil);
+    t_wait = stats_now(ws);
+    if (ws)
+        ws->time_write += t_wait - t_write;
 
     // Write other data
     g_mutex_lock(udata->mutex_oth);
     while (udata->id_oth != id)
         g_cond_wait (udata->cond_oth, udata->mutex_oth);
+    t_write = stats_now(ws);
+    if (ws)
+        ws->time_wait_oth += t_write - t_wait;
     ++udata->id_oth;
     cr_xmlfile_add_chunk(udata->oth_f, (const char *) res.other, &tmp_err);
     if (tmp_err) {
@@ -186,25 +219,12 @@ write_pkg(long id,
             g_clear_error(&tmp_err);
         }
     }
-    if (udata->oth_zck) {
-        if (new_pkg) {
-            cr_end_chunk(udata->oth_zck->f, &tmp_err);
-            if (tmp_err) {
-                g_critical("Unable to end other zchunk: %s", tmp_err->message);
-                udata->had_errors = TRUE;
-                g_clear_error(&tmp_err);
-            }
-        }
-        cr_xmlfile_add_chunk(udata->oth_zck, (const char *) res.other, &tmp_err);
-        if (tmp_err) {
-            g_critical("Cannot add other zchunk:\n%s\nError: %s",
-                       res.other, tmp_err->message);
-            udata->had_errors = TRUE;
-            g_clear_error(&tmp_err);
-        }
-    }
+    if (udata->oth_zck)
+        cr_zck_writer_add(udata->oth_zck, (const char *) res.other, new_pkg);
     g_cond_broadcast(udata->cond_oth);
     g_mutex_unlock(udata->mutex_oth);
+    if (ws)
+        ws->time_write += stats_now(ws) - t_write;
 }
 
 static char *
@@ -212,26 +232,35 @@ get_checksum(const char *filename,
              cr_ChecksumType type,
              cr_Package *pkg,
              const char *cachedir,
+             gboolean *cached,
              GError **err)
 {
     GError *tmp_err = NULL;
     char *checksum = NULL;
     char *cachefn = NULL;
 
+    *cached = FALSE;
+
     if (cachedir) {
         // Prepare cache fn
         char *key;
-        cr_ChecksumCtx *ctx = cr_checksum_new(type, err);
-        if (!ctx) return NULL;
+        const void *bufs[3] = { NULL, NULL, NULL };
+        size_t lens[3] = { 0, 0, 0 };
 
-        if (pkg->siggpg)
-            cr_checksum_update(ctx, pkg->siggpg->data, pkg->siggpg->size, NULL);
-        if (pkg->sigpgp)
-            cr_checksum_update(ctx, pkg->sigpgp->data, pkg->sigpgp->size, NULL);
-        if (pkg->hdrid)
-            cr_checksum_update(ctx, pkg->hdrid, strlen(pkg->hdrid), NULL);
+        if (pkg->siggpg) {
+            bufs[0] = pkg->siggpg->data;
+            lens[0] = pkg->siggpg->size;
+        }
+        if (pkg->sigpgp) {
+            bufs[1] = pkg->sigpgp->data;
+            lens[1] = pkg->sigpgp->size;
+        }
+        if (pkg->hdrid) {
+            bufs[2] = pkg->hdrid;
+            lens[2] = strlen(pkg->hdrid);
+        }
 
-        key = cr_checksum_final(ctx, err);
+        key = cr_checksum_buffers(type, bufs, lens, 3, err);
         if (!key) return NULL;
 
         cachefn = g_strdup_printf("%s%s-%s-%"G_GINT64_FORMAT"-%"G_GINT64_FORMAT,
@@ -253,6 +282,7 @@ get_checksum(const char *filename,
 
         if (checksum) {
             g_debug("Cached checksum used: %s: \"%s\"", cachefn, checksum);
+            *cached = TRUE;
             goto exit;
         }
     }
@@ -304,6 +334,38 @@ prepare_split_media_baseurl(int media_id, const char *location_base)
     return g_strdup_printf("%s#%d", tmp_location_base, media_id);
 }
 
+/** Generate the primary chunk of the reused package and copy its original
+ * filelists and other chunks (there is nothing in them which could change).
+ * @return          TRUE if the original chunks were used, FALSE if they are
+ *                  not available or on error (err is set)
+ */
+static gboolean
+xml_passthrough(cr_Package *md,
+                cr_Metadata *old_metadata,
+                struct cr_XmlBuffers *buffers,
+                GError **err)
+{
+    const char *fil, *oth;
+    gsize fil_len, oth_len;
+
+    fil = cr_metadata_get_xml(old_metadata, md->pkgId,
+                              CR_XMLFILE_FILELISTS, &fil_len);
+    oth = cr_metadata_get_xml(old_metadata, md->pkgId,
+                              CR_XMLFILE_OTHER, &oth_len);
+    if (!fil || !oth)
+        return FALSE;
+
+    if (cr_xml_dump_buffers_primary(md, buffers, err) != CRE_OK)
+        return FALSE;
+
+    g_string_append_len(buffers->filelists, fil, fil_len);
+    g_string_append_c(buffers->filelists, '\n');
+    g_string_append_len(buffers->other, oth, oth_len);
+    g_string_append_c(buffers->other, '\n');
+
+    return TRUE;
+}
+
 static cr_Package *
 load_rpm(const char *fullpath,
          cr_ChecksumType checksum_type,
@@ -313,16 +375,20 @@ load_rpm(const char *fullpath,
          int changelog_limit,
          struct stat *stat_buf,
          cr_HeaderReadingFlags hdrrflags,
+         cr_WorkerStats *ws,
          GError **err)
 {
     cr_Package *pkg = NULL;
     GError *tmp_err = NULL;
+    gint64 t_start = stats_now(ws);
 
     assert(fullpath);
     assert(!err || *err == NULL);
 
     // Get a package object
     pkg = cr_package_from_rpm_base(fullpath, changelog_limit, hdrrflags, err);
+    if (ws)
+        ws->time_header += stats_now(ws) - t_start;
     if (!pkg)
         goto errexit;
 
@@ -352,16 +418,28 @@ load_rpm(const char *fullpath,
     }
 
     // Compute checksum
+    t_start = stats_now(ws);
+    gboolean cached;
     char *checksum = get_checksum(fullpath, checksum_type, pkg,
-                                  checksum_cachedir, &tmp_err);
+                                  checksum_cachedir, &cached, &tmp_err);
+    if (ws) {
+        ws->time_checksum += stats_now(ws) - t_start;
+        if (cached)
+            ws->checksum_cache_hits++;
+        else if (checksum)
+            ws->bytes_read += pkg->size_package;
+    }
     if (!checksum)
         goto errexit;
     pkg->pkgId = cr_safe_string_chunk_insert(pkg->chunk, checksum);
     free(checksum);
 
     // Get header range
+    t_start = stats_now(ws);
     struct cr_HeaderRangeStruct hdr_r = cr_get_header_byte_range(fullpath,
                                                                  &tmp_err);
+    if (ws)
+        ws->time_header += stats_now(ws) - t_start;
     if (tmp_err) {
         g_propagate_prefixed_error(err, tmp_err,
                                    "Error while determinig header range: ");
@@ -387,38 +465,43 @@ cr_dumper_thread(gpointer data, gpointer user_data)
     cr_Package *pkg = NULL;     // Package from file
     struct stat stat_buf;       // Struct with info from stat() on file
     struct cr_XmlStruct res;    // Structure for generated XML
+    struct cr_XmlBuffers *xml_buffers = get_thread_xml_buffers();
     cr_HeaderReadingFlags hdrrflags = CR_HDRR_NONE;
 
     struct UserData *udata = (struct UserData *) user_data;
     struct PoolTask *task  = (struct PoolTask *) data;
+    cr_WorkerStats *ws     = cr_stats_worker(udata->stats);
+    gint64 t_task          = stats_now(ws);
+    gint64 t_start;
+
+    // Let the prefetcher read the packages which come after this one
+    cr_prefetcher_advance(udata->prefetcher, task->id);
 
     // get location_href without leading part of path (path to repo)
     // including '/' char
-    _cleanup_free_ gchar *location_href = NULL;
-    location_href = g_strdup(task->full_path + udata->repodir_name_len);
+    // Note: location_href and location_base point into the task or udata
+    // and they are copied only if really needed
+    gchar *location_href = task->full_path + udata->repodir_name_len;
+    _cleanup_free_ gchar *prefixed_location_href = NULL;
 
-    _cleanup_free_ gchar *location_base = NULL;
-    location_base = g_strdup(udata->location_base);
+    gchar *location_base = (gchar *) udata->location_base;
+    _cleanup_free_ gchar *split_location_base = NULL;
 
     // User requested modification of the location href
-    if (udata->cut_dirs) {
-        gchar *tmp = location_href;
-        location_href = g_strdup(cr_cut_dirs(location_href, udata->cut_dirs));
-        g_free(tmp);
-    }
+    if (udata->cut_dirs)
+        location_href = cr_cut_dirs(location_href, udata->cut_dirs);
 
     if (udata->location_prefix) {
-        gchar *tmp = location_href;
-        location_href = g_build_filename(udata->location_prefix, tmp, NULL);
-        g_free(tmp);
+        prefixed_location_href = g_build_filename(udata->location_prefix,
+                                                  location_href, NULL);
+        location_href = prefixed_location_href;
     }
 
     // Prepare location base (if split option is used)
     if (task->media_id) {
-        gchar *new_location_base = prepare_split_media_baseurl(task->media_id,
-                                                               location_base);
-        g_free(location_base);
-        location_base = new_location_base;
+        split_location_base = prepare_split_media_baseurl(task->media_id,
+                                                          location_base);
+        location_base = split_location_base;
     }
 
     // If --cachedir is used, load signatures and hdrid from packages too
@@ -435,10 +518,13 @@ cr_dumper_thread(gpointer data, gpointer user_data)
 
     // Update stuff
     if (udata->old_metadata) {
-        // We have old metadata
-        md = (cr_Package *) g_hash_table_lookup(
-                                cr_metadata_hashtable(udata->old_metadata),
-                                task->filename);
+        // We have old metadata (lazily loaded packages are parsed here)
+        md = cr_metadata_get(udata->old_metadata, task->filename, &tmp_err);
+        if (tmp_err) {
+            g_warning("Cannot load old metadata of %s: %s",
+                      task->filename, tmp_err->message);
+            g_clear_error(&tmp_err);
+        }
 
         if (md) {
             g_debug("CACHE HIT %s", task->filename);
@@ -456,6 +542,9 @@ cr_dumper_thread(gpointer data, gpointer user_data)
             }
 
             if (old_used) {
+                if (ws)
+                    ws->cache_hits++;
+
                 // We have usable old data, but we have to set proper locations
                 // WARNING! This two lines destructively modifies content of
                 // packages in old metadata.
@@ -474,7 +563,7 @@ cr_dumper_thread(gpointer data, gpointer user_data)
         pkg = load_rpm(task->full_path, udata->checksum_type,
                        udata->checksum_cachedir, location_href,
                        location_base, udata->changelog_limit,
-                       NULL, hdrrflags, &tmp_err);
+                       NULL, hdrrflags, ws, &tmp_err);
         assert(pkg || tmp_err);
 
         if (!pkg) {
@@ -485,7 +574,10 @@ cr_dumper_thread(gpointer data, gpointer user_data)
             goto task_cleanup;
         }
 
-        res = cr_xml_dump(pkg, &tmp_err);
+        t_start = stats_now(ws);
+        cr_xml_dump_buffers(pkg, xml_buffers, &tmp_err);
+        if (ws)
+            ws->time_dump += stats_now(ws) - t_start;
         if (tmp_err) {
             g_critical("Cannot dump XML for %s (%s): %s",
                        pkg->name, pkg->pkgId, tmp_err->message);
@@ -496,7 +588,17 @@ cr_dumper_thread(gpointer data, gpointer user_data)
     } else {
         // Just gen XML from old loaded metadata
         pkg = md;
-        res = cr_xml_dump(md, &tmp_err);
+        t_start = stats_now(ws);
+        if (udata->xml_passthrough
+            && xml_passthrough(md, udata->old_metadata, xml_buffers, &tmp_err))
+        {
+            if (ws)
+                ws->xml_passthrough++;
+        } else if (!tmp_err) {
+            cr_xml_dump_buffers(md, xml_buffers, &tmp_err);
+        }
+        if (ws)
+            ws->time_dump += stats_now(ws) - t_start;
         if (tmp_err) {
             g_critical("Cannot dump XML for %s (%s): %s",
                        md->name, md->pkgId, tmp_err->message);
@@ -506,6 +608,11 @@ cr_dumper_thread(gpointer data, gpointer user_data)
         }
     }
 
+    // The chunks are owned by the thread's buffers
+    res.primary   = xml_buffers->primary->str;
+    res.filelists = xml_buffers->filelists->str;
+    res.other     = xml_buffers->other->str;
+
 #ifdef CR_DELTA_RPM_SUPPORT
     // Delta candidate
     if (udata->deltas
@@ -542,9 +649,15 @@ cr_dumper_thread(gpointer data, gpointer user_data)
         //  * this isn't the last task
         // Then: save the task to the buffer
 
-        struct BufferedTask *buf_task = malloc(sizeof(struct BufferedTask));
+        struct BufferedTask *buf_task = g_slice_new(struct BufferedTask);
         buf_task->id  = task->id;
-        buf_task->res = res;
+        // The thread's buffers are reused by the next task, copy the chunks
+        buf_task->res.primary   = g_strndup(xml_buffers->primary->str,
+                                            xml_buffers->primary->len);
+        buf_task->res.filelists = g_strndup(xml_buffers->filelists->str,
+                                            xml_buffers->filelists->len);
+        buf_task->res.other     = g_strndup(xml_buffers->other->str,
+                                            xml_buffers->other->len);
         buf_task->pkg = pkg;
         buf_task->location_href = NULL;
         buf_task->location_base = NULL;
@@ -567,24 +680,32 @@ cr_dumper_thread(gpointer data, gpointer user_data)
         g_free(task->path);
         g_free(task);
 
+        if (ws) {
+            ws->packages++;
+            ws->time_total += stats_now(ws) - t_task;
+        }
+
         return;
     }
 
     g_mutex_unlock(udata->mutex_buffer);
 
     // Dump XML and SQLite
-    write_pkg(task->id, res, pkg, udata);
+    write_pkg(task->id, res, pkg, udata, ws);
+
+    if (ws)
+        ws->packages++;
 
     // Clean up
     if (pkg != md)
         cr_package_free(pkg);
-    g_free(res.primary);
-    g_free(res.filelists);
-    g_free(res.other);
 
 task_cleanup:
     if (udata->id_pri <= task->id) {
         // An error was encountered and we have to wait to increment counters
+        if (ws)
+            ws->errors++;
+
         g_mutex_lock(udata->mutex_pri);
         while (udata->id_pri != task->id)
             g_cond_wait (udata->cond_pri, udata->mutex_pri);
@@ -621,7 +742,7 @@ task_cleanup:
             buf_task = g_queue_pop_head (udata->buffer);
             g_mutex_unlock(udata->mutex_buffer);
             // Dump XML and SQLite
-            write_pkg(buf_task->id, buf_task->res, buf_task->pkg, udata);
+            write_pkg(buf_task->id, buf_task->res, buf_task->pkg, udata, ws);
             // Clean up
             if (!buf_task->pkg_from_md)
                 cr_package_free(buf_task->pkg);
@@ -630,12 +751,15 @@ task_cleanup:
             g_free(buf_task->res.other);
             g_free(buf_task->location_href);
             g_free(buf_task->location_base);
-            g_free(buf_task);
+            g_slice_free(struct BufferedTask, buf_task);
         } else {
             g_mutex_unlock(udata->mutex_buffer);
             break;
         }
     }
 
+    if (ws)
+        ws->time_total += stats_now(ws) - t_task;
+
     return;
 }
@@ -30,8 +30,12 @@ extern "C" {
 #include "locate_metadata.h"
 #include "misc.h"
 #include "package.h"
+#include "prefetch.h"
 #include "sqlite.h"
+#include "snapshot.h"
+#include "stats.h"
 #include "xml_file.h"
+#include "zck_writer.h"
 
 /** \defgroup   dumperthread    Implementation of concurent dumping used in createrepo_c
  *  \addtogroup dumperthread
@@ -53,10 +57,9 @@ struct UserData {
     cr_SqliteDb *pri_db;            // Primary db
     cr_SqliteDb *fil_db;            // Filelists db
     cr_SqliteDb *oth_db;            // Other db
-    cr_XmlFile *pri_zck;            // Opened compressed primary.xml.zck
-    cr_XmlFile *fil_zck;            // Opened compressed filelists.xml.zck
-    cr_XmlFile *oth_zck;            // Opened compressed other.xml.zck
-    char *prev_srpm;                // Previous srpm
+    cr_ZckWriter *pri_zck;          // Writer of primary.xml.zck
+    cr_ZckWriter *fil_zck;          // Writer of filelists.xml.zck
+    cr_ZckWriter *oth_zck;          // Writer of other.xml.zck
     char *cur_srpm;                 // Current srpm
     int changelog_limit;            // Max number of changelogs for a package
     const char *location_base;      // Base location url
@@ -71,6 +74,8 @@ struct UserData {
     // Update stuff
     gboolean skip_stat;             // Skip stat() while updating
     cr_Metadata *old_metadata;      // Loaded metadata
+    gboolean xml_passthrough;       // Copy original filelists and other
+                                    // chunks of the reused packages
 
     // Thread serialization
     GMutex *mutex_pri;              // Mutex for primary metadata
@@ -100,6 +105,18 @@ struct UserData {
     gchar *location_prefix;         // Append this prefix into location_href
                                     // during repodata generation
     gboolean had_errors;            // Any errors encountered?
+
+    // Read ahead
+    cr_Prefetcher *prefetcher;      // Prefetcher of queued packages or NULL
+    GHashTable *prefetch_old_pkgs;  // Copy of the old_metadata index for
+                                    // the prefetch filter (read-only),
+                                    // NULL if old_metadata are lazy
+
+    // Statistics
+    cr_Stats *stats;                // Run statistics or NULL (disabled)
+
+    // Binary snapshot
+    cr_SnapshotWriter *snapshot;    // Snapshot writer or NULL (disabled)
 };
 
 
@@ -85,6 +85,10 @@ cr_strerror(cr_Error rc)
             return "Child process exited abnormally";
         case CRE_DELTARPM:
             return "Deltarpm error";
+        case CRE_BADSNAPSHOT:
+            return "Bad binary snapshot";
+        case CRE_MDSERVER:
+            return "Metadata server error";
         default:
             return "Unknown error";
     }
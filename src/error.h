@@ -96,6 +96,10 @@ typedef enum {
         (33) Cannot change blocked signals */
     CRE_ZCK, /*!<
         (34) ZCK library related error */
+    CRE_BADSNAPSHOT, /*!<
+        (35) Bad or corrupted binary snapshot */
+    CRE_MDSERVER, /*!<
+        (36) Metadata server communication error */
     CRE_SENTINEL, /*!<
         (XX) Sentinel */
 } cr_Error;
@@ -18,20 +18,28 @@
  */
 
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <fcntl.h>
 #include <string.h>
+#include <unistd.h>
 #include <assert.h>
+#include <errno.h>
+#include "compression_wrapper.h"
 #include "error.h"
 #include "package.h"
 #include "misc.h"
 #include "load_metadata.h"
 #include "locate_metadata.h"
+#include "snapshot.h"
 #include "xml_parser.h"
 
 #define ERR_DOMAIN              CREATEREPO_C_ERROR
 #define STRINGCHUNK_SIZE        16384
+#define LAZY_BUFFER_SIZE        (128*1024)
+
+typedef struct _cr_LazyIndex cr_LazyIndex;
 
 /** Structure for loaded metadata
  */
@@ -42,8 +50,20 @@ struct _cr_Metadata {
     GHashTable *pkglist_ht; /*!< list of allowed package basenames to load */
     cr_HashTableKeyDupAction dupaction; /*!<
         How to behave in case of duplicated items */
+    gboolean lazy;          /*!< Only index the xml files during loading */
+    GSList *lazy_indexes;   /*!< Indexes of not yet parsed packages
+                                 (one per loaded location) */
+    GHashTable *lazy_by_key;/*!< Key selected by user -> cr_LazyEntry
+                                 or NULL if nothing was lazily loaded */
+    GMutex *lazy_mutex;     /*!< Lock for the parsing on demand */
+    gboolean keep_xml;      /*!< Keep the original filelists and other xml */
+    GSList *xml_indexes;    /*!< Indexes of the original filelists and other
+                                 xml chunks (one per loaded location) */
+    gboolean use_snapshot;  /*!< Load the binary snapshot if available */
 };
 
+static void cr_lazy_index_free(cr_LazyIndex *index);
+
 cr_HashTableKey
 cr_metadata_key(cr_Metadata *md)
 {
@@ -126,6 +146,12 @@ cr_metadata_free(cr_Metadata *md)
         g_string_chunk_free(md->chunk);
     if (md->pkglist_ht)
         g_hash_table_destroy(md->pkglist_ht);
+    if (md->lazy_by_key)
+        g_hash_table_destroy(md->lazy_by_key);
+    if (md->lazy_mutex)
+        g_mutex_free(md->lazy_mutex);
+    g_slist_free_full(md->lazy_indexes, (GDestroyNotify) cr_lazy_index_free);
+    g_slist_free_full(md->xml_indexes, (GDestroyNotify) cr_lazy_index_free);
     g_free(md);
 }
 
@@ -138,6 +164,27 @@ cr_metadata_set_dupaction(cr_Metadata *md, cr_HashTableKeyDupAction dupaction)
     return TRUE;
 }
 
+void
+cr_metadata_set_lazy(cr_Metadata *md, gboolean lazy)
+{
+    assert(md);
+    md->lazy = lazy;
+}
+
+void
+cr_metadata_set_keep_xml(cr_Metadata *md, gboolean keep)
+{
+    assert(md);
+    md->keep_xml = keep;
+}
+
+void
+cr_metadata_set_use_snapshot(cr_Metadata *md, gboolean use)
+{
+    assert(md);
+    md->use_snapshot = use;
+}
+
 // Callbacks for XML parsers
 
 typedef enum {
@@ -160,6 +207,8 @@ typedef struct {
         Key is pkgId and value is NULL. */
     cr_ParsingState state;
     gint64          pkgKey; /*!< basically order of the package */
+    cr_PackageLoadingFlags origin; /*!< CR_PACKAGE_FROM_XML or
+        CR_PACKAGE_FROM_SNAPSHOT - set to stored packages */
 } cr_CbData;
 
 static int
@@ -228,7 +277,7 @@ primary_pkgcb(cr_Package *pkg, void *cbdata, G_GNUC_UNUSED GError **err)
 
     if (!epkg) {
         // Store package into the hashtable
-        pkg->loadingflags |= CR_PACKAGE_FROM_XML;
+        pkg->loadingflags |= cb_data->origin;
         pkg->loadingflags |= CR_PACKAGE_LOADED_PRI;
         g_hash_table_replace(cb_data->ht, pkg->pkgId, pkg);
     } else {
@@ -351,6 +400,7 @@ cr_load_xml_files(GHashTable *hashtable,
     cb_data.ignored_pkgIds  = g_hash_table_new_full(g_str_hash, g_str_equal,
                                                     g_free, NULL);
     cb_data.pkgKey          = G_GINT64_CONSTANT(0);
+    cb_data.origin          = CR_PACKAGE_FROM_XML;
 
     cr_xml_parse_primary(primary_xml_path,
                          primary_newpkgcb,
@@ -413,48 +463,78 @@ cr_load_xml_files(GHashTable *hashtable,
     return CRE_OK;
 }
 
-int
-cr_metadata_load_xml(cr_Metadata *md,
-                     struct cr_MetadataLocation *ml,
-                     GError **err)
+static int
+cr_load_snapshot_file(GHashTable *hashtable,
+                      const char *snapshot_path,
+                      GStringChunk *chunk,
+                      GHashTable *pkglist_ht,
+                      GError **err)
 {
-    int result;
-    GError *tmp_err = NULL;
-    GHashTable *intern_hashtable;  // key is checksum (pkgId)
-    cr_HashTableKeyDupAction dupaction = md->dupaction;
+    cr_CbData cb_data;
+    cr_Snapshot *snap;
+    guint count;
+    int ret = CRE_OK;
 
-    assert(md);
-    assert(ml);
-    assert(!err || *err == NULL);
+    assert(hashtable);
 
-    if (!ml->pri_xml_href) {
-        g_set_error(err, ERR_DOMAIN, CRE_BADARG,
-                    "primary.xml file is missing");
-        return CRE_BADARG;
-    }
+    snap = cr_snapshot_open(snapshot_path, err);
+    if (!snap)
+        return CRE_BADSNAPSHOT;
 
-    // Load metadata
-    intern_hashtable = cr_new_metadata_hashtable();
-    result = cr_load_xml_files(intern_hashtable,
-                               ml->pri_xml_href,
-                               ml->fil_xml_href,
-                               ml->oth_xml_href,
-                               md->chunk,
-                               md->pkglist_ht,
-                               &tmp_err);
+    // Prepare cb data - packages are stored by the same callback
+    // as packages from primary.xml
+    cb_data.state           = PARSING_PRI;
+    cb_data.ht              = hashtable;
+    cb_data.chunk           = chunk;
+    cb_data.pkglist_ht      = pkglist_ht;
+    cb_data.ignored_pkgIds  = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                    g_free, NULL);
+    cb_data.pkgKey          = G_GINT64_CONSTANT(0);
+    cb_data.origin          = CR_PACKAGE_FROM_SNAPSHOT;
+
+    count = cr_snapshot_count(snap);
+    for (guint idx = 0; idx < count; idx++) {
+        cr_Package *pkg;
+
+        if (pkglist_ht) {
+            // Do not materialize packages which are not on the pkglist
+            const char *basename = cr_snapshot_package_key(snap, idx,
+                                                    CR_HT_KEY_FILENAME);
+            if (basename && !g_hash_table_lookup_extended(pkglist_ht,
+                                                    basename, NULL, NULL))
+                continue;
+        }
 
-    if (result != CRE_OK) {
-        g_critical("%s: Error encountered while parsing", __func__);
-        g_propagate_prefixed_error(err, tmp_err,
-                                   "Error encountered while parsing:");
-        cr_destroy_metadata_hashtable(intern_hashtable);
-        return result;
+        pkg = cr_snapshot_package(snap, idx,
+                                  CR_PACKAGE_LOADED_FIL|CR_PACKAGE_LOADED_OTH,
+                                  chunk);
+        if (!pkg || !pkg->pkgId) {
+            g_set_error(err, ERR_DOMAIN, CRE_BADSNAPSHOT,
+                        "%s: Package record %u is corrupted",
+                        snapshot_path, idx);
+            cr_package_free(pkg);
+            ret = CRE_BADSNAPSHOT;
+            break;
+        }
+
+        primary_pkgcb(pkg, &cb_data, NULL);
     }
 
-    g_debug("%s: Parsed items: %d", __func__,
-            g_hash_table_size(intern_hashtable));
+    g_hash_table_destroy(cb_data.ignored_pkgIds);
+    cr_snapshot_close(snap);
+
+    return ret;
+}
 
-    // Fill user hashtable and use user selected key
+/** Move packages from the internal hashtable (key is pkgId) into
+ * the user hashtable and use user selected key.
+ */
+static int
+cr_metadata_fill_hashtable(cr_Metadata *md,
+                           GHashTable *intern_hashtable,
+                           GError **err)
+{
+    cr_HashTableKeyDupAction dupaction = md->dupaction;
 
     GHashTableIter iter;
     gpointer p_key, p_value;
@@ -541,11 +621,942 @@ cr_metadata_load_xml(cr_Metadata *md,
     // Cleanup
 
     g_hash_table_destroy(ignored_keys);
-    cr_destroy_metadata_hashtable(intern_hashtable);
 
     return CRE_OK;
 }
 
+// Lazy loading
+
+typedef enum {
+    LAZY_PRI,
+    LAZY_FIL,
+    LAZY_OTH,
+    LAZY_SENTINEL,
+} cr_LazyFileType;
+
+/** Uncompressed xml stream of a lazily loaded metadata file.
+ */
+typedef struct {
+    GMappedFile *mf;
+    const char *data;
+    gsize size;
+} cr_LazyFile;
+
+/** Location of a not yet parsed package.
+ */
+typedef struct {
+    cr_LazyIndex *index;            /*!< Index with the files */
+    const char *pkgId;
+    const char *name;
+    const char *basename;
+    gsize offset[LAZY_SENTINEL];    /*!< Offset of the <package> element */
+    gsize length[LAZY_SENTINEL];    /*!< Its length or 0 if not present */
+    gboolean ignored;               /*!< Conflicting pkgId */
+} cr_LazyEntry;
+
+struct _cr_LazyIndex {
+    cr_LazyFile files[LAZY_SENTINEL];
+    GStringChunk *chunk;    /*!< Strings of the entries */
+    GPtrArray *entries;     /*!< All cr_LazyEntry */
+    GHashTable *by_pkgid;   /*!< pkgId -> cr_LazyEntry */
+};
+
+static cr_LazyIndex *
+cr_lazy_index_new(void)
+{
+    cr_LazyIndex *index = g_new0(cr_LazyIndex, 1);
+    index->chunk    = g_string_chunk_new(STRINGCHUNK_SIZE);
+    index->entries  = g_ptr_array_new_with_free_func(g_free);
+    index->by_pkgid = g_hash_table_new(g_str_hash, g_str_equal);
+    return index;
+}
+
+static void
+cr_lazy_index_free(cr_LazyIndex *index)
+{
+    if (!index)
+        return;
+
+    for (int x = 0; x < LAZY_SENTINEL; x++)
+        if (index->files[x].mf)
+            g_mapped_file_unref(index->files[x].mf);
+    g_string_chunk_free(index->chunk);
+    g_ptr_array_free(index->entries, TRUE);
+    g_hash_table_destroy(index->by_pkgid);
+    g_free(index);
+}
+
+/** Map the uncompressed content of the file. Compressed files (including
+ * zchunk) are decompressed into an unlinked temporary file which is mapped,
+ * so the pages can be dropped by the kernel at any time.
+ */
+static gboolean
+cr_lazy_file_open(cr_LazyFile *lf, const char *path, GError **err)
+{
+    cr_CompressionType type;
+    GError *tmp_err = NULL;
+    gchar *tmp_path = NULL;
+    gchar *buf;
+    CR_FILE *f;
+    int fd;
+    gboolean ret = TRUE;
+
+    type = cr_detect_compression(path, &tmp_err);
+    if (tmp_err) {
+        g_propagate_prefixed_error(err, tmp_err, "%s: ", path);
+        return FALSE;
+    }
+
+    if (type == CR_CW_NO_COMPRESSION) {
+        lf->mf = g_mapped_file_new(path, FALSE, &tmp_err);
+        if (!lf->mf) {
+            g_set_error(err, ERR_DOMAIN, CRE_IO,
+                        "Cannot map %s: %s", path, tmp_err->message);
+            g_clear_error(&tmp_err);
+            return FALSE;
+        }
+        lf->data = g_mapped_file_get_contents(lf->mf);
+        lf->size = g_mapped_file_get_length(lf->mf);
+        return TRUE;
+    }
+
+    f = cr_open(path, CR_CW_MODE_READ, type, &tmp_err);
+    if (!f) {
+        g_propagate_prefixed_error(err, tmp_err, "Cannot open %s: ", path);
+        return FALSE;
+    }
+
+    fd = g_file_open_tmp("createrepo_c_lazy_XXXXXX", &tmp_path, &tmp_err);
+    if (fd == -1) {
+        g_set_error(err, ERR_DOMAIN, CRE_IO,
+                    "Cannot create temporary file: %s", tmp_err->message);
+        g_clear_error(&tmp_err);
+        cr_close(f, NULL);
+        return FALSE;
+    }
+
+    buf = g_malloc(LAZY_BUFFER_SIZE);
+    while (ret) {
+        int len = cr_read(f, buf, LAZY_BUFFER_SIZE, &tmp_err);
+        if (tmp_err) {
+            g_propagate_prefixed_error(err, tmp_err, "Cannot read %s: ", path);
+            ret = FALSE;
+        } else if (len == 0) {
+            break;
+        } else if (write(fd, buf, len) != len) {
+            g_set_error(err, ERR_DOMAIN, CRE_IO,
+                        "Cannot write %s: %s", tmp_path, g_strerror(errno));
+            ret = FALSE;
+        }
+    }
+    g_free(buf);
+    cr_close(f, NULL);
+    close(fd);
+
+    if (ret) {
+        lf->mf = g_mapped_file_new(tmp_path, FALSE, &tmp_err);
+        if (!lf->mf) {
+            g_set_error(err, ERR_DOMAIN, CRE_IO,
+                        "Cannot map %s: %s", tmp_path, tmp_err->message);
+            g_clear_error(&tmp_err);
+            ret = FALSE;
+        } else {
+            lf->data = g_mapped_file_get_contents(lf->mf);
+            lf->size = g_mapped_file_get_length(lf->mf);
+        }
+    }
+
+    // The mapping stays valid
+    g_unlink(tmp_path);
+    g_free(tmp_path);
+
+    return ret;
+}
+
+/** Find the markup (e.g. "<package") in the data. Comments and CDATA
+ * sections are skipped, so a markup in them is never found.
+ * @return              pointer to the markup or NULL
+ */
+static const char *
+cr_lazy_find(const char *data, gsize size, const char *markup)
+{
+    const char *end = data + size;
+    gsize len = strlen(markup);
+
+    while ((data = memchr(data, '<', end - data))) {
+        const char *skip_to = NULL;
+        gsize rest = end - data;
+
+        if (rest >= 4 && !memcmp(data, "<!--", 4))
+            skip_to = "-->";
+        else if (rest >= 9 && !memcmp(data, "<![CDATA[", 9))
+            skip_to = "]]>";
+
+        if (skip_to) {
+            data = g_strstr_len(data, rest, skip_to);
+            if (!data)
+                return NULL;
+            continue;
+        }
+
+        if (rest >= len && !memcmp(data, markup, len))
+            return data;
+        data++;
+    }
+
+    return NULL;
+}
+
+/** Find next <package> element in the data.
+ */
+static gboolean
+cr_lazy_next_package(const char *data, gsize size, gsize *pos,
+                     gsize *start, gsize *len)
+{
+    while (*pos < size) {
+        const char *beg, *end;
+        char c;
+
+        beg = cr_lazy_find(data + *pos, size - *pos, "<package");
+        if (!beg)
+            return FALSE;
+
+        *pos = beg - data + 8;
+        c = (*pos < size) ? data[*pos] : '\0';
+        if (c != ' ' && c != '\t' && c != '\n' && c != '\r' && c != '>')
+            continue;   // E.g. <packager>
+
+        end = cr_lazy_find(beg, size - (beg - data), "</package>");
+        if (!end)
+            return FALSE;
+
+        *start = beg - data;
+        *len = end - beg + 10;
+        *pos = *start + *len;
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/** Decode a numeric character reference (&#NN; or &#xNN;) at the start
+ * of the str and append the character to the out.
+ * @return              length of the reference or 0 if it is not valid
+ */
+static gsize
+cr_lazy_unescape_charref(GString *out, const char *str, gsize len)
+{
+    const char *end = memchr(str, ';', len);
+    const char *num;
+    gchar *num_end;
+    guint64 c;
+
+    if (len < 4 || str[1] != '#' || !end)
+        return 0;
+
+    if (str[2] == 'x' || str[2] == 'X') {
+        num = str + 3;
+        c = g_ascii_strtoull(num, &num_end, 16);
+    } else {
+        num = str + 2;
+        c = g_ascii_strtoull(num, &num_end, 10);
+    }
+
+    if (num_end != end || num_end == num || !g_ascii_isxdigit(*num)
+        || c == 0 || c > G_MAXUINT32 || !g_unichar_validate((gunichar) c))
+        return 0;
+
+    g_string_append_unichar(out, (gunichar) c);
+    return end - str + 1;
+}
+
+/** Append xml text or attribute value to the out and replace
+ * the predefined entities and numeric character references.
+ */
+static void
+cr_lazy_unescape_append(GString *out, const char *str, gsize len)
+{
+    static const struct { const char *entity; char c; } entities[] = {
+        {"&amp;", '&'}, {"&lt;", '<'}, {"&gt;", '>'},
+        {"&quot;", '"'}, {"&apos;", '\''},
+    };
+
+    for (gsize x = 0; x < len; x++) {
+        gboolean replaced = FALSE;
+        if (str[x] == '&' && len - x > 1 && str[x+1] == '#') {
+            gsize rlen = cr_lazy_unescape_charref(out, str + x, len - x);
+            if (rlen) {
+                x += rlen - 1;
+                continue;
+            }
+        } else if (str[x] == '&') {
+            for (gsize y = 0; y < G_N_ELEMENTS(entities); y++) {
+                gsize elen = strlen(entities[y].entity);
+                if (len - x >= elen && !strncmp(str+x, entities[y].entity, elen)) {
+                    g_string_append_c(out, entities[y].c);
+                    x += elen - 1;
+                    replaced = TRUE;
+                    break;
+                }
+            }
+        }
+        if (!replaced)
+            g_string_append_c(out, str[x]);
+    }
+}
+
+/** Copy xml text or attribute value into the chunk and replace
+ * the predefined entities and numeric character references.
+ */
+static const char *
+cr_lazy_unescape(GStringChunk *chunk, const char *str, gsize len)
+{
+    GString *out;
+    const char *res;
+
+    if (!memchr(str, '&', len))
+        return g_string_chunk_insert_len(chunk, str, len);
+
+    out = g_string_sized_new(len);
+    cr_lazy_unescape_append(out, str, len);
+    res = g_string_chunk_insert_len(chunk, out->str, out->len);
+    g_string_free(out, TRUE);
+    return res;
+}
+
+/** Get a text of the first element with the tag in the package.
+ * The text may be split by comments and CDATA sections.
+ */
+static const char *
+cr_lazy_element_text(GStringChunk *chunk, const char *pkg, gsize len,
+                     const char *tag)
+{
+    const char *beg, *end, *pkg_end = pkg + len;
+    GString *text;
+    const char *res;
+
+    beg = cr_lazy_find(pkg, len, tag);
+    if (!beg)
+        return NULL;
+    beg = memchr(beg, '>', pkg_end - beg);
+    if (!beg)
+        return NULL;
+    beg++;
+    end = memchr(beg, '<', pkg_end - beg);
+    if (!end)
+        return NULL;
+
+    // The usual case - just a text
+    if (end + 1 < pkg_end && end[1] == '/')
+        return cr_lazy_unescape(chunk, beg, end - beg);
+
+    text = g_string_new(NULL);
+    while (end) {
+        gsize rest = pkg_end - end;
+
+        cr_lazy_unescape_append(text, beg, end - beg);
+
+        if (rest >= 9 && !memcmp(end, "<![CDATA[", 9)) {
+            beg = end + 9;
+            end = g_strstr_len(beg, pkg_end - beg, "]]>");
+            if (!end)
+                break;
+            g_string_append_len(text, beg, end - beg);
+            beg = end + 3;
+        } else if (rest >= 4 && !memcmp(end, "<!--", 4)) {
+            end = g_strstr_len(end, rest, "-->");
+            if (!end)
+                break;
+            beg = end + 3;
+        } else {
+            // End of the element (or a nested one)
+            res = g_string_chunk_insert_len(chunk, text->str, text->len);
+            g_string_free(text, TRUE);
+            return res;
+        }
+
+        end = memchr(beg, '<', pkg_end - beg);
+    }
+
+    g_string_free(text, TRUE);
+    return NULL;
+}
+
+/** Get a value of an attribute of the first element with the tag.
+ */
+static const char *
+cr_lazy_attr_value(GStringChunk *chunk, const char *pkg, gsize len,
+                   const char *tag, const char *attr)
+{
+    const char *beg, *tag_end, *end;
+    gsize attr_len = strlen(attr);
+    char quote;
+
+    beg = cr_lazy_find(pkg, len, tag);
+    if (!beg)
+        return NULL;
+    tag_end = memchr(beg, '>', len - (beg - pkg));
+    if (!tag_end)
+        return NULL;
+
+    for (beg += strlen(tag); beg + attr_len + 2 < tag_end; beg++) {
+        if ((beg[-1] == ' ' || beg[-1] == '\t' || beg[-1] == '\n')
+            && !strncmp(beg, attr, attr_len) && beg[attr_len] == '=')
+        {
+            beg += attr_len + 1;
+            quote = *beg++;
+            if (quote != '"' && quote != '\'')
+                return NULL;
+            end = memchr(beg, quote, tag_end - beg);
+            if (!end)
+                return NULL;
+            return cr_lazy_unescape(chunk, beg, end - beg);
+        }
+    }
+
+    return NULL;
+}
+
+/** Find the <package> elements in the filelists and other and store their
+ * locations into the entries of the index (paired by pkgId).
+ * @param index         index with opened files
+ * @param add           if TRUE, entries for unknown pkgIds are created
+ *                      and a pkgId present more than once in a file is
+ *                      marked as ignored. If FALSE, only the existing entries
+ *                      are completed (the first occurrence wins).
+ */
+static void
+cr_lazy_index_pair(cr_LazyIndex *index, gboolean add)
+{
+    gsize pos, start, len;
+
+    for (int x = LAZY_FIL; x < LAZY_SENTINEL; x++) {
+        cr_LazyFile *lf = &index->files[x];
+        if (!lf->mf)
+            continue;
+        pos = 0;
+        while (cr_lazy_next_package(lf->data, lf->size, &pos, &start, &len)) {
+            cr_LazyEntry *entry;
+            const char *pkgId;
+            const char *end = memchr(lf->data + start, '>', len);
+
+            if (!end)
+                continue;
+            pkgId = cr_lazy_attr_value(index->chunk, lf->data + start,
+                                       end - (lf->data + start) + 1,
+                                       "<package", "pkgid");
+            if (!pkgId)
+                continue;
+            entry = g_hash_table_lookup(index->by_pkgid, pkgId);
+
+            if (!entry && add) {
+                entry = g_new0(cr_LazyEntry, 1);
+                entry->index = index;
+                entry->pkgId = pkgId;
+                g_ptr_array_add(index->entries, entry);
+                g_hash_table_insert(index->by_pkgid, (gpointer) pkgId, entry);
+            } else if (entry && entry->length[x] && add) {
+                entry->ignored = TRUE;
+            }
+
+            if (entry && !entry->length[x]) {
+                entry->offset[x] = start;
+                entry->length[x] = len;
+            }
+        }
+    }
+}
+
+/** Index the original filelists and other xml chunks.
+ */
+static int
+cr_metadata_index_original_xml(cr_Metadata *md,
+                               struct cr_MetadataLocation *ml,
+                               GError **err)
+{
+    cr_LazyIndex *index = cr_lazy_index_new();
+    const char *paths[LAZY_SENTINEL] = {
+        NULL, ml->fil_xml_href, ml->oth_xml_href
+    };
+
+    for (int x = LAZY_FIL; x < LAZY_SENTINEL; x++) {
+        if (!paths[x])
+            continue;
+        if (!cr_lazy_file_open(&index->files[x], paths[x], err)) {
+            cr_lazy_index_free(index);
+            return CRE_IO;
+        }
+    }
+
+    cr_lazy_index_pair(index, TRUE);
+
+    g_debug("%s: Indexed original xml chunks of %u packages", __func__,
+            index->entries->len);
+
+    md->xml_indexes = g_slist_append(md->xml_indexes, index);
+
+    return CRE_OK;
+}
+
+const char *
+cr_metadata_get_xml(cr_Metadata *md,
+                    const char *pkgId,
+                    cr_XmlFileType type,
+                    gsize *len)
+{
+    GSList *indexes;
+    int x;
+
+    assert(md);
+    assert(len);
+
+    switch (type) {
+        case CR_XMLFILE_FILELISTS:  x = LAZY_FIL; break;
+        case CR_XMLFILE_OTHER:      x = LAZY_OTH; break;
+        default:                    return NULL;
+    }
+
+    if (!pkgId)
+        return NULL;
+
+    // In the lazy mode, the indexes of the packages are used
+    indexes = md->xml_indexes ? md->xml_indexes : md->lazy_indexes;
+
+    for (GSList *elem = indexes; elem; elem = g_slist_next(elem)) {
+        cr_LazyIndex *index = elem->data;
+        cr_LazyEntry *entry = g_hash_table_lookup(index->by_pkgid, pkgId);
+        if (!entry || entry->ignored || !entry->length[x])
+            continue;
+        *len = entry->length[x];
+        return index->files[x].data + entry->offset[x];
+    }
+
+    return NULL;
+}
+
+static int
+cr_metadata_index_xml(cr_Metadata *md,
+                      struct cr_MetadataLocation *ml,
+                      GError **err)
+{
+    cr_LazyIndex *index;
+    const char *paths[LAZY_SENTINEL];
+    GHashTable *by_key, *ignored_keys;
+    gsize pos, start, len;
+    cr_LazyFile *lf;
+
+    paths[LAZY_PRI] = ml->pri_xml_href;
+    paths[LAZY_FIL] = ml->fil_xml_href;
+    paths[LAZY_OTH] = ml->oth_xml_href;
+
+    index = cr_lazy_index_new();
+
+    for (int x = 0; x < LAZY_SENTINEL; x++) {
+        if (!paths[x])
+            continue;
+        if (!cr_lazy_file_open(&index->files[x], paths[x], err)) {
+            cr_lazy_index_free(index);
+            return CRE_IO;
+        }
+    }
+
+    // Primary - one entry per package
+    lf = &index->files[LAZY_PRI];
+    pos = 0;
+    while (cr_lazy_next_package(lf->data, lf->size, &pos, &start, &len)) {
+        const char *pkg = lf->data + start;
+        const char *pkgId, *href, *basename;
+        cr_LazyEntry *entry, *eentry;
+
+        pkgId = cr_lazy_element_text(index->chunk, pkg, len, "<checksum");
+        href  = cr_lazy_attr_value(index->chunk, pkg, len, "<location", "href");
+        basename = cr_get_filename(href);
+        if (!pkgId || !basename) {
+            g_debug("%s: Package at offset %"G_GSIZE_FORMAT" without "
+                    "checksum or location - Ignoring", __func__, start);
+            continue;
+        }
+
+        if (md->pkglist_ht
+            && !g_hash_table_lookup_extended(md->pkglist_ht, basename, NULL, NULL))
+            continue;
+
+        eentry = g_hash_table_lookup(index->by_pkgid, pkgId);
+        if (eentry) {
+            // Same rules as for the full loading
+            if (g_strcmp0(eentry->basename, basename)) {
+                g_debug("Multiple different packages with the same "
+                        "checksum: %s. Ignoring all packages with the "
+                        "checksum.", pkgId);
+                eentry->ignored = TRUE;
+            }
+            continue;
+        }
+
+        entry = g_new0(cr_LazyEntry, 1);
+        entry->index    = index;
+        entry->pkgId    = pkgId;
+        entry->name     = cr_lazy_element_text(index->chunk, pkg, len, "<name");
+        entry->basename = basename;
+        entry->offset[LAZY_PRI] = start;
+        entry->length[LAZY_PRI] = len;
+        g_ptr_array_add(index->entries, entry);
+        g_hash_table_insert(index->by_pkgid, (gpointer) pkgId, entry);
+    }
+
+    // Filelists and other - pair by pkgId
+    cr_lazy_index_pair(index, FALSE);
+
+    // Index by the user selected key
+    by_key = g_hash_table_new(g_str_hash, g_str_equal);
+    ignored_keys = g_hash_table_new(g_str_hash, g_str_equal);
+
+    for (guint x = 0; x < index->entries->len; x++) {
+        cr_LazyEntry *entry = g_ptr_array_index(index->entries, x);
+        cr_LazyEntry *eentry;
+        const char *key;
+
+        if (entry->ignored)
+            continue;
+
+        switch (md->key) {
+            case CR_HT_KEY_FILENAME: key = entry->basename; break;
+            case CR_HT_KEY_NAME:     key = entry->name;     break;
+            default:                 key = entry->pkgId;    break;
+        }
+
+        if (!key)
+            continue;
+
+        eentry = g_hash_table_lookup(by_key, key);
+        if (!eentry) {
+            g_hash_table_insert(by_key, (gpointer) key, entry);
+        } else if (md->dupaction == CR_HT_DUPACT_REMOVEALL
+                   && (g_strcmp0(entry->pkgId, eentry->pkgId)
+                       || g_strcmp0(entry->basename, eentry->basename)))
+        {
+            g_hash_table_insert(ignored_keys, (gpointer) key, NULL);
+        }
+    }
+
+    GHashTableIter iter;
+    gpointer p_key, p_value;
+    g_hash_table_iter_init(&iter, ignored_keys);
+    while (g_hash_table_iter_next(&iter, &p_key, NULL))
+        g_hash_table_remove(by_key, p_key);
+    g_hash_table_remove_all(ignored_keys);
+
+    g_debug("%s: Indexed items: %d", __func__, g_hash_table_size(by_key));
+
+    // Merge with the previously loaded locations - same rules as
+    // cr_metadata_fill_hashtable() uses for the full loading
+    if (!md->lazy_by_key) {
+        md->lazy_by_key = g_hash_table_new(g_str_hash, g_str_equal);
+        md->lazy_mutex = g_mutex_new();
+    }
+
+    g_mutex_lock(md->lazy_mutex);
+
+    g_hash_table_iter_init(&iter, by_key);
+    while (g_hash_table_iter_next(&iter, &p_key, &p_value)) {
+        cr_LazyEntry *entry = p_value;
+        cr_LazyEntry *eentry = g_hash_table_lookup(md->lazy_by_key, p_key);
+
+        if (!eentry) {
+            g_hash_table_insert(md->lazy_by_key, p_key, entry);
+        } else if (md->dupaction == CR_HT_DUPACT_REMOVEALL
+                   && (g_strcmp0(entry->pkgId, eentry->pkgId)
+                       || g_strcmp0(entry->basename, eentry->basename)))
+        {
+            g_hash_table_insert(ignored_keys, p_key, NULL);
+        }
+    }
+
+    g_hash_table_iter_init(&iter, ignored_keys);
+    while (g_hash_table_iter_next(&iter, &p_key, NULL))
+        g_hash_table_remove(md->lazy_by_key, p_key);
+
+    // Keys of the index are kept by md->lazy_by_key, so the index lives
+    // as long as the metadata object
+    md->lazy_indexes = g_slist_append(md->lazy_indexes, index);
+
+    g_mutex_unlock(md->lazy_mutex);
+
+    g_hash_table_destroy(ignored_keys);
+    g_hash_table_destroy(by_key);
+
+    return CRE_OK;
+}
+
+static int
+cr_lazy_primary_pkgcb(cr_Package *pkg, void *cbdata, GError **err)
+{
+    cr_CbData *cb_data = cbdata;
+
+    if (cb_data->chunk) {
+        assert(pkg->chunk == cb_data->chunk);
+        pkg->chunk = NULL;
+    }
+
+    if (!pkg->pkgId || g_hash_table_size(cb_data->ht)) {
+        g_set_error(err, ERR_DOMAIN, CRE_XMLDATA,
+                    "Unexpected content of the indexed package");
+        cr_package_free(pkg);
+        return CR_CB_RET_ERR;
+    }
+
+    pkg->loadingflags |= CR_PACKAGE_FROM_XML;
+    pkg->loadingflags |= CR_PACKAGE_LOADED_PRI;
+    g_hash_table_insert(cb_data->ht, pkg->pkgId, pkg);
+
+    return CR_CB_RET_OK;
+}
+
+/** Parse the package from the indexed xml streams.
+ */
+static cr_Package *
+cr_lazy_parse_package(cr_Metadata *md, cr_LazyEntry *entry, GError **err)
+{
+    cr_LazyIndex *index = entry->index;
+    cr_CbData cb_data;
+    cr_Package *pkg = NULL;
+    GHashTableIter iter;
+    gpointer value;
+    gchar *snippet;
+    int ret;
+
+    memset(&cb_data, 0, sizeof(cb_data));
+    cb_data.ht      = g_hash_table_new(g_str_hash, g_str_equal);
+    cb_data.chunk   = md->chunk;
+    cb_data.origin  = CR_PACKAGE_FROM_XML;
+
+    cb_data.state = PARSING_PRI;
+    snippet = g_strndup(index->files[LAZY_PRI].data + entry->offset[LAZY_PRI],
+                        entry->length[LAZY_PRI]);
+    ret = cr_xml_parse_primary_snippet(snippet,
+                                       primary_newpkgcb,
+                                       &cb_data,
+                                       cr_lazy_primary_pkgcb,
+                                       &cb_data,
+                                       cr_warning_cb,
+                                       "Primary XML parser",
+                                       (entry->length[LAZY_FIL]) ? 0 : 1,
+                                       err);
+    g_free(snippet);
+
+    g_hash_table_iter_init(&iter, cb_data.ht);
+    if (g_hash_table_iter_next(&iter, NULL, &value))
+        pkg = value;
+
+    if (ret != CRE_OK || !pkg)
+        goto error;
+
+    for (int x = LAZY_FIL; x < LAZY_SENTINEL; x++) {
+        if (!entry->length[x])
+            continue;
+
+        snippet = g_strndup(index->files[x].data + entry->offset[x],
+                            entry->length[x]);
+        if (x == LAZY_FIL) {
+            cb_data.state = PARSING_FIL;
+            ret = cr_xml_parse_filelists_snippet(snippet, newpkgcb, &cb_data,
+                                                 pkgcb, &cb_data, cr_warning_cb,
+                                                 "Filelists XML parser", err);
+        } else {
+            cb_data.state = PARSING_OTH;
+            ret = cr_xml_parse_other_snippet(snippet, newpkgcb, &cb_data,
+                                             pkgcb, &cb_data, cr_warning_cb,
+                                             "Other XML parser", err);
+        }
+        g_free(snippet);
+
+        if (ret != CRE_OK)
+            goto error;
+    }
+
+    g_hash_table_destroy(cb_data.ht);
+    return pkg;
+
+error:
+    if (pkg && md->chunk)
+        pkg->chunk = NULL;
+    cr_package_free(pkg);
+    g_hash_table_destroy(cb_data.ht);
+    if (err && !*err)
+        g_set_error(err, ERR_DOMAIN, CRE_XMLDATA,
+                    "Cannot parse indexed package %s", entry->pkgId);
+    return NULL;
+}
+
+cr_Package *
+cr_metadata_get(cr_Metadata *md, const char *key, GError **err)
+{
+    cr_Package *pkg;
+    cr_LazyEntry *entry;
+    const char *new_key;
+
+    assert(md);
+    assert(key);
+    assert(!err || *err == NULL);
+
+    if (!md->lazy_by_key)
+        return g_hash_table_lookup(md->ht, key);
+
+    g_mutex_lock(md->lazy_mutex);
+
+    pkg = g_hash_table_lookup(md->ht, key);
+    if (pkg)
+        goto exit;
+
+    entry = g_hash_table_lookup(md->lazy_by_key, key);
+    if (!entry)
+        goto exit;
+
+    pkg = cr_lazy_parse_package(md, entry, err);
+    if (!pkg)
+        goto exit;
+
+    switch (md->key) {
+        case CR_HT_KEY_FILENAME: new_key = cr_get_filename(pkg->location_href); break;
+        case CR_HT_KEY_NAME:     new_key = pkg->name;  break;
+        default:                 new_key = pkg->pkgId; break;
+    }
+
+    if (!new_key || strcmp(new_key, key)) {
+        // The parsed value differs from the indexed one (e.g. because
+        // of an unusual escaping) - Use a copy of the requested key
+        // owned by the metadata or by the package
+        new_key = g_string_chunk_insert(md->chunk ? md->chunk : pkg->chunk,
+                                        key);
+    }
+
+    g_hash_table_insert(md->ht, (gpointer) new_key, pkg);
+
+exit:
+    g_mutex_unlock(md->lazy_mutex);
+    return pkg;
+}
+
+guint
+cr_metadata_count(cr_Metadata *md)
+{
+    assert(md);
+
+    // Parsed packages stay in the lazy index
+    if (md->lazy_by_key)
+        return g_hash_table_size(md->lazy_by_key);
+    return g_hash_table_size(md->ht);
+}
+
+int
+cr_metadata_load_snapshot(cr_Metadata *md,
+                          const char *path,
+                          GError **err)
+{
+    int result;
+    GHashTable *intern_hashtable;  // key is checksum (pkgId)
+
+    assert(md);
+    assert(path);
+    assert(!err || *err == NULL);
+
+    intern_hashtable = cr_new_metadata_hashtable();
+    result = cr_load_snapshot_file(intern_hashtable,
+                                   path,
+                                   md->chunk,
+                                   md->pkglist_ht,
+                                   err);
+
+    if (result == CRE_OK) {
+        g_debug("%s: Loaded items: %d", __func__,
+                g_hash_table_size(intern_hashtable));
+        result = cr_metadata_fill_hashtable(md, intern_hashtable, err);
+    }
+
+    cr_destroy_metadata_hashtable(intern_hashtable);
+    return result;
+}
+
+int
+cr_metadata_load_xml(cr_Metadata *md,
+                     struct cr_MetadataLocation *ml,
+                     GError **err)
+{
+    int result;
+    GError *tmp_err = NULL;
+    GHashTable *intern_hashtable;  // key is checksum (pkgId)
+
+    assert(md);
+    assert(ml);
+    assert(!err || *err == NULL);
+
+    if (md->lazy) {
+        if (!ml->pri_xml_href) {
+            g_set_error(err, ERR_DOMAIN, CRE_BADARG,
+                        "primary.xml file is missing");
+            return CRE_BADARG;
+        }
+        return cr_metadata_index_xml(md, ml, err);
+    }
+
+    // The original chunks are used even if the snapshot is loaded
+    if (md->keep_xml) {
+        result = cr_metadata_index_original_xml(md, ml, err);
+        if (result != CRE_OK)
+            return result;
+    }
+
+    if (md->use_snapshot
+        && ml->snapshot_href
+        && g_file_test(ml->snapshot_href, G_FILE_TEST_IS_REGULAR))
+    {
+        // Binary snapshot is much faster to load than the XML files
+        if (cr_snapshot_verify(ml->snapshot_href,
+                               ml->snapshot_checksum_type,
+                               ml->snapshot_checksum,
+                               &tmp_err)
+            && cr_metadata_load_snapshot(md, ml->snapshot_href, &tmp_err)
+                == CRE_OK)
+            return CRE_OK;
+
+        g_warning("%s: Cannot use snapshot %s (%s) - Falling back to XML",
+                  __func__, ml->snapshot_href, tmp_err->message);
+        g_clear_error(&tmp_err);
+    }
+
+    if (!ml->pri_xml_href) {
+        g_set_error(err, ERR_DOMAIN, CRE_BADARG,
+                    "primary.xml file is missing");
+        return CRE_BADARG;
+    }
+
+    // Load metadata
+    intern_hashtable = cr_new_metadata_hashtable();
+    result = cr_load_xml_files(intern_hashtable,
+                               ml->pri_xml_href,
+                               ml->fil_xml_href,
+                               ml->oth_xml_href,
+                               md->chunk,
+                               md->pkglist_ht,
+                               &tmp_err);
+
+    if (result != CRE_OK) {
+        g_critical("%s: Error encountered while parsing", __func__);
+        g_propagate_prefixed_error(err, tmp_err,
+                                   "Error encountered while parsing:");
+        cr_destroy_metadata_hashtable(intern_hashtable);
+        return result;
+    }
+
+    g_debug("%s: Parsed items: %d", __func__,
+            g_hash_table_size(intern_hashtable));
+
+    result = cr_metadata_fill_hashtable(md, intern_hashtable, err);
+    cr_destroy_metadata_hashtable(intern_hashtable);
+
+    return result;
+}
+
 int
 cr_metadata_locate_and_load_xml(cr_Metadata *md,
                                 const char *repopath,
@@ -22,6 +22,8 @@
 
 #include <glib.h>
 #include "locate_metadata.h"
+#include "package.h"
+#include "xml_file.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -119,12 +121,99 @@ cr_Metadata *cr_metadata_new(cr_HashTableKey key,
 gboolean
 cr_metadata_set_dupaction(cr_Metadata *md, cr_HashTableKeyDupAction dupaction);
 
+/** Enable or disable lazy loading. In the lazy mode, the loading functions
+ * only scan the xml files and remember where each package is located
+ * in the uncompressed streams. Compressed files are decompressed into
+ * an unlinked temporary file which is memory mapped.
+ * Packages are parsed on demand by cr_metadata_get() and only parsed
+ * packages are present in the cr_metadata_hashtable().
+ * Binary snapshot is not used in the lazy mode.
+ * @param md            metadata object
+ * @param lazy          TRUE to enable lazy loading
+ */
+void
+cr_metadata_set_lazy(cr_Metadata *md, gboolean lazy);
+
+/** Get a package by key. In the lazy mode, the package is parsed
+ * when it is requested for the first time. This function is thread safe.
+ * @param md            metadata object
+ * @param key           key of the package (see cr_HashTableKey)
+ * @param err           GError **
+ * @return              package owned by the metadata object or NULL
+ *                      if not found (or on error)
+ */
+cr_Package *
+cr_metadata_get(cr_Metadata *md, const char *key, GError **err);
+
+/** Get number of packages. In the lazy mode, the not yet parsed
+ * packages are counted too.
+ * @param md            metadata object
+ * @return              number of packages
+ */
+guint
+cr_metadata_count(cr_Metadata *md);
+
+/** Keep the original filelists and other xml chunks of the packages.
+ * When enabled, the loading functions additionally index the uncompressed
+ * filelists and other files (see cr_metadata_set_lazy()) and the chunks
+ * are available through cr_metadata_get_xml(). In the lazy mode,
+ * the chunks are always available.
+ * @param md            metadata object
+ * @param keep          TRUE to keep the chunks
+ */
+void
+cr_metadata_set_keep_xml(cr_Metadata *md, gboolean keep);
+
+/** Load the binary snapshot (see snapshot.h) instead of the XML files
+ * if the metadata location has one. Disabled by default.
+ * The snapshot is used only if its checksum matches the checksum
+ * in repomd.xml, otherwise the XML files are loaded. Binary snapshot
+ * is not used in the lazy mode.
+ * @param md            metadata object
+ * @param use           TRUE to use the snapshot
+ */
+void
+cr_metadata_set_use_snapshot(cr_Metadata *md, gboolean use);
+
+/** Get the original xml chunk (<package>...</package> element without
+ * the trailing newline) of the package as it was in the loaded file.
+ * @param md            metadata object
+ * @param pkgId         pkgId of the package
+ * @param type          CR_XMLFILE_FILELISTS or CR_XMLFILE_OTHER
+ * @param len           length of the chunk
+ * @return              pointer to the chunk (it is NOT null terminated)
+ *                      which is valid until the metadata are freed or NULL
+ *                      if the chunk is not available (e.g. the pkgId is
+ *                      present more than once)
+ */
+const char *
+cr_metadata_get_xml(cr_Metadata *md,
+                    const char *pkgId,
+                    cr_XmlFileType type,
+                    gsize *len);
+
 /** Destroy metadata.
  * @param md            cr_Metadata object
  */
 void cr_metadata_free(cr_Metadata *md);
 
+/** Load metadata from a binary snapshot (see snapshot.h).
+ * Packages which are not on the pkglist are not materialized at all.
+ * Loaded packages are marked with CR_PACKAGE_FROM_SNAPSHOT.
+ * @param md            metadata object
+ * @param path          path to the snapshot file
+ * @param err           GError **
+ * @return              cr_Error code
+ */
+int cr_metadata_load_snapshot(cr_Metadata *md,
+                              const char *path,
+                              GError **err);
+
 /** Load metadata from the specified location.
+ * If enabled by cr_metadata_set_use_snapshot() and the location contains
+ * a binary snapshot which is available locally, the snapshot is loaded
+ * instead of the XML files. If the snapshot cannot be verified or loaded,
+ * the XML files are used.
  * @param md            metadata object
  * @param ml            metadata location
  * @param err           GError **
@@ -24,6 +24,8 @@
 #include <curl/curl.h>
 #include <string.h>
 #include <errno.h>
+#include <unistd.h>
+#include "checksum.h"
 #include "error.h"
 #include "misc.h"
 #include "locate_metadata.h"
@@ -38,6 +40,14 @@
 #define FORMAT_XML      1
 #define FORMAT_LEVEL    0
 
+#define CACHE_STATE_FILE        "cache.ini"
+#define CACHE_GROUP_REPOMD      "repomd"
+#define CACHE_GROUP_FILES       "files"
+#define MAX_HOST_CONNECTIONS    6L
+#define CONNECT_TIMEOUT         30L     /*!< seconds */
+#define LOW_SPEED_LIMIT         1000L   /*!< bytes per second ... */
+#define LOW_SPEED_TIME          30L     /*!< ... for this many seconds */
+
 
 
 void
@@ -57,9 +67,15 @@ cr_metadatalocation_free(struct cr_MetadataLocation *ml)
     g_free(ml->pri_sqlite_href);
     g_free(ml->fil_sqlite_href);
     g_free(ml->oth_sqlite_href);
+    g_free(ml->pri_zck_href);
+    g_free(ml->fil_zck_href);
+    g_free(ml->oth_zck_href);
     g_free(ml->groupfile_href);
     g_free(ml->cgroupfile_href);
     g_free(ml->updateinfo_href);
+    g_free(ml->snapshot_href);
+    g_free(ml->snapshot_checksum);
+    g_free(ml->snapshot_checksum_type);
     g_free(ml->repomd);
     g_free(ml->original_url);
     g_free(ml->local_path);
@@ -110,12 +126,23 @@ cr_parse_repomd(const char *repomd_path,
             mdloc->oth_xml_href = full_location_href;
         else if (!g_strcmp0(record->type, "other_db") && !ignore_sqlite)
             mdloc->oth_sqlite_href = full_location_href;
+        else if (!g_strcmp0(record->type, "primary_zck"))
+            mdloc->pri_zck_href = full_location_href;
+        else if (!g_strcmp0(record->type, "filelists_zck"))
+            mdloc->fil_zck_href = full_location_href;
+        else if (!g_strcmp0(record->type, "other_zck"))
+            mdloc->oth_zck_href = full_location_href;
         else if (!g_strcmp0(record->type, "group"))
             mdloc->groupfile_href = full_location_href;
         else if (!g_strcmp0(record->type, "group_gz"))
             mdloc->cgroupfile_href = full_location_href;
         else if (!g_strcmp0(record->type, "updateinfo"))
             mdloc->updateinfo_href = full_location_href;
+        else if (!g_strcmp0(record->type, "snapshot")) {
+            mdloc->snapshot_href = full_location_href;
+            mdloc->snapshot_checksum = g_strdup(record->checksum);
+            mdloc->snapshot_checksum_type = g_strdup(record->checksum_type);
+        }
         else
             g_free(full_location_href);
     }
@@ -152,132 +179,570 @@ cr_get_local_metadata(const char *repopath, gboolean ignore_sqlite)
 }
 
 
-static struct cr_MetadataLocation *
-cr_get_remote_metadata(const char *repopath, gboolean ignore_sqlite)
+/** Metadata types downloaded from a remote repository.
+ */
+static gboolean
+remote_record_wanted(const char *type, gboolean ignore_sqlite)
 {
-    CURL *handle = NULL;
-    _cleanup_free_ gchar *tmp_dir = NULL;
-    _cleanup_free_ gchar *tmp_repodata = NULL;
-    _cleanup_free_ gchar *tmp_repomd = NULL;
-    _cleanup_free_ gchar *url = NULL;
-    struct cr_MetadataLocation *r_location = NULL;
-    struct cr_MetadataLocation *ret = NULL;
-    _cleanup_error_free_ GError *tmp_err = NULL;
+    if (!g_strcmp0(type, "primary_db")
+        || !g_strcmp0(type, "filelists_db")
+        || !g_strcmp0(type, "other_db"))
+        return !ignore_sqlite;
+
+    return !g_strcmp0(type, "primary")
+           || !g_strcmp0(type, "filelists")
+           || !g_strcmp0(type, "other")
+           || !g_strcmp0(type, "group")
+           || !g_strcmp0(type, "group_gz")
+           || !g_strcmp0(type, "updateinfo");
+}
 
-    if (!repopath)
-        return ret;
+/** One file downloaded by remote_download().
+ */
+typedef struct {
+    CURL *handle;
+    gchar *url;
+    gchar *dst;             /*!< Final path of the file */
+    gchar *tmp_dst;         /*!< Path the file is written to */
+    FILE *f;
+    struct curl_slist *headers;
+    gchar *checksum;        /*!< "type:value" of the file from repomd.xml */
+    gchar *etag;            /*!< ETag of the response */
+    gchar *last_modified;   /*!< Last-Modified of the response */
+    long response_code;
+    CURLcode result;
+    gboolean done;          /*!< File was downloaded and is on dst */
+    char errorbuf[CURL_ERROR_SIZE];
+} RemoteFile;
+
+static size_t
+remote_header_cb(char *buffer, size_t size, size_t nitems, void *userdata)
+{
+    RemoteFile *file = userdata;
+    size_t len = size * nitems;
+    _cleanup_free_ gchar *line = g_strndup(buffer, len);
+
+    g_strstrip(line);
+    if (g_str_has_prefix(line, "HTTP/")) {
+        // Headers of a new response (e.g. after a redirect)
+        g_free(file->etag);
+        g_free(file->last_modified);
+        file->etag = NULL;
+        file->last_modified = NULL;
+    } else if (!g_ascii_strncasecmp(line, "ETag:", 5)) {
+        g_free(file->etag);
+        file->etag = g_strdup(g_strstrip(line + 5));
+    } else if (!g_ascii_strncasecmp(line, "Last-Modified:", 14)) {
+        g_free(file->last_modified);
+        file->last_modified = g_strdup(g_strstrip(line + 14));
+    }
 
-    // Create temporary repo in /tmp
-    tmp_dir = g_build_filename(g_get_tmp_dir(), TMPDIR_PATTERN, NULL);
-    if (!mkdtemp(tmp_dir)) {
-        g_critical("%s: Cannot create a temporary directory: %s",
-                   __func__, g_strerror(errno));
-        return ret;
+    return len;
+}
+
+static void
+remote_file_free(RemoteFile *file)
+{
+    if (!file)
+        return;
+
+    if (file->handle)
+        curl_easy_cleanup(file->handle);
+    curl_slist_free_all(file->headers);
+    if (file->f)
+        fclose(file->f);
+    if (file->tmp_dst)
+        remove(file->tmp_dst);
+    g_free(file->tmp_dst);
+    g_free(file->dst);
+    g_free(file->url);
+    g_free(file->checksum);
+    g_free(file->etag);
+    g_free(file->last_modified);
+    g_free(file);
+}
+
+static RemoteFile *
+remote_file_new(const char *url, const char *dst, GError **err)
+{
+    int fd;
+    _cleanup_free_ gchar *dirname = g_path_get_dirname(dst);
+    RemoteFile *file = g_malloc0(sizeof(RemoteFile));
+
+    file->url = g_strdup(url);
+    file->dst = g_strdup(dst);
+    file->result = CURLE_GOT_NOTHING;
+
+    // Download into a hidden file next to dst and rename it when complete,
+    // so an interrupted download never looks like a cached file
+    file->tmp_dst = g_strconcat(dirname, "/.", cr_get_filename(dst),
+                                ".XXXXXX", NULL);
+    fd = g_mkstemp(file->tmp_dst);
+    if (fd < 0) {
+        g_set_error(err, ERR_DOMAIN, CRE_IO,
+                    "Cannot create %s: %s", file->tmp_dst, g_strerror(errno));
+        g_free(file->tmp_dst);
+        file->tmp_dst = NULL;
+        remote_file_free(file);
+        return NULL;
+    }
+
+    file->f = fdopen(fd, "wb");
+    if (!file->f) {
+        g_set_error(err, ERR_DOMAIN, CRE_IO,
+                    "Cannot open %s: %s", file->tmp_dst, g_strerror(errno));
+        close(fd);
+        remote_file_free(file);
+        return NULL;
     }
 
-    g_debug("%s: Using tmp dir: %s", __func__, tmp_dir);
+    file->handle = curl_easy_init();
+    if (!file->handle
+        || curl_easy_setopt(file->handle, CURLOPT_URL, url) != CURLE_OK
+        || curl_easy_setopt(file->handle, CURLOPT_FAILONERROR, 1L) != CURLE_OK
+        || curl_easy_setopt(file->handle, CURLOPT_FOLLOWLOCATION, 1L) != CURLE_OK
+        || curl_easy_setopt(file->handle, CURLOPT_MAXREDIRS, 6L) != CURLE_OK
+        || curl_easy_setopt(file->handle, CURLOPT_CONNECTTIMEOUT, CONNECT_TIMEOUT) != CURLE_OK
+        || curl_easy_setopt(file->handle, CURLOPT_LOW_SPEED_LIMIT, LOW_SPEED_LIMIT) != CURLE_OK
+        || curl_easy_setopt(file->handle, CURLOPT_LOW_SPEED_TIME, LOW_SPEED_TIME) != CURLE_OK
+        || curl_easy_setopt(file->handle, CURLOPT_ERRORBUFFER, file->errorbuf) != CURLE_OK
+        || curl_easy_setopt(file->handle, CURLOPT_WRITEDATA, file->f) != CURLE_OK
+        || curl_easy_setopt(file->handle, CURLOPT_HEADERFUNCTION, remote_header_cb) != CURLE_OK
+        || curl_easy_setopt(file->handle, CURLOPT_HEADERDATA, file) != CURLE_OK
+        || curl_easy_setopt(file->handle, CURLOPT_PRIVATE, (char *) file) != CURLE_OK)
+    {
+        g_set_error(err, ERR_DOMAIN, CRE_CURL,
+                    "Cannot set up a curl handle for %s", url);
+        remote_file_free(file);
+        return NULL;
+    }
 
-    // Create repodata subdir in tmp dir
-    tmp_repodata = g_build_filename(tmp_dir, "repodata", NULL);
-    if (g_mkdir (tmp_repodata, S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH)) {
-        g_critical("%s: Cannot create a temporary directory", __func__);
-        return ret;
+    return file;
+}
+
+/** Make the request conditional. If the server answers 304 Not Modified
+ * the response_code is set and dst is left untouched.
+ */
+static void
+remote_file_set_condition(RemoteFile *file,
+                          const char *etag,
+                          const char *last_modified)
+{
+    if (etag) {
+        _cleanup_free_ gchar *header = g_strconcat("If-None-Match: ",
+                                                   etag, NULL);
+        file->headers = curl_slist_append(file->headers, header);
+    }
+
+    if (last_modified) {
+        _cleanup_free_ gchar *header = g_strconcat("If-Modified-Since: ",
+                                                   last_modified, NULL);
+        file->headers = curl_slist_append(file->headers, header);
     }
 
-    // Prepare temporary repomd.xml filename
-    tmp_repomd = g_build_filename(tmp_repodata, "repomd.xml", NULL);
+    if (file->headers)
+        curl_easy_setopt(file->handle, CURLOPT_HTTPHEADER, file->headers);
+}
 
-    // Prepare repomd.xml URL
-    if (g_str_has_suffix(repopath, "/"))
-        url = g_strconcat(repopath, "repodata/repomd.xml", NULL);
+/** Check a downloaded file against its checksum from repomd.xml,
+ * so a truncated or corrupted download is never cached.
+ */
+static gboolean
+remote_file_verify(RemoteFile *file, GError **err)
+{
+    cr_ChecksumType type;
+    const char *value = strchr(file->checksum, ':');
+    _cleanup_free_ gchar *type_str = NULL;
+    _cleanup_free_ gchar *checksum = NULL;
+
+    if (!value) {
+        g_set_error(err, ERR_DOMAIN, CRE_UNKNOWNCHECKSUMTYPE,
+                    "Bad checksum of %s in repomd.xml", file->url);
+        return FALSE;
+    }
+
+    type_str = g_strndup(file->checksum, value - file->checksum);
+    type = cr_checksum_type(type_str);
+    if (type == CR_CHECKSUM_UNKNOWN) {
+        g_set_error(err, ERR_DOMAIN, CRE_UNKNOWNCHECKSUMTYPE,
+                    "Unknown checksum type \"%s\" of %s", type_str, file->url);
+        return FALSE;
+    }
+
+    checksum = cr_checksum_file(file->tmp_dst, type, err);
+    if (!checksum)
+        return FALSE;
+
+    if (g_strcmp0(checksum, value + 1)) {
+        g_set_error(err, ERR_DOMAIN, CRE_IO,
+                    "Checksum mismatch of %s (repomd.xml: %s, downloaded: %s)",
+                    file->url, value + 1, checksum);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/** Download all files in parallel. Every successfully downloaded file
+ * which matches its checksum (if any) is renamed to its dst and marked
+ * as done, even if other downloads failed.
+ */
+static int
+remote_download(GPtrArray *files, GError **err)
+{
+    int ret = CRE_OK;
+    int running = 0;
+    int msgs_left;
+    CURLM *multi;
+    CURLMcode mcode = CURLM_OK;
+    CURLMsg *msg;
+
+    if (!files->len)
+        return CRE_OK;
+
+    multi = curl_multi_init();
+    if (!multi) {
+        g_set_error(err, ERR_DOMAIN, CRE_CURL, "curl_multi_init failed");
+        return CRE_CURL;
+    }
+
+    // Connections to the same host are reused by all the transfers
+    curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS,
+                      MAX_HOST_CONNECTIONS);
+
+    for (guint i = 0; i < files->len; i++) {
+        RemoteFile *file = g_ptr_array_index(files, i);
+        curl_multi_add_handle(multi, file->handle);
+    }
+
+    do {
+        mcode = curl_multi_perform(multi, &running);
+        if (mcode == CURLM_OK && running)
+            mcode = curl_multi_wait(multi, NULL, 0, 1000, NULL);
+    } while (mcode == CURLM_OK && running);
+
+    while ((msg = curl_multi_info_read(multi, &msgs_left))) {
+        RemoteFile *file = NULL;
+
+        if (msg->msg != CURLMSG_DONE)
+            continue;
+
+        curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **) &file);
+        file->result = msg->data.result;
+        curl_easy_getinfo(msg->easy_handle, CURLINFO_RESPONSE_CODE,
+                          &file->response_code);
+    }
+
+    if (mcode != CURLM_OK) {
+        g_set_error(err, ERR_DOMAIN, CRE_CURL,
+                    "curl_multi_perform failed: %s", curl_multi_strerror(mcode));
+        ret = CRE_CURL;
+    }
+
+    for (guint i = 0; i < files->len; i++) {
+        RemoteFile *file = g_ptr_array_index(files, i);
+        int rc = fclose(file->f);
+
+        file->f = NULL;
+        curl_multi_remove_handle(multi, file->handle);
+
+        if (file->result != CURLE_OK) {
+            if (ret == CRE_OK)
+                g_set_error(err, ERR_DOMAIN, CRE_CURL,
+                            "Cannot download %s: %s", file->url,
+                            file->errorbuf[0] ? file->errorbuf
+                                : curl_easy_strerror(file->result));
+            ret = CRE_CURL;
+            continue;
+        }
+
+        if (file->response_code == 304) {
+            g_debug("%s: %s not modified", __func__, file->url);
+            continue;
+        }
+
+        if (!rc && file->checksum) {
+            GError *tmp_err = NULL;
+            if (!remote_file_verify(file, &tmp_err)) {
+                if (ret == CRE_OK) {
+                    ret = tmp_err->code;
+                    g_propagate_error(err, tmp_err);
+                } else {
+                    g_error_free(tmp_err);
+                }
+                continue;
+            }
+        }
+
+        if (rc || rename(file->tmp_dst, file->dst)) {
+            if (ret == CRE_OK)
+                g_set_error(err, ERR_DOMAIN, CRE_IO,
+                            "Cannot store %s: %s", file->dst,
+                            g_strerror(errno));
+            ret = CRE_IO;
+            continue;
+        }
+
+        g_free(file->tmp_dst);
+        file->tmp_dst = NULL;
+        file->done = TRUE;
+        g_debug("%s: Downloaded %s", __func__, file->url);
+    }
+
+    curl_multi_cleanup(multi);
+
+    return ret;
+}
+
+/** Remove cached files which are not referenced by the current repomd.xml.
+ */
+static void
+remote_cache_prune(const char *repodata, cr_Repomd *repomd, GKeyFile *state)
+{
+    const gchar *name;
+    GDir *dir;
+    gchar **keys;
+    GHashTable *keep = g_hash_table_new(g_str_hash, g_str_equal);
+
+    g_hash_table_add(keep, (gpointer) "repomd.xml");
+    for (GSList *elem = repomd->records; elem; elem = g_slist_next(elem)) {
+        cr_RepomdRecord *rec = elem->data;
+        if (rec->location_href)
+            g_hash_table_add(keep, cr_get_filename(rec->location_href));
+    }
+
+    dir = g_dir_open(repodata, 0, NULL);
+    while (dir && (name = g_dir_read_name(dir))) {
+        // Hidden files are downloads in progress
+        if (name[0] == '.' || g_hash_table_contains(keep, name))
+            continue;
+        _cleanup_free_ gchar *path = g_build_filename(repodata, name, NULL);
+        g_debug("%s: Removing %s", __func__, path);
+        remove(path);
+    }
+    if (dir)
+        g_dir_close(dir);
+
+    keys = g_key_file_get_keys(state, CACHE_GROUP_FILES, NULL, NULL);
+    for (gchar **key = keys; key && *key; key++)
+        if (!g_hash_table_contains(keep, *key))
+            g_key_file_remove_key(state, CACHE_GROUP_FILES, *key, NULL);
+    g_strfreev(keys);
+
+    g_hash_table_destroy(keep);
+}
+
+static void
+remote_cache_set(GKeyFile *state, const char *key, const char *value)
+{
+    if (value)
+        g_key_file_set_string(state, CACHE_GROUP_REPOMD, key, value);
     else
-        url = g_strconcat(repopath, "/repodata/repomd.xml", NULL);
+        g_key_file_remove_key(state, CACHE_GROUP_REPOMD, key, NULL);
+}
+
+static struct cr_MetadataLocation *
+cr_get_remote_metadata(const char *repopath,
+                       gboolean ignore_sqlite,
+                       const char *cache_dir,
+                       GError **err)
+{
+    _cleanup_free_ gchar *baseurl = NULL;
+    _cleanup_free_ gchar *local_dir = NULL;
+    _cleanup_free_ gchar *repodata = NULL;
+    _cleanup_free_ gchar *repomd_path = NULL;
+    _cleanup_free_ gchar *repomd_url = NULL;
+    _cleanup_free_ gchar *state_path = NULL;
+    GKeyFile *state = NULL;
+    GPtrArray *files = NULL;
+    RemoteFile *file;
+    cr_Repomd *repomd = NULL;
+    struct cr_MetadataLocation *ret = NULL;
+    GError *tmp_err = NULL;
+
+    baseurl = g_strdup(repopath);
+    while (g_str_has_suffix(baseurl, "/"))
+        baseurl[strlen(baseurl) - 1] = '\0';
+
+    if (cache_dir) {
+        // Every repository has its own subdirectory in the cache
+        _cleanup_free_ gchar *key = g_compute_checksum_for_string(
+                                            G_CHECKSUM_SHA256, baseurl, -1);
+        local_dir = g_build_filename(cache_dir, key, NULL);
+    } else {
+        // Create temporary repo in /tmp
+        local_dir = g_build_filename(g_get_tmp_dir(), TMPDIR_PATTERN, NULL);
+        if (!mkdtemp(local_dir)) {
+            g_set_error(err, ERR_DOMAIN, CRE_IO,
+                        "Cannot create a temporary directory: %s",
+                        g_strerror(errno));
+            return NULL;
+        }
+    }
 
-    // Create and setup CURL handle
-    handle = curl_easy_init();
+    g_debug("%s: Using dir: %s", __func__, local_dir);
 
-    // Fail on HTTP error (return code >= 400)
-    if (curl_easy_setopt(handle, CURLOPT_FAILONERROR, 1) != CURLE_OK) {
-        g_critical("%s: curl_easy_setopt(CURLOPT_FAILONERROR) error", __func__);
+    repodata = g_build_filename(local_dir, "repodata", NULL);
+    if (g_mkdir_with_parents(repodata, S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH)) {
+        g_set_error(err, ERR_DOMAIN, CRE_IO,
+                    "Cannot create %s: %s", repodata, g_strerror(errno));
         goto get_remote_metadata_cleanup;
     }
 
-    // Follow redirs
-    if (curl_easy_setopt(handle, CURLOPT_FOLLOWLOCATION, 1) != CURLE_OK) {
-        g_critical("%s: curl_easy_setopt(CURLOPT_FOLLOWLOCATION) error", __func__);
+    state = g_key_file_new();
+    if (cache_dir) {
+        state_path = g_build_filename(local_dir, CACHE_STATE_FILE, NULL);
+        // Missing or broken state only means that nothing is cached
+        g_key_file_load_from_file(state, state_path, G_KEY_FILE_NONE, NULL);
+    }
+
+    files = g_ptr_array_new_with_free_func((GDestroyNotify) remote_file_free);
+
+    // Download repomd.xml, conditionally if there is a cached one
+    repomd_path = g_build_filename(repodata, "repomd.xml", NULL);
+    repomd_url = g_strconcat(baseurl, "/repodata/repomd.xml", NULL);
+    file = remote_file_new(repomd_url, repomd_path, err);
+    if (!file)
         goto get_remote_metadata_cleanup;
+    g_ptr_array_add(files, file);
+
+    if (state_path && g_file_test(repomd_path, G_FILE_TEST_IS_REGULAR)) {
+        _cleanup_free_ gchar *etag = NULL;
+        _cleanup_free_ gchar *last_modified = NULL;
+        etag = g_key_file_get_string(state, CACHE_GROUP_REPOMD, "etag", NULL);
+        last_modified = g_key_file_get_string(state, CACHE_GROUP_REPOMD,
+                                              "last_modified", NULL);
+        remote_file_set_condition(file, etag, last_modified);
     }
 
-    // Maximal number of redirects
-    if (curl_easy_setopt(handle, CURLOPT_MAXREDIRS, 6) != CURLE_OK) {
-        g_critical("%s: curl_easy_setopt(CURLOPT_MAXREDIRS) error", __func__);
+    if (remote_download(files, err) != CRE_OK)
         goto get_remote_metadata_cleanup;
+
+    if (file->done) {
+        remote_cache_set(state, "etag", file->etag);
+        remote_cache_set(state, "last_modified", file->last_modified);
     }
 
-    // Download repomd.xml
-    cr_download(handle, url, tmp_repomd, &tmp_err);
+    g_ptr_array_set_size(files, 0);
+
+    // Parse repomd.xml
+    repomd = cr_repomd_new();
+    cr_xml_parse_repomd(repomd_path, repomd, cr_warning_cb,
+                        "Repomd xml parser", &tmp_err);
     if (tmp_err) {
-        g_critical("%s: %s", __func__, tmp_err->message);
+        // Do not let a broken repomd.xml be revalidated next time
+        g_key_file_remove_group(state, CACHE_GROUP_REPOMD, NULL);
+        g_propagate_prefixed_error(err, tmp_err, "%s: ", repomd_url);
         goto get_remote_metadata_cleanup;
     }
 
-    // Parse downloaded repomd.xml
-    r_location = cr_parse_repomd(tmp_repomd, repopath, ignore_sqlite);
-    if (!r_location) {
-        g_critical("%s: repomd.xml parser failed on %s", __func__, tmp_repomd);
-        goto get_remote_metadata_cleanup;
+    // Download all other files at once, except the ones which are
+    // already cached with the same checksum
+    for (GSList *elem = repomd->records; elem; elem = g_slist_next(elem)) {
+        cr_RepomdRecord *rec = elem->data;
+        _cleanup_free_ gchar *dst = NULL;
+        _cleanup_free_ gchar *url = NULL;
+        gchar *checksum = NULL;
+
+        if (!rec->location_href || !remote_record_wanted(rec->type, ignore_sqlite))
+            continue;
+
+        dst = g_build_filename(repodata, cr_get_filename(rec->location_href),
+                               NULL);
+
+        if (rec->checksum_type && rec->checksum)
+            checksum = g_strconcat(rec->checksum_type, ":", rec->checksum, NULL);
+
+        if (state_path && checksum) {
+            _cleanup_free_ gchar *cached = NULL;
+            cached = g_key_file_get_string(state, CACHE_GROUP_FILES,
+                                           cr_get_filename(dst), NULL);
+            if (!g_strcmp0(cached, checksum)
+                && g_file_test(dst, G_FILE_TEST_IS_REGULAR))
+            {
+                g_debug("%s: Using cached %s", __func__, dst);
+                g_free(checksum);
+                continue;
+            }
+        }
+
+        url = g_strconcat(baseurl, "/", rec->location_href, NULL);
+        file = remote_file_new(url, dst, err);
+        if (!file) {
+            g_free(checksum);
+            goto get_remote_metadata_cleanup;
+        }
+        file->checksum = checksum;
+        g_ptr_array_add(files, file);
     }
 
-    // Download all other repofiles
-    if (r_location->pri_xml_href)
-        cr_download(handle, r_location->pri_xml_href, tmp_repodata, &tmp_err);
-    if (!tmp_err && r_location->fil_xml_href)
-        cr_download(handle, r_location->fil_xml_href, tmp_repodata, &tmp_err);
-    if (!tmp_err && r_location->oth_xml_href)
-        cr_download(handle, r_location->oth_xml_href, tmp_repodata, &tmp_err);
-    if (!tmp_err && r_location->pri_sqlite_href)
-        cr_download(handle, r_location->pri_sqlite_href, tmp_repodata, &tmp_err);
-    if (!tmp_err && r_location->fil_sqlite_href)
-        cr_download(handle, r_location->fil_sqlite_href, tmp_repodata, &tmp_err);
-    if (!tmp_err && r_location->oth_sqlite_href)
-        cr_download(handle, r_location->oth_sqlite_href, tmp_repodata, &tmp_err);
-    if (!tmp_err && r_location->groupfile_href)
-        cr_download(handle, r_location->groupfile_href, tmp_repodata, &tmp_err);
-    if (!tmp_err && r_location->cgroupfile_href)
-        cr_download(handle, r_location->cgroupfile_href, tmp_repodata, &tmp_err);
-    if (!tmp_err && r_location->updateinfo_href)
-        cr_download(handle, r_location->updateinfo_href, tmp_repodata, &tmp_err);
-
-    cr_metadatalocation_free(r_location);
+    remote_download(files, &tmp_err);
+
+    for (guint i = 0; i < files->len; i++) {
+        file = g_ptr_array_index(files, i);
+        if (file->done && file->checksum)
+            g_key_file_set_string(state, CACHE_GROUP_FILES,
+                                  cr_get_filename(file->dst), file->checksum);
+    }
 
     if (tmp_err) {
-        g_critical("%s: Error while downloadig files: %s",
-                   __func__, tmp_err->message);
+        g_propagate_prefixed_error(err, tmp_err,
+                                   "Error while downloading files: ");
         goto get_remote_metadata_cleanup;
     }
 
     g_debug("%s: Remote metadata was successfully downloaded", __func__);
 
+    if (state_path)
+        remote_cache_prune(repodata, repomd, state);
+
     // Parse downloaded data
-    ret = cr_get_local_metadata(tmp_dir, ignore_sqlite);
-    if (ret)
+    ret = cr_get_local_metadata(local_dir, ignore_sqlite);
+    if (!ret)
+        g_set_error(err, ERR_DOMAIN, CRE_BADXMLREPOMD,
+                    "Cannot parse %s", repomd_path);
+    else if (!cache_dir)
         ret->tmp = 1;
 
 get_remote_metadata_cleanup:
 
-    if (handle)
-        curl_easy_cleanup(handle);
-    if (!ret) cr_remove_dir(tmp_dir, NULL);
+    if (state_path) {
+        _cleanup_free_ gchar *data = g_key_file_to_data(state, NULL, NULL);
+        if (!g_file_set_contents(state_path, data, -1, &tmp_err)) {
+            g_warning("%s: Cannot save %s: %s", __func__,
+                      state_path, tmp_err->message);
+            g_clear_error(&tmp_err);
+        }
+    }
+
+    if (files)
+        g_ptr_array_free(files, TRUE);
+    if (state)
+        g_key_file_free(state);
+    cr_repomd_free(repomd);
+
+    if (!ret && !cache_dir)
+        cr_remove_dir(local_dir, NULL);
 
     return ret;
 }
 
 
-// XXX: err is not really used in this function yet
 struct cr_MetadataLocation *
 cr_locate_metadata(const char *repopath, gboolean ignore_sqlite, GError **err)
+{
+    return cr_locate_metadata_cached(repopath, ignore_sqlite, NULL, err);
+}
+
+
+struct cr_MetadataLocation *
+cr_locate_metadata_cached(const char *repopath,
+                          gboolean ignore_sqlite,
+                          const char *cache_dir,
+                          GError **err)
 {
     struct cr_MetadataLocation *ret = NULL;
+    GError *tmp_err = NULL;
 
     assert(repopath);
     assert(!err || *err == NULL);
@@ -287,7 +752,8 @@ cr_locate_metadata(const char *repopath, gboolean ignore_sqlite, GError **err)
         g_str_has_prefix(repopath, "https://"))
     {
         // Remote metadata - Download them via curl
-        ret = cr_get_remote_metadata(repopath, ignore_sqlite);
+        ret = cr_get_remote_metadata(repopath, ignore_sqlite, cache_dir,
+                                     &tmp_err);
     } else {
         // Local metadata
         if (g_str_has_prefix(repopath, "file://"))
@@ -295,6 +761,13 @@ cr_locate_metadata(const char *repopath, gboolean ignore_sqlite, GError **err)
         ret = cr_get_local_metadata(repopath, ignore_sqlite);
     }
 
+    if (tmp_err) {
+        g_debug("%s: %s", __func__, tmp_err->message);
+        g_propagate_prefixed_error(err, tmp_err,
+                                   "Cannot locate metadata of %s: ", repopath);
+        return NULL;
+    }
+
     if (ret)
         ret->original_url = g_strdup(repopath);
 
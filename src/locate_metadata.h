@@ -40,9 +40,16 @@ struct cr_MetadataLocation {
     char *pri_sqlite_href;      /*!< path to primary.sqlite */
     char *fil_sqlite_href;      /*!< path to filelists.sqlite */
     char *oth_sqlite_href;      /*!< path to other.sqlite */
+    char *pri_zck_href;         /*!< path to primary.xml.zck */
+    char *fil_zck_href;         /*!< path to filelists.xml.zck */
+    char *oth_zck_href;         /*!< path to other.xml.zck */
     char *groupfile_href;       /*!< path to groupfile */
     char *cgroupfile_href;      /*!< path to compressed groupfile */
     char *updateinfo_href;      /*!< path to updateinfo */
+    char *snapshot_href;        /*!< path to binary snapshot */
+    char *snapshot_checksum;    /*!< checksum of the snapshot from
+                                     repomd.xml */
+    char *snapshot_checksum_type; /*!< type of the snapshot_checksum */
     char *repomd;               /*!< path to repomd.xml */
     char *original_url;         /*!< original path of repo from commandline
                                      param */
@@ -54,8 +61,8 @@ struct cr_MetadataLocation {
 
 /** Parses repomd.xml and returns a filled cr_MetadataLocation structure.
  * Remote repodata (repopath with prefix "ftp://" or "http://") are dowloaded
- * into a temporary directory and removed when the cr_metadatalocation_free()
- * is called on the cr_MetadataLocation.
+ * (all files in parallel) into a temporary directory and removed when
+ * the cr_metadatalocation_free() is called on the cr_MetadataLocation.
  * @param repopath      path to directory with repodata/ subdirectory
  * @param ignore_sqlite if ignore_sqlite != 0 sqlite dbs are ignored
  * @param err           GError **
@@ -65,6 +72,26 @@ struct cr_MetadataLocation *cr_locate_metadata(const char *repopath,
                                                gboolean ignore_sqlite,
                                                GError **err);
 
+/** Same as cr_locate_metadata(), but remote repodata are kept in
+ * a persistent cache directory instead of a temporary one.
+ * Every repository has its own subdirectory in the cache_dir. The repomd.xml
+ * is requested with If-None-Match/If-Modified-Since headers based on the
+ * previous response and the other files are downloaded (in parallel) only
+ * if their checksum in repomd.xml differs from the cached one. Files which
+ * are no longer referenced by repomd.xml are removed from the cache.
+ * The cached repodata are not removed by cr_metadatalocation_free().
+ * @param repopath      path to directory with repodata/ subdirectory
+ * @param ignore_sqlite if ignore_sqlite != 0 sqlite dbs are ignored
+ * @param cache_dir     cache directory for remote repodata or NULL
+ *                      to download them into a temporary directory
+ * @param err           GError **
+ * @return              filled cr_MetadataLocation structure or NULL
+ */
+struct cr_MetadataLocation *cr_locate_metadata_cached(const char *repopath,
+                                                      gboolean ignore_sqlite,
+                                                      const char *cache_dir,
+                                                      GError **err);
+
 /** Free cr_MetadataLocation. If repodata were downloaded remove
  * a temporary directory with repodata.
  * @param ml            MeatadaLocation
@@ -0,0 +1,999 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2013  Tomas Mlcoch
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "mdserver.h"
+#include "error.h"
+#include "locate_metadata.h"
+#include "misc.h"
+#include "repomd.h"
+#include "xml_parser.h"
+
+#define ERR_DOMAIN              CREATEREPO_C_ERROR
+#define SOCKET_NAME             "createrepo_c-mdserver.sock"
+#define CACHE_SUBDIR            "createrepo_c/mdserver"
+#define READ_CHUNK              4096
+#define MAX_LINE                (64*1024)
+#define OPEN_ATTEMPTS           3
+
+/*
+ * Line based communication
+ */
+
+/** Read a line (without the trailing newline) from the socket.
+ * If stop_fd is readable, reading is interrupted as if the peer
+ * closed the connection.
+ * @return          New line, NULL on the end of the stream or on error
+ */
+static gchar *
+read_line(int fd, int stop_fd, GString *buf, GError **err)
+{
+    while (1) {
+        char *nl = memchr(buf->str, '\n', buf->len);
+        if (nl) {
+            gchar *line = g_strndup(buf->str, nl - buf->str);
+            g_string_erase(buf, 0, nl - buf->str + 1);
+            return line;
+        }
+
+        if (buf->len > MAX_LINE) {
+            g_set_error(err, ERR_DOMAIN, CRE_MDSERVER, "Too long line");
+            return NULL;
+        }
+
+        struct pollfd fds[2] = {
+            { .fd = fd,      .events = POLLIN },
+            { .fd = stop_fd, .events = POLLIN },
+        };
+
+        if (poll(fds, 2, -1) == -1) {
+            if (errno == EINTR)
+                continue;
+            g_set_error(err, ERR_DOMAIN, CRE_MDSERVER,
+                        "poll() failed: %s", g_strerror(errno));
+            return NULL;
+        }
+
+        if (fds[1].revents)
+            return NULL;
+
+        char chunk[READ_CHUNK];
+        ssize_t len = recv(fd, chunk, sizeof(chunk), 0);
+        if (len == -1) {
+            if (errno == EINTR)
+                continue;
+            g_set_error(err, ERR_DOMAIN, CRE_MDSERVER,
+                        "Cannot read from the socket: %s", g_strerror(errno));
+            return NULL;
+        }
+
+        if (len == 0)
+            return NULL;
+
+        g_string_append_len(buf, chunk, len);
+    }
+}
+
+static gboolean
+write_all(int fd, const char *data, gsize len, GError **err)
+{
+    while (len > 0) {
+        ssize_t written = send(fd, data, len, MSG_NOSIGNAL);
+        if (written == -1) {
+            if (errno == EINTR)
+                continue;
+            g_set_error(err, ERR_DOMAIN, CRE_MDSERVER,
+                        "Cannot write to the socket: %s", g_strerror(errno));
+            return FALSE;
+        }
+        data += written;
+        len -= written;
+    }
+    return TRUE;
+}
+
+static gboolean
+fill_address(struct sockaddr_un *addr, const char *path, GError **err)
+{
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path)) {
+        g_set_error(err, ERR_DOMAIN, CRE_BADARG,
+                    "Socket path %s is too long", path);
+        return FALSE;
+    }
+    strcpy(addr->sun_path, path);
+    return TRUE;
+}
+
+static int
+connect_socket(const char *path, GError **err)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    if (!fill_address(&addr, path, err))
+        return -1;
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        g_set_error(err, ERR_DOMAIN, CRE_MDSERVER,
+                    "Cannot create socket: %s", g_strerror(errno));
+        return -1;
+    }
+
+    if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == -1) {
+        g_set_error(err, ERR_DOMAIN, CRE_MDSERVER,
+                    "Cannot connect to %s: %s", path, g_strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+gchar *
+cr_mdserver_default_socket(void)
+{
+    return g_build_filename(g_get_user_runtime_dir(), SOCKET_NAME, NULL);
+}
+
+/*
+ * Server
+ */
+
+/** A repository served by the server.
+ */
+typedef struct {
+    gchar *path;            /*!< Canonical path of the repository */
+    GMutex *mutex;          /*!< Serializes checks and reloads */
+    gboolean have_stat;     /*!< Stat of the repomd.xml is valid */
+    dev_t dev;              /*!< Stat of the repomd.xml of the snapshot */
+    ino_t ino;
+    off_t size;
+    time_t mtime;
+    gchar *revision;        /*!< Revision of the snapshot or NULL */
+    guint generation;       /*!< Incremented on every reload */
+    gchar *snapshot;        /*!< Path of the served snapshot */
+    gboolean own_snapshot;  /*!< The snapshot is in the cache dir */
+} MdRepo;
+
+struct _cr_MdServer {
+    int sock;
+    int stop_pipe[2];
+    gchar *socket_path;
+    gchar *cache_dir;
+    GMutex *mutex;          /*!< Protects repos and clients */
+    GCond *cond;            /*!< Signaled when a client disconnects */
+    GHashTable *repos;      /*!< Canonical path -> MdRepo */
+    guint clients;          /*!< Number of connected clients */
+};
+
+typedef struct {
+    cr_MdServer *srv;
+    int fd;
+} MdConnection;
+
+static void
+mdrepo_free(MdRepo *repo)
+{
+    if (repo->own_snapshot)
+        g_unlink(repo->snapshot);
+    g_free(repo->path);
+    g_mutex_free(repo->mutex);
+    g_free(repo->revision);
+    g_free(repo->snapshot);
+    g_free(repo);
+}
+
+/** Write all packages of the repository into a new snapshot
+ * in the cache dir.
+ */
+static gchar *
+build_snapshot(cr_MdServer *srv,
+               MdRepo *repo,
+               struct cr_MetadataLocation *ml,
+               GError **err)
+{
+    cr_PkgIterator *iter;
+    cr_SnapshotWriter *sw;
+    cr_Package *pkg;
+    gchar *checksum, *filename, *path;
+    GError *tmp_err = NULL;
+
+    if (!ml->pri_xml_href) {
+        g_set_error(err, ERR_DOMAIN, CRE_NOFILE,
+                    "%s has no primary.xml", repo->path);
+        return NULL;
+    }
+
+    iter = cr_pkg_iterator_new(ml->pri_xml_href,
+                               ml->fil_xml_href,
+                               ml->oth_xml_href,
+                               NULL, NULL, err);
+    if (!iter)
+        return NULL;
+
+    sw = cr_snapshot_writer_new();
+    while ((pkg = cr_pkg_iterator_next(iter, &tmp_err))) {
+        gboolean ret = cr_snapshot_writer_add_pkg(sw, pkg, &tmp_err);
+        cr_package_free(pkg);
+        if (!ret)
+            break;
+    }
+    cr_pkg_iterator_free(iter);
+
+    if (tmp_err) {
+        g_propagate_error(err, tmp_err);
+        cr_snapshot_writer_free(sw);
+        return NULL;
+    }
+
+    // The name is unique even among runs of the server, the clients
+    // could still map snapshots of a previous run
+    checksum = g_compute_checksum_for_string(G_CHECKSUM_SHA1, repo->path, -1);
+    filename = g_strdup_printf("%s-%ld-%u.crsnap", checksum,
+                               (long) getpid(), repo->generation + 1);
+    path = g_build_filename(srv->cache_dir, filename, NULL);
+    g_free(checksum);
+    g_free(filename);
+
+    if (!cr_snapshot_writer_write(sw, path, err)) {
+        g_free(path);
+        path = NULL;
+    }
+    cr_snapshot_writer_free(sw);
+
+    return path;
+}
+
+/** Check the repomd.xml of the repository and reload its snapshot
+ * if the revision changed. repo->mutex must be locked.
+ */
+static gboolean
+mdrepo_check(cr_MdServer *srv, MdRepo *repo, GError **err)
+{
+    struct stat st;
+    struct cr_MetadataLocation *ml;
+    cr_Repomd *repomd;
+    gchar *repomd_path, *snapshot = NULL;
+    gboolean own = FALSE;
+    GError *tmp_err = NULL;
+
+    repomd_path = g_build_filename(repo->path, "repodata", "repomd.xml", NULL);
+    if (stat(repomd_path, &st) == -1) {
+        g_set_error(err, ERR_DOMAIN, CRE_NOFILE,
+                    "Cannot stat %s: %s", repomd_path, g_strerror(errno));
+        g_free(repomd_path);
+        return FALSE;
+    }
+
+    if (repo->have_stat
+        && repo->dev == st.st_dev
+        && repo->ino == st.st_ino
+        && repo->size == st.st_size
+        && repo->mtime == st.st_mtime)
+    {
+        // Nothing changed
+        g_free(repomd_path);
+        return TRUE;
+    }
+
+    repomd = cr_repomd_new();
+    cr_xml_parse_repomd(repomd_path, repomd, NULL, NULL, &tmp_err);
+    g_free(repomd_path);
+    if (tmp_err) {
+        g_propagate_error(err, tmp_err);
+        cr_repomd_free(repomd);
+        return FALSE;
+    }
+
+    if (repo->snapshot && repomd->revision
+        && !g_strcmp0(repomd->revision, repo->revision))
+    {
+        // The file was touched, but it is still the same revision
+        g_debug("%s: %s: Revision %s didn't change",
+                __func__, repo->path, repomd->revision);
+        goto done;
+    }
+
+    g_debug("%s: %s: Loading revision %s", __func__, repo->path,
+            repomd->revision ? repomd->revision : "(none)");
+
+    ml = cr_locate_metadata(repo->path, TRUE, err);
+    if (!ml) {
+        cr_repomd_free(repomd);
+        return FALSE;
+    }
+
+    // A snapshot of the repository is served as is if it belongs
+    // to this revision of repomd.xml
+    if (ml->snapshot_href
+        && g_file_test(ml->snapshot_href, G_FILE_TEST_IS_REGULAR))
+    {
+        cr_Snapshot *snap = NULL;
+        if (cr_snapshot_verify(ml->snapshot_href,
+                               ml->snapshot_checksum_type,
+                               ml->snapshot_checksum,
+                               &tmp_err))
+            snap = cr_snapshot_open(ml->snapshot_href, &tmp_err);
+        if (snap) {
+            cr_snapshot_close(snap);
+            snapshot = g_strdup(ml->snapshot_href);
+        } else {
+            g_debug("%s: Cannot use %s (%s) - Using XML",
+                    __func__, ml->snapshot_href, tmp_err->message);
+            g_clear_error(&tmp_err);
+        }
+    }
+
+    if (!snapshot) {
+        snapshot = build_snapshot(srv, repo, ml, err);
+        own = TRUE;
+    }
+
+    cr_metadatalocation_free(ml);
+
+    if (!snapshot) {
+        cr_repomd_free(repomd);
+        return FALSE;
+    }
+
+    // Clients which mapped the previous snapshot keep using it until
+    // their next request
+    if (repo->own_snapshot)
+        g_unlink(repo->snapshot);
+    g_free(repo->snapshot);
+    repo->snapshot = snapshot;
+    repo->own_snapshot = own;
+    repo->generation++;
+    g_free(repo->revision);
+    repo->revision = g_strdup(repomd->revision);
+
+done:
+    repo->have_stat = TRUE;
+    repo->dev   = st.st_dev;
+    repo->ino   = st.st_ino;
+    repo->size  = st.st_size;
+    repo->mtime = st.st_mtime;
+    cr_repomd_free(repomd);
+    return TRUE;
+}
+
+static MdRepo *
+get_repo(cr_MdServer *srv, const char *path, GError **err)
+{
+    char *canonical;
+    MdRepo *repo;
+
+    canonical = realpath(path, NULL);
+    if (!canonical) {
+        g_set_error(err, ERR_DOMAIN, CRE_NODIR,
+                    "Cannot resolve %s: %s", path, g_strerror(errno));
+        return NULL;
+    }
+
+    g_mutex_lock(srv->mutex);
+    repo = g_hash_table_lookup(srv->repos, canonical);
+    if (!repo) {
+        repo = g_new0(MdRepo, 1);
+        repo->path = g_strdup(canonical);
+        repo->mutex = g_mutex_new();
+        g_hash_table_insert(srv->repos, repo->path, repo);
+    }
+    g_mutex_unlock(srv->mutex);
+
+    free(canonical);
+    return repo;
+}
+
+/** Check the repository and return its current generation and snapshot.
+ */
+static gboolean
+open_repo(cr_MdServer *srv,
+          const char *path,
+          guint *generation,
+          gchar **snapshot,
+          GError **err)
+{
+    MdRepo *repo = get_repo(srv, path, err);
+    gboolean ret;
+
+    if (!repo)
+        return FALSE;
+
+    g_mutex_lock(repo->mutex);
+    ret = mdrepo_check(srv, repo, err);
+    if (ret) {
+        *generation = repo->generation;
+        *snapshot = g_strdup(repo->snapshot);
+    }
+    g_mutex_unlock(repo->mutex);
+
+    return ret;
+}
+
+gboolean
+cr_mdserver_load(cr_MdServer *srv, const char *repo, GError **err)
+{
+    guint generation;
+    gchar *snapshot;
+
+    assert(srv);
+    assert(repo);
+    assert(!err || *err == NULL);
+
+    if (!open_repo(srv, repo, &generation, &snapshot, err))
+        return FALSE;
+
+    g_free(snapshot);
+    return TRUE;
+}
+
+static gchar *
+handle_request(cr_MdServer *srv, const char *line)
+{
+    gchar **fields = g_strsplit(line, "\t", 2);
+    gchar *reply;
+
+    if (!g_strcmp0(fields[0], "OPEN") && fields[1]
+        && !g_path_is_absolute(fields[1]))
+    {
+        // Relative to what? The client's working directory is unknown
+        reply = g_strdup_printf("ERR\tNot an absolute path: %s\n", fields[1]);
+    } else if (!g_strcmp0(fields[0], "OPEN") && fields[1]) {
+        guint generation;
+        gchar *snapshot;
+        GError *tmp_err = NULL;
+
+        if (open_repo(srv, fields[1], &generation, &snapshot, &tmp_err)) {
+            reply = g_strdup_printf("OK\t%u\t%s\n", generation, snapshot);
+            g_free(snapshot);
+        } else {
+            g_debug("%s: Cannot open %s: %s", __func__, fields[1],
+                    tmp_err->message);
+            reply = g_strdup_printf("ERR\t%s\n", tmp_err->message);
+            g_error_free(tmp_err);
+        }
+    } else {
+        reply = g_strdup_printf("ERR\tUnknown request: %s\n", fields[0]);
+    }
+
+    g_strfreev(fields);
+    return reply;
+}
+
+static gpointer
+connection_thread(gpointer data)
+{
+    MdConnection *conn = data;
+    cr_MdServer *srv = conn->srv;
+    GString *buf = g_string_new(NULL);
+    gchar *line;
+    GError *tmp_err = NULL;
+
+    while ((line = read_line(conn->fd, srv->stop_pipe[0], buf, &tmp_err))) {
+        gchar *reply = handle_request(srv, line);
+        gboolean ret = write_all(conn->fd, reply, strlen(reply), &tmp_err);
+        g_free(reply);
+        g_free(line);
+        if (!ret)
+            break;
+    }
+
+    if (tmp_err) {
+        g_debug("%s: Client disconnected: %s", __func__, tmp_err->message);
+        g_error_free(tmp_err);
+    }
+
+    close(conn->fd);
+    g_string_free(buf, TRUE);
+    g_free(conn);
+
+    g_mutex_lock(srv->mutex);
+    srv->clients--;
+    g_cond_signal(srv->cond);
+    g_mutex_unlock(srv->mutex);
+
+    return NULL;
+}
+
+cr_MdServer *
+cr_mdserver_new(const char *socket_path, const char *cache_dir, GError **err)
+{
+    struct sockaddr_un addr;
+    cr_MdServer *srv;
+    gchar *path;
+    int fd;
+
+    assert(!err || *err == NULL);
+
+    path = socket_path ? g_strdup(socket_path) : cr_mdserver_default_socket();
+    if (!fill_address(&addr, path, err)) {
+        g_free(path);
+        return NULL;
+    }
+
+    // Remove the socket of a dead server
+    if (g_file_test(path, G_FILE_TEST_EXISTS)) {
+        fd = connect_socket(path, NULL);
+        if (fd != -1) {
+            close(fd);
+            g_set_error(err, ERR_DOMAIN, CRE_EXISTS,
+                        "A server is already listening on %s", path);
+            g_free(path);
+            return NULL;
+        }
+        g_unlink(path);
+    }
+
+    srv = g_new0(cr_MdServer, 1);
+    srv->sock = -1;
+    srv->stop_pipe[0] = srv->stop_pipe[1] = -1;
+    srv->socket_path = path;
+    srv->cache_dir = cache_dir ? g_strdup(cache_dir)
+                   : g_build_filename(g_get_user_cache_dir(), CACHE_SUBDIR, NULL);
+    srv->mutex = g_mutex_new();
+    srv->cond = g_cond_new();
+    srv->repos = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+                                       (GDestroyNotify) mdrepo_free);
+
+    if (g_mkdir_with_parents(srv->cache_dir, 0700) == -1) {
+        g_set_error(err, ERR_DOMAIN, CRE_IO, "Cannot create %s: %s",
+                    srv->cache_dir, g_strerror(errno));
+        goto error;
+    }
+
+    if (pipe(srv->stop_pipe) == -1) {
+        g_set_error(err, ERR_DOMAIN, CRE_IO,
+                    "Cannot create pipe: %s", g_strerror(errno));
+        goto error;
+    }
+    fcntl(srv->stop_pipe[1], F_SETFL, O_NONBLOCK);
+
+    srv->sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (srv->sock == -1) {
+        g_set_error(err, ERR_DOMAIN, CRE_MDSERVER,
+                    "Cannot create socket: %s", g_strerror(errno));
+        goto error;
+    }
+
+    if (bind(srv->sock, (struct sockaddr *) &addr, sizeof(addr)) == -1
+        || listen(srv->sock, SOMAXCONN) == -1)
+    {
+        g_set_error(err, ERR_DOMAIN, CRE_MDSERVER,
+                    "Cannot listen on %s: %s", path, g_strerror(errno));
+        close(srv->sock);
+        srv->sock = -1;
+        goto error;
+    }
+
+    return srv;
+
+error:
+    cr_mdserver_free(srv);
+    return NULL;
+}
+
+gboolean
+cr_mdserver_run(cr_MdServer *srv, GError **err)
+{
+    gboolean ret = TRUE;
+
+    assert(srv);
+    assert(!err || *err == NULL);
+
+    g_debug("%s: Listening on %s", __func__, srv->socket_path);
+
+    while (1) {
+        struct pollfd fds[2] = {
+            { .fd = srv->sock,         .events = POLLIN },
+            { .fd = srv->stop_pipe[0], .events = POLLIN },
+        };
+
+        if (poll(fds, 2, -1) == -1) {
+            if (errno == EINTR)
+                continue;
+            g_set_error(err, ERR_DOMAIN, CRE_MDSERVER,
+                        "poll() failed: %s", g_strerror(errno));
+            ret = FALSE;
+            break;
+        }
+
+        if (fds[1].revents)
+            break;
+
+        int fd = accept(srv->sock, NULL, NULL);
+        if (fd == -1) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            g_set_error(err, ERR_DOMAIN, CRE_MDSERVER,
+                        "accept() failed: %s", g_strerror(errno));
+            ret = FALSE;
+            break;
+        }
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+        MdConnection *conn = g_new0(MdConnection, 1);
+        conn->srv = srv;
+        conn->fd = fd;
+
+        g_mutex_lock(srv->mutex);
+        srv->clients++;
+        g_mutex_unlock(srv->mutex);
+
+        // Clients are long living, every client has its own thread
+        g_thread_unref(g_thread_new("mdserver-client", connection_thread, conn));
+    }
+
+    // Wait for the clients, they stop reading when the server is stopped
+    cr_mdserver_stop(srv);
+    g_mutex_lock(srv->mutex);
+    while (srv->clients > 0)
+        g_cond_wait(srv->cond, srv->mutex);
+    g_mutex_unlock(srv->mutex);
+
+    return ret;
+}
+
+void
+cr_mdserver_stop(cr_MdServer *srv)
+{
+    // The pipe stays readable, everybody who polls it wakes up
+    ssize_t ret = write(srv->stop_pipe[1], "", 1);
+    (void) ret;
+}
+
+void
+cr_mdserver_free(cr_MdServer *srv)
+{
+    if (!srv)
+        return;
+
+    if (srv->sock != -1) {
+        close(srv->sock);
+        g_unlink(srv->socket_path);
+    }
+    if (srv->stop_pipe[0] != -1) {
+        close(srv->stop_pipe[0]);
+        close(srv->stop_pipe[1]);
+    }
+    g_hash_table_destroy(srv->repos);
+    g_mutex_free(srv->mutex);
+    g_cond_free(srv->cond);
+    g_free(srv->socket_path);
+    g_free(srv->cache_dir);
+    g_free(srv);
+}
+
+/*
+ * Client
+ */
+
+/** Snapshot of a repository mapped by the client.
+ */
+typedef struct {
+    guint generation;
+    gchar *path;
+    cr_Snapshot *snap;
+} MdClientRepo;
+
+struct _cr_MdClient {
+    int fd;
+    gchar *socket_path;
+    GString *buf;           /*!< Received but not yet processed data */
+    GHashTable *repos;      /*!< Repo (as passed by the user) -> MdClientRepo */
+    GMutex *lock;           /*!< Lock of the connection and the repos */
+};
+
+static void
+mdclientrepo_free(MdClientRepo *repo)
+{
+    g_free(repo->path);
+    cr_snapshot_close(repo->snap);
+    g_free(repo);
+}
+
+cr_MdClient *
+cr_mdclient_new(const char *socket_path, GError **err)
+{
+    cr_MdClient *client;
+    gchar *path;
+    int fd;
+
+    assert(!err || *err == NULL);
+
+    path = socket_path ? g_strdup(socket_path) : cr_mdserver_default_socket();
+    fd = connect_socket(path, err);
+    if (fd == -1) {
+        g_free(path);
+        return NULL;
+    }
+
+    client = g_new0(cr_MdClient, 1);
+    client->fd = fd;
+    client->socket_path = path;
+    client->buf = g_string_new(NULL);
+    client->repos = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                          (GDestroyNotify) mdclientrepo_free);
+    client->lock = g_mutex_new();
+    return client;
+}
+
+/** Send a request and read the reply. If the server was restarted,
+ * reconnect and try again.
+ */
+static gchar *
+client_request(cr_MdClient *client, const char *request, GError **err)
+{
+    for (int attempt = 0; attempt < 2; attempt++) {
+        GError *tmp_err = NULL;
+        gchar *reply = NULL;
+
+        if (client->fd == -1)
+            client->fd = connect_socket(client->socket_path, &tmp_err);
+
+        if (client->fd != -1
+            && write_all(client->fd, request, strlen(request), &tmp_err))
+            reply = read_line(client->fd, -1, client->buf, &tmp_err);
+
+        if (reply)
+            return reply;
+
+        if (!tmp_err)
+            g_set_error(&tmp_err, ERR_DOMAIN, CRE_MDSERVER,
+                        "Connection closed by the server");
+
+        if (client->fd != -1) {
+            close(client->fd);
+            client->fd = -1;
+        }
+        g_string_truncate(client->buf, 0);
+
+        if (attempt == 1) {
+            g_propagate_error(err, tmp_err);
+            break;
+        }
+        g_error_free(tmp_err);
+    }
+
+    return NULL;
+}
+
+/** Get the snapshot of the repo. The client must be locked.
+ */
+static cr_Snapshot *
+client_snapshot(cr_MdClient *client, const char *repo_arg, GError **err)
+{
+    gchar *request, *repo;
+    cr_Snapshot *snap = NULL;
+
+    // The server resolves the path on its own, in its working directory
+    if (g_path_is_absolute(repo_arg)) {
+        repo = g_strdup(repo_arg);
+    } else {
+        gchar *cwd = g_get_current_dir();
+        repo = g_build_filename(cwd, repo_arg, NULL);
+        g_free(cwd);
+    }
+
+    request = g_strdup_printf("OPEN\t%s\n", repo);
+
+    for (int attempt = 0; attempt < OPEN_ATTEMPTS && !snap; attempt++) {
+        GError *tmp_err = NULL;
+        gchar *reply, **fields;
+        MdClientRepo *crepo;
+        guint generation;
+
+        reply = client_request(client, request, err);
+        if (!reply)
+            break;
+
+        fields = g_strsplit(reply, "\t", 3);
+        g_free(reply);
+
+        if (!g_strcmp0(fields[0], "ERR")) {
+            g_set_error(err, ERR_DOMAIN, CRE_MDSERVER, "%s: %s", repo,
+                        fields[1] ? fields[1] : "Unknown error");
+            g_strfreev(fields);
+            break;
+        }
+
+        if (g_strcmp0(fields[0], "OK") || !fields[1] || !fields[2]) {
+            g_set_error(err, ERR_DOMAIN, CRE_MDSERVER,
+                        "Bad reply from the server");
+            g_strfreev(fields);
+            break;
+        }
+
+        generation = (guint) g_ascii_strtoull(fields[1], NULL, 10);
+        crepo = g_hash_table_lookup(client->repos, repo);
+        if (crepo && crepo->generation == generation
+            && !g_strcmp0(crepo->path, fields[2]))
+        {
+            g_strfreev(fields);
+            snap = crepo->snap;
+            break;
+        }
+
+        snap = cr_snapshot_open(fields[2], &tmp_err);
+        if (!snap) {
+            // The snapshot could be replaced since the reply was sent
+            if (attempt + 1 == OPEN_ATTEMPTS)
+                g_propagate_error(err, tmp_err);
+            else
+                g_error_free(tmp_err);
+            g_strfreev(fields);
+            continue;
+        }
+
+        crepo = g_new0(MdClientRepo, 1);
+        crepo->generation = generation;
+        crepo->path = g_strdup(fields[2]);
+        crepo->snap = snap;
+        g_hash_table_replace(client->repos, g_strdup(repo), crepo);
+        g_strfreev(fields);
+    }
+
+    g_free(request);
+    g_free(repo);
+    return snap;
+}
+
+cr_Snapshot *
+cr_mdclient_snapshot(cr_MdClient *client, const char *repo, GError **err)
+{
+    cr_Snapshot *snap;
+
+    assert(client);
+    assert(repo);
+    assert(!err || *err == NULL);
+
+    g_mutex_lock(client->lock);
+    snap = client_snapshot(client, repo, err);
+    g_mutex_unlock(client->lock);
+
+    return snap;
+}
+
+static gboolean
+match_nevra(cr_Package *pkg, cr_NEVRA *nevra)
+{
+    const char *epoch = nevra->epoch ? nevra->epoch : "0";
+    const char *pkg_epoch = pkg->epoch ? pkg->epoch : "0";
+
+    return !g_strcmp0(pkg->name, nevra->name)
+           && !g_strcmp0(pkg_epoch, epoch)
+           && !g_strcmp0(pkg->version, nevra->version)
+           && !g_strcmp0(pkg->release, nevra->release)
+           && !g_strcmp0(pkg->arch, nevra->arch);
+}
+
+GSList *
+cr_mdclient_find(cr_MdClient *client,
+                 const char *repo,
+                 cr_MdKey key,
+                 const char *value,
+                 cr_PackageLoadingFlags parts,
+                 GError **err)
+{
+    cr_Snapshot *snap;
+    cr_NEVRA *nevra = NULL;
+    GArray *found;
+    GSList *pkgs = NULL;
+
+    assert(client);
+    assert(repo);
+    assert(value);
+    assert(key < CR_MD_KEY_SENTINEL);
+    assert(!err || *err == NULL);
+
+    if (key == CR_MD_KEY_NEVRA) {
+        nevra = cr_str_to_nevra(value);
+        if (!nevra || !nevra->name || !nevra->version
+            || !nevra->release || !nevra->arch)
+        {
+            g_set_error(err, ERR_DOMAIN, CRE_BADARG,
+                        "Bad NEVRA: %s", value);
+            if (nevra)
+                cr_nevra_free(nevra);
+            return NULL;
+        }
+    }
+
+    // The snapshot may be replaced by the next request - keep the client
+    // locked until the packages are loaded
+    g_mutex_lock(client->lock);
+
+    snap = client_snapshot(client, repo, err);
+    if (!snap) {
+        g_mutex_unlock(client->lock);
+        if (nevra)
+            cr_nevra_free(nevra);
+        return NULL;
+    }
+
+    switch (key) {
+        case CR_MD_KEY_HASH:
+            found = cr_snapshot_find(snap, CR_HT_KEY_HASH, value);
+            break;
+        case CR_MD_KEY_NAME:
+            found = cr_snapshot_find(snap, CR_HT_KEY_NAME, value);
+            break;
+        case CR_MD_KEY_FILENAME:
+            found = cr_snapshot_find(snap, CR_HT_KEY_FILENAME, value);
+            break;
+        default:
+            // NEVRA - candidates are packages with the name
+            found = cr_snapshot_find(snap, CR_HT_KEY_NAME, nevra->name);
+            break;
+    }
+
+    for (guint x = 0; x < found->len; x++) {
+        guint idx = g_array_index(found, guint, x);
+        cr_Package *pkg = cr_snapshot_package(snap, idx, parts, NULL);
+        if (!pkg) {
+            g_set_error(err, ERR_DOMAIN, CRE_BADSNAPSHOT,
+                        "Cannot load package %u of %s", idx, repo);
+            g_slist_free_full(pkgs, (GDestroyNotify) cr_package_free);
+            pkgs = NULL;
+            break;
+        }
+        if (nevra && !match_nevra(pkg, nevra)) {
+            cr_package_free(pkg);
+            continue;
+        }
+        pkgs = g_slist_prepend(pkgs, pkg);
+    }
+
+    g_mutex_unlock(client->lock);
+
+    g_array_free(found, TRUE);
+    if (nevra)
+        cr_nevra_free(nevra);
+
+    return g_slist_reverse(pkgs);
+}
+
+void
+cr_mdclient_free(cr_MdClient *client)
+{
+    if (!client)
+        return;
+
+    if (client->fd != -1)
+        close(client->fd);
+    g_free(client->socket_path);
+    g_string_free(client->buf, TRUE);
+    g_hash_table_destroy(client->repos);
+    g_mutex_free(client->lock);
+    g_free(client);
+}
@@ -0,0 +1,186 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2013  Tomas Mlcoch
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef __C_CREATEREPOLIB_MDSERVER_H__
+#define __C_CREATEREPOLIB_MDSERVER_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <glib.h>
+#include "package.h"
+#include "snapshot.h"
+
+/** \defgroup   mdserver    Metadata server and its client.
+ *
+ * The server loads metadata of a repository once and stores them
+ * as a binary snapshot (see snapshot.h) in its cache directory.
+ * Clients ask the server for the snapshot of a repository over a local
+ * UNIX socket and memory map it read-only, so all the clients share
+ * the same pages and no client parses any XML.
+ *
+ * On every request the server checks the repomd.xml of the repository.
+ * When its revision changes, the snapshot is rebuilt and the clients
+ * map the new one on their next lookup. If the repository already
+ * contains a snapshot (createrepo_c --snapshot), it is used directly.
+ *
+ * Protocol (one request per line, fields are separated by a tab):
+ * \code
+ * -> OPEN <repo>
+ * <- OK <generation> <snapshot_path>
+ * <- ERR <message>
+ * \endcode
+ *
+ * Example:
+ * \code
+ * cr_MdClient *client;
+ * GSList *pkgs;
+ *
+ * client = cr_mdclient_new(NULL, NULL);
+ * pkgs = cr_mdclient_find(client, "/srv/repo/", CR_MD_KEY_NAME, "bash",
+ *                         CR_PACKAGE_LOADED_PRI, NULL);
+ * // Do something
+ * g_slist_free_full(pkgs, (GDestroyNotify) cr_package_free);
+ * cr_mdclient_free(client);
+ * \endcode
+ *
+ *  \addtogroup mdserver
+ *  @{
+ */
+
+/** Key of a lookup.
+ */
+typedef enum {
+    CR_MD_KEY_HASH,         /*!< pkgId */
+    CR_MD_KEY_NAME,         /*!< name */
+    CR_MD_KEY_FILENAME,     /*!< basename of location_href */
+    CR_MD_KEY_NEVRA,        /*!< name-[epoch:]version-release.arch */
+    CR_MD_KEY_SENTINEL,
+} cr_MdKey;
+
+typedef struct _cr_MdServer cr_MdServer;
+typedef struct _cr_MdClient cr_MdClient;
+
+/** Default path of the server socket
+ * ($XDG_RUNTIME_DIR/createrepo_c-mdserver.sock).
+ * @return              Path, free it with g_free()
+ */
+gchar *
+cr_mdserver_default_socket(void);
+
+/** Create a new server listening on the socket.
+ * @param socket_path   Path of the socket or NULL for the default
+ * @param cache_dir     Directory for the snapshots or NULL for
+ *                      $XDG_CACHE_HOME/createrepo_c/mdserver,
+ *                      it is created if it doesn't exist
+ * @param err           GError **
+ * @return              New cr_MdServer or NULL
+ */
+cr_MdServer *
+cr_mdserver_new(const char *socket_path,
+                const char *cache_dir,
+                GError **err);
+
+/** Load (or reload) a repository before any client asks for it.
+ * @param srv           Server
+ * @param repo          Path to the repository (with repodata/ subdir)
+ * @param err           GError **
+ * @return              TRUE on success
+ */
+gboolean
+cr_mdserver_load(cr_MdServer *srv, const char *repo, GError **err);
+
+/** Serve the clients until cr_mdserver_stop() is called. Every
+ * connected client is served by its own thread.
+ * @param srv           Server
+ * @param err           GError **
+ * @return              TRUE if the server was stopped, FALSE on error
+ */
+gboolean
+cr_mdserver_run(cr_MdServer *srv, GError **err);
+
+/** Stop cr_mdserver_run(). The function is async-signal-safe.
+ * @param srv           Server
+ */
+void
+cr_mdserver_stop(cr_MdServer *srv);
+
+/** Close the socket, remove the snapshots and free the server.
+ * @param srv           Server or NULL
+ */
+void
+cr_mdserver_free(cr_MdServer *srv);
+
+/** Connect to a server.
+ * @param socket_path   Path of the socket or NULL for the default
+ * @param err           GError **
+ * @return              New cr_MdClient or NULL
+ */
+cr_MdClient *
+cr_mdclient_new(const char *socket_path, GError **err);
+
+/** Get the current snapshot of a repository.
+ * The snapshot is unmapped when a newer one of the same repository is
+ * mapped, so it is only valid until the next cr_mdclient_snapshot() or
+ * cr_mdclient_find() call on the client. Do not use it while other threads
+ * use the client.
+ * @param client        Client
+ * @param repo          Path to the repository
+ * @param err           GError **
+ * @return              Snapshot owned by the client, valid until the next
+ *                      call (see above)
+ */
+cr_Snapshot *
+cr_mdclient_snapshot(cr_MdClient *client, const char *repo, GError **err);
+
+/** Find packages of a repository. The returned packages are copies,
+ * so this function can be called from more threads on one client
+ * (the calls are serialized).
+ * @param client        Client
+ * @param repo          Path to the repository
+ * @param key           Key of the lookup
+ * @param value         Searched value
+ * @param parts         Which parts of the packages to load (see
+ *                      cr_snapshot_package())
+ * @param err           GError **
+ * @return              List of cr_Package (free them with cr_package_free)
+ *                      or NULL if nothing was found or on error
+ */
+GSList *
+cr_mdclient_find(cr_MdClient *client,
+                 const char *repo,
+                 cr_MdKey key,
+                 const char *value,
+                 cr_PackageLoadingFlags parts,
+                 GError **err);
+
+/** Disconnect and free the client (unmaps all its snapshots).
+ * @param client        Client or NULL
+ */
+void
+cr_mdclient_free(cr_MdClient *client);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __C_CREATEREPOLIB_MDSERVER_H__ */
@@ -0,0 +1,146 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2013  Tomas Mlcoch
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <glib.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "error.h"
+#include "cleanup.h"
+#include "createrepo_shared.h"
+#include "version.h"
+#include "misc.h"
+#include "mdserver.h"
+
+/**
+ * Command line options
+ */
+typedef struct {
+    gboolean version;           /*!< print program version */
+    gboolean quiet;             /*!< quiet mode */
+    gboolean verbose;           /*!< verbose mode */
+    gchar *socket;              /*!< path of the socket */
+    gchar *cache_dir;           /*!< directory for the snapshots */
+} MdserverCmdOptions;
+
+static cr_MdServer *server = NULL;
+
+static gboolean
+parse_mdserver_arguments(int *argc,
+                         char ***argv,
+                         MdserverCmdOptions *options,
+                         GError **err)
+{
+    const GOptionEntry cmd_entries[] = {
+
+        { "version", 'V', 0, G_OPTION_ARG_NONE, &(options->version),
+          "Show program's version number and exit.", NULL},
+        { "quiet", 'q', 0, G_OPTION_ARG_NONE, &(options->quiet),
+          "Run quietly.", NULL },
+        { "verbose", 'v', 0, G_OPTION_ARG_NONE, &(options->verbose),
+          "Run verbosely.", NULL },
+        { "socket", 's', 0, G_OPTION_ARG_FILENAME, &(options->socket),
+          "Path of the socket (default: "
+          "$XDG_RUNTIME_DIR/createrepo_c-mdserver.sock).", "SOCKET" },
+        { "cache-dir", 'c', 0, G_OPTION_ARG_FILENAME, &(options->cache_dir),
+          "Directory for the snapshots of the repositories (default: "
+          "$XDG_CACHE_HOME/createrepo_c/mdserver).", "CACHEDIR" },
+        { NULL },
+    };
+
+    GOptionContext *context;
+    context = g_option_context_new("[<repo>...]");
+    g_option_context_set_summary(context, "Serve metadata of repositories "
+            "to local clients. The listed repositories are loaded on start, "
+            "other repositories on the first request.");
+    g_option_context_add_main_entries(context, cmd_entries, NULL);
+    gboolean ret = g_option_context_parse(context, argc, argv, err);
+    g_option_context_free(context);
+    return ret;
+}
+
+static void
+sigterm_handler(G_GNUC_UNUSED int sig)
+{
+    if (server)
+        cr_mdserver_stop(server);
+}
+
+int
+main(int argc, char **argv)
+{
+    MdserverCmdOptions options = { 0 };
+    struct sigaction sigact;
+    _cleanup_error_free_ GError *tmp_err = NULL;
+
+    // Parse arguments
+    if (!parse_mdserver_arguments(&argc, &argv, &options, &tmp_err)) {
+        g_printerr("%s\n", tmp_err->message);
+        exit(EXIT_FAILURE);
+    }
+
+    // Set logging
+    cr_setup_logging(options.quiet, options.verbose);
+
+    // Print version if required
+    if (options.version) {
+        printf("Version: %s\n", cr_version_string_with_features());
+        exit(EXIT_SUCCESS);
+    }
+
+    // Emit debug message with version
+    g_debug("Version: %s", cr_version_string_with_features());
+
+    server = cr_mdserver_new(options.socket, options.cache_dir, &tmp_err);
+    if (!server) {
+        g_printerr("%s\n", tmp_err->message);
+        exit(EXIT_FAILURE);
+    }
+
+    memset(&sigact, 0, sizeof(struct sigaction));
+    sigemptyset(&sigact.sa_mask);
+    sigact.sa_handler = sigterm_handler;
+    sigaction(SIGINT, &sigact, NULL);
+    sigaction(SIGTERM, &sigact, NULL);
+    sigaction(SIGHUP, &sigact, NULL);
+
+    for (int x = 1; x < argc; x++) {
+        g_message("Loading %s", argv[x]);
+        if (!cr_mdserver_load(server, argv[x], &tmp_err)) {
+            g_printerr("Cannot load %s: %s\n", argv[x], tmp_err->message);
+            cr_mdserver_free(server);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    g_message("Serving metadata");
+    if (!cr_mdserver_run(server, &tmp_err)) {
+        g_printerr("%s\n", tmp_err->message);
+        cr_mdserver_free(server);
+        exit(EXIT_FAILURE);
+    }
+
+    g_message("Terminating");
+    cr_mdserver_free(server);
+    g_free(options.socket);
+    g_free(options.cache_dir);
+
+    exit(EXIT_SUCCESS);
+}
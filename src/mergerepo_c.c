@@ -19,6 +19,7 @@
 
 #include <glib.h>
 #include <glib/gstdio.h>
+#include <curl/curl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
@@ -37,8 +38,11 @@
 #include "xml_dump.h"
 #include "repomd.h"
 #include "sqlite.h"
+#include "string_pool.h"
 #include "threads.h"
+#include "updateinfo_writer.h"
 #include "xml_file.h"
+#include "xml_parser.h"
 #include "cleanup.h"
 
 
@@ -49,6 +53,7 @@
 #define DEFAULT_OUTPUTDIR               "merged_repo/"
 #define DEFAULT_DB_COMPRESSION_TYPE             CR_CW_BZ2_COMPRESSION
 #define DEFAULT_GROUPFILE_COMPRESSION_TYPE      CR_CW_GZ_COMPRESSION
+#define LOCATE_THREADS                  8
 
 // struct KojiMergedReposStuff
 // contains information needed to simulate sort_and_filter() method from
@@ -134,6 +139,7 @@ struct CmdOptions {
     gboolean unique_md_filenames;
     gboolean simple_md_filenames;
     gboolean omit_baseurl;
+    char *cache_dir;
 
     // Koji mergerepos specific options
     gboolean koji;
@@ -213,6 +219,9 @@ static GOptionEntry cmd_entries[] =
       "Do not include the file's checksum in the metadata filename.", NULL },
     { "omit-baseurl", 0, 0, G_OPTION_ARG_NONE, &(_cmd_options.omit_baseurl),
       "Don't add a baseurl to packages that don't have one before." , NULL},
+    { "cache-dir", 0, 0, G_OPTION_ARG_FILENAME, &(_cmd_options.cache_dir),
+      "Keep downloaded metadata of remote repos in this directory and "
+      "download only the files changed since the last run.", "DIR" },
 
     // -- Options related to Koji-mergerepos behaviour
     { "koji", 'k', 0, G_OPTION_ARG_NONE, &(_cmd_options.koji),
@@ -228,6 +237,23 @@ static GOptionEntry cmd_entries[] =
 };
 
 
+struct LocateTask {
+    const char *repopath;
+    const char *cache_dir;
+    struct cr_MetadataLocation *loc;
+    GError *err;
+};
+
+
+static void
+locate_thread(gpointer data, G_GNUC_UNUSED gpointer user_data)
+{
+    struct LocateTask *task = data;
+    task->loc = cr_locate_metadata_cached(task->repopath, TRUE,
+                                          task->cache_dir, &task->err);
+}
+
+
 GSList *
 append_arch(GSList *list, gchar *arch, gboolean expand)
 {
@@ -324,7 +350,13 @@ check_arguments(struct CmdOptions *options)
     options->repo_list = NULL;
     while (options->repos && options->repos[x] != NULL) {
         char *normalized = cr_normalize_dir_path(options->repos[x]);
-        if (normalized) {
+        if (normalized && g_slist_find_custom(options->repo_list, normalized,
+                                              (GCompareFunc) g_strcmp0)) {
+            // The same repo would be located twice at once and its
+            // downloads would race in the same cache directory
+            g_debug("Repo %s is listed more than once", normalized);
+            g_free(normalized);
+        } else if (normalized) {
             options->repo_list = g_slist_prepend(options->repo_list, normalized);
         }
         x++;
@@ -468,6 +500,7 @@ free_options(struct CmdOptions *options)
     g_free(options->compress_type);
     g_free(options->merge_method_str);
     g_free(options->noarch_repo_url);
+    g_free(options->cache_dir);
 
     g_free(options->groupfile);
     g_free(options->blocked);
@@ -1136,10 +1169,95 @@ package_cmp(gconstpointer a_p, gconstpointer b_p)
 }
 
 
+typedef struct {
+    GHashTable *ids;            // Ids of the already merged records
+    cr_UpdateinfoWriter *writer;
+} MergeUpdateinfoData;
+
+static int
+merge_updateinfo_recordcb(cr_UpdateRecord *rec,
+                          void *cbdata,
+                          G_GNUC_UNUSED GError **err)
+{
+    MergeUpdateinfoData *data = cbdata;
+
+    // The first repo with an update of the given id wins
+    if (!rec->id || g_hash_table_lookup_extended(data->ids, rec->id, NULL, NULL)) {
+        cr_updaterecord_free(rec);
+        return CR_CB_RET_OK;
+    }
+
+    g_hash_table_add(data->ids, g_strdup(rec->id));
+    cr_updateinfo_writer_add(data->writer, rec);
+    return CR_CB_RET_OK;
+}
+
+/** Merge updateinfo.xml of all repos into a new file. The records
+ * are streamed from the parsers to the writer, which renders them
+ * on all available cpus.
+ */
+static gboolean
+merge_updateinfo(GSList *local_repos,
+                 const char *filename,
+                 cr_CompressionType comtype,
+                 GError **err)
+{
+    gboolean ret = TRUE;
+    GError *tmp_err = NULL;
+    MergeUpdateinfoData data;
+    cr_XmlFile *f;
+
+    f = cr_xmlfile_open_updateinfo(filename, comtype, err);
+    if (!f)
+        return FALSE;
+
+    data.writer = cr_updateinfo_writer_new(f, g_get_num_processors(), err);
+    if (!data.writer) {
+        cr_xmlfile_close(f, NULL);
+        return FALSE;
+    }
+    data.ids = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+    // local_repos are in the reversed order of the repos on the command line
+    GSList *repos = g_slist_reverse(g_slist_copy(local_repos));
+    for (GSList *elem = repos; elem && ret; elem = g_slist_next(elem)) {
+        struct cr_MetadataLocation *loc = elem->data;
+
+        if (!loc->updateinfo_href)
+            continue;
+
+        g_debug("Merging updateinfo: %s", loc->updateinfo_href);
+        if (cr_xml_parse_updateinfo_records(loc->updateinfo_href,
+                                            merge_updateinfo_recordcb,
+                                            &data,
+                                            NULL, NULL,
+                                            &tmp_err) != CRE_OK)
+        {
+            g_propagate_prefixed_error(err, tmp_err, "%s: ",
+                                       loc->updateinfo_href);
+            tmp_err = NULL;
+            ret = FALSE;
+        }
+    }
+    g_slist_free(repos);
+
+    if (!cr_updateinfo_writer_finish(data.writer, ret ? err : NULL))
+        ret = FALSE;
+    cr_updateinfo_writer_free(data.writer);
+    g_hash_table_destroy(data.ids);
+
+    if (cr_xmlfile_close(f, ret ? err : NULL) != CRE_OK)
+        ret = FALSE;
+
+    return ret;
+}
+
+
 int
 dump_merged_metadata(GHashTable *merged_hashtable,
                      long packages,
                      gchar *groupfile,
+                     GSList *local_repos,
                      struct CmdOptions *cmd_options)
 {
     GError *tmp_err = NULL;
@@ -1473,23 +1591,22 @@ dump_merged_metadata(GHashTable *merged_hashtable,
 
 
     // Write updateinfo.xml
-    // TODO
 
-    if (!cmd_options->noupdateinfo) {
-        CR_FILE *update_info = cr_open(update_info_filename,
-                                       CR_CW_MODE_WRITE,
-                                       cmd_options->groupfile_compression_type,
-                                       &tmp_err);
-        if (update_info) {
-            cr_puts(update_info,
-                    "<?xml version=\"1.0\"?>\n<updates></updates>\n",
-                    NULL);
-            cr_close(update_info, NULL);
-        } else {
-            g_warning("Cannot open %s: %s",
+    gboolean updateinfo_ok = !cmd_options->noupdateinfo;
+    if (updateinfo_ok) {
+        if (!merge_updateinfo(local_repos,
+                              update_info_filename,
+                              cmd_options->groupfile_compression_type,
+                              &tmp_err))
+        {
+            // A partially merged updateinfo must not be published
+            g_warning("Cannot merge updateinfo into %s: %s - "
+                      "The repo will have no updateinfo",
                       update_info_filename,
                       tmp_err->message);
-            g_error_free(tmp_err);
+            g_clear_error(&tmp_err);
+            remove(update_info_filename);
+            updateinfo_ok = FALSE;
         }
     }
 
@@ -1571,7 +1688,7 @@ dump_merged_metadata(GHashTable *merged_hashtable,
 
     // Update info
 
-    if (!cmd_options->noupdateinfo) {
+    if (updateinfo_ok) {
         update_info_rec = cr_repomd_record_new("updateinfo", update_info_filename);
         cr_repomd_record_fill(update_info_rec, CR_CHECKSUM_SHA256, NULL);
         if (cmd_options->zck_compression) {
@@ -1972,16 +2089,37 @@ main(int argc, char **argv)
     gchar *groupfile = NULL;
     gboolean cr_download_failed = FALSE;
 
-    for (element = cmd_options->repo_list; element; element = g_slist_next(element)) {
-        struct cr_MetadataLocation *loc = cr_locate_metadata((gchar *) element->data, TRUE, NULL);
-        if (!loc) {
-            g_warning("Downloading of repodata failed: %s", (gchar *) element->data);
+    // Remote repos are downloaded in parallel
+    curl_global_init(CURL_GLOBAL_ALL);
+
+    guint repo_count = g_slist_length(cmd_options->repo_list);
+    struct LocateTask *locate_tasks = g_new0(struct LocateTask, repo_count);
+    GThreadPool *locate_pool = g_thread_pool_new(locate_thread, NULL,
+                                                 LOCATE_THREADS, FALSE, NULL);
+
+    guint i = 0;
+    for (element = cmd_options->repo_list; element; element = g_slist_next(element), i++) {
+        locate_tasks[i].repopath = (gchar *) element->data;
+        locate_tasks[i].cache_dir = cmd_options->cache_dir;
+        g_thread_pool_push(locate_pool, &locate_tasks[i], NULL);
+    }
+
+    g_thread_pool_free(locate_pool, FALSE, TRUE);
+
+    for (i = 0; i < repo_count; i++) {
+        struct LocateTask *task = &locate_tasks[i];
+        if (!task->loc) {
+            g_warning("Downloading of repodata failed: %s: %s", task->repopath,
+                      task->err ? task->err->message : "unknown error");
             cr_download_failed = TRUE;
-            break;
+        } else {
+            local_repos = g_slist_prepend(local_repos, task->loc);
         }
-        local_repos = g_slist_prepend(local_repos, loc);
+        g_clear_error(&task->err);
     }
 
+    g_free(locate_tasks);
+
     if (cr_download_failed) {
         // Remove downloaded metadata and free structures
         for (element = local_repos; element; element = g_slist_next(element)) {
@@ -2028,6 +2166,12 @@ main(int argc, char **argv)
         }
     }
 
+    // Strings repeated across the packages of all the merged repos
+    // (dependency names, versions, ...) are stored only once
+
+    cr_StringPool *string_pool = cr_string_pool_new();
+    cr_string_pool_set_default(string_pool);
+
     // Load noarch repo
 
     cr_Metadata *noarch_metadata = NULL;
@@ -2108,6 +2252,15 @@ main(int argc, char **argv)
                                   cmd_options->repo_prefix_replace
                                  );
 
+    cr_string_pool_set_default(NULL);
+
+    cr_StringPoolStats pool_stats;
+    cr_string_pool_get_stats(string_pool, &pool_stats);
+    g_debug("String pool: %"G_GINT64_FORMAT" unique strings "
+            "(%"G_GINT64_FORMAT" bytes), %"G_GINT64_FORMAT" bytes saved",
+            pool_stats.strings, pool_stats.bytes,
+            pool_stats.saved_bytes - pool_stats.overhead);
+
     // Destroy koji stuff - we have to close pkgorigins file before dump
 
     if (cmd_options->koji)
@@ -2116,7 +2269,8 @@ main(int argc, char **argv)
 
     // Dump metadata
 
-    dump_merged_metadata(merged_hashtable, loaded_packages, groupfile, cmd_options);
+    dump_merged_metadata(merged_hashtable, loaded_packages, groupfile,
+                         local_repos, cmd_options);
 
 
     // Remove downloaded repos and free repo location structures
@@ -2133,6 +2287,7 @@ main(int argc, char **argv)
     g_free(groupfile);
     cr_metadata_free(noarch_metadata);
     destroy_merged_metadata_hashtable(merged_hashtable);
+    cr_string_pool_free(string_pool);
     free_options(cmd_options);
     return 0;
 }
@@ -19,9 +19,13 @@
  */
 
 #include <string.h>
+#include <assert.h>
 #include "package.h"
+#include "error.h"
 #include "misc.h"
 
+#define ERR_DOMAIN              CREATEREPO_C_ERROR
+
 #define PACKAGE_CHUNK_SIZE 2048
 
 cr_Dependency *
@@ -187,11 +191,13 @@ cr_dependency_dup(GStringChunk *chunk, GSList *orig)
     return g_slist_reverse(list);
 }
 
-cr_Package *
-cr_package_copy(cr_Package *orig)
+/** Copy orig into pkg. With keep_order FALSE the lists of files and
+ * changelogs end up reversed, which is what cr_package_copy() has
+ * always done.
+ */
+static void
+package_copy_into(cr_Package *pkg, cr_Package *orig, gboolean keep_order)
 {
-    cr_Package *pkg = cr_package_new();
-
     pkg->pkgKey           = orig->pkgKey;
     pkg->pkgId            = cr_safe_string_chunk_insert(pkg->chunk, orig->pkgId);
     pkg->name             = cr_safe_string_chunk_insert(pkg->chunk, orig->name);
@@ -236,6 +242,8 @@ cr_package_copy(cr_Package *orig)
         file->name = cr_safe_string_chunk_insert(pkg->chunk, orig_file->name);
         pkg->files = g_slist_prepend(pkg->files, file);
     }
+    if (keep_order)
+        pkg->files = g_slist_reverse(pkg->files);
 
     for (GSList *elem = orig->changelogs; elem; elem = g_slist_next(elem)) {
         cr_ChangelogEntry *orig_log = elem->data;
@@ -245,6 +253,34 @@ cr_package_copy(cr_Package *orig)
         log->changelog = cr_safe_string_chunk_insert(pkg->chunk, orig_log->changelog);
         pkg->changelogs = g_slist_prepend(pkg->changelogs, log);
     }
+    if (keep_order)
+        pkg->changelogs = g_slist_reverse(pkg->changelogs);
+}
 
+int
+cr_package_copy_into(cr_Package *pkg, cr_Package *orig, GError **err)
+{
+    assert(!err || *err == NULL);
+
+    if (!pkg || !orig) {
+        g_set_error(err, ERR_DOMAIN, CRE_BADARG, "No package to copy");
+        return CRE_BADARG;
+    }
+
+    if (!pkg->chunk) {
+        g_set_error(err, ERR_DOMAIN, CRE_BADARG,
+                    "Destination package has no string chunk");
+        return CRE_BADARG;
+    }
+
+    package_copy_into(pkg, orig, TRUE);
+    return CRE_OK;
+}
+
+cr_Package *
+cr_package_copy(cr_Package *orig)
+{
+    cr_Package *pkg = cr_package_new();
+    package_copy_into(pkg, orig, FALSE);
     return pkg;
 }
@@ -36,6 +36,7 @@ extern "C" {
 typedef enum {
     CR_PACKAGE_FROM_HEADER  = (1<<1),   /*!< Metadata parsed from header */
     CR_PACKAGE_FROM_XML     = (1<<2),   /*!< Metadata parsed xml */
+    CR_PACKAGE_FROM_SNAPSHOT= (1<<3),   /*!< Metadata from binary snapshot */
     /* Some values are reserved (for sqlite, solv, etc..) */
     CR_PACKAGE_LOADED_PRI   = (1<<10),  /*!< Primary metadata was loaded */
     CR_PACKAGE_LOADED_FIL   = (1<<11),  /*!< Filelists metadata was loaded */
@@ -190,6 +191,20 @@ gchar *cr_package_nevra(cr_Package *package);
  */
 cr_Package *cr_package_copy(cr_Package *package);
 
+/** Copy all attributes of the package into another, empty, package.
+ * Strings are stored into the chunk of the destination package,
+ * which could be shared with other packages. Unlike cr_package_copy(),
+ * the files and changelogs keep the order of the source package.
+ * @param dst           Destination cr_Package, it must have a chunk
+ *                      (e.g. from cr_package_new())
+ * @param package       Source cr_Package
+ * @param err           GError **
+ * @return              cr_Error code (CRE_BADARG if dst has no chunk)
+ */
+int cr_package_copy_into(cr_Package *dst,
+                         cr_Package *package,
+                         GError **err);
+
 /** @} */
 
 #ifdef __cplusplus
@@ -24,6 +24,7 @@
 #include "parsehdr.h"
 #include "xml_dump.h"
 #include "misc.h"
+#include "string_pool.h"
 #include "cleanup.h"
 
 #if defined(RPMTAG_SUGGESTS) && defined(RPMTAG_ENHANCES) \
@@ -78,6 +79,131 @@ static DepItem dep_items[] = {
     { DEP_SENTINEL, 0, 0, 0 },
 };
 
+/*
+ * Lookup tables used during the header conversion.
+ *
+ * They are open addressing tables sized from the number of items in the
+ * related header tag (at most half full). The tables only reference
+ * strings which live in the header or in the package chunk.
+ */
+
+#define HASH_INIT       2166136261u     // FNV-1a offset basis
+
+static inline guint32
+hash_str(guint32 hash, const char *str)
+{
+    for (const unsigned char *p = (const unsigned char *) str; *p; p++)
+        hash = (hash ^ *p) * 16777619u;
+    return hash;
+}
+
+static guint32
+table_size(guint32 items)
+{
+    guint32 size = 16;
+    while (size < items * 2)
+        size <<= 1;
+    return size;
+}
+
+typedef struct {
+    const char *key;
+    gpointer value;
+} StrTableSlot;
+
+/** String -> value table
+ */
+typedef struct {
+    StrTableSlot *slots;
+    guint32 mask;
+} StrTable;
+
+static void
+strtable_init(StrTable *table, guint32 items)
+{
+    guint32 size = table_size(items);
+    table->slots = g_new0(StrTableSlot, size);
+    table->mask  = size - 1;
+}
+
+/** Return the slot of the key or the empty slot where the key belongs.
+ */
+static StrTableSlot *
+strtable_slot(StrTable *table, const char *key)
+{
+    guint32 i = hash_str(HASH_INIT, key) & table->mask;
+    while (table->slots[i].key && strcmp(table->slots[i].key, key))
+        i = (i + 1) & table->mask;
+    return &table->slots[i];
+}
+
+static gboolean
+strtable_lookup(StrTable *table, const char *key, gpointer *value)
+{
+    if (!table->slots)
+        return FALSE;
+    StrTableSlot *slot = strtable_slot(table, key);
+    if (!slot->key)
+        return FALSE;
+    if (value)
+        *value = slot->value;
+    return TRUE;
+}
+
+static void
+strtable_replace(StrTable *table, const char *key, gpointer value)
+{
+    StrTableSlot *slot = strtable_slot(table, key);
+    slot->key   = key;
+    slot->value = value;
+}
+
+/** Set of files referenced by their directory and basename, so the full
+ * paths never have to be built. The hash of a path is computed over
+ * the directory and then the basename, which is the same as the hash of
+ * the full path.
+ */
+typedef struct {
+    cr_PackageFile **slots;
+    guint32 mask;
+} FileSet;
+
+static void
+fileset_init(FileSet *set, GPtrArray *files)
+{
+    guint32 size = table_size(files->len);
+    set->slots = g_new0(cr_PackageFile *, size);
+    set->mask  = size - 1;
+
+    for (guint x = 0; x < files->len; x++) {
+        cr_PackageFile *file = g_ptr_array_index(files, x);
+        guint32 i = hash_str(hash_str(HASH_INIT, file->path), file->name);
+        i &= set->mask;
+        while (set->slots[i])
+            i = (i + 1) & set->mask;
+        set->slots[i] = file;
+    }
+}
+
+static gboolean
+fileset_contains(FileSet *set, const char *path)
+{
+    if (!set->slots)
+        return FALSE;
+
+    for (guint32 i = hash_str(HASH_INIT, path) & set->mask;
+         set->slots[i];
+         i = (i + 1) & set->mask)
+    {
+        cr_PackageFile *file = set->slots[i];
+        size_t len = strlen(file->path);
+        if (!strncmp(path, file->path, len) && !strcmp(path + len, file->name))
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
 static inline int
 cr_compare_dependency(const char *dep1, const char *dep2)
 {
@@ -188,14 +314,16 @@ cr_package_from_header(Header hdr,
         pkg->arch = cr_safe_string_chunk_insert(pkg->chunk, headerGetString(hdr, RPMTAG_ARCH));
     }
 
-    pkg->version = cr_safe_string_chunk_insert(pkg->chunk, headerGetString(hdr, RPMTAG_VERSION));
+    pkg->version = cr_string_pool_chunk_insert(pkg->chunk, headerGetString(hdr, RPMTAG_VERSION));
 
 #define MAX_STR_INT_LEN 24
     char tmp_epoch[MAX_STR_INT_LEN];
     if (snprintf(tmp_epoch, MAX_STR_INT_LEN, "%llu", (long long unsigned int) headerGetNumber(hdr, RPMTAG_EPOCH)) <= 0) {
         tmp_epoch[0] = '\0';
     }
-    pkg->epoch = g_string_chunk_insert_len(pkg->chunk, tmp_epoch, MAX_STR_INT_LEN);
+    pkg->epoch = cr_string_pool_get_default()
+                 ? cr_string_pool_chunk_insert(pkg->chunk, tmp_epoch)
+                 : g_string_chunk_insert_len(pkg->chunk, tmp_epoch, MAX_STR_INT_LEN);
 
     pkg->release = cr_safe_string_chunk_insert(pkg->chunk, headerGetString(hdr, RPMTAG_RELEASE));
     pkg->summary = cr_safe_string_chunk_insert(pkg->chunk, headerGetString(hdr, RPMTAG_SUMMARY));
@@ -204,12 +332,12 @@ cr_package_from_header(Header hdr,
     if (headerGet(hdr, RPMTAG_BUILDTIME, td, flags)) {
         pkg->time_build = rpmtdGetNumber(td);
     }
-    pkg->rpm_license = cr_safe_string_chunk_insert(pkg->chunk, headerGetString(hdr, RPMTAG_LICENSE));
-    pkg->rpm_vendor = cr_safe_string_chunk_insert(pkg->chunk, headerGetString(hdr, RPMTAG_VENDOR));
-    pkg->rpm_group = cr_safe_string_chunk_insert(pkg->chunk, headerGetString(hdr, RPMTAG_GROUP));
-    pkg->rpm_buildhost = cr_safe_string_chunk_insert(pkg->chunk, headerGetString(hdr, RPMTAG_BUILDHOST));
-    pkg->rpm_sourcerpm = cr_safe_string_chunk_insert(pkg->chunk, headerGetString(hdr, RPMTAG_SOURCERPM));
-    pkg->rpm_packager = cr_safe_string_chunk_insert(pkg->chunk, headerGetString(hdr, RPMTAG_PACKAGER));
+    pkg->rpm_license = cr_string_pool_chunk_insert(pkg->chunk, headerGetString(hdr, RPMTAG_LICENSE));
+    pkg->rpm_vendor = cr_string_pool_chunk_insert(pkg->chunk, headerGetString(hdr, RPMTAG_VENDOR));
+    pkg->rpm_group = cr_string_pool_chunk_insert(pkg->chunk, headerGetString(hdr, RPMTAG_GROUP));
+    pkg->rpm_buildhost = cr_string_pool_chunk_insert(pkg->chunk, headerGetString(hdr, RPMTAG_BUILDHOST));
+    pkg->rpm_sourcerpm = cr_string_pool_chunk_insert(pkg->chunk, headerGetString(hdr, RPMTAG_SOURCERPM));
+    pkg->rpm_packager = cr_string_pool_chunk_insert(pkg->chunk, headerGetString(hdr, RPMTAG_PACKAGER));
     // RPMTAG_LONGSIZE is allways present (is emulated for small packages because HEADERGET_EXT flag was used)
     if (headerGet(hdr, RPMTAG_LONGSIZE, td, flags)) {
         pkg->size_installed = rpmtdGetNumber(td);
@@ -228,13 +356,15 @@ cr_package_from_header(Header hdr,
     // Fill files
     //
 
-    rpmtd full_filenames = rpmtdNew(); // Only for filenames_hashtable
     rpmtd indexes   = rpmtdNew();
     rpmtd filenames = rpmtdNew();
     rpmtd fileflags = rpmtdNew();
     rpmtd filemodes = rpmtdNew();
 
-    GHashTable *filenames_hashtable = g_hash_table_new(g_str_hash, g_str_equal);
+    // Primary files of the package (only these are interesting
+    // for filtering of the requires)
+    GPtrArray *primary_files = NULL;
+    FileSet primary_fileset = { NULL, 0 };
 
     rpmtd dirnames = rpmtdNew();
 
@@ -243,29 +373,35 @@ cr_package_from_header(Header hdr,
 
     int dir_count;
     char **dir_list = NULL;
+    // Whether files in the directory are primary files, see cr_is_primary().
+    // Directory names end with '/', so a "bin/" substring of a path
+    // is always in its directory part.
+    gint8 *dir_primary = NULL;
     if (headerGet(hdr, RPMTAG_DIRNAMES, dirnames,  flags) && (dir_count = rpmtdCount(dirnames))) {
         int x = 0;
         dir_list = malloc(sizeof(char *) * dir_count);
+        dir_primary = malloc(sizeof(gint8) * dir_count);
         while (rpmtdNext(dirnames) != -1) {
-            dir_list[x] = cr_safe_string_chunk_insert(pkg->chunk, rpmtdGetString(dirnames));
+            dir_list[x] = cr_string_pool_chunk_insert(pkg->chunk, rpmtdGetString(dirnames));
+            if (!g_str_has_suffix(dir_list[x], "/"))
+                dir_primary[x] = -1;    // Unusual dirname, check full path
+            else
+                dir_primary[x] = cr_is_primary(dir_list[x]) ? 1 : 0;
             x++;
         }
         assert(x == dir_count);
     }
 
-    if (headerGet(hdr, RPMTAG_FILENAMES,  full_filenames,  flags) &&
-        headerGet(hdr, RPMTAG_DIRINDEXES, indexes,  flags) &&
+    if (headerGet(hdr, RPMTAG_DIRINDEXES, indexes,  flags) &&
         headerGet(hdr, RPMTAG_BASENAMES,  filenames, flags) &&
         headerGet(hdr, RPMTAG_FILEFLAGS,  fileflags, flags) &&
         headerGet(hdr, RPMTAG_FILEMODES,  filemodes, flags))
     {
-        rpmtdInit(full_filenames);
         rpmtdInit(indexes);
         rpmtdInit(filenames);
         rpmtdInit(fileflags);
         rpmtdInit(filemodes);
-        while ((rpmtdNext(full_filenames) != -1)   &&
-               (rpmtdNext(indexes) != -1)   &&
+        while ((rpmtdNext(indexes) != -1)   &&
                (rpmtdNext(filenames) != -1) &&
                (rpmtdNext(fileflags) != -1) &&
                (rpmtdNext(filemodes) != -1))
@@ -273,7 +409,8 @@ cr_package_from_header(Header hdr,
             cr_PackageFile *packagefile = cr_package_file_new();
             packagefile->name = cr_safe_string_chunk_insert(pkg->chunk,
                                                          rpmtdGetString(filenames));
-            packagefile->path = (dir_list) ? dir_list[(int) rpmtdGetNumber(indexes)] : "";
+            int dir_index = (int) rpmtdGetNumber(indexes);
+            packagefile->path = (dir_list) ? dir_list[dir_index] : "";
 
             if (S_ISDIR(rpmtdGetNumber(filemodes))) {
                 // Directory
@@ -286,9 +423,25 @@ cr_package_from_header(Header hdr,
                 packagefile->type = cr_safe_string_chunk_insert(pkg->chunk, "");
             }
 
-            g_hash_table_replace(filenames_hashtable,
-                                 (gpointer) rpmtdGetString(full_filenames),
-                                 (gpointer) rpmtdGetString(full_filenames));
+            gboolean primary = FALSE;
+            if (!dir_primary || dir_primary[dir_index] == -1) {
+                _cleanup_free_ gchar *fullpath = g_strconcat(packagefile->path,
+                                                            packagefile->name,
+                                                            NULL);
+                primary = cr_is_primary(fullpath);
+            } else if (dir_primary[dir_index]) {
+                primary = TRUE;
+            } else if (!strcmp(packagefile->path, "/usr/lib/")) {
+                // The only primary file matched by its full name
+                primary = !strcmp(packagefile->name, "sendmail");
+            }
+
+            if (primary) {
+                if (!primary_files)
+                    primary_files = g_ptr_array_new();
+                g_ptr_array_add(primary_files, packagefile);
+            }
+
             pkg->files = g_slist_prepend(pkg->files, packagefile);
         }
         pkg->files = g_slist_reverse (pkg->files);
@@ -306,6 +459,12 @@ cr_package_from_header(Header hdr,
 
     if (dir_list) {
         free((void *) dir_list);
+        free((void *) dir_primary);
+    }
+
+    if (primary_files) {
+        fileset_init(&primary_fileset, primary_files);
+        g_ptr_array_free(primary_files, TRUE);
     }
 
 
@@ -322,17 +481,17 @@ cr_package_from_header(Header hdr,
         int pre;
     };
 
-    // Hastable with filenames from provided
-    GHashTable *provided_hashtable = g_hash_table_new_full(g_str_hash,
-                                                           g_str_equal,
-                                                           g_free,
-                                                           NULL);
+    // Provides (NameFlagsVersion strings are stored in provided_chunk)
+    StrTable provided_table = { NULL, 0 };
+    GStringChunk *provided_chunk = NULL;
 
-    // Hashtable with already processed files from requires
-    GHashTable *ap_hashtable = g_hash_table_new_full(g_str_hash,
-                                                     g_str_equal,
-                                                     NULL,
-                                                     free);
+    // Already processed files from requires
+    StrTable ap_table = { NULL, 0 };
+    struct ap_value_struct *ap_values = NULL;
+    guint32 ap_values_used = 0;
+
+    // Dep NameFlagsVersion - reused for all dependencies of the package
+    GString *depnfv = g_string_sized_new(128);
 
     for (int deptype=0; dep_items[deptype].type != DEP_SENTINEL; deptype++) {
         if (headerGet(hdr, dep_items[deptype].nametag, filenames, flags) &&
@@ -344,6 +503,16 @@ cr_package_from_header(Header hdr,
             // e.g. libc.so.6(GLIBC_2.4)
             cr_Dependency *libc_require_highest = NULL;
 
+            // Tables are sized by the number of the dependencies
+            if (deptype == DEP_PROVIDES) {
+                strtable_init(&provided_table, rpmtdCount(filenames));
+                provided_chunk = g_string_chunk_new(4096);
+            } else if (deptype == DEP_REQUIRES) {
+                strtable_init(&ap_table, rpmtdCount(filenames));
+                ap_values = g_new(struct ap_value_struct,
+                                  rpmtdCount(filenames));
+            }
+
             rpmtdInit(filenames);
             rpmtdInit(fileflags);
             rpmtdInit(fileversions);
@@ -357,11 +526,14 @@ cr_package_from_header(Header hdr,
                 const char *flags = cr_flag_to_str(num_flags);
                 const char *full_version = rpmtdGetString(fileversions);
 
-                _cleanup_free_ char *depnfv = NULL;  // Dep NameFlagsVersion
-                depnfv = g_strconcat(filename,
-                                     flags ? flags : "",
-                                     full_version ? full_version : "",
-                                     NULL);
+                // Only provides and requires need the NameFlagsVersion
+                if (deptype == DEP_PROVIDES || deptype == DEP_REQUIRES) {
+                    g_string_assign(depnfv, filename);
+                    if (flags)
+                        g_string_append(depnfv, flags);
+                    if (full_version)
+                        g_string_append(depnfv, full_version);
+                }
 
                 // Requires specific stuff
                 if (deptype == DEP_REQUIRES) {
@@ -371,14 +543,15 @@ cr_package_from_header(Header hdr,
                     }
 
                     // Skip package primary files
-                    if (*filename == '/' && g_hash_table_lookup_extended(filenames_hashtable, filename, NULL, NULL)) {
-                        if (cr_is_primary(filename)) {
-                            continue;
-                        }
+                    if (*filename == '/'
+                        && cr_is_primary(filename)
+                        && fileset_contains(&primary_fileset, filename))
+                    {
+                        continue;
                     }
 
                     // Skip files which are provided
-                    if (g_hash_table_lookup_extended(provided_hashtable, depnfv, NULL, NULL)) {
+                    if (strtable_lookup(&provided_table, depnfv->str, NULL)) {
                         continue;
                     }
 
@@ -392,7 +565,7 @@ cr_package_from_header(Header hdr,
 
                     // Skip duplicate files
                     gpointer value;
-                    if (g_hash_table_lookup_extended(ap_hashtable, filename, NULL, &value)) {
+                    if (strtable_lookup(&ap_table, filename, &value)) {
                         struct ap_value_struct *ap_value = value;
                         if (!g_strcmp0(ap_value->flags, flags) &&
                             !strcmp(ap_value->version, full_version) &&
@@ -404,30 +577,44 @@ cr_package_from_header(Header hdr,
                 }
 
                 // Parse dep string
-                cr_EVR *evr = cr_str_to_evr(full_version, pkg->chunk);
+                // With a string pool, the parts are interned instead
+                cr_StringPool *pool = cr_string_pool_get_default();
+                cr_EVR *evr = cr_str_to_evr(full_version, pool ? NULL : pkg->chunk);
                 if ((full_version && *full_version) && !evr->epoch) {
                     // NULL in epoch mean that the epoch was bad (non-numerical)
                     _cleanup_free_ gchar *pkg_nevra = cr_package_nevra(pkg);
                     g_warning("Bad epoch in version string \"%s\" for dependency \"%s\" in package \"%s\"",
                               full_version, filename, pkg_nevra);
                     g_warning("Skipping this dependency");
-                    g_free(evr);
+                    if (pool)
+                        cr_evr_free(evr);
+                    else
+                        g_free(evr);
                     continue;
                 }
 
                 // Create dynamic dependency object
                 cr_Dependency *dependency = cr_dependency_new();
-                dependency->name = cr_safe_string_chunk_insert(pkg->chunk, filename);
-                dependency->flags = cr_safe_string_chunk_insert(pkg->chunk, flags);
-                dependency->epoch = evr->epoch;
-                dependency->version = evr->version;
-                dependency->release = evr->release;
-                g_free(evr);
+                dependency->name = cr_string_pool_chunk_insert(pkg->chunk, filename);
+                dependency->flags = cr_string_pool_chunk_insert(pkg->chunk, flags);
+                if (pool) {
+                    dependency->epoch = (char *) cr_string_pool_intern(pool, evr->epoch);
+                    dependency->version = (char *) cr_string_pool_intern(pool, evr->version);
+                    dependency->release = (char *) cr_string_pool_intern(pool, evr->release);
+                    cr_evr_free(evr);
+                } else {
+                    dependency->epoch = evr->epoch;
+                    dependency->version = evr->version;
+                    dependency->release = evr->release;
+                    g_free(evr);
+                }
 
                 switch (deptype) {
                     case DEP_PROVIDES: {
-                        char *depnfv_dup = g_strdup(depnfv);
-                        g_hash_table_replace(provided_hashtable, depnfv_dup, NULL);
+                        char *depnfv_dup = g_string_chunk_insert_len(provided_chunk,
+                                                                     depnfv->str,
+                                                                     depnfv->len);
+                        strtable_replace(&provided_table, depnfv_dup, NULL);
                         pkg->provides = g_slist_prepend(pkg->provides, dependency);
                         break;
                     }
@@ -465,12 +652,12 @@ cr_package_from_header(Header hdr,
 
                         pkg->requires = g_slist_prepend(pkg->requires, dependency);
 
-                        // Add file into ap_hashtable
-                        struct ap_value_struct *value = malloc(sizeof(struct ap_value_struct));
+                        // Add file into ap_table
+                        struct ap_value_struct *value = &ap_values[ap_values_used++];
                         value->flags = flags;
                         value->version = full_version;
                         value->pre = dependency->pre;
-                        g_hash_table_replace(ap_hashtable, dependency->name, value);
+                        strtable_replace(&ap_table, dependency->name, value);
                         break; //case REQUIRES end
                     case DEP_SUGGESTS:
                         pkg->suggests = g_slist_prepend(pkg->suggests, dependency);
@@ -523,21 +710,19 @@ cr_package_from_header(Header hdr,
     pkg->recommends  = g_slist_reverse (pkg->recommends);
     pkg->supplements = g_slist_reverse (pkg->supplements);
 
-    g_hash_table_remove_all(filenames_hashtable);
-    g_hash_table_remove_all(provided_hashtable);
-    g_hash_table_remove_all(ap_hashtable);
+    g_free(primary_fileset.slots);
+    g_free(provided_table.slots);
+    if (provided_chunk)
+        g_string_chunk_free(provided_chunk);
+    g_free(ap_table.slots);
+    g_free(ap_values);
 
-    g_hash_table_unref(filenames_hashtable);
-    g_hash_table_unref(provided_hashtable);
-    g_hash_table_unref(ap_hashtable);
+    g_string_free(depnfv, TRUE);
 
     rpmtdFree(filenames);
     rpmtdFree(fileflags);
     rpmtdFree(fileversions);
 
-    rpmtdFreeData(full_filenames);
-    rpmtdFree(full_filenames);
-
 
     //
     // Changelogs
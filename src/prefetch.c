@@ -0,0 +1,456 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2014  Tomas Mlcoch
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <glib.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#ifdef WITH_LIBURING
+#include <liburing.h>
+#endif
+#include "prefetch.h"
+#include "error.h"
+
+#define ERR_DOMAIN              CREATEREPO_C_ERROR
+#define PREFETCH_BLOCK_SIZE     (256*1024)
+#define URING_QUEUE_DEPTH       32
+#define PREFETCH_STOP           GINT_TO_POINTER(-1)
+
+struct _cr_Prefetcher {
+    cr_PrefetchEngine engine;   // Engine really used
+    int depth;                  // How many packages read ahead
+    cr_PrefetchFilterFunc filter;
+    void *filter_data;
+
+    GPtrArray *paths;           // Paths of the packages (index is task id)
+    GMutex *mutex;              // Protects everything bellow
+    long current;               // Highest task id which is being processed
+    long scheduled;             // Highest task id which was scheduled
+    gint64 files;               // Number of prefetched files
+    gint64 bytes;               // Number of prefetched bytes
+    volatile gint stop;         // Stop flag
+
+    // Threads engine
+    GThreadPool *pool;
+
+    // io_uring engine
+    GAsyncQueue *queue;         // Queue of ids (id + 1) to prefetch
+    GThread *thread;
+#ifdef WITH_LIBURING
+    struct io_uring ring;
+#endif
+};
+
+cr_PrefetchEngine
+cr_prefetch_engine_from_str(const char *name)
+{
+    if (!name || !g_strcmp0(name, "auto"))
+        return CR_PREFETCH_AUTO;
+    if (!g_strcmp0(name, "threads"))
+        return CR_PREFETCH_THREADS;
+    if (!g_strcmp0(name, "io_uring") || !g_strcmp0(name, "io-uring"))
+        return CR_PREFETCH_IO_URING;
+    return CR_PREFETCH_SENTINEL;
+}
+
+/** Return path of the package if it should be prefetched, NULL otherwise.
+ */
+static const char *
+prefetch_path(cr_Prefetcher *pf, long id)
+{
+    const char *path = NULL;
+
+    if (g_atomic_int_get(&pf->stop))
+        return NULL;
+
+    g_mutex_lock(pf->mutex);
+    // A dumper thread already works on the package, it's too late
+    if (id > pf->current)
+        path = g_ptr_array_index(pf->paths, id);
+    g_mutex_unlock(pf->mutex);
+
+    if (path && pf->filter && !pf->filter(path, pf->filter_data))
+        return NULL;
+
+    return path;
+}
+
+static void
+prefetch_account(cr_Prefetcher *pf, gint64 bytes)
+{
+    g_mutex_lock(pf->mutex);
+    pf->files++;
+    pf->bytes += bytes;
+    g_mutex_unlock(pf->mutex);
+}
+
+/** Threads engine */
+
+static void
+prefetch_thread(gpointer data, gpointer user_data)
+{
+    cr_Prefetcher *pf = user_data;
+    long id = GPOINTER_TO_INT(data) - 1;
+    const char *path;
+    unsigned char *buf;
+    gint64 total = 0;
+    ssize_t ret;
+    int fd;
+
+    path = prefetch_path(pf, id);
+    if (!path)
+        return;
+
+    fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        g_debug("%s: Cannot open %s: %s", __func__, path, g_strerror(errno));
+        return;
+    }
+
+#ifdef POSIX_FADV_WILLNEED
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+#endif
+
+    // The data are thrown away, the point is to get them into page cache
+    buf = g_malloc(PREFETCH_BLOCK_SIZE);
+    while (!g_atomic_int_get(&pf->stop)) {
+        ret = read(fd, buf, PREFETCH_BLOCK_SIZE);
+        if (ret == -1 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            break;
+        total += ret;
+    }
+    g_free(buf);
+    close(fd);
+
+    prefetch_account(pf, total);
+}
+
+/** io_uring engine */
+
+#ifdef WITH_LIBURING
+
+typedef struct {
+    int fd;
+    off_t size;
+    off_t offset;       // Offset of the next read to submit
+    int inflight;       // Number of submitted, not completed reads
+    gint64 bytes;       // Bytes read so far
+} UringFile;
+
+static UringFile *
+uring_file_open(cr_Prefetcher *pf, long id)
+{
+    const char *path;
+    struct stat st;
+    UringFile *file;
+    int fd;
+
+    path = prefetch_path(pf, id);
+    if (!path)
+        return NULL;
+
+    fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        g_debug("%s: Cannot open %s: %s", __func__, path, g_strerror(errno));
+        return NULL;
+    }
+
+    if (fstat(fd, &st) == -1 || st.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+
+    file = g_new0(UringFile, 1);
+    file->fd = fd;
+    file->size = st.st_size;
+    return file;
+}
+
+static void
+uring_file_close(cr_Prefetcher *pf, UringFile *file)
+{
+    close(file->fd);
+    prefetch_account(pf, file->bytes);
+    g_free(file);
+}
+
+static gpointer
+prefetch_uring_thread(gpointer data)
+{
+    cr_Prefetcher *pf = data;
+    struct io_uring *ring = &pf->ring;
+    unsigned char *bufs;
+    UringFile *slots[URING_QUEUE_DEPTH] = {NULL};
+    UringFile *cur = NULL;      // File whose reads are being submitted
+    int inflight = 0;
+    gboolean done = FALSE;
+
+    bufs = g_malloc((gsize) URING_QUEUE_DEPTH * PREFETCH_BLOCK_SIZE);
+
+    while (!done || inflight > 0) {
+        struct io_uring_cqe *cqe;
+        UringFile *file;
+        uintptr_t slot;
+        int submitted = 0;
+        int ret;
+
+        if (!done && g_atomic_int_get(&pf->stop)) {
+            done = TRUE;
+            if (cur && cur->inflight == 0)
+                uring_file_close(pf, cur);
+            cur = NULL;
+        }
+
+        // Keep the ring full
+        while (!done && inflight < URING_QUEUE_DEPTH) {
+            struct io_uring_sqe *sqe;
+
+            if (!cur) {
+                gpointer item;
+
+                // Block only if there is nothing else to wait for
+                if (inflight)
+                    item = g_async_queue_try_pop(pf->queue);
+                else
+                    item = g_async_queue_pop(pf->queue);
+
+                if (!item)
+                    break;
+                if (item == PREFETCH_STOP) {
+                    done = TRUE;
+                    break;
+                }
+
+                cur = uring_file_open(pf, GPOINTER_TO_INT(item) - 1);
+                if (!cur)
+                    continue;
+            }
+
+            sqe = io_uring_get_sqe(ring);
+            if (!sqe)
+                break;
+
+            for (slot = 0; slots[slot]; slot++)
+                ;
+
+            io_uring_prep_read(sqe, cur->fd,
+                               bufs + slot * PREFETCH_BLOCK_SIZE,
+                               PREFETCH_BLOCK_SIZE, cur->offset);
+            io_uring_sqe_set_data(sqe, (void *) slot);
+            slots[slot] = cur;
+            cur->inflight++;
+            cur->offset += PREFETCH_BLOCK_SIZE;
+            inflight++;
+            submitted++;
+
+            if (cur->offset >= cur->size)
+                cur = NULL;  // Closed when the last read completes
+        }
+
+        if (submitted)
+            io_uring_submit(ring);
+
+        if (!inflight)
+            continue;
+
+        ret = io_uring_wait_cqe(ring, &cqe);
+        if (ret == -EINTR)
+            continue;
+        if (ret < 0) {
+            g_warning("%s: io_uring_wait_cqe: %s", __func__, g_strerror(-ret));
+            break;
+        }
+
+        slot = (uintptr_t) io_uring_cqe_get_data(cqe);
+        file = slots[slot];
+        slots[slot] = NULL;
+        inflight--;
+        file->inflight--;
+        if (cqe->res > 0)
+            file->bytes += cqe->res;
+        io_uring_cqe_seen(ring, cqe);
+
+        if (file->inflight == 0 && file != cur)
+            uring_file_close(pf, file);
+    }
+
+    // Only reachable with reads in flight if the ring broke,
+    // io_uring_queue_exit() cancels them
+    io_uring_queue_exit(ring);
+    for (int x = 0; x < URING_QUEUE_DEPTH; x++) {
+        UringFile *file = slots[x];
+        if (file && --file->inflight == 0 && file != cur)
+            uring_file_close(pf, file);
+    }
+    if (cur)
+        uring_file_close(pf, cur);
+
+    g_free(bufs);
+    return NULL;
+}
+
+#endif /* WITH_LIBURING */
+
+cr_Prefetcher *
+cr_prefetcher_new(cr_PrefetchEngine engine,
+                  int depth,
+                  int threads,
+                  cr_PrefetchFilterFunc filter,
+                  void *filter_data,
+                  GError **err)
+{
+    cr_Prefetcher *pf;
+
+    assert(engine < CR_PREFETCH_SENTINEL);
+    assert(!err || *err == NULL);
+
+    if (depth < 1) {
+        g_set_error(err, ERR_DOMAIN, CRE_BADARG,
+                    "Prefetch depth must be a positive number");
+        return NULL;
+    }
+
+#ifndef WITH_LIBURING
+    if (engine == CR_PREFETCH_IO_URING) {
+        g_set_error(err, ERR_DOMAIN, CRE_BADARG,
+                    "createrepo_c was built without io_uring support");
+        return NULL;
+    }
+#endif
+
+    pf = g_new0(cr_Prefetcher, 1);
+    pf->depth       = depth;
+    pf->filter      = filter;
+    pf->filter_data = filter_data;
+    pf->paths       = g_ptr_array_new_with_free_func(g_free);
+    pf->mutex       = g_mutex_new();
+    pf->current     = -1;
+    pf->scheduled   = -1;
+
+#ifdef WITH_LIBURING
+    if (engine != CR_PREFETCH_THREADS) {
+        int ret = io_uring_queue_init(URING_QUEUE_DEPTH, &pf->ring, 0);
+        if (ret == 0) {
+            pf->engine = CR_PREFETCH_IO_URING;
+            pf->queue  = g_async_queue_new();
+            pf->thread = g_thread_new("prefetch", prefetch_uring_thread, pf);
+            return pf;
+        }
+
+        if (engine == CR_PREFETCH_IO_URING) {
+            g_set_error(err, ERR_DOMAIN, CRE_IO,
+                        "Cannot initialize io_uring: %s", g_strerror(-ret));
+            cr_prefetcher_free(pf);
+            return NULL;
+        }
+
+        g_debug("%s: io_uring is not available (%s) - using threads",
+                __func__, g_strerror(-ret));
+    }
+#endif
+
+    pf->engine = CR_PREFETCH_THREADS;
+    pf->pool = g_thread_pool_new(prefetch_thread,
+                                 pf,
+                                 MAX(threads, 1),
+                                 FALSE,
+                                 NULL);
+    return pf;
+}
+
+void
+cr_prefetcher_add(cr_Prefetcher *pf, const char *path)
+{
+    assert(pf);
+    assert(path);
+
+    g_mutex_lock(pf->mutex);
+    g_ptr_array_add(pf->paths, g_strdup(path));
+    g_mutex_unlock(pf->mutex);
+}
+
+void
+cr_prefetcher_advance(cr_Prefetcher *pf, long id)
+{
+    long last;
+
+    if (!pf)
+        return;
+
+    g_mutex_lock(pf->mutex);
+
+    if (id > pf->current)
+        pf->current = id;
+
+    last = MIN(pf->current + pf->depth, (long) pf->paths->len - 1);
+    if (pf->scheduled < pf->current)
+        pf->scheduled = pf->current;
+
+    while (pf->scheduled < last) {
+        gpointer item = GINT_TO_POINTER(++pf->scheduled + 1);
+        if (pf->engine == CR_PREFETCH_THREADS)
+            g_thread_pool_push(pf->pool, item, NULL);
+        else
+            g_async_queue_push(pf->queue, item);
+    }
+
+    g_mutex_unlock(pf->mutex);
+}
+
+const char *
+cr_prefetcher_engine_name(cr_Prefetcher *pf)
+{
+    assert(pf);
+    return (pf->engine == CR_PREFETCH_IO_URING) ? "io_uring" : "threads";
+}
+
+void
+cr_prefetcher_free(cr_Prefetcher *pf)
+{
+    if (!pf)
+        return;
+
+    g_atomic_int_set(&pf->stop, 1);
+
+    if (pf->pool)
+        g_thread_pool_free(pf->pool, TRUE, TRUE);
+
+    if (pf->thread) {
+        g_async_queue_push(pf->queue, PREFETCH_STOP);
+        g_thread_join(pf->thread);
+    }
+
+    if (pf->queue)
+        g_async_queue_unref(pf->queue);
+
+    g_debug("Prefetcher (%s): %"G_GINT64_FORMAT" files, "
+            "%"G_GINT64_FORMAT" bytes read ahead",
+            cr_prefetcher_engine_name(pf), pf->files, pf->bytes);
+
+    g_ptr_array_free(pf->paths, TRUE);
+    g_mutex_free(pf->mutex);
+    g_free(pf);
+}
@@ -0,0 +1,127 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2014  Tomas Mlcoch
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef __C_CREATEREPOLIB_PREFETCH_H__
+#define __C_CREATEREPOLIB_PREFETCH_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <glib.h>
+
+/** \defgroup   prefetch    Asynchronous prefetching of packages
+ *
+ * The prefetcher reads packages which are queued for the dumper threads
+ * ahead of time, so when a dumper thread picks up a task, the content
+ * of the package is already in the page cache and the thread doesn't
+ * have to wait for the (possibly network) storage.
+ *
+ * Packages are registered in the same order in which they are processed
+ * (by their task id). Every time a dumper thread starts to work on
+ * a package, it calls cr_prefetcher_advance() and the prefetcher makes
+ * sure that reading of the next *depth* packages is in progress.
+ *
+ *  \addtogroup prefetch
+ *  @{
+ */
+
+/** Engine used for the prefetching.
+ */
+typedef enum {
+    CR_PREFETCH_AUTO,       /*!< io_uring if available, threads otherwise */
+    CR_PREFETCH_THREADS,    /*!< Pool of threads doing blocking reads */
+    CR_PREFETCH_IO_URING,   /*!< Single thread submitting reads via io_uring */
+    CR_PREFETCH_SENTINEL,   /*!< Sentinel of the list */
+} cr_PrefetchEngine;
+
+/** Function which decides if the package has to be prefetched.
+ * @param path          Path to the package.
+ * @param user_data     User data.
+ * @return              FALSE if the package won't be read by the
+ *                      dumper (e.g. its old metadata will be reused)
+ */
+typedef gboolean (*cr_PrefetchFilterFunc)(const char *path,
+                                          void *user_data);
+
+typedef struct _cr_Prefetcher cr_Prefetcher;
+
+/** Convert string to cr_PrefetchEngine.
+ * @param name          "auto", "threads" or "io_uring"
+ * @return              Engine or CR_PREFETCH_SENTINEL if unknown
+ */
+cr_PrefetchEngine
+cr_prefetch_engine_from_str(const char *name);
+
+/** Create a new prefetcher.
+ * @param engine        Engine to use. If CR_PREFETCH_IO_URING is requested
+ *                      and io_uring is not available, an error is returned.
+ *                      CR_PREFETCH_AUTO silently falls back to threads.
+ * @param depth         Number of packages to read ahead (>= 1).
+ * @param threads       Number of reader threads for the threads engine.
+ * @param filter        Optional filter function or NULL.
+ * @param filter_data   User data for the filter function.
+ * @param err           GError **
+ * @return              New prefetcher or NULL on error.
+ */
+cr_Prefetcher *
+cr_prefetcher_new(cr_PrefetchEngine engine,
+                  int depth,
+                  int threads,
+                  cr_PrefetchFilterFunc filter,
+                  void *filter_data,
+                  GError **err);
+
+/** Register a package. Packages must be added in the order of their
+ * task ids (the first added package has id 0).
+ * @param pf            Prefetcher
+ * @param path          Path to the package (the string is copied)
+ */
+void
+cr_prefetcher_add(cr_Prefetcher *pf, const char *path);
+
+/** Notify the prefetcher that processing of the package with the given
+ * id started. Reading of the packages up to id + depth is scheduled.
+ * This function is thread safe.
+ * @param pf            Prefetcher (NULL is a no-op)
+ * @param id            Task id
+ */
+void
+cr_prefetcher_advance(cr_Prefetcher *pf, long id);
+
+/** Name of the engine actually used by the prefetcher.
+ * @param pf            Prefetcher
+ * @return              "threads" or "io_uring"
+ */
+const char *
+cr_prefetcher_engine_name(cr_Prefetcher *pf);
+
+/** Stop the prefetcher (pending reads are dropped) and free it.
+ * @param pf            Prefetcher
+ */
+void
+cr_prefetcher_free(cr_Prefetcher *pf);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __C_CREATEREPOLIB_PREFETCH_H__ */
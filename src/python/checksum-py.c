@@ -47,3 +47,61 @@ py_checksum_type(G_GNUC_UNUSED PyObject *self, PyObject *args)
 
     return PyLong_FromLong((long) cr_checksum_type(type));
 }
+
+PyObject *
+py_checksum_file_multi(G_GNUC_UNUSED PyObject *self, PyObject *args)
+{
+    char *filename;
+    PyObject *py_types, *py_seq, *dict;
+    cr_ChecksumType *types;
+    Py_ssize_t count;
+    char **checksums;
+    GError *tmp_err = NULL;
+
+    if (!PyArg_ParseTuple(args, "sO:py_checksum_file_multi",
+                          &filename, &py_types))
+        return NULL;
+
+    py_seq = PySequence_Fast(py_types, "checksum_types must be a sequence");
+    if (!py_seq)
+        return NULL;
+
+    count = PySequence_Fast_GET_SIZE(py_seq);
+    types = g_new0(cr_ChecksumType, count > 0 ? count : 1);
+    for (Py_ssize_t x = 0; x < count; x++) {
+        PyObject *item = PySequence_Fast_GET_ITEM(py_seq, x);
+        if (!PyLong_Check(item)) {
+            PyErr_SetString(PyExc_TypeError,
+                            "checksum_types must contain integers");
+            Py_DECREF(py_seq);
+            g_free(types);
+            return NULL;
+        }
+        types[x] = (cr_ChecksumType) PyLong_AsLong(item);
+    }
+    Py_DECREF(py_seq);
+
+    Py_BEGIN_ALLOW_THREADS
+    checksums = cr_checksum_file_multi(filename, types, count, &tmp_err);
+    Py_END_ALLOW_THREADS
+
+    if (tmp_err) {
+        g_free(types);
+        nice_exception(&tmp_err, NULL);
+        return NULL;
+    }
+
+    dict = PyDict_New();
+    for (Py_ssize_t x = 0; x < count; x++) {
+        PyObject *key = PyLong_FromLong((long) types[x]);
+        PyObject *val = PyUnicodeOrNone_FromString(checksums[x]);
+        PyDict_SetItem(dict, key, val);
+        Py_DECREF(key);
+        Py_DECREF(val);
+    }
+
+    g_strfreev(checksums);
+    g_free(types);
+
+    return dict;
+}
@@ -34,4 +34,11 @@ PyDoc_STRVAR(checksum_type__doc__,
 
 PyObject *py_checksum_type(PyObject *self, PyObject *args);
 
+PyDoc_STRVAR(checksum_file_multi__doc__,
+"checksum_file_multi(filename, checksum_types) -> dict\n\n"
+"Calculate several checksums of the file by a single read of its content.\n"
+"Returns dict {checksum_type: checksum}");
+
+PyObject *py_checksum_file_multi(PyObject *self, PyObject *args);
+
 #endif
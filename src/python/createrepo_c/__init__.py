@@ -91,6 +91,15 @@ XML_WARNING_UNKNOWNVAL  = _createrepo_c.XML_WARNING_UNKNOWNVAL
 #: XML warning - Bad attribute value
 XML_WARNING_BADATTRVAL  = _createrepo_c.XML_WARNING_BADATTRVAL
 
+REPODIFF_ADDED   = _createrepo_c.REPODIFF_ADDED   #: Package only in the new repo
+REPODIFF_REMOVED = _createrepo_c.REPODIFF_REMOVED #: Package only in the old repo
+REPODIFF_CHANGED = _createrepo_c.REPODIFF_CHANGED #: Same NEVRA, different pkgId
+
+MD_KEY_HASH     = _createrepo_c.MD_KEY_HASH     #: Lookup by pkgId
+MD_KEY_NAME     = _createrepo_c.MD_KEY_NAME     #: Lookup by name
+MD_KEY_FILENAME = _createrepo_c.MD_KEY_FILENAME #: Lookup by filename
+MD_KEY_NEVRA    = _createrepo_c.MD_KEY_NEVRA    #: Lookup by NEVRA
+
 # Helper contants
 
 
@@ -133,6 +142,14 @@ class CrFile(_createrepo_c.CrFile):
         :arg stat: ContentStat object or None"""
         _createrepo_c.CrFile.__init__(self, filename, mode, comtype, stat)
 
+# MdClient class
+
+class MdClient(_createrepo_c.MdClient):
+    def __init__(self, socket=None):
+        """:arg socket: Path to the socket of mdserver_c or None
+            for the default"""
+        _createrepo_c.MdClient.__init__(self, socket)
+
 # Metadata class
 
 Metadata = _createrepo_c.Metadata
@@ -145,6 +162,18 @@ MetadataLocation = _createrepo_c.MetadataLocation
 
 Package = _createrepo_c.Package
 
+# PackageIterator class
+
+class PackageIterator(_createrepo_c.PkgIterator):
+    def __init__(self, primary_path, filelists_path=None, other_path=None,
+                 warningcb=None):
+        """:arg primary_path: Path to the primary.xml
+        :arg filelists_path: Path to the filelists.xml or None
+        :arg other_path: Path to the other.xml or None
+        :arg warningcb: Warning callback or None"""
+        _createrepo_c.PkgIterator.__init__(self, primary_path, filelists_path,
+                                           other_path, warningcb)
+
 # Repomd class
 
 class Repomd(_createrepo_c.Repomd):
@@ -324,8 +353,18 @@ def xml_parse_repomd(path, repomdobj, warningcb=None):
     """Parse repomd.xml"""
     return _createrepo_c.xml_parse_repomd(path, repomdobj, warningcb)
 
+def repodiff(old, new, diffcb=None, primary=False):
+    """Compare packages of two repositories (or two primary.xml files
+    if primary is True). Packages are tuples (pkgId, name, arch, epoch,
+    version, release, location_href) or None.
+    If diffcb is None, list of (type, old_pkg, new_pkg) is returned,
+    otherwise diffcb(type, old_pkg, new_pkg) is called for every
+    difference."""
+    return _createrepo_c.repodiff(old, new, diffcb, 1 if primary else 0)
+
 checksum_name_str   = _createrepo_c.checksum_name_str
 checksum_type       = _createrepo_c.checksum_type
+checksum_file_multi = _createrepo_c.checksum_file_multi
 
 def compress_file(src, dst, comtype, stat=None):
     return _createrepo_c.compress_file_with_stat(src, dst, comtype, stat)
@@ -370,3 +409,11 @@ def modifyrepo_c():
 
 def sqliterepo_c():
     raise SystemExit(_program('sqliterepo_c', sys.argv[1:]))
+
+
+def repodiff_c():
+    raise SystemExit(_program('repodiff_c', sys.argv[1:]))
+
+
+def mdserver_c():
+    raise SystemExit(_program('mdserver_c', sys.argv[1:]))
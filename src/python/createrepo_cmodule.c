@@ -31,6 +31,9 @@
 #include "misc-py.h"
 #include "package-py.h"
 #include "parsepkg-py.h"
+#include "pkg_iterator-py.h"
+#include "mdclient-py.h"
+#include "repodiff-py.h"
 #include "repomd-py.h"
 #include "repomdrecord-py.h"
 #include "sqlite-py.h"
@@ -72,10 +75,14 @@ static struct PyMethodDef createrepo_c_methods[] = {
         METH_VARARGS, xml_parse_repomd__doc__},
     {"xml_parse_updateinfo",    (PyCFunction)py_xml_parse_updateinfo,
         METH_VARARGS, xml_parse_updateinfo__doc__},
+    {"repodiff",                (PyCFunction)py_repodiff,
+        METH_VARARGS, repodiff__doc__},
     {"checksum_name_str",       (PyCFunction)py_checksum_name_str,
         METH_VARARGS, checksum_name_str__doc__},
     {"checksum_type",           (PyCFunction)py_checksum_type,
         METH_VARARGS, checksum_type__doc__},
+    {"checksum_file_multi",     (PyCFunction)py_checksum_file_multi,
+        METH_VARARGS, checksum_file_multi__doc__},
     {"compress_file_with_stat", (PyCFunction)py_compress_file_with_stat,
         METH_VARARGS, compress_file_with_stat__doc__},
     {"decompress_file_with_stat",(PyCFunction)py_decompress_file_with_stat,
@@ -148,6 +155,18 @@ init_createrepo_c(void)
     Py_INCREF(&Package_Type);
     PyModule_AddObject(m, "Package", (PyObject *)&Package_Type);
 
+    /* _createrepo_c.PkgIterator */
+    if (PyType_Ready(&PkgIterator_Type) < 0)
+        return FAILURE;
+    Py_INCREF(&PkgIterator_Type);
+    PyModule_AddObject(m, "PkgIterator", (PyObject *)&PkgIterator_Type);
+
+    /* _createrepo_c.MdClient */
+    if (PyType_Ready(&MdClient_Type) < 0)
+        return FAILURE;
+    Py_INCREF(&MdClient_Type);
+    PyModule_AddObject(m, "MdClient", (PyObject *)&MdClient_Type);
+
     /* _createrepo_c.Metadata */
     if (PyType_Ready(&Metadata_Type) < 0)
         return FAILURE;
@@ -293,6 +312,17 @@ init_createrepo_c(void)
     PyModule_AddIntConstant(m, "XML_WARNING_UNKNOWNVAL", CR_XML_WARNING_UNKNOWNVAL);
     PyModule_AddIntConstant(m, "XML_WARNING_BADATTRVAL", CR_XML_WARNING_BADATTRVAL);
 
+    /* Repodiff types */
+    PyModule_AddIntConstant(m, "REPODIFF_ADDED", CR_REPODIFF_ADDED);
+    PyModule_AddIntConstant(m, "REPODIFF_REMOVED", CR_REPODIFF_REMOVED);
+    PyModule_AddIntConstant(m, "REPODIFF_CHANGED", CR_REPODIFF_CHANGED);
+
+    /* Metadata server lookup keys */
+    PyModule_AddIntConstant(m, "MD_KEY_HASH", CR_MD_KEY_HASH);
+    PyModule_AddIntConstant(m, "MD_KEY_NAME", CR_MD_KEY_NAME);
+    PyModule_AddIntConstant(m, "MD_KEY_FILENAME", CR_MD_KEY_FILENAME);
+    PyModule_AddIntConstant(m, "MD_KEY_NEVRA", CR_MD_KEY_NEVRA);
+
 #if PY_MAJOR_VERSION >= 3
     return m;
 #else
@@ -67,10 +67,12 @@ metadatalocation_new(PyTypeObject *type,
 
 PyDoc_STRVAR(metadatalocation_init__doc__,
 "Class representing location of metadata\n\n"
-".. method:: __init__(path, ignore_db)\n\n"
+".. method:: __init__(path, ignore_db[, cache_dir])\n\n"
 "    :arg path: String with url/path to the repository\n"
 "    :arg ignore_db: Boolean. If False then in case of remote repository\n"
-"                    databases will not be downloaded)\n");
+"                    databases will not be downloaded)\n"
+"    :arg cache_dir: Directory where remote repodata are cached\n"
+"                    between runs or None to use a temporary directory\n");
 
 static int
 metadatalocation_init(_MetadataLocationObject *self,
@@ -78,19 +80,29 @@ metadatalocation_init(_MetadataLocationObject *self,
                       G_GNUC_UNUSED PyObject *kwds)
 {
     char *repopath;
+    char *cache_dir = NULL;
     PyObject *py_ignore_db = NULL;
     GError *tmp_err = NULL;
 
-    if (!PyArg_ParseTuple(args, "sO|:metadatalocation_init", &repopath, &py_ignore_db))
+    if (!PyArg_ParseTuple(args, "sO|z:metadatalocation_init", &repopath,
+                          &py_ignore_db, &cache_dir))
         return -1;
 
     /* Free all previous resources when reinitialization */
     if (self->ml) {
         cr_metadatalocation_free(self->ml);
+        self->ml = NULL;
     }
 
     /* Init */
-    self->ml = cr_locate_metadata(repopath, PyObject_IsTrue(py_ignore_db), &tmp_err);
+    int ignore_db = PyObject_IsTrue(py_ignore_db);
+
+    // Remote repodata are downloaded here - let other threads run
+    Py_BEGIN_ALLOW_THREADS
+    self->ml = cr_locate_metadata_cached(repopath, ignore_db,
+                                         cache_dir, &tmp_err);
+    Py_END_ALLOW_THREADS
+
     if (tmp_err) {
         nice_exception(&tmp_err, NULL);
         return -1;
@@ -161,6 +173,12 @@ getitem(_MetadataLocationObject *self, PyObject *pykey)
         value = self->ml->fil_sqlite_href;
     } else if (!strcmp(key, "other_db")) {
         value = self->ml->oth_sqlite_href;
+    } else if (!strcmp(key, "primary_zck")) {
+        value = self->ml->pri_zck_href;
+    } else if (!strcmp(key, "filelists_zck")) {
+        value = self->ml->fil_zck_href;
+    } else if (!strcmp(key, "other_zck")) {
+        value = self->ml->oth_zck_href;
     } else if (!strcmp(key, "group")) {
         value = self->ml->groupfile_href;
     } else if (!strcmp(key, "group_gz")) {
@@ -0,0 +1,219 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2014  Tomas Mlcoch
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <Python.h>
+#include <assert.h>
+#include <stddef.h>
+
+#include "mdclient-py.h"
+#include "package-py.h"
+#include "exception-py.h"
+#include "typeconversion.h"
+
+typedef struct {
+    PyObject_HEAD
+    cr_MdClient *client;
+} _MdClientObject;
+
+static int
+check_MdClientStatus(const _MdClientObject *self)
+{
+    assert(self != NULL);
+    assert(MdClientObject_Check(self));
+    if (self->client == NULL) {
+        PyErr_SetString(CrErr_Exception, "Improper createrepo_c MdClient object.");
+        return -1;
+    }
+    return 0;
+}
+
+/* Function on the type */
+
+static PyObject *
+mdclient_new(PyTypeObject *type,
+             G_GNUC_UNUSED PyObject *args,
+             G_GNUC_UNUSED PyObject *kwds)
+{
+    _MdClientObject *self = (_MdClientObject *)type->tp_alloc(type, 0);
+    if (self)
+        self->client = NULL;
+    return (PyObject *)self;
+}
+
+PyDoc_STRVAR(mdclient_init__doc__,
+"MdClient object - client of the metadata server (mdserver_c)\n\n"
+".. method:: __init__(socket)\n\n"
+"    :arg socket: Path to the socket of the server or None\n"
+"                 for the default\n");
+
+static int
+mdclient_init(_MdClientObject *self,
+              PyObject *args,
+              G_GNUC_UNUSED PyObject *kwds)
+{
+    char *socket_path;
+    GError *tmp_err = NULL;
+
+    if (!PyArg_ParseTuple(args, "z:mdclient_init", &socket_path))
+        return -1;
+
+    /* Free all previous resources when reinitialization */
+    if (self->client) {
+        cr_mdclient_free(self->client);
+        self->client = NULL;
+    }
+
+    /* Init */
+    self->client = cr_mdclient_new(socket_path, &tmp_err);
+    if (tmp_err) {
+        nice_exception(&tmp_err, "MdClient init failed: ");
+        return -1;
+    }
+
+    return 0;
+}
+
+static void
+mdclient_dealloc(_MdClientObject *self)
+{
+    if (self->client)
+        cr_mdclient_free(self->client);
+    Py_TYPE(self)->tp_free(self);
+}
+
+static PyObject *
+mdclient_repr(G_GNUC_UNUSED _MdClientObject *self)
+{
+    return PyUnicode_FromFormat("<createrepo_c.MdClient object>");
+}
+
+/* MdClient methods */
+
+PyDoc_STRVAR(find__doc__,
+"find(repo, key, value) -> list\n\n"
+"Find packages of the repository. Key is one of MD_KEY_HASH,\n"
+"MD_KEY_NAME, MD_KEY_FILENAME or MD_KEY_NEVRA.");
+
+static PyObject *
+find(_MdClientObject *self, PyObject *args)
+{
+    char *repo, *value;
+    int key;
+    GSList *pkgs;
+    PyObject *list;
+    GError *tmp_err = NULL;
+
+    if (!PyArg_ParseTuple(args, "sis:find", &repo, &key, &value))
+        return NULL;
+
+    if (check_MdClientStatus(self))
+        return NULL;
+
+    if (key < 0 || key >= CR_MD_KEY_SENTINEL) {
+        PyErr_SetString(PyExc_ValueError, "Bad key");
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    pkgs = cr_mdclient_find(self->client, repo, key, value,
+                            CR_PACKAGE_LOADED_PRI
+                            | CR_PACKAGE_LOADED_FIL
+                            | CR_PACKAGE_LOADED_OTH,
+                            &tmp_err);
+    Py_END_ALLOW_THREADS
+
+    if (tmp_err) {
+        nice_exception(&tmp_err, NULL);
+        return NULL;
+    }
+
+    list = PyList_New(0);
+    if (!list) {
+        g_slist_free_full(pkgs, (GDestroyNotify) cr_package_free);
+        return NULL;
+    }
+
+    for (GSList *elem = pkgs; elem; elem = g_slist_next(elem)) {
+        PyObject *py_pkg = Object_FromPackage(elem->data, 1);
+        elem->data = NULL;
+        if (!py_pkg || PyList_Append(list, py_pkg) == -1) {
+            Py_XDECREF(py_pkg);
+            Py_DECREF(list);
+            g_slist_free_full(g_slist_next(elem),
+                              (GDestroyNotify) cr_package_free);
+            elem->next = NULL;
+            g_slist_free(pkgs);
+            return NULL;
+        }
+        Py_DECREF(py_pkg);
+    }
+
+    g_slist_free(pkgs);
+    return list;
+}
+
+static struct PyMethodDef mdclient_methods[] = {
+    {"find", (PyCFunction)find, METH_VARARGS, find__doc__},
+    {NULL} /* sentinel */
+};
+
+/* Object */
+
+PyTypeObject MdClient_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "createrepo_c.MdClient",        /* tp_name */
+    sizeof(_MdClientObject),        /* tp_basicsize */
+    0,                              /* tp_itemsize */
+    (destructor) mdclient_dealloc,  /* tp_dealloc */
+    0,                              /* tp_print */
+    0,                              /* tp_getattr */
+    0,                              /* tp_setattr */
+    0,                              /* tp_compare */
+    (reprfunc) mdclient_repr,       /* tp_repr */
+    0,                              /* tp_as_number */
+    0,                              /* tp_as_sequence */
+    0,                              /* tp_as_mapping */
+    0,                              /* tp_hash */
+    0,                              /* tp_call */
+    0,                              /* tp_str */
+    0,                              /* tp_getattro */
+    0,                              /* tp_setattro */
+    0,                              /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT|Py_TPFLAGS_BASETYPE, /* tp_flags */
+    mdclient_init__doc__,           /* tp_doc */
+    0,                              /* tp_traverse */
+    0,                              /* tp_clear */
+    0,                              /* tp_richcompare */
+    0,                              /* tp_weaklistoffset */
+    0,                              /* tp_iter */
+    0,                              /* tp_iternext */
+    mdclient_methods,               /* tp_methods */
+    0,                              /* tp_members */
+    0,                              /* tp_getset */
+    0,                              /* tp_base */
+    0,                              /* tp_dict */
+    0,                              /* tp_descr_get */
+    0,                              /* tp_descr_set */
+    0,                              /* tp_dictoffset */
+    (initproc) mdclient_init,       /* tp_init */
+    0,                              /* tp_alloc */
+    mdclient_new,                   /* tp_new */
+    0,                              /* tp_free */
+    0,                              /* tp_is_gc */
+};
@@ -0,0 +1,246 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2014  Tomas Mlcoch
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <Python.h>
+#include <assert.h>
+#include <stddef.h>
+
+#include "pkg_iterator-py.h"
+#include "package-py.h"
+#include "exception-py.h"
+#include "typeconversion.h"
+
+typedef struct {
+    PyObject_HEAD
+    cr_PkgIterator *iter;
+    PyObject *py_warningcb;
+    int running;    /*!< next() is in progress (without the GIL) */
+} _PkgIteratorObject;
+
+static int
+check_PkgIteratorStatus(const _PkgIteratorObject *self)
+{
+    assert(self != NULL);
+    assert(PkgIteratorObject_Check(self));
+    if (self->iter == NULL) {
+        PyErr_SetString(CrErr_Exception, "Improper createrepo_c PkgIterator object.");
+        return -1;
+    }
+    return 0;
+}
+
+/* The parsing runs without the GIL, the callback has to acquire it */
+static int
+c_warningcb(cr_XmlParserWarningType type,
+            char *msg,
+            void *cbdata,
+            GError **err)
+{
+    PyObject *arglist, *result;
+    PyGILState_STATE gstate;
+    _PkgIteratorObject *self = cbdata;
+    int ret = CR_CB_RET_OK;
+
+    gstate = PyGILState_Ensure();
+
+    arglist = Py_BuildValue("(is)", type, msg);
+    result = PyObject_CallObject(self->py_warningcb, arglist);
+    Py_DECREF(arglist);
+
+    if (result == NULL) {
+        // Exception raised
+        PyErr_ToGError(err);
+        ret = CR_CB_RET_ERR;
+    } else {
+        Py_DECREF(result);
+    }
+
+    PyGILState_Release(gstate);
+    return ret;
+}
+
+/* Function on the type */
+
+static PyObject *
+pkg_iterator_new(PyTypeObject *type,
+                 G_GNUC_UNUSED PyObject *args,
+                 G_GNUC_UNUSED PyObject *kwds)
+{
+    _PkgIteratorObject *self = (_PkgIteratorObject *)type->tp_alloc(type, 0);
+    if (self) {
+        self->iter = NULL;
+        self->py_warningcb = NULL;
+        self->running = 0;
+    }
+    return (PyObject *)self;
+}
+
+PyDoc_STRVAR(pkg_iterator_init__doc__,
+"PkgIterator object which parses primary, filelists and other xml files\n"
+"in small chunks and yields complete packages one by one.\n"
+"Packages must be in the same order in all the files.\n\n"
+".. method:: __init__(primary_path, filelists_path, other_path, warningcb)\n\n"
+"    :arg primary_path: Path to the primary.xml\n"
+"    :arg filelists_path: Path to the filelists.xml or None\n"
+"    :arg other_path: Path to the other.xml or None\n"
+"    :arg warningcb: Callable or None\n");
+
+static int
+pkg_iterator_init(_PkgIteratorObject *self,
+                  PyObject *args,
+                  G_GNUC_UNUSED PyObject *kwds)
+{
+    char *primary_path, *filelists_path, *other_path;
+    PyObject *py_warningcb;
+    cr_XmlParserWarningCb warningcb = NULL;
+    GError *tmp_err = NULL;
+
+    if (!PyArg_ParseTuple(args, "szzO:pkg_iterator_init", &primary_path,
+                          &filelists_path, &other_path, &py_warningcb))
+        return -1;
+
+    if (!PyCallable_Check(py_warningcb) && py_warningcb != Py_None) {
+        PyErr_SetString(PyExc_TypeError, "warningcb must be callable or None");
+        return -1;
+    }
+
+    if (self->running) {
+        PyErr_SetString(PyExc_ValueError, "generator already executing");
+        return -1;
+    }
+
+    /* Free all previous resources when reinitialization */
+    if (self->iter) {
+        cr_pkg_iterator_free(self->iter);
+        self->iter = NULL;
+    }
+    Py_CLEAR(self->py_warningcb);
+
+    if (py_warningcb != Py_None) {
+        Py_INCREF(py_warningcb);
+        self->py_warningcb = py_warningcb;
+        warningcb = c_warningcb;
+    }
+
+    /* Init */
+    self->iter = cr_pkg_iterator_new(primary_path, filelists_path, other_path,
+                                     warningcb, self, &tmp_err);
+    if (tmp_err) {
+        nice_exception(&tmp_err, "PkgIterator init failed: ");
+        return -1;
+    }
+
+    return 0;
+}
+
+static void
+pkg_iterator_dealloc(_PkgIteratorObject *self)
+{
+    if (self->iter)
+        cr_pkg_iterator_free(self->iter);
+    Py_XDECREF(self->py_warningcb);
+    Py_TYPE(self)->tp_free(self);
+}
+
+static PyObject *
+pkg_iterator_repr(G_GNUC_UNUSED _PkgIteratorObject *self)
+{
+    return PyUnicode_FromFormat("<createrepo_c.PkgIterator object>");
+}
+
+static PyObject *
+pkg_iterator_iternext(_PkgIteratorObject *self)
+{
+    cr_Package *pkg;
+    GError *tmp_err = NULL;
+
+    if (check_PkgIteratorStatus(self))
+        return NULL;
+
+    // The parser state is not thread safe, the flag is checked and set
+    // with the GIL held (like CPython generators do)
+    if (self->running) {
+        PyErr_SetString(PyExc_ValueError, "generator already executing");
+        return NULL;
+    }
+    self->running = 1;
+
+    Py_BEGIN_ALLOW_THREADS
+    pkg = cr_pkg_iterator_next(self->iter, &tmp_err);
+    Py_END_ALLOW_THREADS
+
+    self->running = 0;
+
+    if (tmp_err) {
+        nice_exception(&tmp_err, NULL);
+        return NULL;
+    }
+
+    if (!pkg) {
+        // No more packages - StopIteration
+        return NULL;
+    }
+
+    return Object_FromPackage(pkg, 1);
+}
+
+/* Object */
+
+PyTypeObject PkgIterator_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "createrepo_c.PkgIterator",     /* tp_name */
+    sizeof(_PkgIteratorObject),     /* tp_basicsize */
+    0,                              /* tp_itemsize */
+    (destructor) pkg_iterator_dealloc, /* tp_dealloc */
+    0,                              /* tp_print */
+    0,                              /* tp_getattr */
+    0,                              /* tp_setattr */
+    0,                              /* tp_compare */
+    (reprfunc) pkg_iterator_repr,   /* tp_repr */
+    0,                              /* tp_as_number */
+    0,                              /* tp_as_sequence */
+    0,                              /* tp_as_mapping */
+    0,                              /* tp_hash */
+    0,                              /* tp_call */
+    0,                              /* tp_str */
+    0,                              /* tp_getattro */
+    0,                              /* tp_setattro */
+    0,                              /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT|Py_TPFLAGS_BASETYPE, /* tp_flags */
+    pkg_iterator_init__doc__,       /* tp_doc */
+    0,                              /* tp_traverse */
+    0,                              /* tp_clear */
+    0,                              /* tp_richcompare */
+    0,                              /* tp_weaklistoffset */
+    PyObject_SelfIter,              /* tp_iter */
+    (iternextfunc) pkg_iterator_iternext, /* tp_iternext */
+    0,                              /* tp_methods */
+    0,                              /* tp_members */
+    0,                              /* tp_getset */
+    0,                              /* tp_base */
+    0,                              /* tp_dict */
+    0,                              /* tp_descr_get */
+    0,                              /* tp_descr_set */
+    0,                              /* tp_dictoffset */
+    (initproc) pkg_iterator_init,   /* tp_init */
+    0,                              /* tp_alloc */
+    pkg_iterator_new,               /* tp_new */
+    0,                              /* tp_free */
+    0,                              /* tp_is_gc */
+};
@@ -0,0 +1,145 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2013  Tomas Mlcoch
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <Python.h>
+#include <assert.h>
+#include <stddef.h>
+
+#include "src/createrepo_c.h"
+
+#include "repodiff-py.h"
+#include "typeconversion.h"
+#include "exception-py.h"
+
+typedef struct {
+    PyObject *py_diffcb;
+    PyObject *list;         /*!< Collected differences if no callback */
+} CbData;
+
+static PyObject *
+PyObject_FromRepodiffPackage(const cr_RepodiffPackage *pkg)
+{
+    if (!pkg)
+        Py_RETURN_NONE;
+
+    return Py_BuildValue("(sssssss)",
+                         pkg->pkgId,
+                         pkg->name,
+                         pkg->arch,
+                         pkg->epoch,
+                         pkg->version,
+                         pkg->release,
+                         pkg->location_href);
+}
+
+static int
+c_diffcb(cr_RepodiffType type,
+         const cr_RepodiffPackage *old_pkg,
+         const cr_RepodiffPackage *new_pkg,
+         void *cbdata,
+         GError **err)
+{
+    PyObject *arglist, *result;
+    CbData *data = cbdata;
+
+    arglist = Py_BuildValue("(iNN)",
+                            type,
+                            PyObject_FromRepodiffPackage(old_pkg),
+                            PyObject_FromRepodiffPackage(new_pkg));
+    if (arglist == NULL) {
+        PyErr_ToGError(err);
+        return CR_CB_RET_ERR;
+    }
+
+    if (data->list) {
+        int ret = PyList_Append(data->list, arglist);
+        Py_DECREF(arglist);
+        if (ret == -1) {
+            PyErr_ToGError(err);
+            return CR_CB_RET_ERR;
+        }
+        return CR_CB_RET_OK;
+    }
+
+    result = PyObject_CallObject(data->py_diffcb, arglist);
+    Py_DECREF(arglist);
+
+    if (result == NULL) {
+        // Exception raised
+        PyErr_ToGError(err);
+        return CR_CB_RET_ERR;
+    }
+
+    Py_DECREF(result);
+    return CR_CB_RET_OK;
+}
+
+PyObject *
+py_repodiff(G_GNUC_UNUSED PyObject *self, PyObject *args)
+{
+    char *old_path, *new_path;
+    int primary;
+    PyObject *py_diffcb;
+    CbData cbdata;
+    GError *tmp_err = NULL;
+
+    if (!PyArg_ParseTuple(args, "ssOi:py_repodiff",
+                                         &old_path,
+                                         &new_path,
+                                         &py_diffcb,
+                                         &primary)) {
+        return NULL;
+    }
+
+    if (!PyCallable_Check(py_diffcb) && py_diffcb != Py_None) {
+        PyErr_SetString(PyExc_TypeError, "diffcb must be callable or None");
+        return NULL;
+    }
+
+    cbdata.py_diffcb = py_diffcb;
+    cbdata.list      = NULL;
+
+    if (py_diffcb == Py_None) {
+        cbdata.list = PyList_New(0);
+        if (!cbdata.list)
+            return NULL;
+    }
+
+    Py_XINCREF(py_diffcb);
+
+    if (primary)
+        cr_repodiff_primary(old_path, new_path, c_diffcb, &cbdata,
+                            NULL, &tmp_err);
+    else
+        cr_repodiff(old_path, new_path, c_diffcb, &cbdata,
+                    NULL, &tmp_err);
+
+    Py_XDECREF(py_diffcb);
+
+    if (tmp_err) {
+        Py_XDECREF(cbdata.list);
+        nice_exception(&tmp_err, NULL);
+        return NULL;
+    }
+
+    if (cbdata.list)
+        return cbdata.list;
+
+    Py_RETURN_NONE;
+}
@@ -0,0 +1,35 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2013  Tomas Mlcoch
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef CR_REPODIFF_PY_H
+#define CR_REPODIFF_PY_H
+
+#include "src/createrepo_c.h"
+
+PyDoc_STRVAR(repodiff__doc__,
+"repodiff(old, new, diffcb, primary) -> list or None\n\n"
+"Compare packages of two repositories (or two primary.xml files if "
+"primary is True). diffcb(type, old_pkg, new_pkg) is called for every "
+"difference, packages are tuples (pkgId, name, arch, epoch, version, "
+"release, location_href) or None. If diffcb is None, list of "
+"(type, old_pkg, new_pkg) tuples is returned");
+
+PyObject *py_repodiff(PyObject *self, PyObject *args);
+
+#endif
@@ -146,11 +146,126 @@ xml_dump(_UpdateInfoObject *self, G_GNUC_UNUSED void *nothing)
     return py_str;
 }
 
+/** Convert a list of records to a Python list of UpdateRecords (copies).
+ * The GSList is freed.
+ */
+static PyObject *
+records_to_pylist(GSList *records)
+{
+    PyObject *list;
+
+    if ((list = PyList_New(0)) == NULL) {
+        g_slist_free(records);
+        return NULL;
+    }
+
+    for (GSList *elem = records; elem; elem = g_slist_next(elem)) {
+        PyObject *obj = Object_FromUpdateRecord(cr_updaterecord_copy(elem->data));
+        if (!obj) continue;
+        PyList_Append(list, obj);
+        Py_DECREF(obj);
+    }
+
+    g_slist_free(records);
+    return list;
+}
+
+PyDoc_STRVAR(build_index__doc__,
+"build_index() -> None\n\n"
+"Build the lookup index used by the get_by_* methods. The index is\n"
+"built automatically by the first lookup.");
+
+static PyObject *
+build_index(_UpdateInfoObject *self, G_GNUC_UNUSED void *nothing)
+{
+    if (check_UpdateInfoStatus(self))
+        return NULL;
+    cr_updateinfo_build_index(self->updateinfo);
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(get_by_id__doc__,
+"get_by_id(id) -> UpdateRecord or None\n\n"
+"Return the update with the advisory id");
+
+static PyObject *
+get_by_id(_UpdateInfoObject *self, PyObject *args)
+{
+    char *id;
+    cr_UpdateRecord *rec;
+
+    if (!PyArg_ParseTuple(args, "s:get_by_id", &id))
+        return NULL;
+    if (check_UpdateInfoStatus(self))
+        return NULL;
+
+    rec = cr_updateinfo_get_by_id(self->updateinfo, id);
+    if (!rec)
+        Py_RETURN_NONE;
+    return Object_FromUpdateRecord(cr_updaterecord_copy(rec));
+}
+
+PyDoc_STRVAR(get_by_package__doc__,
+"get_by_package(name[, epoch=None, version=None, release=None, arch=None])"
+" -> list\n\n"
+"Return updates which contain the package. If only the name is\n"
+"specified, updates with any version of the package are returned.");
+
+static PyObject *
+get_by_package(_UpdateInfoObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *kwlist[] = { "name", "epoch", "version", "release",
+                              "arch", NULL };
+
+    char *name = NULL, *epoch = NULL, *version = NULL;
+    char *release = NULL, *arch = NULL;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|zzzz:get_by_package",
+                                     kwlist, &name, &epoch, &version,
+                                     &release, &arch))
+        return NULL;
+    if (check_UpdateInfoStatus(self))
+        return NULL;
+
+    return records_to_pylist(cr_updateinfo_get_by_package(self->updateinfo,
+                                                          name, epoch,
+                                                          version, release,
+                                                          arch));
+}
+
+PyDoc_STRVAR(get_by_issued_date__doc__,
+"get_by_issued_date([from=None, to=None]) -> list\n\n"
+"Return updates issued in the [from, to) range sorted by the issued\n"
+"date. Dates are strings like \"2013-12-02 00:00:00\" or its prefix.");
+
+static PyObject *
+get_by_issued_date(_UpdateInfoObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *kwlist[] = { "from", "to", NULL };
+
+    char *from = NULL, *to = NULL;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|zz:get_by_issued_date",
+                                     kwlist, &from, &to))
+        return NULL;
+    if (check_UpdateInfoStatus(self))
+        return NULL;
+
+    return records_to_pylist(cr_updateinfo_get_by_issued_date(self->updateinfo,
+                                                              from, to));
+}
+
 static struct PyMethodDef updateinfo_methods[] = {
     {"append", (PyCFunction)append, METH_VARARGS,
         append__doc__},
     {"xml_dump", (PyCFunction)xml_dump, METH_NOARGS,
         xml_dump__doc__},
+    {"build_index", (PyCFunction)build_index, METH_NOARGS,
+        build_index__doc__},
+    {"get_by_id", (PyCFunction)get_by_id, METH_VARARGS,
+        get_by_id__doc__},
+    {"get_by_package", (PyCFunction)get_by_package,
+        METH_VARARGS|METH_KEYWORDS, get_by_package__doc__},
+    {"get_by_issued_date", (PyCFunction)get_by_issued_date,
+        METH_VARARGS|METH_KEYWORDS, get_by_issued_date__doc__},
     {NULL} /* sentinel */
 };
 
@@ -0,0 +1,385 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2013  Tomas Mlcoch
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <glib.h>
+#include <assert.h>
+#include <string.h>
+#include "error.h"
+#include "locate_metadata.h"
+#include "package.h"
+#include "repodiff.h"
+#include "xml_parser.h"
+
+#define ERR_DOMAIN              CREATEREPO_C_ERROR
+#define STRINGCHUNK_SIZE        (64*1024)
+
+/** Keys of all packages from one primary.xml
+ */
+typedef struct {
+    const char *path;
+    GStringChunk *chunk;    /*!< Storage of all strings of the records */
+    GArray *pkgs;           /*!< cr_RepodiffPackage records */
+    int ret;
+    GError *err;
+} RepodiffSide;
+
+static inline const char *
+chunk_insert(GStringChunk *chunk, const char *str)
+{
+    return g_string_chunk_insert(chunk, str ? str : "");
+}
+
+static int
+pkgcb(cr_Package *pkg, void *cbdata, G_GNUC_UNUSED GError **err)
+{
+    RepodiffSide *side = cbdata;
+    cr_RepodiffPackage rec;
+
+    rec.pkgId         = chunk_insert(side->chunk, pkg->pkgId);
+    rec.name          = chunk_insert(side->chunk, pkg->name);
+    rec.arch          = chunk_insert(side->chunk, pkg->arch);
+    rec.epoch         = chunk_insert(side->chunk, pkg->epoch);
+    rec.version       = chunk_insert(side->chunk, pkg->version);
+    rec.release       = chunk_insert(side->chunk, pkg->release);
+    rec.location_href = chunk_insert(side->chunk, pkg->location_href);
+    g_array_append_val(side->pkgs, rec);
+
+    cr_package_free(pkg);
+    return CR_CB_RET_OK;
+}
+
+static int
+cmp_nevra(const cr_RepodiffPackage *a, const cr_RepodiffPackage *b)
+{
+    int ret;
+    if ((ret = strcmp(a->name, b->name)))       return ret;
+    if ((ret = strcmp(a->arch, b->arch)))       return ret;
+    if ((ret = strcmp(a->epoch, b->epoch)))     return ret;
+    if ((ret = strcmp(a->version, b->version))) return ret;
+    return strcmp(a->release, b->release);
+}
+
+static gint
+cmp_records(gconstpointer a, gconstpointer b)
+{
+    int ret = cmp_nevra(a, b);
+    if (ret)
+        return ret;
+    // Packages with the same NEVRA are paired in a stable order
+    return strcmp(((cr_RepodiffPackage *) a)->pkgId,
+                  ((cr_RepodiffPackage *) b)->pkgId);
+}
+
+static gpointer
+parse_side(gpointer data)
+{
+    RepodiffSide *side = data;
+
+    side->ret = cr_xml_parse_primary(side->path,
+                                     NULL, NULL,
+                                     pkgcb, side,
+                                     NULL, NULL,
+                                     0,
+                                     &side->err);
+    if (side->ret == CRE_OK)
+        g_array_sort(side->pkgs, cmp_records);
+
+    return NULL;
+}
+
+static void
+side_init(RepodiffSide *side, const char *path)
+{
+    side->path  = path;
+    side->chunk = g_string_chunk_new(STRINGCHUNK_SIZE);
+    side->pkgs  = g_array_new(FALSE, FALSE, sizeof(cr_RepodiffPackage));
+    side->ret   = CRE_OK;
+    side->err   = NULL;
+}
+
+static void
+side_clear(RepodiffSide *side)
+{
+    g_string_chunk_free(side->chunk);
+    g_array_free(side->pkgs, TRUE);
+    g_clear_error(&side->err);
+}
+
+const char *
+cr_repodiff_type_to_str(cr_RepodiffType type)
+{
+    switch (type) {
+        case CR_REPODIFF_ADDED:     return "added";
+        case CR_REPODIFF_REMOVED:   return "removed";
+        case CR_REPODIFF_CHANGED:   return "changed";
+        default:                    return NULL;
+    }
+}
+
+static int
+report(cr_RepodiffType type,
+       const cr_RepodiffPackage *old_pkg,
+       const cr_RepodiffPackage *new_pkg,
+       cr_RepodiffCb cb,
+       void *cbdata,
+       cr_RepodiffStats *stats,
+       GError **err)
+{
+    GError *tmp_err = NULL;
+
+    switch (type) {
+        case CR_REPODIFF_ADDED:     stats->added++;   break;
+        case CR_REPODIFF_REMOVED:   stats->removed++; break;
+        case CR_REPODIFF_CHANGED:   stats->changed++; break;
+        default: assert(0);
+    }
+
+    if (!cb || cb(type, old_pkg, new_pkg, cbdata, &tmp_err) == CR_CB_RET_OK) {
+        assert(!tmp_err);
+        return CRE_OK;
+    }
+
+    if (tmp_err)
+        g_propagate_prefixed_error(err, tmp_err, "Diff interrupted: ");
+    else
+        g_set_error(err, ERR_DOMAIN, CRE_CBINTERRUPTED, "Diff interrupted");
+    return CRE_CBINTERRUPTED;
+}
+
+#define SIDE_PKG(side, i)   (&g_array_index((side)->pkgs, cr_RepodiffPackage, (i)))
+
+/** Compare packages with the same NEVRA (old[o..o_end), new[n..n_end)).
+ * Packages with identical pkgIds are paired first (both runs are sorted
+ * by pkgId), the remaining ones are paired in order as changed and the rest
+ * is reported as removed or added.
+ */
+static int
+diff_nevra_run(RepodiffSide *old_side, guint o, guint o_end,
+               RepodiffSide *new_side, guint n, guint n_end,
+               cr_RepodiffCb cb,
+               void *cbdata,
+               cr_RepodiffStats *stats,
+               GError **err)
+{
+    int ret = CRE_OK;
+    GPtrArray *old_rest = g_ptr_array_new();
+    GPtrArray *new_rest = g_ptr_array_new();
+
+    while (o < o_end || n < n_end) {
+        int cmp;
+
+        if (o >= o_end)
+            cmp = 1;
+        else if (n >= n_end)
+            cmp = -1;
+        else
+            cmp = strcmp(SIDE_PKG(old_side, o)->pkgId,
+                         SIDE_PKG(new_side, n)->pkgId);
+
+        if (cmp < 0) {
+            g_ptr_array_add(old_rest, SIDE_PKG(old_side, o++));
+        } else if (cmp > 0) {
+            g_ptr_array_add(new_rest, SIDE_PKG(new_side, n++));
+        } else {
+            o++;
+            n++;
+        }
+    }
+
+    for (guint x = 0;
+         ret == CRE_OK && (x < old_rest->len || x < new_rest->len);
+         x++)
+    {
+        cr_RepodiffPackage *old_pkg = NULL, *new_pkg = NULL;
+
+        if (x < old_rest->len)
+            old_pkg = g_ptr_array_index(old_rest, x);
+        if (x < new_rest->len)
+            new_pkg = g_ptr_array_index(new_rest, x);
+
+        if (old_pkg && new_pkg)
+            ret = report(CR_REPODIFF_CHANGED, old_pkg, new_pkg,
+                         cb, cbdata, stats, err);
+        else if (old_pkg)
+            ret = report(CR_REPODIFF_REMOVED, old_pkg, NULL,
+                         cb, cbdata, stats, err);
+        else
+            ret = report(CR_REPODIFF_ADDED, NULL, new_pkg,
+                         cb, cbdata, stats, err);
+    }
+
+    g_ptr_array_free(old_rest, TRUE);
+    g_ptr_array_free(new_rest, TRUE);
+
+    return ret;
+}
+
+int
+cr_repodiff_primary(const char *old_primary,
+                    const char *new_primary,
+                    cr_RepodiffCb cb,
+                    void *cbdata,
+                    cr_RepodiffStats *stats,
+                    GError **err)
+{
+    int ret = CRE_OK;
+    RepodiffSide old_side, new_side;
+    cr_RepodiffStats local_stats;
+    GThread *thread;
+
+    assert(old_primary);
+    assert(new_primary);
+    assert(!err || *err == NULL);
+
+    if (!stats)
+        stats = &local_stats;
+    memset(stats, 0, sizeof(*stats));
+
+    side_init(&old_side, old_primary);
+    side_init(&new_side, new_primary);
+
+    // Parse the old repo in a separate thread, the new one in this thread
+    thread = g_thread_new("repodiff", parse_side, &old_side);
+    parse_side(&new_side);
+    g_thread_join(thread);
+
+    if (old_side.ret != CRE_OK) {
+        ret = old_side.ret;
+        g_propagate_prefixed_error(err, old_side.err, "%s: ", old_primary);
+        old_side.err = NULL;
+        goto cleanup;
+    }
+
+    if (new_side.ret != CRE_OK) {
+        ret = new_side.ret;
+        g_propagate_prefixed_error(err, new_side.err, "%s: ", new_primary);
+        new_side.err = NULL;
+        goto cleanup;
+    }
+
+    stats->old_packages = old_side.pkgs->len;
+    stats->new_packages = new_side.pkgs->len;
+
+    // Merge join
+    guint o = 0, n = 0;
+    while (ret == CRE_OK && (o < old_side.pkgs->len || n < new_side.pkgs->len)) {
+        cr_RepodiffPackage *old_pkg = NULL, *new_pkg = NULL;
+        int cmp;
+
+        if (o < old_side.pkgs->len)
+            old_pkg = SIDE_PKG(&old_side, o);
+        if (n < new_side.pkgs->len)
+            new_pkg = SIDE_PKG(&new_side, n);
+
+        if (!new_pkg)
+            cmp = -1;
+        else if (!old_pkg)
+            cmp = 1;
+        else
+            cmp = cmp_nevra(old_pkg, new_pkg);
+
+        if (cmp < 0) {
+            ret = report(CR_REPODIFF_REMOVED, old_pkg, NULL,
+                         cb, cbdata, stats, err);
+            o++;
+        } else if (cmp > 0) {
+            ret = report(CR_REPODIFF_ADDED, NULL, new_pkg,
+                         cb, cbdata, stats, err);
+            n++;
+        } else {
+            // The NEVRA may be present more than once (rebuilds with
+            // different pkgIds) on both sides
+            guint o_end = o + 1, n_end = n + 1;
+            while (o_end < old_side.pkgs->len
+                   && !cmp_nevra(old_pkg, SIDE_PKG(&old_side, o_end)))
+                o_end++;
+            while (n_end < new_side.pkgs->len
+                   && !cmp_nevra(new_pkg, SIDE_PKG(&new_side, n_end)))
+                n_end++;
+
+            ret = diff_nevra_run(&old_side, o, o_end, &new_side, n, n_end,
+                                 cb, cbdata, stats, err);
+            o = o_end;
+            n = n_end;
+        }
+    }
+
+cleanup:
+    side_clear(&old_side);
+    side_clear(&new_side);
+
+    return ret;
+}
+
+static struct cr_MetadataLocation *
+locate_primary(const char *repo, GError **err)
+{
+    GError *tmp_err = NULL;
+    struct cr_MetadataLocation *ml;
+
+    ml = cr_locate_metadata(repo, TRUE, &tmp_err);
+    if (tmp_err) {
+        g_propagate_error(err, tmp_err);
+        return NULL;
+    }
+
+    if (!ml || !ml->pri_xml_href) {
+        g_set_error(err, ERR_DOMAIN, CRE_BADARG,
+                    "Cannot locate primary.xml of %s", repo);
+        cr_metadatalocation_free(ml);
+        return NULL;
+    }
+
+    return ml;
+}
+
+int
+cr_repodiff(const char *old_repo,
+            const char *new_repo,
+            cr_RepodiffCb cb,
+            void *cbdata,
+            cr_RepodiffStats *stats,
+            GError **err)
+{
+    int ret;
+    struct cr_MetadataLocation *old_ml, *new_ml;
+
+    assert(old_repo);
+    assert(new_repo);
+    assert(!err || *err == NULL);
+
+    old_ml = locate_primary(old_repo, err);
+    if (!old_ml)
+        return CRE_BADARG;
+
+    new_ml = locate_primary(new_repo, err);
+    if (!new_ml) {
+        cr_metadatalocation_free(old_ml);
+        return CRE_BADARG;
+    }
+
+    ret = cr_repodiff_primary(old_ml->pri_xml_href,
+                              new_ml->pri_xml_href,
+                              cb, cbdata, stats, err);
+
+    cr_metadatalocation_free(old_ml);
+    cr_metadatalocation_free(new_ml);
+
+    return ret;
+}
@@ -0,0 +1,157 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2013  Tomas Mlcoch
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef __C_CREATEREPOLIB_REPODIFF_H__
+#define __C_CREATEREPOLIB_REPODIFF_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <glib.h>
+
+/** \defgroup   repodiff    Differences between two repositories.
+ *
+ * Both primary.xml files are parsed in parallel. Only a small key record
+ * (pkgId, NEVRA and location) is kept from every package, full package
+ * objects are freed right after they are parsed. The records of both
+ * repositories are then sorted by NEVRA and compared by a merge join.
+ * If a NEVRA is present more than once, packages with identical pkgIds
+ * are paired first and the rest is reported as changed, added or removed.
+ *
+ * Example:
+ *
+ * \code
+ * static int
+ * diffcb(cr_RepodiffType type,
+ *        const cr_RepodiffPackage *old_pkg,
+ *        const cr_RepodiffPackage *new_pkg,
+ *        void *cbdata,
+ *        GError **err)
+ * {
+ *     const cr_RepodiffPackage *pkg = new_pkg ? new_pkg : old_pkg;
+ *     printf("%s %s\n", cr_repodiff_type_to_str(type), pkg->name);
+ *     return CR_CB_RET_OK;
+ * }
+ *
+ * cr_repodiff("old_repo/", "new_repo/", diffcb, NULL, NULL);
+ * \endcode
+ *
+ *  \addtogroup repodiff
+ *  @{
+ */
+
+/** Type of a difference.
+ */
+typedef enum {
+    CR_REPODIFF_ADDED,      /*!< NEVRA is only in the new repo */
+    CR_REPODIFF_REMOVED,    /*!< NEVRA is only in the old repo */
+    CR_REPODIFF_CHANGED,    /*!< NEVRA is in both repos with different
+                                 pkgId (the package was rebuilt) */
+    CR_REPODIFF_SENTINEL,
+} cr_RepodiffType;
+
+/** Key attributes of a package compared by the diff.
+ */
+typedef struct {
+    const char *pkgId;
+    const char *name;
+    const char *arch;
+    const char *epoch;
+    const char *version;
+    const char *release;
+    const char *location_href;
+} cr_RepodiffPackage;
+
+/** Counts of the found differences.
+ */
+typedef struct {
+    gint64 old_packages;    /*!< Number of packages in the old repo */
+    gint64 new_packages;    /*!< Number of packages in the new repo */
+    gint64 added;
+    gint64 removed;
+    gint64 changed;
+} cr_RepodiffStats;
+
+/** Callback called for every difference. Packages are reported
+ * in NEVRA order.
+ * @param type      Type of the difference
+ * @param old_pkg   Package from the old repo or NULL if type is
+ *                  CR_REPODIFF_ADDED
+ * @param new_pkg   Package from the new repo or NULL if type is
+ *                  CR_REPODIFF_REMOVED
+ * @param cbdata    User data
+ * @param err       GError **
+ * @return          CR_CB_RET_OK (0) or CR_CB_RET_ERR (1) - stops the diff
+ */
+typedef int (*cr_RepodiffCb)(cr_RepodiffType type,
+                             const cr_RepodiffPackage *old_pkg,
+                             const cr_RepodiffPackage *new_pkg,
+                             void *cbdata,
+                             GError **err);
+
+/** Return string representation of the difference type.
+ * @param type      Type of the difference
+ * @return          "added", "removed", "changed" or NULL
+ */
+const char *
+cr_repodiff_type_to_str(cr_RepodiffType type);
+
+/** Compare two primary.xml files. Files could be compressed.
+ * @param old_primary   Path to the old primary.xml
+ * @param new_primary   Path to the new primary.xml
+ * @param cb            Callback called for every difference or NULL
+ * @param cbdata        User data for the callback
+ * @param stats         Filled counts of the differences or NULL
+ * @param err           GError **
+ * @return              cr_Error code
+ */
+int
+cr_repodiff_primary(const char *old_primary,
+                    const char *new_primary,
+                    cr_RepodiffCb cb,
+                    void *cbdata,
+                    cr_RepodiffStats *stats,
+                    GError **err);
+
+/** Locate primary.xml files of two repositories via their repomd.xml
+ * and compare them. See cr_repodiff_primary().
+ * @param old_repo      Path or URL of the old repository
+ * @param new_repo      Path or URL of the new repository
+ * @param cb            Callback called for every difference or NULL
+ * @param cbdata        User data for the callback
+ * @param stats         Filled counts of the differences or NULL
+ * @param err           GError **
+ * @return              cr_Error code
+ */
+int
+cr_repodiff(const char *old_repo,
+            const char *new_repo,
+            cr_RepodiffCb cb,
+            void *cbdata,
+            cr_RepodiffStats *stats,
+            GError **err);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __C_CREATEREPOLIB_REPODIFF_H__ */
@@ -0,0 +1,174 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2013  Tomas Mlcoch
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "error.h"
+#include "cleanup.h"
+#include "createrepo_shared.h"
+#include "version.h"
+#include "misc.h"
+#include "repodiff.h"
+#include "xml_parser.h"
+
+/**
+ * Command line options
+ */
+typedef struct {
+    gboolean version;           /*!< print program version */
+    gboolean quiet;             /*!< quiet mode */
+    gboolean verbose;           /*!< verbose mode */
+    gboolean primary;           /*!< arguments are primary.xml files */
+    gboolean simple;            /*!< print only names of the packages */
+    gboolean no_summary;        /*!< do not print the summary */
+} RepodiffCmdOptions;
+
+static gboolean
+parse_repodiff_arguments(int *argc,
+                         char ***argv,
+                         RepodiffCmdOptions *options,
+                         GError **err)
+{
+    const GOptionEntry cmd_entries[] = {
+
+        { "version", 'V', 0, G_OPTION_ARG_NONE, &(options->version),
+          "Show program's version number and exit.", NULL},
+        { "quiet", 'q', 0, G_OPTION_ARG_NONE, &(options->quiet),
+          "Run quietly.", NULL },
+        { "verbose", 'v', 0, G_OPTION_ARG_NONE, &(options->verbose),
+          "Run verbosely.", NULL },
+        { "primary", 'p', 0, G_OPTION_ARG_NONE, &(options->primary),
+          "Arguments are paths to primary.xml files instead of "
+          "repositories.", NULL },
+        { "simple", 's', 0, G_OPTION_ARG_NONE, &(options->simple),
+          "Print only NEVRAs of the packages, one per line, prefixed "
+          "with '+' (added), '-' (removed) or '~' (changed).", NULL },
+        { "no-summary", '\0', 0, G_OPTION_ARG_NONE, &(options->no_summary),
+          "Do not print the summary.", NULL },
+        { NULL },
+    };
+
+    GOptionContext *context;
+    context = g_option_context_new("<old_repo> <new_repo>");
+    g_option_context_set_summary(context, "Compare packages of two repositories.");
+    g_option_context_add_main_entries(context, cmd_entries, NULL);
+    gboolean ret = g_option_context_parse(context, argc, argv, err);
+    g_option_context_free(context);
+    return ret;
+}
+
+static void
+print_nevra(const cr_RepodiffPackage *pkg)
+{
+    if (pkg->epoch[0] && strcmp(pkg->epoch, "0"))
+        printf("%s-%s:%s-%s.%s", pkg->name, pkg->epoch,
+               pkg->version, pkg->release, pkg->arch);
+    else
+        printf("%s-%s-%s.%s", pkg->name,
+               pkg->version, pkg->release, pkg->arch);
+}
+
+static int
+diffcb(cr_RepodiffType type,
+       const cr_RepodiffPackage *old_pkg,
+       const cr_RepodiffPackage *new_pkg,
+       void *cbdata,
+       G_GNUC_UNUSED GError **err)
+{
+    RepodiffCmdOptions *options = cbdata;
+    const cr_RepodiffPackage *pkg = new_pkg ? new_pkg : old_pkg;
+
+    if (options->simple) {
+        switch (type) {
+            case CR_REPODIFF_ADDED:     printf("+"); break;
+            case CR_REPODIFF_REMOVED:   printf("-"); break;
+            default:                    printf("~"); break;
+        }
+        print_nevra(pkg);
+        printf("\n");
+        return CR_CB_RET_OK;
+    }
+
+    printf("%-8s ", cr_repodiff_type_to_str(type));
+    print_nevra(pkg);
+    if (type == CR_REPODIFF_CHANGED)
+        printf(" (%s -> %s)", old_pkg->pkgId, new_pkg->pkgId);
+    else
+        printf(" (%s)", pkg->location_href);
+    printf("\n");
+
+    return CR_CB_RET_OK;
+}
+
+int
+main(int argc, char **argv)
+{
+    int ret;
+    RepodiffCmdOptions options = { 0 };
+    cr_RepodiffStats stats;
+    _cleanup_error_free_ GError *tmp_err = NULL;
+
+    // Parse arguments
+    if (!parse_repodiff_arguments(&argc, &argv, &options, &tmp_err)) {
+        g_printerr("%s\n", tmp_err->message);
+        exit(EXIT_FAILURE);
+    }
+
+    // Set logging
+    cr_setup_logging(options.quiet, options.verbose);
+
+    // Print version if required
+    if (options.version) {
+        printf("Version: %s\n", cr_version_string_with_features());
+        exit(EXIT_SUCCESS);
+    }
+
+    if (argc != 3) {
+        g_printerr("Must specify exactly two repositories to compare\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Emit debug message with version
+    g_debug("Version: %s", cr_version_string_with_features());
+
+    if (options.primary)
+        ret = cr_repodiff_primary(argv[1], argv[2], diffcb, &options,
+                                  &stats, &tmp_err);
+    else
+        ret = cr_repodiff(argv[1], argv[2], diffcb, &options,
+                          &stats, &tmp_err);
+
+    if (ret != CRE_OK) {
+        g_printerr("%s\n", tmp_err->message);
+        exit(EXIT_FAILURE);
+    }
+
+    if (!options.simple && !options.no_summary && !options.quiet) {
+        printf("\nSummary:\n");
+        printf("Packages in old repo: %"G_GINT64_FORMAT"\n", stats.old_packages);
+        printf("Packages in new repo: %"G_GINT64_FORMAT"\n", stats.new_packages);
+        printf("Added:                %"G_GINT64_FORMAT"\n", stats.added);
+        printf("Removed:              %"G_GINT64_FORMAT"\n", stats.removed);
+        printf("Changed:              %"G_GINT64_FORMAT"\n", stats.changed);
+    }
+
+    exit(EXIT_SUCCESS);
+}
@@ -407,13 +407,21 @@ cr_repomd_record_compress_and_fill(cr_RepomdRecord *record,
     if (record_compression == CR_CW_ZCK_COMPRESSION)
         mode = CR_CW_AUTO_DETECT_COMPRESSION;
 
-    cw_plain = cr_open(path,
-                       CR_CW_MODE_READ,
-                       mode,
-                       &tmp_err);
+    // If the plain file is read as is, its checksum is calculated
+    // during the compression and the file doesn't have to be read again
+    cr_ContentStat *plain_stat = NULL;
+    if (mode == CR_CW_NO_COMPRESSION)
+        plain_stat = cr_contentstat_new(checksum_type, NULL);
+
+    cw_plain = cr_sopen(path,
+                        CR_CW_MODE_READ,
+                        mode,
+                        plain_stat,
+                        &tmp_err);
     if (!cw_plain) {
         ret = tmp_err->code;
         g_propagate_prefixed_error(err, tmp_err, "Cannot open %s: ", path);
+        cr_contentstat_free(plain_stat, NULL);
         return ret;
     }
 
@@ -434,6 +442,8 @@ cr_repomd_record_compress_and_fill(cr_RepomdRecord *record,
                                              &dict_size, &tmp_err)) {
             ret = tmp_err->code;
             g_propagate_prefixed_error(err, tmp_err, "Error reading zchunk dict %s:", dict_file);
+            cr_close(cw_plain, NULL);
+            cr_contentstat_free(plain_stat, NULL);
             return ret;
         }
     }
@@ -447,6 +457,8 @@ cr_repomd_record_compress_and_fill(cr_RepomdRecord *record,
     if (!cw_compressed) {
         ret = tmp_err->code;
         g_propagate_prefixed_error(err, tmp_err, "Cannot open %s: ", cpath);
+        cr_close(cw_plain, NULL);
+        cr_contentstat_free(plain_stat, NULL);
         return ret;
     }
 
@@ -454,11 +466,15 @@ cr_repomd_record_compress_and_fill(cr_RepomdRecord *record,
         if (dict && cr_set_dict(cw_compressed, dict, dict_size, &tmp_err) != CRE_OK) {
             ret = tmp_err->code;
             g_propagate_prefixed_error(err, tmp_err, "Unable to set zdict for %s: ", cpath);
-            return ret;
-        }
-        if (cr_set_autochunk(cw_compressed, TRUE, &tmp_err) != CRE_OK) {
+        } else if (cr_set_autochunk(cw_compressed, TRUE, &tmp_err) != CRE_OK) {
             ret = tmp_err->code;
             g_propagate_prefixed_error(err, tmp_err, "Unable to set auto-chunking for %s: ", cpath);
+        }
+
+        if (ret != CRE_OK) {
+            cr_close(cw_compressed, NULL);
+            cr_close(cw_plain, NULL);
+            cr_contentstat_free(plain_stat, NULL);
             return ret;
         }
     }
@@ -471,8 +487,15 @@ cr_repomd_record_compress_and_fill(cr_RepomdRecord *record,
 
     cr_close(cw_plain, NULL);
 
+    if (plain_stat) {
+        checksum = plain_stat->checksum;
+        plain_stat->checksum = NULL;
+        cr_contentstat_free(plain_stat, NULL);
+    }
+
     if (tmp_err) {
         ret = tmp_err->code;
+        g_free(checksum);
         cr_close(cw_compressed, NULL);
         g_debug("%s: Error while repomd record compression: %s", __func__,
                 tmp_err->message);
@@ -486,17 +509,19 @@ cr_repomd_record_compress_and_fill(cr_RepomdRecord *record,
         ret = tmp_err->code;
         g_propagate_prefixed_error(err, tmp_err,
                 "Error while closing %s: ", path);
-        return ret;
+        goto end;
     }
 
     // Compute checksums
 
-    checksum  = cr_checksum_file(path, checksum_type, &tmp_err);
     if (!checksum) {
-        ret = tmp_err->code;
-        g_propagate_prefixed_error(err, tmp_err,
-                                   "Error while checksum calculation:");
-        goto end;
+        checksum = cr_checksum_file(path, checksum_type, &tmp_err);
+        if (!checksum) {
+            ret = tmp_err->code;
+            g_propagate_prefixed_error(err, tmp_err,
+                                       "Error while checksum calculation:");
+            goto end;
+        }
     }
 
     cchecksum = cr_checksum_file(cpath, checksum_type, &tmp_err);
@@ -0,0 +1,863 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2014  Tomas Mlcoch
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include "snapshot.h"
+#include "checksum.h"
+#include "error.h"
+#include "misc.h"
+
+#define ERR_DOMAIN              CREATEREPO_C_ERROR
+#define SNAPSHOT_MAGIC          "CRSNAP\r\n"
+#define SNAPSHOT_ALIGN          8
+#define STR_NONE                G_MAXUINT32
+#define STRINGCHUNK_SIZE        16384
+
+/* On-disk structures
+ * All members are little endian and naturally aligned. */
+
+typedef enum {
+    SEC_STRINGS,
+    SEC_PACKAGES,
+    SEC_DEPS,
+    SEC_FILES,
+    SEC_CHANGELOGS,
+    SEC_IDX_PKGID,
+    SEC_IDX_NAME,
+    SEC_IDX_FILENAME,
+    SEC_COUNT,
+} SnapSection;
+
+typedef enum {
+    S_PKGID,
+    S_NAME,
+    S_ARCH,
+    S_VERSION,
+    S_EPOCH,
+    S_RELEASE,
+    S_SUMMARY,
+    S_DESCRIPTION,
+    S_URL,
+    S_LICENSE,
+    S_VENDOR,
+    S_GROUP,
+    S_BUILDHOST,
+    S_SOURCERPM,
+    S_PACKAGER,
+    S_LOCATION_HREF,
+    S_LOCATION_BASE,
+    S_CHECKSUM_TYPE,
+    S_COUNT,
+} SnapString;
+
+typedef enum {
+    D_REQUIRES,
+    D_PROVIDES,
+    D_CONFLICTS,
+    D_OBSOLETES,
+    D_SUGGESTS,
+    D_ENHANCES,
+    D_RECOMMENDS,
+    D_SUPPLEMENTS,
+    D_COUNT,
+} SnapDepType;
+
+typedef struct {
+    guint64 offset;
+    guint64 size;
+} SnapSectionInfo;
+
+typedef struct {
+    char magic[8];
+    guint32 version;
+    guint32 pkg_count;
+    SnapSectionInfo sections[SEC_COUNT];
+} SnapHeader;
+
+typedef struct {
+    gint64 time_file;
+    gint64 time_build;
+    gint64 rpm_header_start;
+    gint64 rpm_header_end;
+    gint64 size_package;
+    gint64 size_installed;
+    gint64 size_archive;
+    guint32 str[S_COUNT];           // Offsets into the string table
+    guint32 deps[D_COUNT][2];       // First dependency, count
+    guint32 files[2];               // First file, count
+    guint32 changelogs[2];          // First changelog, count
+} SnapPackage;
+
+typedef struct {
+    guint32 name;
+    guint32 flags;
+    guint32 epoch;
+    guint32 version;
+    guint32 release;
+    guint32 pre;
+} SnapDependency;
+
+typedef struct {
+    guint32 type;
+    guint32 path;
+    guint32 name;
+} SnapFile;
+
+typedef struct {
+    gint64 date;
+    guint32 author;
+    guint32 changelog;
+} SnapChangelog;
+
+G_STATIC_ASSERT(sizeof(SnapHeader) == 16 + SEC_COUNT * 16);
+G_STATIC_ASSERT(sizeof(SnapPackage) == 208);
+G_STATIC_ASSERT(sizeof(SnapDependency) == 24);
+G_STATIC_ASSERT(sizeof(SnapFile) == 12);
+G_STATIC_ASSERT(sizeof(SnapChangelog) == 16);
+
+static const size_t pkg_string_offsets[S_COUNT] = {
+    [S_PKGID]           = G_STRUCT_OFFSET(cr_Package, pkgId),
+    [S_NAME]            = G_STRUCT_OFFSET(cr_Package, name),
+    [S_ARCH]            = G_STRUCT_OFFSET(cr_Package, arch),
+    [S_VERSION]         = G_STRUCT_OFFSET(cr_Package, version),
+    [S_EPOCH]           = G_STRUCT_OFFSET(cr_Package, epoch),
+    [S_RELEASE]         = G_STRUCT_OFFSET(cr_Package, release),
+    [S_SUMMARY]         = G_STRUCT_OFFSET(cr_Package, summary),
+    [S_DESCRIPTION]     = G_STRUCT_OFFSET(cr_Package, description),
+    [S_URL]             = G_STRUCT_OFFSET(cr_Package, url),
+    [S_LICENSE]         = G_STRUCT_OFFSET(cr_Package, rpm_license),
+    [S_VENDOR]          = G_STRUCT_OFFSET(cr_Package, rpm_vendor),
+    [S_GROUP]           = G_STRUCT_OFFSET(cr_Package, rpm_group),
+    [S_BUILDHOST]       = G_STRUCT_OFFSET(cr_Package, rpm_buildhost),
+    [S_SOURCERPM]       = G_STRUCT_OFFSET(cr_Package, rpm_sourcerpm),
+    [S_PACKAGER]        = G_STRUCT_OFFSET(cr_Package, rpm_packager),
+    [S_LOCATION_HREF]   = G_STRUCT_OFFSET(cr_Package, location_href),
+    [S_LOCATION_BASE]   = G_STRUCT_OFFSET(cr_Package, location_base),
+    [S_CHECKSUM_TYPE]   = G_STRUCT_OFFSET(cr_Package, checksum_type),
+};
+
+static const size_t pkg_deps_offsets[D_COUNT] = {
+    [D_REQUIRES]        = G_STRUCT_OFFSET(cr_Package, requires),
+    [D_PROVIDES]        = G_STRUCT_OFFSET(cr_Package, provides),
+    [D_CONFLICTS]       = G_STRUCT_OFFSET(cr_Package, conflicts),
+    [D_OBSOLETES]       = G_STRUCT_OFFSET(cr_Package, obsoletes),
+    [D_SUGGESTS]        = G_STRUCT_OFFSET(cr_Package, suggests),
+    [D_ENHANCES]        = G_STRUCT_OFFSET(cr_Package, enhances),
+    [D_RECOMMENDS]      = G_STRUCT_OFFSET(cr_Package, recommends),
+    [D_SUPPLEMENTS]     = G_STRUCT_OFFSET(cr_Package, supplements),
+};
+
+#define PKG_STRING(pkg, i)  G_STRUCT_MEMBER(char *, (pkg), pkg_string_offsets[i])
+#define PKG_DEPS(pkg, i)    G_STRUCT_MEMBER(GSList *, (pkg), pkg_deps_offsets[i])
+
+/** Writer */
+
+struct _cr_SnapshotWriter {
+    GString *strings;           // String table
+    GHashTable *string_offsets; // String -> offset in the string table
+    GStringChunk *chunk;        // Keys of string_offsets
+    GArray *packages;           // SnapPackage
+    GArray *deps;               // SnapDependency
+    GArray *files;              // SnapFile
+    GArray *changelogs;         // SnapChangelog
+};
+
+cr_SnapshotWriter *
+cr_snapshot_writer_new(void)
+{
+    cr_SnapshotWriter *sw = g_new0(cr_SnapshotWriter, 1);
+    sw->strings         = g_string_sized_new(STRINGCHUNK_SIZE);
+    sw->string_offsets  = g_hash_table_new(g_str_hash, g_str_equal);
+    sw->chunk           = g_string_chunk_new(STRINGCHUNK_SIZE);
+    sw->packages        = g_array_new(FALSE, FALSE, sizeof(SnapPackage));
+    sw->deps            = g_array_new(FALSE, FALSE, sizeof(SnapDependency));
+    sw->files           = g_array_new(FALSE, FALSE, sizeof(SnapFile));
+    sw->changelogs      = g_array_new(FALSE, FALSE, sizeof(SnapChangelog));
+    return sw;
+}
+
+void
+cr_snapshot_writer_free(cr_SnapshotWriter *sw)
+{
+    if (!sw)
+        return;
+
+    g_string_free(sw->strings, TRUE);
+    g_hash_table_destroy(sw->string_offsets);
+    g_string_chunk_free(sw->chunk);
+    g_array_free(sw->packages, TRUE);
+    g_array_free(sw->deps, TRUE);
+    g_array_free(sw->files, TRUE);
+    g_array_free(sw->changelogs, TRUE);
+    g_free(sw);
+}
+
+/** Get reference of the string (add it into the string table if needed).
+ */
+static guint32
+writer_string(cr_SnapshotWriter *sw, const char *str, GError **err)
+{
+    gpointer value;
+    gsize len;
+    guint32 offset;
+
+    if (!str)
+        return GUINT32_TO_LE(STR_NONE);
+
+    if (g_hash_table_lookup_extended(sw->string_offsets, str, NULL, &value))
+        return GUINT32_TO_LE(GPOINTER_TO_UINT(value));
+
+    len = strlen(str) + 1;
+    if ((guint64) sw->strings->len + len >= STR_NONE) {
+        g_set_error(err, ERR_DOMAIN, CRE_BADSNAPSHOT,
+                    "String table of the snapshot is too big");
+        return GUINT32_TO_LE(STR_NONE);
+    }
+
+    offset = sw->strings->len;
+    g_string_append_len(sw->strings, str, len);
+    g_hash_table_insert(sw->string_offsets,
+                        g_string_chunk_insert(sw->chunk, str),
+                        GUINT_TO_POINTER(offset));
+
+    return GUINT32_TO_LE(offset);
+}
+
+gboolean
+cr_snapshot_writer_add_pkg(cr_SnapshotWriter *sw,
+                           cr_Package *pkg,
+                           GError **err)
+{
+    SnapPackage rec;
+    GError *tmp_err = NULL;
+
+    assert(sw);
+    assert(pkg);
+    assert(!err || *err == NULL);
+
+    memset(&rec, 0, sizeof(rec));
+    rec.time_file           = GINT64_TO_LE(pkg->time_file);
+    rec.time_build          = GINT64_TO_LE(pkg->time_build);
+    rec.rpm_header_start    = GINT64_TO_LE(pkg->rpm_header_start);
+    rec.rpm_header_end      = GINT64_TO_LE(pkg->rpm_header_end);
+    rec.size_package        = GINT64_TO_LE(pkg->size_package);
+    rec.size_installed      = GINT64_TO_LE(pkg->size_installed);
+    rec.size_archive        = GINT64_TO_LE(pkg->size_archive);
+
+    for (int x = 0; x < S_COUNT; x++)
+        rec.str[x] = writer_string(sw, PKG_STRING(pkg, x), &tmp_err);
+
+    for (int x = 0; x < D_COUNT; x++) {
+        rec.deps[x][0] = GUINT32_TO_LE(sw->deps->len);
+        rec.deps[x][1] = GUINT32_TO_LE(g_slist_length(PKG_DEPS(pkg, x)));
+        for (GSList *elem = PKG_DEPS(pkg, x); elem; elem = g_slist_next(elem)) {
+            cr_Dependency *dep = elem->data;
+            SnapDependency srec;
+            srec.name    = writer_string(sw, dep->name, &tmp_err);
+            srec.flags   = writer_string(sw, dep->flags, &tmp_err);
+            srec.epoch   = writer_string(sw, dep->epoch, &tmp_err);
+            srec.version = writer_string(sw, dep->version, &tmp_err);
+            srec.release = writer_string(sw, dep->release, &tmp_err);
+            srec.pre     = GUINT32_TO_LE(dep->pre ? 1 : 0);
+            g_array_append_val(sw->deps, srec);
+        }
+    }
+
+    rec.files[0] = GUINT32_TO_LE(sw->files->len);
+    rec.files[1] = GUINT32_TO_LE(g_slist_length(pkg->files));
+    for (GSList *elem = pkg->files; elem; elem = g_slist_next(elem)) {
+        cr_PackageFile *file = elem->data;
+        SnapFile srec;
+        srec.type = writer_string(sw, file->type, &tmp_err);
+        srec.path = writer_string(sw, file->path, &tmp_err);
+        srec.name = writer_string(sw, file->name, &tmp_err);
+        g_array_append_val(sw->files, srec);
+    }
+
+    rec.changelogs[0] = GUINT32_TO_LE(sw->changelogs->len);
+    rec.changelogs[1] = GUINT32_TO_LE(g_slist_length(pkg->changelogs));
+    for (GSList *elem = pkg->changelogs; elem; elem = g_slist_next(elem)) {
+        cr_ChangelogEntry *entry = elem->data;
+        SnapChangelog srec;
+        srec.date      = GINT64_TO_LE(entry->date);
+        srec.author    = writer_string(sw, entry->author, &tmp_err);
+        srec.changelog = writer_string(sw, entry->changelog, &tmp_err);
+        g_array_append_val(sw->changelogs, srec);
+    }
+
+    if (tmp_err) {
+        // The string table overflowed, the writer is unusable
+        g_propagate_error(err, tmp_err);
+        return FALSE;
+    }
+
+    g_array_append_val(sw->packages, rec);
+    return TRUE;
+}
+
+typedef struct {
+    cr_SnapshotWriter *sw;
+    SnapString field;
+    gboolean basename;
+} IndexSortData;
+
+static const char *
+writer_pkg_key(IndexSortData *data, guint32 idx)
+{
+    SnapPackage *rec = &g_array_index(data->sw->packages, SnapPackage, idx);
+    guint32 ref = GUINT32_FROM_LE(rec->str[data->field]);
+    const char *str;
+
+    if (ref == STR_NONE)
+        return "";
+
+    str = data->sw->strings->str + ref;
+    return data->basename ? cr_get_filename(str) : str;
+}
+
+static gint
+index_cmp(gconstpointer a, gconstpointer b, gpointer user_data)
+{
+    IndexSortData *data = user_data;
+    guint32 ia = *((const guint32 *) a);
+    guint32 ib = *((const guint32 *) b);
+    int ret = strcmp(writer_pkg_key(data, ia), writer_pkg_key(data, ib));
+    if (ret)
+        return ret;
+    // Keep the order of the packages for equal keys
+    return (ia > ib) - (ia < ib);
+}
+
+static guint32 *
+writer_build_index(cr_SnapshotWriter *sw, SnapString field, gboolean basename)
+{
+    guint len = sw->packages->len;
+    guint32 *index = g_new(guint32, MAX(len, 1));
+    IndexSortData data = { sw, field, basename };
+
+    for (guint32 x = 0; x < len; x++)
+        index[x] = x;
+
+    g_qsort_with_data(index, len, sizeof(guint32), index_cmp, &data);
+
+    for (guint32 x = 0; x < len; x++)
+        index[x] = GUINT32_TO_LE(index[x]);
+
+    return index;
+}
+
+static gboolean
+writer_write_section(FILE *f,
+                     guint64 *pos,
+                     const SnapSectionInfo *info,
+                     const void *data,
+                     const char *path,
+                     GError **err)
+{
+    static const char zeros[SNAPSHOT_ALIGN] = {0};
+    guint64 offset = GUINT64_FROM_LE(info->offset);
+    guint64 size = GUINT64_FROM_LE(info->size);
+
+    assert(offset >= *pos && offset - *pos < SNAPSHOT_ALIGN);
+
+    if ((offset > *pos && fwrite(zeros, offset - *pos, 1, f) != 1)
+        || (size && fwrite(data, size, 1, f) != 1))
+    {
+        g_set_error(err, ERR_DOMAIN, CRE_IO,
+                    "Cannot write %s: %s", path, g_strerror(errno));
+        return FALSE;
+    }
+
+    *pos = offset + size;
+    return TRUE;
+}
+
+gboolean
+cr_snapshot_writer_write(cr_SnapshotWriter *sw,
+                         const char *path,
+                         GError **err)
+{
+    SnapHeader header;
+    const void *data[SEC_COUNT];
+    guint64 sizes[SEC_COUNT];
+    guint64 offset, pos;
+    gboolean ret = TRUE;
+    FILE *f;
+
+    assert(sw);
+    assert(path);
+    assert(!err || *err == NULL);
+
+    data[SEC_STRINGS]       = sw->strings->str;
+    sizes[SEC_STRINGS]      = sw->strings->len;
+    data[SEC_PACKAGES]      = sw->packages->data;
+    sizes[SEC_PACKAGES]     = (guint64) sw->packages->len * sizeof(SnapPackage);
+    data[SEC_DEPS]          = sw->deps->data;
+    sizes[SEC_DEPS]         = (guint64) sw->deps->len * sizeof(SnapDependency);
+    data[SEC_FILES]         = sw->files->data;
+    sizes[SEC_FILES]        = (guint64) sw->files->len * sizeof(SnapFile);
+    data[SEC_CHANGELOGS]    = sw->changelogs->data;
+    sizes[SEC_CHANGELOGS]   = (guint64) sw->changelogs->len * sizeof(SnapChangelog);
+    data[SEC_IDX_PKGID]     = writer_build_index(sw, S_PKGID, FALSE);
+    data[SEC_IDX_NAME]      = writer_build_index(sw, S_NAME, FALSE);
+    data[SEC_IDX_FILENAME]  = writer_build_index(sw, S_LOCATION_HREF, TRUE);
+    sizes[SEC_IDX_PKGID]    = (guint64) sw->packages->len * sizeof(guint32);
+    sizes[SEC_IDX_NAME]     = sizes[SEC_IDX_PKGID];
+    sizes[SEC_IDX_FILENAME] = sizes[SEC_IDX_PKGID];
+
+    // Prepare header
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version   = GUINT32_TO_LE(CR_SNAPSHOT_VERSION);
+    header.pkg_count = GUINT32_TO_LE(sw->packages->len);
+
+    offset = sizeof(header);
+    for (int x = 0; x < SEC_COUNT; x++) {
+        offset = (offset + SNAPSHOT_ALIGN - 1) & ~((guint64) SNAPSHOT_ALIGN - 1);
+        header.sections[x].offset = GUINT64_TO_LE(offset);
+        header.sections[x].size   = GUINT64_TO_LE(sizes[x]);
+        offset += sizes[x];
+    }
+
+    f = fopen(path, "wb");
+    if (!f) {
+        g_set_error(err, ERR_DOMAIN, CRE_IO,
+                    "Cannot open %s: %s", path, g_strerror(errno));
+        ret = FALSE;
+        goto cleanup;
+    }
+
+    if (fwrite(&header, sizeof(header), 1, f) != 1) {
+        g_set_error(err, ERR_DOMAIN, CRE_IO,
+                    "Cannot write %s: %s", path, g_strerror(errno));
+        ret = FALSE;
+    }
+
+    pos = sizeof(header);
+    for (int x = 0; ret && x < SEC_COUNT; x++)
+        ret = writer_write_section(f, &pos, &header.sections[x],
+                                   data[x], path, err);
+
+    if (fclose(f) != 0 && ret) {
+        g_set_error(err, ERR_DOMAIN, CRE_IO,
+                    "Cannot close %s: %s", path, g_strerror(errno));
+        ret = FALSE;
+    }
+
+    if (!ret)
+        g_remove(path);
+
+cleanup:
+    g_free((gpointer) data[SEC_IDX_PKGID]);
+    g_free((gpointer) data[SEC_IDX_NAME]);
+    g_free((gpointer) data[SEC_IDX_FILENAME]);
+
+    return ret;
+}
+
+/** Reader */
+
+struct _cr_Snapshot {
+    GMappedFile *mf;
+    guint32 pkg_count;
+    const char *strings;
+    guint64 strings_size;
+    const SnapPackage *packages;
+    const SnapDependency *deps;
+    guint64 deps_count;
+    const SnapFile *files;
+    guint64 files_count;
+    const SnapChangelog *changelogs;
+    guint64 changelogs_count;
+    const guint32 *idx_pkgid;
+    const guint32 *idx_name;
+    const guint32 *idx_filename;
+};
+
+gboolean
+cr_snapshot_verify(const char *path,
+                   const char *checksum_type,
+                   const char *checksum,
+                   GError **err)
+{
+    cr_ChecksumType type;
+    gchar *file_checksum;
+    gboolean ret;
+
+    assert(path);
+    assert(!err || *err == NULL);
+
+    if (!checksum || !checksum_type) {
+        g_set_error(err, ERR_DOMAIN, CRE_BADSNAPSHOT,
+                    "No checksum of the snapshot in repomd.xml");
+        return FALSE;
+    }
+
+    type = cr_checksum_type(checksum_type);
+    if (type == CR_CHECKSUM_UNKNOWN) {
+        g_set_error(err, ERR_DOMAIN, CRE_BADSNAPSHOT,
+                    "Unknown checksum type \"%s\" of the snapshot",
+                    checksum_type);
+        return FALSE;
+    }
+
+    file_checksum = cr_checksum_file(path, type, err);
+    if (!file_checksum)
+        return FALSE;
+
+    ret = !g_strcmp0(file_checksum, checksum);
+    if (!ret)
+        g_set_error(err, ERR_DOMAIN, CRE_BADSNAPSHOT,
+                    "Checksum mismatch (repomd.xml: %s, file: %s)",
+                    checksum, file_checksum);
+    g_free(file_checksum);
+    return ret;
+}
+
+cr_Snapshot *
+cr_snapshot_open(const char *path, GError **err)
+{
+    GError *tmp_err = NULL;
+    GMappedFile *mf;
+    const char *data;
+    gsize size;
+    SnapHeader header;
+    const void *sec[SEC_COUNT];
+    guint64 sec_size[SEC_COUNT];
+    cr_Snapshot *snap;
+
+    static const gsize record_sizes[SEC_COUNT] = {
+        [SEC_STRINGS]       = 1,
+        [SEC_PACKAGES]      = sizeof(SnapPackage),
+        [SEC_DEPS]          = sizeof(SnapDependency),
+        [SEC_FILES]         = sizeof(SnapFile),
+        [SEC_CHANGELOGS]    = sizeof(SnapChangelog),
+        [SEC_IDX_PKGID]     = sizeof(guint32),
+        [SEC_IDX_NAME]      = sizeof(guint32),
+        [SEC_IDX_FILENAME]  = sizeof(guint32),
+    };
+
+    assert(path);
+    assert(!err || *err == NULL);
+
+    mf = g_mapped_file_new(path, FALSE, &tmp_err);
+    if (!mf) {
+        g_set_error(err, ERR_DOMAIN, CRE_IO,
+                    "Cannot map %s: %s", path, tmp_err->message);
+        g_clear_error(&tmp_err);
+        return NULL;
+    }
+
+    data = g_mapped_file_get_contents(mf);
+    size = g_mapped_file_get_length(mf);
+
+    if (size < sizeof(header)) {
+        g_set_error(err, ERR_DOMAIN, CRE_BADSNAPSHOT,
+                    "%s: File is too short", path);
+        goto error;
+    }
+
+    memcpy(&header, data, sizeof(header));
+
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic))) {
+        g_set_error(err, ERR_DOMAIN, CRE_BADSNAPSHOT,
+                    "%s: Not a snapshot file", path);
+        goto error;
+    }
+
+    if (GUINT32_FROM_LE(header.version) != CR_SNAPSHOT_VERSION) {
+        g_set_error(err, ERR_DOMAIN, CRE_BADSNAPSHOT,
+                    "%s: Unsupported snapshot version %u (supported: %d)",
+                    path, GUINT32_FROM_LE(header.version),
+                    CR_SNAPSHOT_VERSION);
+        goto error;
+    }
+
+    for (int x = 0; x < SEC_COUNT; x++) {
+        guint64 offset = GUINT64_FROM_LE(header.sections[x].offset);
+        guint64 sec_len = GUINT64_FROM_LE(header.sections[x].size);
+
+        if (offset % SNAPSHOT_ALIGN
+            || offset > size
+            || sec_len > size - offset
+            || sec_len % record_sizes[x])
+        {
+            g_set_error(err, ERR_DOMAIN, CRE_BADSNAPSHOT,
+                        "%s: Section %d is corrupted", path, x);
+            goto error;
+        }
+
+        sec[x] = data + offset;
+        sec_size[x] = sec_len;
+    }
+
+    snap = g_new0(cr_Snapshot, 1);
+    snap->mf                = mf;
+    snap->pkg_count         = GUINT32_FROM_LE(header.pkg_count);
+    snap->strings           = sec[SEC_STRINGS];
+    snap->strings_size      = sec_size[SEC_STRINGS];
+    snap->packages          = sec[SEC_PACKAGES];
+    snap->deps              = sec[SEC_DEPS];
+    snap->deps_count        = sec_size[SEC_DEPS] / sizeof(SnapDependency);
+    snap->files             = sec[SEC_FILES];
+    snap->files_count       = sec_size[SEC_FILES] / sizeof(SnapFile);
+    snap->changelogs        = sec[SEC_CHANGELOGS];
+    snap->changelogs_count  = sec_size[SEC_CHANGELOGS] / sizeof(SnapChangelog);
+    snap->idx_pkgid         = sec[SEC_IDX_PKGID];
+    snap->idx_name          = sec[SEC_IDX_NAME];
+    snap->idx_filename      = sec[SEC_IDX_FILENAME];
+
+    if (sec_size[SEC_PACKAGES] != (guint64) snap->pkg_count * sizeof(SnapPackage)
+        || sec_size[SEC_IDX_PKGID] != (guint64) snap->pkg_count * sizeof(guint32)
+        || sec_size[SEC_IDX_NAME] != sec_size[SEC_IDX_PKGID]
+        || sec_size[SEC_IDX_FILENAME] != sec_size[SEC_IDX_PKGID]
+        || (snap->strings_size && snap->strings[snap->strings_size-1] != '\0'))
+    {
+        g_set_error(err, ERR_DOMAIN, CRE_BADSNAPSHOT,
+                    "%s: Inconsistent snapshot", path);
+        g_free(snap);
+        goto error;
+    }
+
+    return snap;
+
+error:
+    g_mapped_file_unref(mf);
+    return NULL;
+}
+
+void
+cr_snapshot_close(cr_Snapshot *snap)
+{
+    if (!snap)
+        return;
+
+    g_mapped_file_unref(snap->mf);
+    g_free(snap);
+}
+
+guint
+cr_snapshot_count(cr_Snapshot *snap)
+{
+    assert(snap);
+    return snap->pkg_count;
+}
+
+/** Return string referenced by the (little endian) reference.
+ */
+static inline const char *
+snap_string(cr_Snapshot *snap, guint32 ref)
+{
+    ref = GUINT32_FROM_LE(ref);
+    if (ref == STR_NONE || ref >= snap->strings_size)
+        return NULL;
+    return snap->strings + ref;
+}
+
+const char *
+cr_snapshot_package_key(cr_Snapshot *snap, guint idx, cr_HashTableKey key)
+{
+    const SnapPackage *rec;
+
+    assert(snap);
+
+    if (idx >= snap->pkg_count)
+        return NULL;
+
+    rec = &snap->packages[idx];
+
+    switch (key) {
+        case CR_HT_KEY_HASH:
+            return snap_string(snap, rec->str[S_PKGID]);
+        case CR_HT_KEY_NAME:
+            return snap_string(snap, rec->str[S_NAME]);
+        case CR_HT_KEY_FILENAME:
+            return cr_get_filename(snap_string(snap, rec->str[S_LOCATION_HREF]));
+        default:
+            return NULL;
+    }
+}
+
+GArray *
+cr_snapshot_find(cr_Snapshot *snap, cr_HashTableKey key, const char *value)
+{
+    const guint32 *index;
+    GArray *found;
+    guint low = 0, high;
+
+    assert(snap);
+    assert(value);
+
+    found = g_array_new(FALSE, FALSE, sizeof(guint));
+
+    switch (key) {
+        case CR_HT_KEY_HASH:     index = snap->idx_pkgid;    break;
+        case CR_HT_KEY_NAME:     index = snap->idx_name;     break;
+        case CR_HT_KEY_FILENAME: index = snap->idx_filename; break;
+        default:
+            return found;
+    }
+
+    // Lower bound
+    high = snap->pkg_count;
+    while (low < high) {
+        guint mid = low + (high - low) / 2;
+        const char *mkey = cr_snapshot_package_key(snap,
+                                    GUINT32_FROM_LE(index[mid]), key);
+        if (g_strcmp0(mkey ? mkey : "", value) < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    for (; low < snap->pkg_count; low++) {
+        guint idx = GUINT32_FROM_LE(index[low]);
+        if (g_strcmp0(cr_snapshot_package_key(snap, idx, key), value))
+            break;
+        g_array_append_val(found, idx);
+    }
+
+    return found;
+}
+
+/** Check that a (first, count) range fits into an array.
+ */
+static inline gboolean
+snap_range(const guint32 range[2], guint64 total)
+{
+    return (guint64) GUINT32_FROM_LE(range[0])
+           + GUINT32_FROM_LE(range[1]) <= total;
+}
+
+cr_Package *
+cr_snapshot_package(cr_Snapshot *snap,
+                    guint idx,
+                    cr_PackageLoadingFlags parts,
+                    GStringChunk *chunk)
+{
+    const SnapPackage *rec;
+    cr_Package *pkg;
+
+    assert(snap);
+
+    if (idx >= snap->pkg_count)
+        return NULL;
+
+    rec = &snap->packages[idx];
+
+    // Check ranges first
+    for (int x = 0; x < D_COUNT; x++)
+        if (!snap_range(rec->deps[x], snap->deps_count))
+            return NULL;
+    if (!snap_range(rec->files, snap->files_count)
+        || !snap_range(rec->changelogs, snap->changelogs_count))
+        return NULL;
+
+    if (chunk) {
+        pkg = cr_package_new_without_chunk();
+        pkg->chunk = chunk;
+        pkg->loadingflags |= CR_PACKAGE_SINGLE_CHUNK;
+    } else {
+        pkg = cr_package_new();
+    }
+
+    pkg->loadingflags |= CR_PACKAGE_FROM_SNAPSHOT;
+    pkg->loadingflags |= CR_PACKAGE_LOADED_PRI;
+
+    pkg->time_file          = GINT64_FROM_LE(rec->time_file);
+    pkg->time_build         = GINT64_FROM_LE(rec->time_build);
+    pkg->rpm_header_start   = GINT64_FROM_LE(rec->rpm_header_start);
+    pkg->rpm_header_end     = GINT64_FROM_LE(rec->rpm_header_end);
+    pkg->size_package       = GINT64_FROM_LE(rec->size_package);
+    pkg->size_installed     = GINT64_FROM_LE(rec->size_installed);
+    pkg->size_archive       = GINT64_FROM_LE(rec->size_archive);
+
+    for (int x = 0; x < S_COUNT; x++)
+        PKG_STRING(pkg, x) = cr_safe_string_chunk_insert(pkg->chunk,
+                                        snap_string(snap, rec->str[x]));
+
+    for (int x = 0; x < D_COUNT; x++) {
+        guint32 first = GUINT32_FROM_LE(rec->deps[x][0]);
+        guint32 count = GUINT32_FROM_LE(rec->deps[x][1]);
+        GSList *list = NULL;
+
+        for (guint32 y = first + count; y > first; y--) {
+            const SnapDependency *srec = &snap->deps[y-1];
+            cr_Dependency *dep = cr_dependency_new();
+            dep->name    = cr_safe_string_chunk_insert(pkg->chunk,
+                                        snap_string(snap, srec->name));
+            dep->flags   = cr_safe_string_chunk_insert_const(pkg->chunk,
+                                        snap_string(snap, srec->flags));
+            dep->epoch   = cr_safe_string_chunk_insert(pkg->chunk,
+                                        snap_string(snap, srec->epoch));
+            dep->version = cr_safe_string_chunk_insert(pkg->chunk,
+                                        snap_string(snap, srec->version));
+            dep->release = cr_safe_string_chunk_insert(pkg->chunk,
+                                        snap_string(snap, srec->release));
+            dep->pre     = GUINT32_FROM_LE(srec->pre) ? TRUE : FALSE;
+            list = g_slist_prepend(list, dep);
+        }
+
+        PKG_DEPS(pkg, x) = list;
+    }
+
+    if (parts & CR_PACKAGE_LOADED_FIL) {
+        guint32 first = GUINT32_FROM_LE(rec->files[0]);
+        guint32 count = GUINT32_FROM_LE(rec->files[1]);
+
+        for (guint32 y = first + count; y > first; y--) {
+            const SnapFile *srec = &snap->files[y-1];
+            cr_PackageFile *file = cr_package_file_new();
+            file->type = cr_safe_string_chunk_insert_const(pkg->chunk,
+                                        snap_string(snap, srec->type));
+            file->path = cr_safe_string_chunk_insert_const(pkg->chunk,
+                                        snap_string(snap, srec->path));
+            file->name = cr_safe_string_chunk_insert(pkg->chunk,
+                                        snap_string(snap, srec->name));
+            pkg->files = g_slist_prepend(pkg->files, file);
+        }
+
+        pkg->loadingflags |= CR_PACKAGE_LOADED_FIL;
+    }
+
+    if (parts & CR_PACKAGE_LOADED_OTH) {
+        guint32 first = GUINT32_FROM_LE(rec->changelogs[0]);
+        guint32 count = GUINT32_FROM_LE(rec->changelogs[1]);
+
+        for (guint32 y = first + count; y > first; y--) {
+            const SnapChangelog *srec = &snap->changelogs[y-1];
+            cr_ChangelogEntry *entry = cr_changelog_entry_new();
+            entry->date      = GINT64_FROM_LE(srec->date);
+            entry->author    = cr_safe_string_chunk_insert(pkg->chunk,
+                                        snap_string(snap, srec->author));
+            entry->changelog = cr_safe_string_chunk_insert(pkg->chunk,
+                                        snap_string(snap, srec->changelog));
+            pkg->changelogs = g_slist_prepend(pkg->changelogs, entry);
+        }
+
+        pkg->loadingflags |= CR_PACKAGE_LOADED_OTH;
+    }
+
+    return pkg;
+}
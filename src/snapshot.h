@@ -0,0 +1,198 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2014  Tomas Mlcoch
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef __C_CREATEREPOLIB_SNAPSHOT_H__
+#define __C_CREATEREPOLIB_SNAPSHOT_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <glib.h>
+#include "load_metadata.h"
+#include "package.h"
+
+/** \defgroup   snapshot    Binary repository snapshot.
+ *
+ * The snapshot is a compact binary form of primary, filelists and other
+ * metadata. It is designed to be memory mapped and used directly without
+ * parsing:
+ *
+ *  - header with a magic, a format version and a table of sections
+ *  - string table (every distinct string is stored only once)
+ *  - fixed-width package records which reference strings by offset
+ *    and dependencies, files and changelogs by (first, count) ranges
+ *  - dependency, file and changelog arrays
+ *  - indexes of packages sorted by pkgId, name and filename
+ *
+ * All numbers are stored in little endian.
+ *
+ * Example:
+ * \code
+ * cr_Snapshot *snap;
+ * GArray *found;
+ *
+ * snap = cr_snapshot_open("repodata/snapshot.crsnap", NULL);
+ * found = cr_snapshot_find(snap, CR_HT_KEY_NAME, "bash");
+ * for (guint x = 0; x < found->len; x++) {
+ *     guint idx = g_array_index(found, guint, x);
+ *     cr_Package *pkg = cr_snapshot_package(snap, idx,
+ *                                           CR_PACKAGE_LOADED_PRI, NULL);
+ *     // Do something
+ *     cr_package_free(pkg);
+ * }
+ * g_array_free(found, TRUE);
+ * cr_snapshot_close(snap);
+ * \endcode
+ *
+ *  \addtogroup snapshot
+ *  @{
+ */
+
+/** Version of the snapshot format.
+ */
+#define CR_SNAPSHOT_VERSION     1
+
+/** Type of the repomd.xml record of the snapshot.
+ */
+#define CR_SNAPSHOT_RECORD_TYPE "snapshot"
+
+/** Default filename of the snapshot.
+ */
+#define CR_SNAPSHOT_FILENAME    "snapshot.crsnap"
+
+typedef struct _cr_SnapshotWriter cr_SnapshotWriter;
+typedef struct _cr_Snapshot cr_Snapshot;
+
+/** Create a new snapshot writer.
+ * @return              New cr_SnapshotWriter
+ */
+cr_SnapshotWriter *
+cr_snapshot_writer_new(void);
+
+/** Add a package into the snapshot. All the data of the package are
+ * copied, the package can be freed right after the call.
+ * This function is not thread safe.
+ * @param sw            Snapshot writer
+ * @param pkg           Package
+ * @param err           GError **
+ * @return              TRUE on success
+ */
+gboolean
+cr_snapshot_writer_add_pkg(cr_SnapshotWriter *sw,
+                           cr_Package *pkg,
+                           GError **err);
+
+/** Write the snapshot into a file.
+ * @param sw            Snapshot writer
+ * @param path          Output path
+ * @param err           GError **
+ * @return              TRUE on success
+ */
+gboolean
+cr_snapshot_writer_write(cr_SnapshotWriter *sw,
+                         const char *path,
+                         GError **err);
+
+/** Free the snapshot writer.
+ * @param sw            Snapshot writer
+ */
+void
+cr_snapshot_writer_free(cr_SnapshotWriter *sw);
+
+/** Check a snapshot file against its checksum from repomd.xml.
+ * A snapshot which doesn't match (e.g. a leftover of an older run)
+ * must not be used instead of the XML files it was created from.
+ * @param path          Path to the snapshot
+ * @param checksum_type Checksum type from repomd.xml (e.g. "sha256")
+ * @param checksum      Checksum from repomd.xml
+ * @param err           GError **
+ * @return              TRUE if the checksum matches
+ */
+gboolean
+cr_snapshot_verify(const char *path,
+                   const char *checksum_type,
+                   const char *checksum,
+                   GError **err);
+
+/** Map a snapshot file into memory and check its consistency.
+ * @param path          Path to the snapshot
+ * @param err           GError **
+ * @return              Opened snapshot or NULL
+ */
+cr_Snapshot *
+cr_snapshot_open(const char *path, GError **err);
+
+/** Number of packages in the snapshot.
+ * @param snap          Snapshot
+ * @return              Number of packages
+ */
+guint
+cr_snapshot_count(cr_Snapshot *snap);
+
+/** Find packages by key. Uses the indexes, no package is materialized.
+ * @param snap          Snapshot
+ * @param key           CR_HT_KEY_HASH, CR_HT_KEY_NAME or CR_HT_KEY_FILENAME
+ * @param value         Searched value
+ * @return              GArray of indexes (guint) of matching packages,
+ *                      free it with g_array_free()
+ */
+GArray *
+cr_snapshot_find(cr_Snapshot *snap, cr_HashTableKey key, const char *value);
+
+/** Get a key value of a package without its materialization.
+ * @param snap          Snapshot
+ * @param idx           Index of the package
+ * @param key           CR_HT_KEY_HASH, CR_HT_KEY_NAME or CR_HT_KEY_FILENAME
+ * @return              Pointer into the mapped snapshot or NULL
+ */
+const char *
+cr_snapshot_package_key(cr_Snapshot *snap, guint idx, cr_HashTableKey key);
+
+/** Materialize a package from the snapshot.
+ * @param snap          Snapshot
+ * @param idx           Index of the package
+ * @param parts         Which parts to load (CR_PACKAGE_LOADED_PRI,
+ *                      CR_PACKAGE_LOADED_FIL, CR_PACKAGE_LOADED_OTH),
+ *                      primary data are always loaded
+ * @param chunk         String chunk to use for the package strings or NULL.
+ *                      If specified, the package is marked with
+ *                      CR_PACKAGE_SINGLE_CHUNK and the chunk is not freed
+ *                      with the package.
+ * @return              New cr_Package or NULL if the snapshot is corrupted
+ */
+cr_Package *
+cr_snapshot_package(cr_Snapshot *snap,
+                    guint idx,
+                    cr_PackageLoadingFlags parts,
+                    GStringChunk *chunk);
+
+/** Unmap and free the snapshot.
+ * @param snap          Snapshot
+ */
+void
+cr_snapshot_close(cr_Snapshot *snap);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __C_CREATEREPOLIB_SNAPSHOT_H__ */
@@ -1638,27 +1638,25 @@ cr_db_open(const char *path, cr_DatabaseType db_type, GError **err)
 
 
 int
-cr_db_close(cr_SqliteDb *sqlitedb, GError **err)
+cr_db_index(cr_SqliteDb *sqlitedb, GError **err)
 {
     GError *tmp_err = NULL;
 
+    assert(sqlitedb);
     assert(!err || *err == NULL);
 
-    if (!sqlitedb)
+    if (sqlitedb->indexed)
         return CRE_OK;
 
     switch (sqlitedb->type) {
         case CR_DB_PRIMARY:
             db_index_primary_tables(sqlitedb->db, &tmp_err);
-            cr_db_destroy_primary_statements(sqlitedb->statements.pri);
             break;
         case CR_DB_FILELISTS:
             db_index_filelists_tables(sqlitedb->db, &tmp_err);
-            cr_db_destroy_filelists_statements(sqlitedb->statements.fil);
             break;
         case CR_DB_OTHER:
             db_index_other_tables(sqlitedb->db, &tmp_err);
-            cr_db_destroy_other_statements(sqlitedb->statements.oth);
             break;
         default:
             g_critical("%s: Bad db type", __func__);
@@ -1673,6 +1671,45 @@ cr_db_close(cr_SqliteDb *sqlitedb, GError **err)
         return code;
     }
 
+    sqlitedb->indexed = TRUE;
+    return CRE_OK;
+}
+
+
+int
+cr_db_close(cr_SqliteDb *sqlitedb, GError **err)
+{
+    GError *tmp_err = NULL;
+
+    assert(!err || *err == NULL);
+
+    if (!sqlitedb)
+        return CRE_OK;
+
+    cr_db_index(sqlitedb, &tmp_err);
+
+    switch (sqlitedb->type) {
+        case CR_DB_PRIMARY:
+            cr_db_destroy_primary_statements(sqlitedb->statements.pri);
+            break;
+        case CR_DB_FILELISTS:
+            cr_db_destroy_filelists_statements(sqlitedb->statements.fil);
+            break;
+        case CR_DB_OTHER:
+            cr_db_destroy_other_statements(sqlitedb->statements.oth);
+            break;
+        default:
+            // Already reported by cr_db_index()
+            g_propagate_error(err, tmp_err);
+            return CRE_ASSERT;
+    }
+
+    if (tmp_err) {
+        int code = tmp_err->code;
+        g_propagate_error(err, tmp_err);
+        return code;
+    }
+
     sqlite3_exec (sqlitedb->db, "COMMIT", NULL, NULL, NULL);
     sqlite3_close(sqlitedb->db);
 
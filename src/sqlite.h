@@ -91,6 +91,8 @@ typedef struct {
         Type of Sqlite database. */
     cr_Statements statements; /*!<
         Compiled SQL statements */
+    gboolean indexed; /*!<
+        Indexes were already created by cr_db_index() */
 } cr_SqliteDb;
 
 /** Macro over cr_db_open function. Open (create new) primary sqlite sqlite db.
@@ -162,8 +164,18 @@ int cr_db_dbinfo_update(cr_SqliteDb *sqlitedb,
                         const char *checksum,
                         GError **err);
 
+/** Create indexes on tables. No packages should be added after this
+ * call. Calling this function is optional, cr_db_close() creates
+ * the indexes if they don't exist yet. It is useful to build the indexes
+ * while the data for cr_db_dbinfo_update() are not known yet.
+ * @param sqlitedb              open db connection
+ * @param err                   **GError
+ * @return                      cr_Error code
+ */
+int cr_db_index(cr_SqliteDb *sqlitedb, GError **err);
+
 /** Close db.
- *  - creates indexes on tables
+ *  - creates indexes on tables (if cr_db_index() was not called)
  *  - commits transaction
  *  - closes db
  * @param sqlitedb              open db connection
@@ -0,0 +1,356 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2014  Tomas Mlcoch
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <glib.h>
+#include <assert.h>
+#include <string.h>
+#include "stats.h"
+#include "error.h"
+
+#define ERR_DOMAIN              CREATEREPO_C_ERROR
+#define STATS_FORMAT_VERSION    1
+
+typedef struct {
+    gchar *name;
+    gint64 start;       // Offset from the creation of cr_Stats
+    gint64 duration;    // -1 while the phase is running
+} Phase;
+
+typedef struct {
+    gchar *key;
+    gint64 value;
+} IntValue;
+
+struct _cr_Stats {
+    GMutex *mutex;
+    gint64 created;     // Monotonic time of creation
+    GSList *phases;     // List of Phase (in reversed order)
+    GSList *values;     // List of IntValue (in reversed order)
+    GHashTable *workers;// GThread * -> cr_WorkerStats *
+    GSList *worker_list;// List of cr_WorkerStats (in reversed order)
+};
+
+cr_Stats *
+cr_stats_new(void)
+{
+    cr_Stats *stats = g_new0(cr_Stats, 1);
+    stats->mutex    = g_mutex_new();
+    stats->created  = g_get_monotonic_time();
+    stats->workers  = g_hash_table_new(g_direct_hash, g_direct_equal);
+    return stats;
+}
+
+void
+cr_stats_phase_begin(cr_Stats *stats, const char *name)
+{
+    Phase *phase;
+
+    if (!stats)
+        return;
+
+    assert(name);
+
+    phase = g_new0(Phase, 1);
+    phase->name     = g_strdup(name);
+    phase->start    = g_get_monotonic_time() - stats->created;
+    phase->duration = -1;
+
+    g_mutex_lock(stats->mutex);
+    stats->phases = g_slist_prepend(stats->phases, phase);
+    g_mutex_unlock(stats->mutex);
+}
+
+void
+cr_stats_phase_end(cr_Stats *stats, const char *name)
+{
+    gint64 now;
+
+    if (!stats)
+        return;
+
+    assert(name);
+
+    now = g_get_monotonic_time() - stats->created;
+
+    g_mutex_lock(stats->mutex);
+    for (GSList *elem = stats->phases; elem; elem = g_slist_next(elem)) {
+        Phase *phase = elem->data;
+        if (phase->duration == -1 && !strcmp(phase->name, name)) {
+            phase->duration = now - phase->start;
+            break;
+        }
+    }
+    g_mutex_unlock(stats->mutex);
+}
+
+void
+cr_stats_set_int(cr_Stats *stats, const char *key, gint64 value)
+{
+    IntValue *val = NULL;
+
+    if (!stats)
+        return;
+
+    assert(key);
+
+    g_mutex_lock(stats->mutex);
+    for (GSList *elem = stats->values; elem; elem = g_slist_next(elem)) {
+        if (!strcmp(((IntValue *) elem->data)->key, key)) {
+            val = elem->data;
+            break;
+        }
+    }
+    if (!val) {
+        val = g_new0(IntValue, 1);
+        val->key = g_strdup(key);
+        stats->values = g_slist_prepend(stats->values, val);
+    }
+    val->value = value;
+    g_mutex_unlock(stats->mutex);
+}
+
+cr_WorkerStats *
+cr_stats_worker(cr_Stats *stats)
+{
+    cr_WorkerStats *ws;
+    GThread *self;
+
+    if (!stats)
+        return NULL;
+
+    self = g_thread_self();
+
+    g_mutex_lock(stats->mutex);
+    ws = g_hash_table_lookup(stats->workers, self);
+    if (!ws) {
+        ws = g_new0(cr_WorkerStats, 1);
+        g_hash_table_insert(stats->workers, self, ws);
+        stats->worker_list = g_slist_prepend(stats->worker_list, ws);
+    }
+    g_mutex_unlock(stats->mutex);
+
+    return ws;
+}
+
+/** JSON output helpers */
+
+static void
+json_seconds(GString *out, gint64 usec)
+{
+    gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+    g_string_append(out, g_ascii_formatd(buf, sizeof(buf), "%.6f",
+                                         usec / 1000000.0));
+}
+
+static void
+json_double(GString *out, double val)
+{
+    gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+    g_string_append(out, g_ascii_formatd(buf, sizeof(buf), "%.3f", val));
+}
+
+static void
+json_string(GString *out, const char *str)
+{
+    g_string_append_c(out, '"');
+    for (const char *c = str; *c; c++) {
+        if (*c == '"' || *c == '\\')
+            g_string_append_printf(out, "\\%c", *c);
+        else if ((unsigned char) *c < 0x20)
+            g_string_append_printf(out, "\\u%04x", (unsigned char) *c);
+        else
+            g_string_append_c(out, *c);
+    }
+    g_string_append_c(out, '"');
+}
+
+static void
+json_worker(GString *out, cr_WorkerStats *ws, const char *indent)
+{
+    g_string_append_printf(out,
+        "{\n"
+        "%s  \"packages\": %"G_GINT64_FORMAT",\n"
+        "%s  \"cache_hits\": %"G_GINT64_FORMAT",\n"
+        "%s  \"xml_passthrough\": %"G_GINT64_FORMAT",\n"
+        "%s  \"errors\": %"G_GINT64_FORMAT",\n"
+        "%s  \"checksum_cache_hits\": %"G_GINT64_FORMAT",\n"
+        "%s  \"bytes_read\": %"G_GINT64_FORMAT",\n",
+        indent, ws->packages,
+        indent, ws->cache_hits,
+        indent, ws->xml_passthrough,
+        indent, ws->errors,
+        indent, ws->checksum_cache_hits,
+        indent, ws->bytes_read);
+
+#define JSON_TIME(field, last) \
+    g_string_append_printf(out, "%s  \"" #field "\": ", indent); \
+    json_seconds(out, ws->field); \
+    g_string_append(out, (last) ? "\n" : ",\n");
+
+    JSON_TIME(time_header, 0)
+    JSON_TIME(time_checksum, 0)
+    JSON_TIME(time_dump, 0)
+    JSON_TIME(time_write, 0)
+    JSON_TIME(time_wait_pri, 0)
+    JSON_TIME(time_wait_fil, 0)
+    JSON_TIME(time_wait_oth, 0)
+    JSON_TIME(time_total, 1)
+
+#undef JSON_TIME
+
+    g_string_append_printf(out, "%s}", indent);
+}
+
+gboolean
+cr_stats_write_json(cr_Stats *stats, const char *path, GError **err)
+{
+    GString *out;
+    GSList *phases, *values, *workers;
+    cr_WorkerStats total = {0};
+    gint64 dump_time = -1;
+    gboolean ret = TRUE;
+    GError *tmp_err = NULL;
+
+    assert(stats);
+    assert(path);
+    assert(!err || *err == NULL);
+
+    out = g_string_new("{\n");
+
+    g_mutex_lock(stats->mutex);
+    phases  = g_slist_reverse(g_slist_copy(stats->phases));
+    values  = g_slist_reverse(g_slist_copy(stats->values));
+    workers = g_slist_reverse(g_slist_copy(stats->worker_list));
+    g_mutex_unlock(stats->mutex);
+
+    g_string_append_printf(out, "  \"version\": %d,\n", STATS_FORMAT_VERSION);
+    g_string_append(out, "  \"time_total\": ");
+    json_seconds(out, g_get_monotonic_time() - stats->created);
+    g_string_append(out, ",\n");
+
+    for (GSList *elem = values; elem; elem = g_slist_next(elem)) {
+        IntValue *val = elem->data;
+        g_string_append(out, "  ");
+        json_string(out, val->key);
+        g_string_append_printf(out, ": %"G_GINT64_FORMAT",\n", val->value);
+    }
+
+    // Phases
+    g_string_append(out, "  \"phases\": [");
+    for (GSList *elem = phases; elem; elem = g_slist_next(elem)) {
+        Phase *phase = elem->data;
+        g_string_append(out, "\n    {\"name\": ");
+        json_string(out, phase->name);
+        g_string_append(out, ", \"start\": ");
+        json_seconds(out, phase->start);
+        g_string_append(out, ", \"duration\": ");
+        if (phase->duration >= 0)
+            json_seconds(out, phase->duration);
+        else
+            g_string_append(out, "null");
+        g_string_append(out, elem->next ? "}," : "}\n  ");
+        if (!strcmp(phase->name, "dump") && phase->duration >= 0)
+            dump_time = phase->duration;
+    }
+    g_string_append(out, "],\n");
+
+    // Workers
+    g_string_append(out, "  \"workers\": [");
+    for (GSList *elem = workers; elem; elem = g_slist_next(elem)) {
+        cr_WorkerStats *ws = elem->data;
+
+        g_string_append(out, "\n    ");
+        json_worker(out, ws, "    ");
+        g_string_append(out, elem->next ? "," : "\n  ");
+
+        total.packages      += ws->packages;
+        total.cache_hits    += ws->cache_hits;
+        total.xml_passthrough += ws->xml_passthrough;
+        total.errors        += ws->errors;
+        total.checksum_cache_hits += ws->checksum_cache_hits;
+        total.bytes_read    += ws->bytes_read;
+        total.time_header   += ws->time_header;
+        total.time_checksum += ws->time_checksum;
+        total.time_dump     += ws->time_dump;
+        total.time_write    += ws->time_write;
+        total.time_wait_pri += ws->time_wait_pri;
+        total.time_wait_fil += ws->time_wait_fil;
+        total.time_wait_oth += ws->time_wait_oth;
+        total.time_total    += ws->time_total;
+    }
+    g_string_append(out, "],\n");
+
+    // Summary
+    g_string_append(out, "  \"summary\": ");
+    json_worker(out, &total, "  ");
+    g_string_append(out, ",\n");
+
+    g_string_append(out, "  \"cache_hit_ratio\": ");
+    json_double(out, total.packages
+                     ? (double) total.cache_hits / total.packages : 0.0);
+    g_string_append(out, ",\n  \"packages_per_second\": ");
+    json_double(out, dump_time > 0
+                     ? total.packages / (dump_time / 1000000.0) : 0.0);
+    g_string_append(out, ",\n  \"bytes_read_per_second\": ");
+    json_double(out, dump_time > 0
+                     ? total.bytes_read / (dump_time / 1000000.0) : 0.0);
+    g_string_append(out, "\n}\n");
+
+    g_slist_free(phases);
+    g_slist_free(values);
+    g_slist_free(workers);
+
+    if (!g_file_set_contents(path, out->str, out->len, &tmp_err)) {
+        g_set_error(err, ERR_DOMAIN, CRE_IO,
+                    "Cannot write stats file %s: %s", path, tmp_err->message);
+        g_clear_error(&tmp_err);
+        ret = FALSE;
+    }
+
+    g_string_free(out, TRUE);
+    return ret;
+}
+
+static void
+phase_free(Phase *phase)
+{
+    g_free(phase->name);
+    g_free(phase);
+}
+
+static void
+int_value_free(IntValue *val)
+{
+    g_free(val->key);
+    g_free(val);
+}
+
+void
+cr_stats_free(cr_Stats *stats)
+{
+    if (!stats)
+        return;
+
+    g_slist_free_full(stats->phases, (GDestroyNotify) phase_free);
+    g_slist_free_full(stats->values, (GDestroyNotify) int_value_free);
+    g_slist_free_full(stats->worker_list, g_free);
+    g_hash_table_destroy(stats->workers);
+    g_mutex_free(stats->mutex);
+    g_free(stats);
+}
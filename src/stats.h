@@ -0,0 +1,124 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2014  Tomas Mlcoch
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef __C_CREATEREPOLIB_STATS_H__
+#define __C_CREATEREPOLIB_STATS_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <glib.h>
+
+/** \defgroup   stats   Run time statistics of createrepo_c
+ *
+ * Timing of the individual phases of a run and per-worker counters
+ * of the dumper threads. All functions accept NULL instead of the
+ * cr_Stats object (then they do nothing), so the instrumented code
+ * doesn't have to check if the statistics are enabled.
+ *
+ *  \addtogroup stats
+ *  @{
+ */
+
+/** Counters of a single dumper thread.
+ * Every thread updates only its own structure, so no locking is needed.
+ * All times are in microseconds.
+ */
+typedef struct {
+    gint64 packages;        /*!< Number of processed packages */
+    gint64 cache_hits;      /*!< Packages whose old metadata were reused */
+    gint64 xml_passthrough; /*!< Reused packages whose original filelists
+                                 and other xml were copied */
+    gint64 errors;          /*!< Packages which failed */
+    gint64 checksum_cache_hits; /*!< Packages whose checksum was taken
+                                     from the checksum cachedir */
+    gint64 bytes_read;      /*!< Size of the packages read from disk
+                                 to compute their checksums */
+    gint64 time_header;     /*!< Reading and parsing of rpm headers */
+    gint64 time_checksum;   /*!< Package checksum calculation */
+    gint64 time_dump;       /*!< XML dumping */
+    gint64 time_write;      /*!< Writing of XML chunks and sqlite records */
+    gint64 time_wait_pri;   /*!< Waiting for turn to write primary */
+    gint64 time_wait_fil;   /*!< Waiting for turn to write filelists */
+    gint64 time_wait_oth;   /*!< Waiting for turn to write other */
+    gint64 time_total;      /*!< Total time spent on tasks */
+} cr_WorkerStats;
+
+typedef struct _cr_Stats cr_Stats;
+
+/** Create new statistics object.
+ * @return              New cr_Stats
+ */
+cr_Stats *
+cr_stats_new(void);
+
+/** Mark the beginning of a phase.
+ * @param stats         cr_Stats or NULL
+ * @param name          Name of the phase
+ */
+void
+cr_stats_phase_begin(cr_Stats *stats, const char *name);
+
+/** Mark the end of a phase (the last started phase with the name).
+ * @param stats         cr_Stats or NULL
+ * @param name          Name of the phase
+ */
+void
+cr_stats_phase_end(cr_Stats *stats, const char *name);
+
+/** Set a top level integer value of the report (e.g. number of workers).
+ * @param stats         cr_Stats or NULL
+ * @param key           Key
+ * @param value         Value
+ */
+void
+cr_stats_set_int(cr_Stats *stats, const char *key, gint64 value);
+
+/** Get counters of the calling thread. They are created on the first call.
+ * This function is thread safe.
+ * @param stats         cr_Stats or NULL
+ * @return              Counters of the calling thread or NULL
+ */
+cr_WorkerStats *
+cr_stats_worker(cr_Stats *stats);
+
+/** Write the statistics as a JSON report.
+ * Throughput of the packages is computed from the "dump" phase.
+ * @param stats         cr_Stats
+ * @param path          Output path
+ * @param err           GError **
+ * @return              TRUE on success
+ */
+gboolean
+cr_stats_write_json(cr_Stats *stats, const char *path, GError **err);
+
+/** Free the statistics object.
+ * @param stats         cr_Stats or NULL
+ */
+void
+cr_stats_free(cr_Stats *stats);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __C_CREATEREPOLIB_STATS_H__ */
@@ -0,0 +1,146 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2013  Tomas Mlcoch
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <glib.h>
+#include <assert.h>
+#include <string.h>
+#include "string_pool.h"
+
+/** Number of independently locked parts of the pool.
+ * Must be a power of two.
+ */
+#define POOL_SHARDS             64
+#define POOL_CHUNK_SIZE         (64*1024)
+
+/** Rough size of a GHashTable entry (key, value and hash)
+ */
+#define POOL_ENTRY_OVERHEAD     (2 * sizeof(gpointer) + sizeof(guint))
+
+typedef struct {
+    GMutex *mutex;
+    GHashTable *set;        /*!< Strings from the chunk (key == value) */
+    GStringChunk *chunk;    /*!< Storage of the strings */
+    gint64 bytes;
+    gint64 hits;
+    gint64 saved_bytes;
+} cr_StringPoolShard;
+
+struct _cr_StringPool {
+    cr_StringPoolShard shards[POOL_SHARDS];
+};
+
+static cr_StringPool *default_pool = NULL;
+
+cr_StringPool *
+cr_string_pool_new(void)
+{
+    cr_StringPool *pool = g_new0(cr_StringPool, 1);
+
+    for (int x = 0; x < POOL_SHARDS; x++) {
+        cr_StringPoolShard *shard = &pool->shards[x];
+        shard->mutex = g_mutex_new();
+        shard->set   = g_hash_table_new(g_str_hash, g_str_equal);
+        shard->chunk = g_string_chunk_new(POOL_CHUNK_SIZE);
+    }
+
+    return pool;
+}
+
+const char *
+cr_string_pool_intern(cr_StringPool *pool, const char *str)
+{
+    cr_StringPoolShard *shard;
+    gchar *stored;
+    gsize len;
+
+    assert(pool);
+
+    if (!str)
+        return NULL;
+
+    // The low bits are used by the hash tables of the shards
+    shard = &pool->shards[(g_str_hash(str) >> 16) & (POOL_SHARDS - 1)];
+    len = strlen(str) + 1;
+
+    g_mutex_lock(shard->mutex);
+    stored = g_hash_table_lookup(shard->set, str);
+    if (stored) {
+        shard->hits++;
+        shard->saved_bytes += len;
+    } else {
+        stored = g_string_chunk_insert_len(shard->chunk, str, len - 1);
+        g_hash_table_insert(shard->set, stored, stored);
+        shard->bytes += len;
+    }
+    g_mutex_unlock(shard->mutex);
+
+    return stored;
+}
+
+void
+cr_string_pool_get_stats(cr_StringPool *pool, cr_StringPoolStats *stats)
+{
+    assert(pool);
+    assert(stats);
+
+    memset(stats, 0, sizeof(*stats));
+
+    for (int x = 0; x < POOL_SHARDS; x++) {
+        cr_StringPoolShard *shard = &pool->shards[x];
+        g_mutex_lock(shard->mutex);
+        stats->strings     += g_hash_table_size(shard->set);
+        stats->bytes       += shard->bytes;
+        stats->hits        += shard->hits;
+        stats->saved_bytes += shard->saved_bytes;
+        g_mutex_unlock(shard->mutex);
+    }
+
+    stats->overhead = stats->strings * POOL_ENTRY_OVERHEAD;
+}
+
+void
+cr_string_pool_free(cr_StringPool *pool)
+{
+    if (!pool)
+        return;
+
+    // Do not leave a dangling default pool
+    g_atomic_pointer_compare_and_exchange(&default_pool, pool, NULL);
+
+    for (int x = 0; x < POOL_SHARDS; x++) {
+        cr_StringPoolShard *shard = &pool->shards[x];
+        g_hash_table_destroy(shard->set);
+        g_string_chunk_free(shard->chunk);
+        g_mutex_free(shard->mutex);
+    }
+
+    g_free(pool);
+}
+
+void
+cr_string_pool_set_default(cr_StringPool *pool)
+{
+    g_atomic_pointer_set(&default_pool, pool);
+}
+
+cr_StringPool *
+cr_string_pool_get_default(void)
+{
+    return g_atomic_pointer_get(&default_pool);
+}
@@ -0,0 +1,149 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2013  Tomas Mlcoch
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef __C_CREATEREPOLIB_STRING_POOL_H__
+#define __C_CREATEREPOLIB_STRING_POOL_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <glib.h>
+
+/** \defgroup   string_pool     Pool of interned strings.
+ *
+ * Strings like dependency names ("libc.so.6()(64bit)", "/bin/sh"),
+ * versions, directory names or licenses repeat in many packages.
+ * When a default string pool is set (cr_string_pool_set_default()),
+ * the xml parsers and cr_package_from_header() store such strings
+ * only once into the pool instead of into the string chunk of every
+ * package.
+ *
+ * Strings in the pool are never freed before the pool itself, so the pool
+ * MUST NOT be freed before all packages which were created while it was
+ * the default pool.
+ *
+ * Example:
+ *
+ * \code
+ * cr_StringPool *pool = cr_string_pool_new();
+ * cr_string_pool_set_default(pool);
+ * // Load metadata...
+ * cr_string_pool_set_default(NULL);
+ * // Use and free the packages...
+ * cr_string_pool_free(pool);
+ * \endcode
+ *
+ *  \addtogroup string_pool
+ *  @{
+ */
+
+/** Pool of interned strings. All functions are thread safe.
+ */
+typedef struct _cr_StringPool cr_StringPool;
+
+/** Statistics of a cr_StringPool
+ */
+typedef struct {
+    gint64 strings;     /*!< Number of unique strings in the pool */
+    gint64 bytes;       /*!< Size of the unique strings */
+    gint64 hits;        /*!< Number of requests for an already stored
+                             string */
+    gint64 saved_bytes; /*!< Size of the strings which were not stored
+                             again thanks to the pool */
+    gint64 overhead;    /*!< Estimated size of the pool's index */
+} cr_StringPoolStats;
+
+/** Create a new empty pool.
+ * @return              new cr_StringPool
+ */
+cr_StringPool *
+cr_string_pool_new(void);
+
+/** Return the stored copy of the string. The string is added into
+ * the pool if it is not there yet.
+ * @param pool          cr_StringPool
+ * @param str           string or NULL
+ * @return              copy of the string owned by the pool or NULL
+ */
+const char *
+cr_string_pool_intern(cr_StringPool *pool, const char *str);
+
+/** Get statistics of the pool.
+ * @param pool          cr_StringPool
+ * @param stats         filled statistics
+ */
+void
+cr_string_pool_get_stats(cr_StringPool *pool, cr_StringPoolStats *stats);
+
+/** Free the pool and all its strings.
+ * @param pool          cr_StringPool or NULL
+ */
+void
+cr_string_pool_free(cr_StringPool *pool);
+
+/** Set the pool used by the xml parsers and cr_package_from_header().
+ * @param pool          cr_StringPool or NULL to disable interning
+ */
+void
+cr_string_pool_set_default(cr_StringPool *pool);
+
+/** Return the default pool.
+ * @return              cr_StringPool or NULL
+ */
+cr_StringPool *
+cr_string_pool_get_default(void);
+
+/** Intern the string into the default pool or, if there is no default pool,
+ * copy it into the chunk.
+ * @param chunk         a GStringChunk
+ * @param str           string or NULL
+ * @return              copy of the string or NULL if str is NULL
+ */
+static inline gchar *
+cr_string_pool_chunk_insert(GStringChunk *chunk, const char *str)
+{
+    cr_StringPool *pool;
+    if (!str) return NULL;
+    pool = cr_string_pool_get_default();
+    if (pool)
+        return (gchar *) cr_string_pool_intern(pool, str);
+    return g_string_chunk_insert(chunk, str);
+}
+
+/** Same as cr_string_pool_chunk_insert() but for empty string NULL
+ * is returned.
+ * @param chunk         a GStringChunk
+ * @param str           string or NULL
+ * @return              copy of the string or NULL if str is NULL or empty
+ */
+static inline gchar *
+cr_string_pool_chunk_insert_null(GStringChunk *chunk, const char *str)
+{
+    if (!str || *str == '\0') return NULL;
+    return cr_string_pool_chunk_insert(chunk, str);
+}
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __C_CREATEREPOLIB_STRING_POOL_H__ */
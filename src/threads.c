@@ -162,3 +162,198 @@ cr_repomd_record_fill_thread(gpointer data, G_GNUC_UNUSED gpointer user_data)
         g_propagate_error(&task->err, tmp_err);
     }
 }
+
+/** Task graph */
+
+struct _cr_TaskGraphTask {
+    gchar *name;
+    cr_TaskGraphFunc func;
+    gpointer data;
+    guint idx;              // Position in the graph (dependencies go first)
+    guint unmet;            // Number of not finished dependencies
+    gboolean skip;          // A dependency failed
+    GSList *dependents;     // Tasks waiting for this task
+    cr_TaskGraph *graph;
+};
+
+struct _cr_TaskGraph {
+    GPtrArray *tasks;
+    GThreadPool *pool;
+    gboolean started;       // The graph can run only once
+    GMutex *mutex;          // Protects all members below and unmet/skip
+    GCond *cond;            // of the tasks while the graph runs
+    guint remaining;        // Number of not finished tasks
+    GError *err;            // Error of the first failed task
+};
+
+cr_TaskGraph *
+cr_taskgraph_new(void)
+{
+    cr_TaskGraph *graph = g_new0(cr_TaskGraph, 1);
+    graph->tasks = g_ptr_array_new();
+    graph->mutex = g_mutex_new();
+    graph->cond = g_cond_new();
+    return graph;
+}
+
+cr_TaskGraphTask *
+cr_taskgraph_add(cr_TaskGraph *graph,
+                 const char *name,
+                 cr_TaskGraphFunc func,
+                 gpointer data)
+{
+    cr_TaskGraphTask *task;
+
+    assert(graph);
+    assert(name);
+    assert(func);
+    assert(!graph->started);
+
+    task = g_new0(cr_TaskGraphTask, 1);
+    task->name = g_strdup(name);
+    task->func = func;
+    task->data = data;
+    task->idx = graph->tasks->len;
+    task->graph = graph;
+    g_ptr_array_add(graph->tasks, task);
+
+    return task;
+}
+
+void
+cr_taskgraph_depends(cr_TaskGraphTask *task, cr_TaskGraphTask *dependency)
+{
+    assert(task);
+
+    if (!dependency)
+        return;
+
+    assert(dependency->graph == task->graph);
+    assert(dependency->idx < task->idx);
+
+    dependency->dependents = g_slist_prepend(dependency->dependents, task);
+    task->unmet++;
+}
+
+/** Must be called with the mutex of the graph locked */
+static void
+cr_taskgraph_task_done(cr_TaskGraph *graph,
+                       cr_TaskGraphTask *task,
+                       gboolean ok)
+{
+    for (GSList *elem = task->dependents; elem; elem = g_slist_next(elem)) {
+        cr_TaskGraphTask *dependent = elem->data;
+
+        if (!ok)
+            dependent->skip = TRUE;
+
+        if (--dependent->unmet > 0)
+            continue;
+
+        if (dependent->skip) {
+            g_debug("%s: Skipping %s - a task it depends on failed",
+                    __func__, dependent->name);
+            cr_taskgraph_task_done(graph, dependent, FALSE);
+        } else {
+            g_thread_pool_push(graph->pool, dependent, NULL);
+        }
+    }
+
+    graph->remaining--;
+    g_cond_broadcast(graph->cond);
+}
+
+static void
+cr_taskgraph_thread(gpointer data, G_GNUC_UNUSED gpointer user_data)
+{
+    cr_TaskGraphTask *task = data;
+    cr_TaskGraph *graph = task->graph;
+    GError *tmp_err = NULL;
+    gboolean ok;
+    gint64 start = g_get_monotonic_time();
+
+    ok = task->func(task->data, &tmp_err);
+    assert(ok || tmp_err);
+
+    g_debug("%s: Task %s %s in %.3f s", __func__, task->name,
+            ok ? "finished" : "failed",
+            (g_get_monotonic_time() - start) / 1000000.0);
+
+    g_mutex_lock(graph->mutex);
+    if (tmp_err) {
+        if (!ok && !graph->err) {
+            g_propagate_prefixed_error(&graph->err, tmp_err, "%s: ",
+                                       task->name);
+        } else {
+            g_warning("%s: %s", task->name, tmp_err->message);
+            g_error_free(tmp_err);
+        }
+    }
+    cr_taskgraph_task_done(graph, task, ok);
+    g_mutex_unlock(graph->mutex);
+}
+
+gboolean
+cr_taskgraph_run(cr_TaskGraph *graph, int threads, GError **err)
+{
+    GError *tmp_err = NULL;
+
+    assert(graph);
+    assert(!graph->started);
+    assert(!err || *err == NULL);
+
+    graph->started = TRUE;
+
+    if (graph->tasks->len == 0)
+        return TRUE;
+
+    graph->pool = g_thread_pool_new(cr_taskgraph_thread, NULL,
+                                    MAX(threads, 1), FALSE, &tmp_err);
+    if (!graph->pool) {
+        g_propagate_prefixed_error(err, tmp_err,
+                                   "Cannot create thread pool: ");
+        return FALSE;
+    }
+
+    g_mutex_lock(graph->mutex);
+    graph->remaining = graph->tasks->len;
+    for (guint x = 0; x < graph->tasks->len; x++) {
+        cr_TaskGraphTask *task = g_ptr_array_index(graph->tasks, x);
+        if (task->unmet == 0)
+            g_thread_pool_push(graph->pool, task, NULL);
+    }
+    while (graph->remaining > 0)
+        g_cond_wait(graph->cond, graph->mutex);
+    g_mutex_unlock(graph->mutex);
+
+    g_thread_pool_free(graph->pool, FALSE, TRUE);
+    graph->pool = NULL;
+
+    if (graph->err) {
+        g_propagate_error(err, graph->err);
+        graph->err = NULL;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+void
+cr_taskgraph_free(cr_TaskGraph *graph)
+{
+    if (!graph)
+        return;
+
+    for (guint x = 0; x < graph->tasks->len; x++) {
+        cr_TaskGraphTask *task = g_ptr_array_index(graph->tasks, x);
+        g_slist_free(task->dependents);
+        g_free(task->name);
+        g_free(task);
+    }
+    g_ptr_array_free(graph->tasks, TRUE);
+    g_clear_error(&graph->err);
+    g_mutex_free(graph->mutex);
+    g_cond_free(graph->cond);
+    g_free(graph);
+}
+
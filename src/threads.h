@@ -156,6 +156,84 @@ cr_repomdrecordfilltask_free(cr_RepomdRecordFillTask *task, GError **err);
 void
 cr_repomd_record_fill_thread(gpointer data, gpointer user_data);
 
+/** Graph of tasks with dependencies.
+ *
+ * Every task is started on a thread pool as soon as all tasks it depends
+ * on are successfully finished. If a task fails, the tasks which depend
+ * on it (directly or indirectly) are skipped.
+ *
+ * \code
+ * cr_TaskGraph *graph = cr_taskgraph_new();
+ * cr_TaskGraphTask *compress = cr_taskgraph_add(graph, "compress",
+ *                                               compress_func, data);
+ * cr_TaskGraphTask *fill = cr_taskgraph_add(graph, "fill",
+ *                                           fill_func, data);
+ * cr_taskgraph_depends(fill, compress);
+ * if (!cr_taskgraph_run(graph, 4, &err))
+ *     ...
+ * cr_taskgraph_free(graph);
+ * \endcode
+ */
+typedef struct _cr_TaskGraph cr_TaskGraph;
+
+/** Task of a cr_TaskGraph. The task belongs to the graph.
+ */
+typedef struct _cr_TaskGraphTask cr_TaskGraphTask;
+
+/** Function of a task.
+ * @param data      User data of the task
+ * @param err       GError **
+ * @return          TRUE on success, FALSE (and set err) on error
+ */
+typedef gboolean (*cr_TaskGraphFunc)(gpointer data, GError **err);
+
+/** Create a new empty task graph.
+ * @return          New cr_TaskGraph
+ */
+cr_TaskGraph *
+cr_taskgraph_new(void);
+
+/** Add a task into the graph.
+ * @param graph     Task graph
+ * @param name      Name of the task (used in error messages)
+ * @param func      Function of the task
+ * @param data      User data for the function (not freed by the graph)
+ * @return          The new task
+ */
+cr_TaskGraphTask *
+cr_taskgraph_add(cr_TaskGraph *graph,
+                 const char *name,
+                 cr_TaskGraphFunc func,
+                 gpointer data);
+
+/** Make the task wait until the dependency is successfully finished.
+ * The dependency must be added to the graph before the task, so the graph
+ * can never contain a cycle.
+ * @param task          Task
+ * @param dependency    Task which must be finished first. If NULL,
+ *                      nothing is done (handy for optional tasks).
+ */
+void
+cr_taskgraph_depends(cr_TaskGraphTask *task, cr_TaskGraphTask *dependency);
+
+/** Run all tasks of the graph and wait until they are finished.
+ * A graph can be run only once.
+ * @param graph     Task graph
+ * @param threads   Max number of tasks running at the same time
+ * @param err       GError **
+ * @return          FALSE if any task failed (the error of the first
+ *                  failed task is returned, errors of the other tasks
+ *                  are logged)
+ */
+gboolean
+cr_taskgraph_run(cr_TaskGraph *graph, int threads, GError **err);
+
+/** Free the task graph.
+ * @param graph     Task graph or NULL
+ */
+void
+cr_taskgraph_free(cr_TaskGraph *graph);
+
 /** @} */
 
 #ifdef __cplusplus
@@ -257,6 +257,197 @@ cr_updaterecord_append_collection(cr_UpdateRecord *record,
 }
 
 
+/*
+ * cr_UpdateInfoIndex
+ */
+
+typedef struct {
+    gchar *date;            /*!< Normalized issued date */
+    guint seq;              /*!< Position of the record in the updateinfo */
+    cr_UpdateRecord *rec;
+} cr_UpdateInfoDate;
+
+struct _cr_UpdateInfoIndex {
+    guint records;          /*!< Number of indexed records */
+    GHashTable *by_id;      /*!< id -> cr_UpdateRecord */
+    GHashTable *by_name;    /*!< name -> GPtrArray of cr_UpdateRecord */
+    GHashTable *by_nevra;   /*!< NEVRA -> GPtrArray of cr_UpdateRecord */
+    GArray *dates;          /*!< cr_UpdateInfoDate */
+    gboolean dates_sorted;
+};
+
+static void
+cr_updateinfo_date_clear(cr_UpdateInfoDate *date)
+{
+    g_free(date->date);
+}
+
+static void
+cr_updateinfo_index_free(cr_UpdateInfoIndex *index)
+{
+    if (!index)
+        return;
+    g_hash_table_destroy(index->by_id);
+    g_hash_table_destroy(index->by_name);
+    g_hash_table_destroy(index->by_nevra);
+    for (guint x = 0; x < index->dates->len; x++)
+        cr_updateinfo_date_clear(&g_array_index(index->dates,
+                                                cr_UpdateInfoDate, x));
+    g_array_free(index->dates, TRUE);
+    g_free(index);
+}
+
+static cr_UpdateInfoIndex *
+cr_updateinfo_index_new(void)
+{
+    cr_UpdateInfoIndex *index = g_new0(cr_UpdateInfoIndex, 1);
+    // Keys of by_id point into the records
+    index->by_id = g_hash_table_new(g_str_hash, g_str_equal);
+    index->by_name = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                           (GDestroyNotify) g_ptr_array_unref);
+    index->by_nevra = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                            (GDestroyNotify) g_ptr_array_unref);
+    index->dates = g_array_new(FALSE, FALSE, sizeof(cr_UpdateInfoDate));
+    index->dates_sorted = TRUE;
+    return index;
+}
+
+static gchar *
+cr_updateinfo_nevra_key(const char *name,
+                        const char *epoch,
+                        const char *version,
+                        const char *release,
+                        const char *arch)
+{
+    return g_strdup_printf("%s-%s:%s-%s.%s",
+                           name,
+                           (epoch && *epoch) ? epoch : "0",
+                           version ? version : "",
+                           release ? release : "",
+                           arch ? arch : "");
+}
+
+/** Convert an issued date to a string comparable by strcmp().
+ * Dates in the seconds since the epoch format are converted
+ * to "YYYY-MM-DD HH:MM:SS" (UTC), other dates are kept as they are.
+ */
+static gchar *
+cr_updateinfo_normalize_date(const char *date)
+{
+    const char *c = date;
+    while (g_ascii_isdigit(*c))
+        c++;
+
+    if (c != date && *c == '\0') {
+        GDateTime *dt = g_date_time_new_from_unix_utc(g_ascii_strtoll(date, NULL, 10));
+        if (dt) {
+            gchar *str = g_date_time_format(dt, "%Y-%m-%d %H:%M:%S");
+            g_date_time_unref(dt);
+            return str;
+        }
+    }
+
+    return g_strdup(date);
+}
+
+static void
+cr_updateinfo_index_add_to(GHashTable *table, gchar *key, cr_UpdateRecord *rec)
+{
+    GPtrArray *records = g_hash_table_lookup(table, key);
+
+    if (!records) {
+        records = g_ptr_array_new();
+        g_hash_table_insert(table, key, records);
+    } else {
+        g_free(key);
+        // A record lists the same package in many collections (archs)
+        if (g_ptr_array_index(records, records->len - 1) == rec)
+            return;
+    }
+
+    g_ptr_array_add(records, rec);
+}
+
+static void
+cr_updateinfo_index_add(cr_UpdateInfoIndex *index, cr_UpdateRecord *rec)
+{
+    guint seq = index->records++;
+
+    if (rec->id && !g_hash_table_lookup(index->by_id, rec->id))
+        g_hash_table_insert(index->by_id, rec->id, rec);
+
+    for (GSList *c = rec->collections; c; c = g_slist_next(c)) {
+        cr_UpdateCollection *col = c->data;
+        for (GSList *p = col->packages; p; p = g_slist_next(p)) {
+            cr_UpdateCollectionPackage *pkg = p->data;
+            if (!pkg->name)
+                continue;
+            cr_updateinfo_index_add_to(index->by_name,
+                                       g_strdup(pkg->name),
+                                       rec);
+            cr_updateinfo_index_add_to(index->by_nevra,
+                                       cr_updateinfo_nevra_key(pkg->name,
+                                                               pkg->epoch,
+                                                               pkg->version,
+                                                               pkg->release,
+                                                               pkg->arch),
+                                       rec);
+        }
+    }
+
+    if (rec->issued_date) {
+        cr_UpdateInfoDate date;
+        date.date = cr_updateinfo_normalize_date(rec->issued_date);
+        date.seq = seq;
+        date.rec = rec;
+        if (index->dates->len > 0 && index->dates_sorted) {
+            cr_UpdateInfoDate *last = &g_array_index(index->dates,
+                                                     cr_UpdateInfoDate,
+                                                     index->dates->len - 1);
+            if (strcmp(last->date, date.date) > 0)
+                index->dates_sorted = FALSE;
+        }
+        g_array_append_val(index->dates, date);
+    }
+}
+
+static gint
+cr_updateinfo_date_cmp(gconstpointer a, gconstpointer b)
+{
+    const cr_UpdateInfoDate *da = a, *db = b;
+    int ret = strcmp(da->date, db->date);
+    if (ret)
+        return ret;
+    // Keep the order of the updateinfo for the same dates
+    return (da->seq > db->seq) - (da->seq < db->seq);
+}
+
+/** Index of the first date which is not less than the given one */
+static guint
+cr_updateinfo_date_lower_bound(GArray *dates, const char *date)
+{
+    guint lo = 0, hi = dates->len;
+
+    while (lo < hi) {
+        guint mid = lo + (hi - lo) / 2;
+        if (strcmp(g_array_index(dates, cr_UpdateInfoDate, mid).date, date) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+static cr_UpdateInfoIndex *
+cr_updateinfo_get_index(cr_UpdateInfo *uinfo)
+{
+    if (!uinfo->index)
+        cr_updateinfo_build_index(uinfo);
+    return uinfo->index;
+}
+
+
 /*
  * cr_Updateinfo
  */
@@ -273,6 +464,7 @@ cr_updateinfo_free(cr_UpdateInfo *uinfo)
 {
     if (!uinfo)
         return;
+    cr_updateinfo_index_free(uinfo->index);
     cr_slist_free_full(uinfo->updates, (GDestroyNotify) cr_updaterecord_free);
     g_free(uinfo);
 }
@@ -282,5 +474,105 @@ cr_updateinfo_apped_record(cr_UpdateInfo *uinfo, cr_UpdateRecord *record)
 {
     if (!uinfo || !record) return;
     uinfo->updates = g_slist_append(uinfo->updates, record);
+    if (uinfo->index)
+        cr_updateinfo_index_add(uinfo->index, record);
+}
+
+void
+cr_updateinfo_build_index(cr_UpdateInfo *uinfo)
+{
+    assert(uinfo);
+
+    cr_updateinfo_index_free(uinfo->index);
+    uinfo->index = cr_updateinfo_index_new();
+    for (GSList *elem = uinfo->updates; elem; elem = g_slist_next(elem))
+        cr_updateinfo_index_add(uinfo->index, elem->data);
+}
+
+cr_UpdateRecord *
+cr_updateinfo_get_by_id(cr_UpdateInfo *uinfo, const char *id)
+{
+    assert(uinfo);
+
+    if (!id)
+        return NULL;
+
+    return g_hash_table_lookup(cr_updateinfo_get_index(uinfo)->by_id, id);
+}
+
+GSList *
+cr_updateinfo_get_by_package(cr_UpdateInfo *uinfo,
+                             const char *name,
+                             const char *epoch,
+                             const char *version,
+                             const char *release,
+                             const char *arch)
+{
+    cr_UpdateInfoIndex *index;
+    GPtrArray *records;
+    GSList *list = NULL;
+
+    assert(uinfo);
+
+    if (!name)
+        return NULL;
+
+    index = cr_updateinfo_get_index(uinfo);
+
+    if (!version && !release && !arch) {
+        records = g_hash_table_lookup(index->by_name, name);
+    } else {
+        gchar *key = cr_updateinfo_nevra_key(name, epoch, version,
+                                             release, arch);
+        records = g_hash_table_lookup(index->by_nevra, key);
+        g_free(key);
+    }
+
+    if (!records)
+        return NULL;
+
+    for (guint x = records->len; x > 0; x--)
+        list = g_slist_prepend(list, g_ptr_array_index(records, x - 1));
+
+    return list;
 }
 
+GSList *
+cr_updateinfo_get_by_issued_date(cr_UpdateInfo *uinfo,
+                                 const char *from,
+                                 const char *to)
+{
+    cr_UpdateInfoIndex *index;
+    guint first, last;
+    GSList *list = NULL;
+
+    assert(uinfo);
+
+    index = cr_updateinfo_get_index(uinfo);
+
+    if (!index->dates_sorted) {
+        g_array_sort(index->dates, cr_updateinfo_date_cmp);
+        index->dates_sorted = TRUE;
+    }
+
+    first = 0;
+    last = index->dates->len;
+
+    if (from) {
+        gchar *date = cr_updateinfo_normalize_date(from);
+        first = cr_updateinfo_date_lower_bound(index->dates, date);
+        g_free(date);
+    }
+
+    if (to) {
+        gchar *date = cr_updateinfo_normalize_date(to);
+        last = cr_updateinfo_date_lower_bound(index->dates, date);
+        g_free(date);
+    }
+
+    for (guint x = last; x > first; x--)
+        list = g_slist_prepend(list,
+                    g_array_index(index->dates, cr_UpdateInfoDate, x - 1).rec);
+
+    return list;
+}
@@ -88,8 +88,13 @@ typedef struct {
     GStringChunk *chunk;/*!< String chunk */
 } cr_UpdateRecord;
 
+/** Lookup index of cr_UpdateInfo (see cr_updateinfo_build_index()).
+ */
+typedef struct _cr_UpdateInfoIndex cr_UpdateInfoIndex;
+
 typedef struct {
     GSList *updates;    /*!< List of cr_UpdateRecord */
+    cr_UpdateInfoIndex *index; /*!< Lookup index or NULL */
 } cr_UpdateInfo;
 
 /*
@@ -169,6 +174,69 @@ cr_updateinfo_free(cr_UpdateInfo *uinfo);
 void
 cr_updateinfo_apped_record(cr_UpdateInfo *uinfo, cr_UpdateRecord *record);
 
+/** Build (or rebuild) the lookup index of all records of the updateinfo.
+ * The index maps advisory ids and package names/NEVRAs to the records
+ * and keeps the records sorted by their issued date.
+ * cr_updateinfo_apped_record() and cr_xml_parse_updateinfo() keep
+ * an existing index up to date. If the updates list is modified
+ * directly, the index must be rebuilt.
+ * The lookup functions build the index automatically when it doesn't
+ * exist yet, so calling this function is needed only to pay the cost
+ * in advance. The index is not thread-safe.
+ * @param uinfo         cr_UpdateInfo
+ */
+void
+cr_updateinfo_build_index(cr_UpdateInfo *uinfo);
+
+/** Find a record by its advisory id.
+ * @param uinfo         cr_UpdateInfo
+ * @param id            Advisory id (e.g. "RHEA-2013:1777")
+ * @return              The first record with the id (owned by
+ *                      the updateinfo) or NULL
+ */
+cr_UpdateRecord *
+cr_updateinfo_get_by_id(cr_UpdateInfo *uinfo, const char *id);
+
+/** Find records which contain a package. If only the name is specified,
+ * records with any version of the package are returned. Otherwise all
+ * of epoch, version, release and arch have to match (NULL epoch
+ * is the same as "0").
+ * @param uinfo         cr_UpdateInfo
+ * @param name          Package name
+ * @param epoch         Epoch or NULL
+ * @param version       Version or NULL for a lookup by name
+ * @param release       Release or NULL for a lookup by name
+ * @param arch          Arch or NULL for a lookup by name
+ * @return              List of records (owned by the updateinfo) in their
+ *                      order in the updateinfo. Free the list (only
+ *                      the list) by g_slist_free().
+ */
+GSList *
+cr_updateinfo_get_by_package(cr_UpdateInfo *uinfo,
+                             const char *name,
+                             const char *epoch,
+                             const char *version,
+                             const char *release,
+                             const char *arch);
+
+/** Find records issued in the [from, to) range. Dates are compared
+ * as strings in the "YYYY-MM-DD HH:MM:SS" format, so a prefix like
+ * "2013-12" could be used as well. Issued dates in the seconds since
+ * the epoch format are converted (UTC) before the comparison.
+ * Records without an issued date are never returned.
+ * @param uinfo         cr_UpdateInfo
+ * @param from          Start of the range or NULL for unlimited
+ * @param to            End of the range (not included) or NULL
+ *                      for unlimited
+ * @return              List of records (owned by the updateinfo) sorted
+ *                      by their issued date. Free the list (only
+ *                      the list) by g_slist_free().
+ */
+GSList *
+cr_updateinfo_get_by_issued_date(cr_UpdateInfo *uinfo,
+                                 const char *from,
+                                 const char *to);
+
 /** @} */
 
 #ifdef __cplusplus
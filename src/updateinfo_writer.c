@@ -0,0 +1,221 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2013  Tomas Mlcoch
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <glib.h>
+#include <assert.h>
+#include <string.h>
+#include "updateinfo_writer.h"
+#include "error.h"
+#include "xml_dump.h"
+
+#define ERR_DOMAIN                      CREATEREPO_C_ERROR
+#define UPDATEINFO_WRITER_PENDING_PER_WORKER    4
+
+typedef struct {
+    cr_UpdateRecord *rec;
+    gint64 seq;                 // Position of the record in the file
+} cr_UpdateinfoWriterTask;
+
+typedef struct {
+    gboolean done;              // Record was rendered
+    gchar *xml;                 // Rendered record (NULL on error)
+} cr_UpdateinfoWriterSlot;
+
+struct _cr_UpdateinfoWriter {
+    cr_XmlFile *f;
+    GThreadPool *pool;
+    gboolean finished;
+
+    GMutex *mutex;              // Protects all members below
+    GCond *cond;
+    cr_UpdateinfoWriterSlot *slots; // Ring of the rendered records
+    gint64 nslots;
+    gint64 added;               // Number of added records
+    gint64 written;             // Number of written records
+    gboolean writing;           // A thread is writing rendered records
+
+    GError *err;                // First error
+};
+
+static void
+cr_updateinfo_writer_set_error(cr_UpdateinfoWriter *w, GError *tmp_err)
+{
+    // Must be called with the mutex locked
+    if (!w->err)
+        w->err = tmp_err;
+    else
+        g_error_free(tmp_err);
+}
+
+static void
+cr_updateinfo_writer_thread(gpointer data, gpointer user_data)
+{
+    cr_UpdateinfoWriterTask *task = data;
+    cr_UpdateinfoWriter *w = user_data;
+    cr_UpdateinfoWriterSlot *slot;
+    GError *tmp_err = NULL;
+    gchar *xml;
+
+    xml = cr_xml_dump_updaterecord(task->rec, &tmp_err);
+    if (tmp_err)
+        g_prefix_error(&tmp_err, "Cannot dump update record %s: ",
+                       task->rec->id ? task->rec->id : "");
+    cr_updaterecord_free(task->rec);
+
+    g_mutex_lock(w->mutex);
+
+    if (tmp_err)
+        cr_updateinfo_writer_set_error(w, tmp_err);
+
+    slot = &w->slots[task->seq % w->nslots];
+    slot->done = TRUE;
+    slot->xml = xml;
+    g_free(task);
+
+    // Only one thread writes at a time, the others just leave
+    // their rendered records in the ring
+    if (w->writing) {
+        g_mutex_unlock(w->mutex);
+        return;
+    }
+    w->writing = TRUE;
+
+    slot = &w->slots[w->written % w->nslots];
+    while (slot->done) {
+        xml = slot->xml;
+        slot->done = FALSE;
+        slot->xml = NULL;
+        gboolean skip = (w->err != NULL);
+        g_mutex_unlock(w->mutex);
+
+        if (xml && !skip)
+            cr_xmlfile_add_chunk(w->f, xml, &tmp_err);
+        g_free(xml);
+
+        g_mutex_lock(w->mutex);
+        if (tmp_err) {
+            cr_updateinfo_writer_set_error(w, tmp_err);
+            tmp_err = NULL;
+        }
+        w->written++;
+        g_cond_broadcast(w->cond);
+        slot = &w->slots[w->written % w->nslots];
+    }
+
+    w->writing = FALSE;
+    g_mutex_unlock(w->mutex);
+}
+
+cr_UpdateinfoWriter *
+cr_updateinfo_writer_new(cr_XmlFile *f, int workers, GError **err)
+{
+    cr_UpdateinfoWriter *w;
+    GError *tmp_err = NULL;
+
+    assert(f);
+    assert(!err || *err == NULL);
+
+    if (workers < 1)
+        workers = 1;
+
+    w = g_new0(cr_UpdateinfoWriter, 1);
+    w->f = f;
+    w->mutex = g_mutex_new();
+    w->cond = g_cond_new();
+    w->nslots = workers * UPDATEINFO_WRITER_PENDING_PER_WORKER;
+    w->slots = g_new0(cr_UpdateinfoWriterSlot, w->nslots);
+
+    w->pool = g_thread_pool_new(cr_updateinfo_writer_thread, w,
+                                workers, TRUE, &tmp_err);
+    if (!w->pool) {
+        g_propagate_prefixed_error(err, tmp_err,
+                                   "Cannot create updateinfo writer threads: ");
+        w->finished = TRUE;
+        cr_updateinfo_writer_free(w);
+        return NULL;
+    }
+
+    return w;
+}
+
+void
+cr_updateinfo_writer_add(cr_UpdateinfoWriter *w, cr_UpdateRecord *rec)
+{
+    cr_UpdateinfoWriterTask *task;
+
+    assert(w);
+    assert(rec);
+    assert(!w->finished);
+
+    task = g_new(cr_UpdateinfoWriterTask, 1);
+    task->rec = rec;
+
+    // A slot of the ring is free only after its previous record
+    // was written
+    g_mutex_lock(w->mutex);
+    while (w->added - w->written >= w->nslots)
+        g_cond_wait(w->cond, w->mutex);
+    task->seq = w->added++;
+    g_mutex_unlock(w->mutex);
+
+    g_thread_pool_push(w->pool, task, NULL);
+}
+
+gboolean
+cr_updateinfo_writer_finish(cr_UpdateinfoWriter *w, GError **err)
+{
+    assert(w);
+    assert(!err || *err == NULL);
+
+    if (!w->finished) {
+        // Wait for all queued tasks, the last rendered record
+        // always writes all remaining ones
+        g_thread_pool_free(w->pool, FALSE, TRUE);
+        w->pool = NULL;
+        w->finished = TRUE;
+        assert(w->written == w->added);
+    }
+
+    if (w->err) {
+        g_propagate_error(err, w->err);
+        w->err = NULL;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+void
+cr_updateinfo_writer_free(cr_UpdateinfoWriter *w)
+{
+    if (!w)
+        return;
+
+    if (!w->finished) {
+        GError *tmp_err = NULL;
+        cr_updateinfo_writer_finish(w, &tmp_err);
+        g_clear_error(&tmp_err);
+    }
+
+    g_clear_error(&w->err);
+    g_free(w->slots);
+    g_mutex_free(w->mutex);
+    g_cond_free(w->cond);
+    g_free(w);
+}
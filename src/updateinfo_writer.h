@@ -0,0 +1,106 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2013  Tomas Mlcoch
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef __C_CREATEREPOLIB_UPDATEINFO_WRITER_H__
+#define __C_CREATEREPOLIB_UPDATEINFO_WRITER_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <glib.h>
+#include "updateinfo.h"
+#include "xml_file.h"
+
+/** \defgroup   updateinfo_writer  Parallel writing of updateinfo.xml
+ *
+ * Rendering of update records to xml is the expensive part of writing
+ * of a big updateinfo.xml. The writer renders the added records
+ * on a pool of threads and writes the rendered chunks into the xml file
+ * strictly in the order in which the records were added.
+ *
+ * Together with cr_xml_parse_updateinfo_records() an errata feed can be
+ * regenerated or merged without keeping all its records in memory:
+ *
+ * \code
+ * static int
+ * recordcb(cr_UpdateRecord *rec, void *cbdata, GError **err)
+ * {
+ *     cr_updateinfo_writer_add(cbdata, rec);
+ *     return CR_CB_RET_OK;
+ * }
+ *
+ * cr_XmlFile *f = cr_xmlfile_open_updateinfo("updateinfo.xml.gz",
+ *                                            CR_CW_GZ_COMPRESSION, NULL);
+ * cr_UpdateinfoWriter *w = cr_updateinfo_writer_new(f, 4, NULL);
+ * cr_xml_parse_updateinfo_records("old/updateinfo.xml.gz", recordcb, w,
+ *                                 NULL, NULL, NULL);
+ * cr_updateinfo_writer_finish(w, NULL);
+ * cr_updateinfo_writer_free(w);
+ * cr_xmlfile_close(f, NULL);
+ * \endcode
+ *
+ *  \addtogroup updateinfo_writer
+ *  @{
+ */
+
+typedef struct _cr_UpdateinfoWriter cr_UpdateinfoWriter;
+
+/** Create a new updateinfo writer.
+ * @param f                 Opened updateinfo xml file. The file is not
+ *                          closed by the writer.
+ * @param workers           Number of rendering threads (at least 1)
+ * @param err               GError **
+ * @return                  New writer or NULL on error
+ */
+cr_UpdateinfoWriter *
+cr_updateinfo_writer_new(cr_XmlFile *f, int workers, GError **err);
+
+/** Queue an update record. The records are written in the same order
+ * in which they were added. If too many records wait for the rendering
+ * or writing, the call blocks.
+ * @param w                 Writer
+ * @param rec               Update record. The writer takes the ownership
+ *                          and frees the record when it is rendered.
+ */
+void
+cr_updateinfo_writer_add(cr_UpdateinfoWriter *w, cr_UpdateRecord *rec);
+
+/** Wait until all queued records are written.
+ * @param w                 Writer
+ * @param err               GError **
+ * @return                  FALSE if rendering or writing of any record
+ *                          failed
+ */
+gboolean
+cr_updateinfo_writer_finish(cr_UpdateinfoWriter *w, GError **err);
+
+/** Finish the writer (if not finished yet) and free it.
+ * @param w                 Writer or NULL
+ */
+void
+cr_updateinfo_writer_free(cr_UpdateinfoWriter *w);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __C_CREATEREPOLIB_UPDATEINFO_WRITER_H__ */
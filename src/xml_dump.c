@@ -29,6 +29,18 @@
 #include "xml_dump_internal.h"
 
 
+static void
+cr_xml_dump_thread_buffer_free(gpointer buf)
+{
+    xmlBufferFree((xmlBufferPtr) buf);
+}
+
+/** Every thread (dumper in the createrepo_c thread pool) reuses its own
+ * xmlBuffer instead of creating a new one for every dumped chunk.
+ */
+static GPrivate thread_buffer = G_PRIVATE_INIT(cr_xml_dump_thread_buffer_free);
+
+
 void
 cr_xml_dump_init()
 {
@@ -42,6 +54,34 @@ cr_xml_dump_cleanup()
     xmlCleanupParser();
 }
 
+xmlBufferPtr
+cr_xml_dump_thread_buffer(GError **err)
+{
+    xmlBufferPtr buf = g_private_get(&thread_buffer);
+
+    // Do not keep an extremely large buffer (e.g. after a package
+    // with a huge changelog) for the rest of the thread's life
+    if (buf && buf->size > CR_XML_DUMP_MAX_KEPT_BUFFER) {
+        g_private_replace(&thread_buffer, NULL);
+        buf = NULL;
+    }
+
+    if (!buf) {
+        buf = xmlBufferCreate();
+        if (!buf) {
+            g_critical("%s: Error while creating xml buffer", __func__);
+            g_set_error(err, CREATEREPO_C_ERROR, CRE_MEMORY,
+                        "Cannot create an xml buffer");
+            return NULL;
+        }
+        g_private_set(&thread_buffer, buf);
+    } else {
+        xmlBufferEmpty(buf);
+    }
+
+    return buf;
+}
+
 gboolean cr_hascontrollchars(const unsigned char *str)
 {
     while (*str) {
@@ -232,3 +272,92 @@ cr_xml_dump(cr_Package *pkg, GError **err)
 
     return result;
 }
+
+
+struct cr_XmlBuffers *
+cr_xml_buffers_new(void)
+{
+    struct cr_XmlBuffers *buffers = g_new0(struct cr_XmlBuffers, 1);
+    buffers->primary   = g_string_sized_new(4096);
+    buffers->filelists = g_string_sized_new(4096);
+    buffers->other     = g_string_sized_new(4096);
+    return buffers;
+}
+
+
+void
+cr_xml_buffers_free(struct cr_XmlBuffers *buffers)
+{
+    if (!buffers)
+        return;
+    g_string_free(buffers->primary, TRUE);
+    g_string_free(buffers->filelists, TRUE);
+    g_string_free(buffers->other, TRUE);
+    g_free(buffers);
+}
+
+
+int
+cr_xml_dump_buffers(cr_Package *pkg,
+                    struct cr_XmlBuffers *buffers,
+                    GError **err)
+{
+    GError *tmp_err = NULL;
+
+    assert(buffers);
+    assert(!err || *err == NULL);
+
+    g_string_truncate(buffers->primary, 0);
+    g_string_truncate(buffers->filelists, 0);
+    g_string_truncate(buffers->other, 0);
+
+    if (!pkg) {
+        g_set_error(err, CREATEREPO_C_ERROR, CRE_BADARG,
+                    "No package object to dump specified");
+        return CRE_BADARG;
+    }
+
+    if (!cr_xml_dump_primary_append(pkg, buffers->primary, &tmp_err)
+        || !cr_xml_dump_filelists_append(pkg, buffers->filelists, &tmp_err)
+        || !cr_xml_dump_other_append(pkg, buffers->other, &tmp_err))
+    {
+        int code = tmp_err->code;
+        g_propagate_error(err, tmp_err);
+        g_string_truncate(buffers->primary, 0);
+        g_string_truncate(buffers->filelists, 0);
+        g_string_truncate(buffers->other, 0);
+        return code;
+    }
+
+    return CRE_OK;
+}
+
+
+int
+cr_xml_dump_buffers_primary(cr_Package *pkg,
+                            struct cr_XmlBuffers *buffers,
+                            GError **err)
+{
+    GError *tmp_err = NULL;
+
+    assert(buffers);
+    assert(!err || *err == NULL);
+
+    g_string_truncate(buffers->primary, 0);
+    g_string_truncate(buffers->filelists, 0);
+    g_string_truncate(buffers->other, 0);
+
+    if (!pkg) {
+        g_set_error(err, CREATEREPO_C_ERROR, CRE_BADARG,
+                    "No package object to dump specified");
+        return CRE_BADARG;
+    }
+
+    if (!cr_xml_dump_primary_append(pkg, buffers->primary, &tmp_err)) {
+        int code = tmp_err->code;
+        g_propagate_error(err, tmp_err);
+        return code;
+    }
+
+    return CRE_OK;
+}
@@ -118,6 +118,49 @@ char *cr_xml_dump_other(cr_Package *package, GError **err);
  */
 struct cr_XmlStruct cr_xml_dump(cr_Package *package, GError **err);
 
+/** Reusable output strings for cr_xml_dump_buffers().
+ */
+struct cr_XmlBuffers {
+    GString *primary;   /*!< XML chunk for primary.xml */
+    GString *filelists; /*!< XML chunk for filelists.xml */
+    GString *other;     /*!< XML chunk for other.xml */
+};
+
+/** Create new empty cr_XmlBuffers.
+ * @return              new cr_XmlBuffers
+ */
+struct cr_XmlBuffers *cr_xml_buffers_new(void);
+
+/** Free cr_XmlBuffers.
+ * @param buffers       cr_XmlBuffers or NULL
+ */
+void cr_xml_buffers_free(struct cr_XmlBuffers *buffers);
+
+/** Generate all three xml chunks (primary, filelists, other) from cr_Package
+ * into the buffers. Previous content of the buffers is replaced.
+ * Unlike cr_xml_dump(), no memory is allocated for the chunks when
+ * the buffers are reused for many packages.
+ * @param package       cr_Package
+ * @param buffers       cr_XmlBuffers
+ * @param err           **GError
+ * @return              cr_Error code
+ */
+int cr_xml_dump_buffers(cr_Package *package,
+                        struct cr_XmlBuffers *buffers,
+                        GError **err);
+
+/** Generate only the primary xml chunk from cr_Package into the buffers.
+ * The filelists and other buffers are emptied (e.g. to be filled with
+ * the original chunks of the package).
+ * @param package       cr_Package
+ * @param buffers       cr_XmlBuffers
+ * @param err           **GError
+ * @return              cr_Error code
+ */
+int cr_xml_dump_buffers_primary(cr_Package *package,
+                                struct cr_XmlBuffers *buffers,
+                                GError **err);
+
 /** Generate xml representation of cr_Repomd.
  * @param repomd        cr_Repomd
  * @param err           **GError
@@ -42,6 +42,48 @@ extern "C" {
 #define DATESIZE_STR_MAX_LEN    SIZE_STR_MAX_LEN
 #endif
 
+/** Buffers which grow over this size are not kept for reuse.
+ */
+#define CR_XML_DUMP_MAX_KEPT_BUFFER     (4*1024*1024)
+
+/** Return an empty xmlBuffer owned by the calling thread.
+ * The buffer is reused by the subsequent calls from the same thread,
+ * so its content is valid only until the next call.
+ * @param err           GError **
+ * @return              xmlBuffer or NULL on error
+ */
+xmlBufferPtr cr_xml_dump_thread_buffer(GError **err);
+
+/** Append primary xml chunk of the package to the string.
+ * @param package       cr_Package
+ * @param out           output string
+ * @param err           GError **
+ * @return              TRUE on success
+ */
+gboolean cr_xml_dump_primary_append(cr_Package *package,
+                                    GString *out,
+                                    GError **err);
+
+/** Append filelists xml chunk of the package to the string.
+ * @param package       cr_Package
+ * @param out           output string
+ * @param err           GError **
+ * @return              TRUE on success
+ */
+gboolean cr_xml_dump_filelists_append(cr_Package *package,
+                                      GString *out,
+                                      GError **err);
+
+/** Append other xml chunk of the package to the string.
+ * @param package       cr_Package
+ * @param out           output string
+ * @param err           GError **
+ * @return              TRUE on success
+ */
+gboolean cr_xml_dump_other_append(cr_Package *package,
+                                  GString *out,
+                                  GError **err);
+
 /** Dump files from the package and append them to the node as childrens.
  * @param node          parent xml node
  * @param package       cr_Package
@@ -375,11 +375,13 @@ cr_xml_dump_primary_base_items(xmlNodePtr root, cr_Package *package)
 
 
 
-char *
-cr_xml_dump_primary(cr_Package *package, GError **err)
+/** Dump the package into the per-thread xml buffer.
+ */
+static xmlBufferPtr
+cr_xml_dump_primary_to_buffer(cr_Package *package, GError **err)
 {
     xmlNodePtr root;
-    char *result;
+    xmlBufferPtr buf;
 
     assert(!err || *err == NULL);
 
@@ -389,31 +391,45 @@ cr_xml_dump_primary(cr_Package *package, GError **err)
         return NULL;
     }
 
+
     // Dump IT!
 
-    xmlBufferPtr buf = xmlBufferCreate();
-    if (buf == NULL) {
-        g_critical("%s: Error creating the xml buffer", __func__);
-        g_set_error(err, ERR_DOMAIN, CRE_MEMORY,
-                    "Cannot create an xml buffer");
+    buf = cr_xml_dump_thread_buffer(err);
+    if (!buf)
         return NULL;
-    }
 
     root = xmlNewNode(NULL, BAD_CAST "package");
     cr_xml_dump_primary_base_items(root, package);
     // xmlNodeDump seems to be a little bit faster than xmlDocDumpFormatMemory
     xmlNodeDump(buf, NULL, root, FORMAT_LEVEL, FORMAT_XML);
+    xmlBufferAdd(buf, BAD_CAST "\n", 1);
     assert(buf->content);
-    result = g_strndup((char *) buf->content, (buf->use+1));
-    result[buf->use]     = '\n';
-    result[buf->use+1]   = '\0';
 
 
     // Cleanup
 
-    xmlBufferFree(buf);
     xmlFreeNode(root);
 
-    return result;
+    return buf;
+}
+
 
+char *
+cr_xml_dump_primary(cr_Package *package, GError **err)
+{
+    xmlBufferPtr buf = cr_xml_dump_primary_to_buffer(package, err);
+    if (!buf)
+        return NULL;
+    return g_strndup((char *) buf->content, buf->use);
+}
+
+
+gboolean
+cr_xml_dump_primary_append(cr_Package *package, GString *out, GError **err)
+{
+    xmlBufferPtr buf = cr_xml_dump_primary_to_buffer(package, err);
+    if (!buf)
+        return FALSE;
+    g_string_append_len(out, (char *) buf->content, buf->use);
+    return TRUE;
 }
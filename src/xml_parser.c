@@ -21,12 +21,25 @@
 #include <glib/gprintf.h>
 #include <assert.h>
 #include <errno.h>
+#include <string.h>
+#include <time.h>
 #include "error.h"
 #include "xml_parser.h"
 #include "xml_parser_internal.h"
 #include "misc.h"
 
 #define ERR_DOMAIN      CREATEREPO_C_ERROR
+#define PROFILE_TEXT    "#text"
+
+struct _cr_XmlParserProfile {
+    GMutex *mutex;
+    GHashTable *elements;   /*!< Element name -> cr_XmlParserElementStats */
+};
+
+static cr_XmlParserProfile *active_profile = NULL;
+
+static void cr_xml_parser_profile_merge(cr_XmlParserProfile *profile,
+                                        GHashTable *elements);
 
 
 cr_ParserData *
@@ -35,8 +48,7 @@ cr_xml_parser_data(unsigned int numstates)
     cr_ParserData *pd = g_new0(cr_ParserData, 1);
     pd->content = g_malloc(CONTENT_REALLOC_STEP);
     pd->acontent = CONTENT_REALLOC_STEP;
-    pd->swtab = g_malloc0(sizeof(cr_StatesSwitch *) * numstates);
-    pd->sbtab = g_malloc(sizeof(unsigned int) * numstates);
+    pd->numstates = numstates;
 
     return pd;
 }
@@ -44,9 +56,11 @@ cr_xml_parser_data(unsigned int numstates)
 void
 cr_xml_parser_data_free(cr_ParserData *pd)
 {
+    if (pd->elements) {
+        cr_xml_parser_profile_merge(pd->profile, pd->elements);
+        g_hash_table_destroy(pd->elements);
+    }
     g_free(pd->content);
-    g_free(pd->swtab);
-    g_free(pd->sbtab);
     g_free(pd);
 }
 
@@ -76,6 +90,284 @@ cr_char_handler(void *pdata, const XML_Char *s, int len)
     *c = '\0';
 }
 
+// State switches
+
+#define STATES_HASH_SEED_TRIES  256
+
+/** Try to place all sub-tags of one state into slots without collisions.
+ */
+static gboolean
+states_hash_try(cr_StatesSwitch *first,
+                cr_StatesSwitch **slots,
+                guint32 mask,
+                guint32 seed)
+{
+    memset(slots, 0, sizeof(cr_StatesSwitch *) * (mask + 1));
+    for (cr_StatesSwitch *sw = first; sw->ename && sw->from == first->from; sw++) {
+        guint32 slot = cr_xml_name_hash(sw->ename, seed) & mask;
+        if (slots[slot])
+            return FALSE;
+        slots[slot] = sw;
+    }
+    return TRUE;
+}
+
+static void
+states_hash_build(cr_StatesHash *hash, cr_StatesSwitch *first)
+{
+    guint32 count = 0, size = 2;
+
+    for (cr_StatesSwitch *sw = first; sw->ename && sw->from == first->from; sw++)
+        count++;
+    while (size < 2 * count)
+        size <<= 1;
+
+    // A few sub-tags in twice as many slots - a seed without collisions
+    // is found quickly, if not, more slots are used
+    for (;; size <<= 1) {
+        hash->slots = g_realloc(hash->slots, sizeof(cr_StatesSwitch *) * size);
+        hash->mask = size - 1;
+        for (hash->seed = 0; hash->seed < STATES_HASH_SEED_TRIES; hash->seed++)
+            if (states_hash_try(first, hash->slots, hash->mask, hash->seed))
+                return;
+    }
+}
+
+/** Tables built from one state switches table.
+ */
+typedef struct {
+    cr_StatesSwitch **swtab;
+    unsigned int    *sbtab;
+    cr_StatesHash   *swhash;
+} cr_StatesTables;
+
+/* State switches -> cr_StatesTables. The tables are never freed,
+ * like the state switches they are built from */
+static GHashTable *states_cache = NULL;
+G_LOCK_DEFINE_STATIC(states_cache);
+
+void
+cr_xml_parser_set_states(cr_ParserData *pd, cr_StatesSwitch *stateswitches)
+{
+    cr_StatesTables *tables;
+
+    G_LOCK(states_cache);
+
+    if (!states_cache)
+        states_cache = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+    tables = g_hash_table_lookup(states_cache, stateswitches);
+    if (!tables) {
+        tables = g_new0(cr_StatesTables, 1);
+        tables->swtab  = g_new0(cr_StatesSwitch *, pd->numstates);
+        tables->sbtab  = g_new0(unsigned int, pd->numstates);
+        tables->swhash = g_new0(cr_StatesHash, pd->numstates);
+
+        for (cr_StatesSwitch *sw = stateswitches; sw->ename; sw++) {
+            assert(sw->from < pd->numstates);
+            assert(sw->to < pd->numstates);
+            if (!tables->swtab[sw->from]) {
+                tables->swtab[sw->from] = sw;
+                states_hash_build(&tables->swhash[sw->from], sw);
+            }
+            tables->sbtab[sw->to] = sw->from;
+        }
+
+        g_hash_table_insert(states_cache, stateswitches, tables);
+    }
+
+    G_UNLOCK(states_cache);
+
+    pd->swtab  = tables->swtab;
+    pd->sbtab  = tables->sbtab;
+    pd->swhash = tables->swhash;
+}
+
+// Profiling
+
+static void
+element_stats_free(cr_XmlParserElementStats *stats)
+{
+    g_free(stats->element);
+    g_free(stats);
+}
+
+static GHashTable *
+element_stats_table(void)
+{
+    // The key is owned by the value
+    return g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+                                 (GDestroyNotify) element_stats_free);
+}
+
+static cr_XmlParserElementStats *
+element_stats(GHashTable *elements, const char *element)
+{
+    cr_XmlParserElementStats *stats = g_hash_table_lookup(elements, element);
+    if (!stats) {
+        stats = g_new0(cr_XmlParserElementStats, 1);
+        stats->element = g_strdup(element);
+        g_hash_table_insert(elements, stats->element, stats);
+    }
+    return stats;
+}
+
+static inline gint64
+profile_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (gint64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void XMLCALL
+profile_start_handler(void *pdata, const XML_Char *element, const XML_Char **attr)
+{
+    cr_ParserData *pd = pdata;
+    gint64 start = profile_now();
+    pd->start_handler(pdata, element, attr);
+    gint64 elapsed = profile_now() - start;
+
+    cr_XmlParserElementStats *stats = element_stats(pd->elements, element);
+    stats->start_calls++;
+    stats->start_ns += elapsed;
+}
+
+static void XMLCALL
+profile_end_handler(void *pdata, const XML_Char *element)
+{
+    cr_ParserData *pd = pdata;
+    gint64 start = profile_now();
+    pd->end_handler(pdata, element);
+    gint64 elapsed = profile_now() - start;
+
+    cr_XmlParserElementStats *stats = element_stats(pd->elements, element);
+    stats->end_calls++;
+    stats->end_ns += elapsed;
+}
+
+static void XMLCALL
+profile_char_handler(void *pdata, const XML_Char *s, int len)
+{
+    cr_ParserData *pd = pdata;
+    gint64 start = profile_now();
+    cr_char_handler(pdata, s, len);
+    gint64 elapsed = profile_now() - start;
+
+    cr_XmlParserElementStats *stats = element_stats(pd->elements, PROFILE_TEXT);
+    stats->start_calls++;
+    stats->start_ns += elapsed;
+}
+
+void
+cr_xml_parser_profile_attach(XML_Parser parser,
+                             cr_ParserData *pd,
+                             XML_StartElementHandler start_handler,
+                             XML_EndElementHandler end_handler)
+{
+    cr_XmlParserProfile *profile = g_atomic_pointer_get(&active_profile);
+
+    if (!profile)
+        return;
+
+    pd->profile = profile;
+    pd->elements = element_stats_table();
+    pd->start_handler = start_handler;
+    pd->end_handler = end_handler;
+    XML_SetElementHandler(parser, profile_start_handler, profile_end_handler);
+    XML_SetCharacterDataHandler(parser, profile_char_handler);
+}
+
+static void
+cr_xml_parser_profile_merge(cr_XmlParserProfile *profile, GHashTable *elements)
+{
+    GHashTableIter iter;
+    gpointer value;
+
+    g_mutex_lock(profile->mutex);
+    g_hash_table_iter_init(&iter, elements);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        cr_XmlParserElementStats *src = value;
+        cr_XmlParserElementStats *dst = element_stats(profile->elements,
+                                                      src->element);
+        dst->start_calls += src->start_calls;
+        dst->start_ns    += src->start_ns;
+        dst->end_calls   += src->end_calls;
+        dst->end_ns      += src->end_ns;
+    }
+    g_mutex_unlock(profile->mutex);
+}
+
+cr_XmlParserProfile *
+cr_xml_parser_profile_new(void)
+{
+    cr_XmlParserProfile *profile = g_new0(cr_XmlParserProfile, 1);
+    profile->mutex = g_mutex_new();
+    profile->elements = element_stats_table();
+    return profile;
+}
+
+void
+cr_xml_parser_profile_set(cr_XmlParserProfile *profile)
+{
+    g_atomic_pointer_set(&active_profile, profile);
+}
+
+static gint
+cmp_element_stats(gconstpointer a, gconstpointer b)
+{
+    const cr_XmlParserElementStats *s1 = *((cr_XmlParserElementStats **) a);
+    const cr_XmlParserElementStats *s2 = *((cr_XmlParserElementStats **) b);
+    gint64 t1 = s1->start_ns + s1->end_ns;
+    gint64 t2 = s2->start_ns + s2->end_ns;
+
+    if (t1 != t2)
+        return t1 > t2 ? -1 : 1;
+    return strcmp(s1->element, s2->element);
+}
+
+GPtrArray *
+cr_xml_parser_profile_stats(cr_XmlParserProfile *profile)
+{
+    GHashTableIter iter;
+    gpointer value;
+    GPtrArray *stats = g_ptr_array_new();
+
+    assert(profile);
+
+    g_mutex_lock(profile->mutex);
+    g_hash_table_iter_init(&iter, profile->elements);
+    while (g_hash_table_iter_next(&iter, NULL, &value))
+        g_ptr_array_add(stats, value);
+    g_mutex_unlock(profile->mutex);
+
+    g_ptr_array_sort(stats, cmp_element_stats);
+    return stats;
+}
+
+void
+cr_xml_parser_profile_reset(cr_XmlParserProfile *profile)
+{
+    assert(profile);
+
+    g_mutex_lock(profile->mutex);
+    g_hash_table_remove_all(profile->elements);
+    g_mutex_unlock(profile->mutex);
+}
+
+void
+cr_xml_parser_profile_free(cr_XmlParserProfile *profile)
+{
+    if (!profile)
+        return;
+
+    assert(g_atomic_pointer_get(&active_profile) != profile);
+
+    g_hash_table_destroy(profile->elements);
+    g_mutex_free(profile->mutex);
+    g_free(profile);
+}
+
 int
 cr_xml_parser_warning(cr_ParserData *pd,
                       cr_XmlParserWarningType type,
@@ -240,3 +532,36 @@ cr_xml_parser_generic(XML_Parser parser,
 
     return ret;
 }
+
+int
+cr_xml_parser_generic_from_string(XML_Parser parser,
+                                  cr_ParserData *pd,
+                                  const char *xml_string,
+                                  GError **err)
+{
+    /* Note: This function uses .err members of cr_ParserData! */
+
+    assert(parser);
+    assert(pd);
+    assert(xml_string);
+    assert(!err || *err == NULL);
+
+    if (!XML_Parse(parser, xml_string, strlen(xml_string), 1)) {
+        g_critical("%s: parsing error: %s",
+                   __func__,
+                   XML_ErrorString(XML_GetErrorCode(parser)));
+        g_set_error(err, ERR_DOMAIN, CRE_XMLPARSER,
+                    "Parse error at line: %d (%s)",
+                    (int) XML_GetCurrentLineNumber(parser),
+                    (char *) XML_ErrorString(XML_GetErrorCode(parser)));
+        return CRE_XMLPARSER;
+    }
+
+    if (pd->err) {
+        int ret = pd->err->code;
+        g_propagate_error(err, pd->err);
+        return ret;
+    }
+
+    return CRE_OK;
+}
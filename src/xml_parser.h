@@ -97,6 +97,19 @@ typedef int (*cr_XmlParserWarningCb)(cr_XmlParserWarningType type,
                                      void *cbdata,
                                      GError **err);
 
+/** Callback for XML parser wich is called when an update element
+ * of updateinfo.xml is parsed.
+ * @param rec       Parsed update record. The callback takes the ownership
+ *                  of the record (it has to free it by
+ *                  cr_updaterecord_free()), even if it returns an error.
+ * @param cbdata    User data.
+ * @param err       GError **
+ * @return          CR_CB_RET_OK (0) or CR_CB_RET_ERR (1) - stops the parsing
+ */
+typedef int (*cr_XmlParserUpdateRecordCb)(cr_UpdateRecord *rec,
+                                          void *cbdata,
+                                          GError **err);
+
 /** Parse primary.xml. File could be compressed.
  * @param path           Path to filelists.xml
  * @param newpkgcb       Callback for new package (Called when new package
@@ -123,6 +136,63 @@ int cr_xml_parse_primary(const char *path,
                          int do_files,
                          GError **err);
 
+/** Parse primary.xml by several threads. File could be compressed.
+ * The document is split into segments at <package> boundaries and
+ * the segments are parsed in a thread pool. The callbacks are called
+ * only from the calling thread, in the document order, so the results
+ * are the same as from cr_xml_parse_primary(). If a newpkgcb is
+ * specified, it's called with NULL pkgId, name and arch when the package
+ * is already parsed and the package is copied into the object it
+ * returns - use NULL newpkgcb (packages are then passed to the pkgcb
+ * directly) for the best performance.
+ * Files without any package or with an unexpected root element
+ * are parsed sequentially by cr_xml_parse_primary().
+ * @param path           Path to the primary.xml
+ * @param newpkgcb       Callback for new package, see cr_xml_parse_primary()
+ * @param newpkgcb_data  User data for the newpkgcb.
+ * @param pkgcb          Package callback, see cr_xml_parse_primary()
+ * @param pkgcb_data     User data for the pkgcb.
+ * @param warningcb      Callback for warning messages.
+ * @param warningcb_data User data for the warningcb.
+ * @param do_files       0 - Ignore file tags in primary.xml.
+ * @param workers        Number of parsing threads (less than 2 means
+ *                       sequential parsing)
+ * @param err            GError **
+ * @return               cr_Error code.
+ */
+int cr_xml_parse_primary_parallel(const char *path,
+                                  cr_XmlParserNewPkgCb newpkgcb,
+                                  void *newpkgcb_data,
+                                  cr_XmlParserPkgCb pkgcb,
+                                  void *pkgcb_data,
+                                  cr_XmlParserWarningCb warningcb,
+                                  void *warningcb_data,
+                                  int do_files,
+                                  int workers,
+                                  GError **err);
+
+/** Parse a primary.xml snippet (one or more <package> elements).
+ * @param xml_string     Snippet
+ * @param newpkgcb       See cr_xml_parse_primary()
+ * @param newpkgcb_data  User data for the newpkgcb.
+ * @param pkgcb          See cr_xml_parse_primary()
+ * @param pkgcb_data     User data for the pkgcb.
+ * @param warningcb      Callback for warning messages.
+ * @param warningcb_data User data for the warningcb.
+ * @param do_files       0 - Ignore file tags.
+ * @param err            GError **
+ * @return               cr_Error code.
+ */
+int cr_xml_parse_primary_snippet(const char *xml_string,
+                                 cr_XmlParserNewPkgCb newpkgcb,
+                                 void *newpkgcb_data,
+                                 cr_XmlParserPkgCb pkgcb,
+                                 void *pkgcb_data,
+                                 cr_XmlParserWarningCb warningcb,
+                                 void *warningcb_data,
+                                 int do_files,
+                                 GError **err);
+
 /** Parse filelists.xml. File could be compressed.
  * @param path           Path to filelists.xml
  * @param newpkgcb       Callback for new package (Called when new package
@@ -147,6 +217,26 @@ int cr_xml_parse_filelists(const char *path,
                            void *warningcb_data,
                            GError **err);
 
+/** Parse a filelists.xml snippet (one or more <package> elements).
+ * @param xml_string     Snippet
+ * @param newpkgcb       See cr_xml_parse_filelists()
+ * @param newpkgcb_data  User data for the newpkgcb.
+ * @param pkgcb          See cr_xml_parse_filelists()
+ * @param pkgcb_data     User data for the pkgcb.
+ * @param warningcb      Callback for warning messages.
+ * @param warningcb_data User data for the warningcb.
+ * @param err            GError **
+ * @return               cr_Error code.
+ */
+int cr_xml_parse_filelists_snippet(const char *xml_string,
+                                   cr_XmlParserNewPkgCb newpkgcb,
+                                   void *newpkgcb_data,
+                                   cr_XmlParserPkgCb pkgcb,
+                                   void *pkgcb_data,
+                                   cr_XmlParserWarningCb warningcb,
+                                   void *warningcb_data,
+                                   GError **err);
+
 /** Parse other.xml. File could be compressed.
  * @param path           Path to other.xml
  * @param newpkgcb       Callback for new package (Called when new package
@@ -171,6 +261,73 @@ int cr_xml_parse_other(const char *path,
                        void *warningcb_data,
                        GError **err);
 
+/** Parse an other.xml snippet (one or more <package> elements).
+ * @param xml_string     Snippet
+ * @param newpkgcb       See cr_xml_parse_other()
+ * @param newpkgcb_data  User data for the newpkgcb.
+ * @param pkgcb          See cr_xml_parse_other()
+ * @param pkgcb_data     User data for the pkgcb.
+ * @param warningcb      Callback for warning messages.
+ * @param warningcb_data User data for the warningcb.
+ * @param err            GError **
+ * @return               cr_Error code.
+ */
+int cr_xml_parse_other_snippet(const char *xml_string,
+                               cr_XmlParserNewPkgCb newpkgcb,
+                               void *newpkgcb_data,
+                               cr_XmlParserPkgCb pkgcb,
+                               void *pkgcb_data,
+                               cr_XmlParserWarningCb warningcb,
+                               void *warningcb_data,
+                               GError **err);
+
+/** Iterator over packages of primary, filelists and other xml files.
+ * All three files are parsed together in small chunks, so the memory
+ * consumption doesn't depend on the number of packages. Packages must
+ * be in the same order in all the files (as generated by createrepo_c).
+ */
+typedef struct _cr_PkgIterator cr_PkgIterator;
+
+/** Create a new package iterator. Files could be compressed.
+ * @param primary_path   Path to primary.xml
+ * @param filelists_path Path to filelists.xml or NULL
+ * @param other_path     Path to other.xml or NULL
+ * @param warningcb      Callback for warning messages.
+ * @param warningcb_data User data for the warningcb.
+ * @param err            GError **
+ * @return               New cr_PkgIterator or NULL on error.
+ */
+cr_PkgIterator *
+cr_pkg_iterator_new(const char *primary_path,
+                    const char *filelists_path,
+                    const char *other_path,
+                    cr_XmlParserWarningCb warningcb,
+                    void *warningcb_data,
+                    GError **err);
+
+/** Parse and return the next package. The iterator doesn't call any
+ * callback except of the warningcb.
+ * @param iter           Package iterator
+ * @param err            GError **
+ * @return               Package (the caller is responsible for freeing it)
+ *                       or NULL if there are no more packages or on error.
+ */
+cr_Package *
+cr_pkg_iterator_next(cr_PkgIterator *iter, GError **err);
+
+/** Check if all packages were returned.
+ * @param iter           Package iterator
+ * @return               TRUE if there are no more packages
+ */
+gboolean
+cr_pkg_iterator_is_finished(cr_PkgIterator *iter);
+
+/** Free the iterator (and all packages which were parsed but not returned).
+ * @param iter           Package iterator or NULL
+ */
+void
+cr_pkg_iterator_free(cr_PkgIterator *iter);
+
 /** Parse repomd.xml. File could be compressed.
  * @param path           Path to repomd.xml
  * @param repomd         cr_Repomd object.
@@ -201,6 +358,82 @@ cr_xml_parse_updateinfo(const char *path,
                         void *warningcb_data,
                         GError **err);
 
+/** Parse updateinfo.xml record by record. File could be compressed.
+ * Unlike cr_xml_parse_updateinfo() the records are not collected,
+ * every record is passed to the recordcb as soon as its update element
+ * is parsed, so the memory usage doesn't grow with the size of the file.
+ * @param path           Path to updateinfo.xml
+ * @param recordcb       Callback called for every parsed record.
+ * @param recordcb_data  User data for the recordcb.
+ * @param warningcb      Callback for warning messages.
+ * @param warningcb_data User data for the warningcb.
+ * @param err            GError **
+ * @return               cr_Error code.
+ */
+int
+cr_xml_parse_updateinfo_records(const char *path,
+                                cr_XmlParserUpdateRecordCb recordcb,
+                                void *recordcb_data,
+                                cr_XmlParserWarningCb warningcb,
+                                void *warningcb_data,
+                                GError **err);
+
+/** Time spent in the handlers of one XML element.
+ * Times of the start handlers include the newpkgcb, times of the end
+ * handlers include the pkgcb. Character data of all elements are
+ * accounted to the "#text" element (start_* members only).
+ */
+typedef struct {
+    char *element;      /*!< Element name */
+    gint64 start_calls; /*!< Number of calls of the start handler */
+    gint64 start_ns;    /*!< Time spent in the start handler */
+    gint64 end_calls;   /*!< Number of calls of the end handler */
+    gint64 end_ns;      /*!< Time spent in the end handler */
+} cr_XmlParserElementStats;
+
+/** Per element profile of the XML parsers.
+ * When a profile is set by cr_xml_parser_profile_set(), every parser
+ * started afterwards measures its element handlers and adds the times
+ * into the profile when it finishes. Without an active profile
+ * the parsers run their handlers directly, with no overhead.
+ */
+typedef struct _cr_XmlParserProfile cr_XmlParserProfile;
+
+/** Create a new empty profile.
+ * @return              New cr_XmlParserProfile
+ */
+cr_XmlParserProfile *
+cr_xml_parser_profile_new(void);
+
+/** Set the profile used by the parsers started from now on.
+ * @param profile       Profile or NULL to disable profiling
+ */
+void
+cr_xml_parser_profile_set(cr_XmlParserProfile *profile);
+
+/** Get times of all elements of the profile.
+ * @param profile       Profile
+ * @return              GPtrArray of cr_XmlParserElementStats sorted by
+ *                      the total time (the most expensive first).
+ *                      The items belong to the profile and are valid
+ *                      until the next reset or free of the profile,
+ *                      the caller frees only the array.
+ */
+GPtrArray *
+cr_xml_parser_profile_stats(cr_XmlParserProfile *profile);
+
+/** Drop all collected times.
+ * @param profile       Profile
+ */
+void
+cr_xml_parser_profile_reset(cr_XmlParserProfile *profile);
+
+/** Free the profile. The profile must not be set as active.
+ * @param profile       Profile or NULL
+ */
+void
+cr_xml_parser_profile_free(cr_XmlParserProfile *profile);
+
 /** @} */
 
 #ifdef __cplusplus
@@ -29,6 +29,7 @@
 #include "error.h"
 #include "package.h"
 #include "misc.h"
+#include "string_pool.h"
 
 #define ERR_DOMAIN      CREATEREPO_C_ERROR
 #define ERR_CODE_XML    CRE_BADXMLFILELISTS
@@ -43,10 +44,8 @@ typedef enum {
 } cr_FilState;
 
 /* NOTE: Same states in the first column must be together!!!
- * Performance tip: More frequent elements shoud be listed
- * first in its group (eg: element "package" (STATE_PACKAGE)
- * has a "file" element listed first, because it is more frequent
- * than a "version" element). */
+ * Sub-tags of a state are found by a perfect hash built by
+ * cr_xml_parser_set_states(), their order doesn't matter. */
 static cr_StatesSwitch stateswitches[] = {
     { STATE_START,      "filelists",    STATE_FILELISTS,    0 },
     { STATE_FILELISTS,  "package",      STATE_PACKAGE,      0 },
@@ -55,6 +54,9 @@ static cr_StatesSwitch stateswitches[] = {
     { NUMSTATES,        NULL,           NUMSTATES,          0 },
 };
 
+/* Attributes looked up together by cr_find_attrs() */
+static const char * const package_attrs[] = { "pkgid", "name", "arch" };
+
 static void XMLCALL
 cr_start_handler(void *pdata, const char *element, const char **attr)
 {
@@ -81,10 +83,8 @@ cr_start_handler(void *pdata, const char *element, const char **attr)
         return;  // Do not parse current package tag and its content
 
     // Find current state by its name
-    for (sw = pd->swtab[pd->state]; sw->from == pd->state; sw++)
-        if (!strcmp(element, sw->ename))
-            break;
-    if (sw->from != pd->state) {
+    sw = cr_xml_parser_find_state(pd, element);
+    if (!sw) {
         // No state for current element (unknown element)
         cr_xml_parser_warning(pd, CR_XML_WARNING_UNKNOWNTAG,
                               "Unknown element \"%s\"", element);
@@ -109,9 +109,11 @@ cr_start_handler(void *pdata, const char *element, const char **attr)
         break;
 
     case STATE_PACKAGE: {
-        const char *pkgId = cr_find_attr("pkgid", attr);
-        const char *name  = cr_find_attr("name", attr);
-        const char *arch  = cr_find_attr("arch", attr);
+        const char *vals[3];
+        cr_find_attrs(attr, package_attrs, vals, 3);
+        const char *pkgId = vals[0];
+        const char *name  = vals[1];
+        const char *arch  = vals[2];
 
 
         if (!pkgId) {
@@ -169,13 +171,13 @@ cr_start_handler(void *pdata, const char *element, const char **attr)
         // Version string insert only if them don't already exists
 
         if (!pd->pkg->epoch)
-            pd->pkg->epoch = cr_safe_string_chunk_insert(pd->pkg->chunk,
+            pd->pkg->epoch = cr_string_pool_chunk_insert(pd->pkg->chunk,
                                             cr_find_attr("epoch", attr));
         if (!pd->pkg->version)
-            pd->pkg->version = cr_safe_string_chunk_insert(pd->pkg->chunk,
+            pd->pkg->version = cr_string_pool_chunk_insert(pd->pkg->chunk,
                                             cr_find_attr("ver", attr));
         if (!pd->pkg->release)
-            pd->pkg->release = cr_safe_string_chunk_insert(pd->pkg->chunk,
+            pd->pkg->release = cr_string_pool_chunk_insert(pd->pkg->chunk,
                                             cr_find_attr("rel", attr));
         break;
 
@@ -261,8 +263,11 @@ cr_end_handler(void *pdata, G_GNUC_UNUSED const char *element)
         pkg_file->name = cr_safe_string_chunk_insert(pd->pkg->chunk,
                                                 cr_get_filename(pd->content));
         pd->content[pd->lcontent - strlen(pkg_file->name)] = '\0';
-        pkg_file->path = cr_safe_string_chunk_insert_const(pd->pkg->chunk,
-                                                           pd->content);
+        pkg_file->path = cr_string_pool_get_default()
+                         ? cr_string_pool_chunk_insert(pd->pkg->chunk,
+                                                       pd->content)
+                         : cr_safe_string_chunk_insert_const(pd->pkg->chunk,
+                                                             pd->content);
         switch (pd->last_file_type) {
             case FILE_FILE:  pkg_file->type = NULL;    break; // NULL => "file"
             case FILE_DIR:   pkg_file->type = "dir";   break;
@@ -279,36 +284,29 @@ cr_end_handler(void *pdata, G_GNUC_UNUSED const char *element)
     }
 }
 
-int
-cr_xml_parse_filelists(const char *path,
-                       cr_XmlParserNewPkgCb newpkgcb,
-                       void *newpkgcb_data,
-                       cr_XmlParserPkgCb pkgcb,
-                       void *pkgcb_data,
-                       cr_XmlParserWarningCb warningcb,
-                       void *warningcb_data,
-                       GError **err)
+cr_ParserData *
+cr_xml_parser_filelists_new(XML_Parser *parser,
+                            cr_XmlParserNewPkgCb newpkgcb,
+                            void *newpkgcb_data,
+                            cr_XmlParserPkgCb pkgcb,
+                            void *pkgcb_data,
+                            cr_XmlParserWarningCb warningcb,
+                            void *warningcb_data)
 {
-    int ret = CRE_OK;
     cr_ParserData *pd;
-    XML_Parser parser;
-    GError *tmp_err = NULL;
 
-    assert(path);
+    assert(parser);
     assert(newpkgcb || pkgcb);
-    assert(!err || *err == NULL);
 
     if (!newpkgcb)  // Use default newpkgcb
         newpkgcb = cr_newpkgcb;
 
-    // Init
-
-    parser = XML_ParserCreate(NULL);
-    XML_SetElementHandler(parser, cr_start_handler, cr_end_handler);
-    XML_SetCharacterDataHandler(parser, cr_char_handler);
+    *parser = XML_ParserCreate(NULL);
+    XML_SetElementHandler(*parser, cr_start_handler, cr_end_handler);
+    XML_SetCharacterDataHandler(*parser, cr_char_handler);
 
     pd = cr_xml_parser_data(NUMSTATES);
-    pd->parser = &parser;
+    pd->parser = parser;
     pd->state = STATE_START;
     pd->newpkgcb_data = newpkgcb_data;
     pd->newpkgcb = newpkgcb;
@@ -316,17 +314,50 @@ cr_xml_parse_filelists(const char *path,
     pd->pkgcb = pkgcb;
     pd->warningcb = warningcb;
     pd->warningcb_data = warningcb_data;
-    for (cr_StatesSwitch *sw = stateswitches; sw->from != NUMSTATES; sw++) {
-        if (!pd->swtab[sw->from])
-            pd->swtab[sw->from] = sw;
-        pd->sbtab[sw->to] = sw->from;
-    }
+    cr_xml_parser_set_states(pd, stateswitches);
 
-    XML_SetUserData(parser, pd);
+    XML_SetUserData(*parser, pd);
+    cr_xml_parser_profile_attach(*parser, pd, cr_start_handler, cr_end_handler);
+
+    return pd;
+}
+
+static int
+cr_xml_parse_filelists_internal(const char *target,
+                                cr_XmlParserNewPkgCb newpkgcb,
+                                void *newpkgcb_data,
+                                cr_XmlParserPkgCb pkgcb,
+                                void *pkgcb_data,
+                                cr_XmlParserWarningCb warningcb,
+                                void *warningcb_data,
+                                cr_XmlParserGenericFunc parser_func,
+                                GError **err)
+{
+    int ret = CRE_OK;
+    cr_ParserData *pd;
+    XML_Parser parser;
+    GError *tmp_err = NULL;
+
+    assert(target);
+    assert(newpkgcb || pkgcb);
+    assert(!err || *err == NULL);
+
+    if (!newpkgcb)  // Use default newpkgcb
+        newpkgcb = cr_newpkgcb;
+
+    // Init
+
+    pd = cr_xml_parser_filelists_new(&parser,
+                                     newpkgcb,
+                                     newpkgcb_data,
+                                     pkgcb,
+                                     pkgcb_data,
+                                     warningcb,
+                                     warningcb_data);
 
     // Parsing
 
-    ret = cr_xml_parser_generic(parser, pd, path, &tmp_err);
+    ret = parser_func(parser, pd, target, &tmp_err);
     if (tmp_err)
         g_propagate_error(err, tmp_err);
 
@@ -355,3 +386,56 @@ cr_xml_parse_filelists(const char *path,
 
     return ret;
 }
+
+int
+cr_xml_parse_filelists(const char *path,
+                       cr_XmlParserNewPkgCb newpkgcb,
+                       void *newpkgcb_data,
+                       cr_XmlParserPkgCb pkgcb,
+                       void *pkgcb_data,
+                       cr_XmlParserWarningCb warningcb,
+                       void *warningcb_data,
+                       GError **err)
+{
+    return cr_xml_parse_filelists_internal(path,
+                                           newpkgcb,
+                                           newpkgcb_data,
+                                           pkgcb,
+                                           pkgcb_data,
+                                           warningcb,
+                                           warningcb_data,
+                                           cr_xml_parser_generic,
+                                           err);
+}
+
+int
+cr_xml_parse_filelists_snippet(const char *xml_string,
+                               cr_XmlParserNewPkgCb newpkgcb,
+                               void *newpkgcb_data,
+                               cr_XmlParserPkgCb pkgcb,
+                               void *pkgcb_data,
+                               cr_XmlParserWarningCb warningcb,
+                               void *warningcb_data,
+                               GError **err)
+{
+    int ret;
+    gchar *wrapped;
+
+    assert(xml_string);
+
+    // The snippet contains only <package> elements, the parser
+    // expects them inside of the main element
+    wrapped = g_strconcat("<filelists>", xml_string, "</filelists>", NULL);
+    ret = cr_xml_parse_filelists_internal(wrapped,
+                                          newpkgcb,
+                                          newpkgcb_data,
+                                          pkgcb,
+                                          pkgcb_data,
+                                          warningcb,
+                                          warningcb_data,
+                                          cr_xml_parser_generic_from_string,
+                                          err);
+    g_free(wrapped);
+
+    return ret;
+}
@@ -62,6 +62,18 @@ typedef struct {
     int             docontent;  /*!< Read text content of element? */
 } cr_StatesSwitch;
 
+/** Perfect hash of names of the sub-tags of one state.
+ * Built by cr_xml_parser_set_states() with a seed for which no two
+ * sub-tags of the state share a slot, so a lookup is one hash
+ * and one strcmp regardless of the number of sub-tags.
+ */
+typedef struct {
+    guint32         seed;       /*!< Seed of the hash function */
+    guint32         mask;       /*!< Number of slots - 1 */
+    cr_StatesSwitch **slots;    /*!< Slots (NULL if the state has no
+                                     sub-tags) */
+} cr_StatesHash;
+
 /** Parser data
  */
 typedef struct _cr_ParserData {
@@ -79,8 +91,19 @@ typedef struct _cr_ParserData {
     int     acontent;   /*!< Available bytes in the content */
 
     XML_Parser      *parser;    /*!< The parser */
-    cr_StatesSwitch **swtab;    /*!< Pointers to statesswitches table */
-    unsigned int    *sbtab;     /*!< stab[to_state] = from_state */
+    cr_StatesSwitch **swtab;    /*!< Pointers to statesswitches table
+                                     (shared, see cr_xml_parser_set_states) */
+    unsigned int    *sbtab;     /*!< stab[to_state] = from_state (shared) */
+    cr_StatesHash   *swhash;    /*!< swhash[state] = sub-tags of the state
+                                     (shared) */
+    unsigned int    numstates;  /*!< Number of states */
+
+    /* Profiling (see cr_xml_parser_profile_attach) */
+
+    struct _cr_XmlParserProfile *profile;   /*!< Profile or NULL */
+    GHashTable      *elements;  /*!< Element name -> cr_XmlParserElementStats */
+    XML_StartElementHandler start_handler;  /*!< Profiled start handler */
+    XML_EndElementHandler   end_handler;    /*!< Profiled end handler */
 
     /* Common stuf */
 
@@ -145,8 +168,10 @@ typedef struct _cr_ParserData {
 
     /* Updateinfo related stuff */
 
-    cr_UpdateInfo *updateinfo; /*!<
-        Update info object */
+    cr_XmlParserUpdateRecordCb updaterecordcb; /*!<
+        Callback called when an update record is completely parsed */
+    void *updaterecordcb_data; /*!<
+        User data for the updaterecordcb */
     cr_UpdateRecord *updaterecord; /*!<
         Update record object */
     cr_UpdateCollection *updatecollection; /*!<
@@ -164,6 +189,62 @@ cr_ParserData *cr_xml_parser_data();
  */
 void cr_xml_parser_data_free(cr_ParserData *pd);
 
+/** If a profile is active (see cr_xml_parser_profile_set()), install
+ * handlers which measure the given element handlers and
+ * the cr_char_handler. The times are added into the profile
+ * by cr_xml_parser_data_free(). Must be called after XML_SetUserData().
+ */
+void cr_xml_parser_profile_attach(XML_Parser parser,
+                                  cr_ParserData *pd,
+                                  XML_StartElementHandler start_handler,
+                                  XML_EndElementHandler end_handler);
+
+/** Set the swtab, sbtab and swhash tables of the state switches.
+ * The tables are built on the first use of the state switches and then
+ * shared (read-only) by all parsers, so parsing of many small snippets
+ * doesn't rebuild them every time.
+ * @param pd            Parser data
+ * @param stateswitches Table terminated by an item with NULL ename.
+ *                      Items with the same from state must be together.
+ */
+void cr_xml_parser_set_states(cr_ParserData *pd,
+                              cr_StatesSwitch *stateswitches);
+
+/** Seeded hash of an element name used by cr_StatesHash.
+ */
+static inline guint32
+cr_xml_name_hash(const char *name, guint32 seed)
+{
+    guint32 h = 2166136261u ^ seed;
+    while (*name)
+        h = (h ^ (unsigned char) *name++) * 16777619u;
+    h ^= h >> 16;
+    h *= 0x45d9f3bu;
+    h ^= h >> 16;
+    return h;
+}
+
+/** Find the state switch of a sub-tag of the current state.
+ * @param pd        Parser data
+ * @param element   Name of the element
+ * @return          State switch or NULL for unknown element
+ */
+static inline cr_StatesSwitch *
+cr_xml_parser_find_state(cr_ParserData *pd, const char *element)
+{
+    cr_StatesHash *hash = &pd->swhash[pd->state];
+    cr_StatesSwitch *sw;
+
+    if (!hash->slots)
+        return NULL;
+
+    sw = hash->slots[cr_xml_name_hash(element, hash->seed) & hash->mask];
+    if (sw && !strcmp(element, sw->ename))
+        return sw;
+
+    return NULL;
+}
+
 /** Find attribute in list of attributes.
  * @param name      Attribute name.
  * @param attr      List of attributes of the tag
@@ -181,6 +262,31 @@ cr_find_attr(const char *name, const char **attr)
     return NULL;
 }
 
+/** Find several attributes in one pass over the list of attributes.
+ * @param attr      List of attributes of the tag
+ * @param names     Names of the wanted attributes
+ * @param values    Values of the attributes (NULL for missing ones)
+ * @param n         Number of the wanted attributes
+ */
+static inline void
+cr_find_attrs(const char **attr,
+              const char * const *names,
+              const char **values,
+              int n)
+{
+    for (int i = 0; i < n; i++)
+        values[i] = NULL;
+
+    for (; *attr; attr += 2)
+        for (int i = 0; i < n; i++)
+            if (!values[i] && attr[0][0] == names[i][0]
+                && !strcmp(attr[0], names[i]))
+            {
+                values[i] = attr[1];
+                break;
+            }
+}
+
 /** XML character handler
  */
 void XMLCALL cr_char_handler(void *pdata, const XML_Char *s, int len);
@@ -217,6 +323,59 @@ cr_xml_parser_generic(XML_Parser parser,
                       const char *path,
                       GError **err);
 
+/** Generic parser of a xml string.
+ */
+int
+cr_xml_parser_generic_from_string(XML_Parser parser,
+                                  cr_ParserData *pd,
+                                  const char *xml_string,
+                                  GError **err);
+
+/** Create a parser of primary.xml and its data. The parser is ready for
+ * an incremental parsing by XML_ParseBuffer(). The parser variable must
+ * remain valid (at the same address) during the parsing.
+ */
+cr_ParserData *
+cr_xml_parser_primary_new(XML_Parser *parser,
+                          cr_XmlParserNewPkgCb newpkgcb,
+                          void *newpkgcb_data,
+                          cr_XmlParserPkgCb pkgcb,
+                          void *pkgcb_data,
+                          cr_XmlParserWarningCb warningcb,
+                          void *warningcb_data,
+                          int do_files);
+
+/** Create a parser of filelists.xml and its data.
+ * See cr_xml_parser_primary_new().
+ */
+cr_ParserData *
+cr_xml_parser_filelists_new(XML_Parser *parser,
+                            cr_XmlParserNewPkgCb newpkgcb,
+                            void *newpkgcb_data,
+                            cr_XmlParserPkgCb pkgcb,
+                            void *pkgcb_data,
+                            cr_XmlParserWarningCb warningcb,
+                            void *warningcb_data);
+
+/** Create a parser of other.xml and its data.
+ * See cr_xml_parser_primary_new().
+ */
+cr_ParserData *
+cr_xml_parser_other_new(XML_Parser *parser,
+                        cr_XmlParserNewPkgCb newpkgcb,
+                        void *newpkgcb_data,
+                        cr_XmlParserPkgCb pkgcb,
+                        void *pkgcb_data,
+                        cr_XmlParserWarningCb warningcb,
+                        void *warningcb_data);
+
+/** Type of cr_xml_parser_generic() and cr_xml_parser_generic_from_string().
+ */
+typedef int (*cr_XmlParserGenericFunc)(XML_Parser parser,
+                                       cr_ParserData *pd,
+                                       const char *target,
+                                       GError **err);
+
 #ifdef __cplusplus
 }
 #endif
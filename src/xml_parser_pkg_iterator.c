@@ -0,0 +1,359 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2014  Tomas Mlcoch
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <glib.h>
+#include <assert.h>
+#include <expat.h>
+#include "xml_parser_internal.h"
+#include "xml_parser.h"
+#include "compression_wrapper.h"
+#include "error.h"
+#include "package.h"
+
+#define ERR_DOMAIN      CREATEREPO_C_ERROR
+
+typedef enum {
+    ITER_PRI,
+    ITER_FIL,
+    ITER_OTH,
+    ITER_SENTINEL,
+} cr_PkgIteratorFile;
+
+typedef struct {
+    XML_Parser parser;
+    cr_ParserData *pd;
+    CR_FILE *f;
+    gchar *path;
+    gboolean finished;      /*!< Whole file was parsed */
+} cr_PkgIteratorParser;
+
+struct _cr_PkgIterator {
+    cr_PkgIteratorParser parsers[ITER_SENTINEL];
+    GQueue *queue;          /*!< Packages from primary.xml which wait for
+                                 filelists and other data */
+    gboolean finished;      /*!< No more packages (or an error occurred) */
+};
+
+static const char *file_names[ITER_SENTINEL] = {
+    "primary.xml", "filelists.xml", "other.xml",
+};
+
+/** Parse next chunk of the file.
+ */
+static int
+cr_pkg_iterator_feed(cr_PkgIterator *iter,
+                     cr_PkgIteratorFile type,
+                     GError **err)
+{
+    cr_PkgIteratorParser *ip = &iter->parsers[type];
+    GError *tmp_err = NULL;
+    void *buf;
+    int len;
+
+    assert(!ip->finished);
+
+    buf = XML_GetBuffer(ip->parser, XML_BUFFER_SIZE);
+    if (!buf) {
+        g_set_error(err, ERR_DOMAIN, CRE_MEMORY,
+                    "Out of memory: Cannot allocate buffer for xml parser '%s'",
+                    ip->path);
+        return CRE_MEMORY;
+    }
+
+    len = cr_read(ip->f, buf, XML_BUFFER_SIZE, &tmp_err);
+    if (tmp_err) {
+        int code = tmp_err->code;
+        g_propagate_prefixed_error(err, tmp_err, "Read error '%s': ", ip->path);
+        return code;
+    }
+
+    if (!XML_ParseBuffer(ip->parser, len, len == 0)) {
+        // The error could be set by a callback of another parser
+        if (ip->pd->err) {
+            int code = ip->pd->err->code;
+            g_propagate_error(err, ip->pd->err);
+            ip->pd->err = NULL;
+            return code;
+        }
+        g_set_error(err, ERR_DOMAIN, CRE_XMLPARSER,
+                    "Parse error '%s' at line: %d (%s)",
+                    ip->path,
+                    (int) XML_GetCurrentLineNumber(ip->parser),
+                    (char *) XML_ErrorString(XML_GetErrorCode(ip->parser)));
+        return CRE_XMLPARSER;
+    }
+
+    if (ip->pd->err) {
+        int code = ip->pd->err->code;
+        g_propagate_error(err, ip->pd->err);
+        ip->pd->err = NULL;
+        return code;
+    }
+
+    if (len == 0)
+        ip->finished = TRUE;
+
+    return CRE_OK;
+}
+
+static int
+cr_pkg_iterator_primary_pkgcb(cr_Package *pkg,
+                              void *cbdata,
+                              G_GNUC_UNUSED GError **err)
+{
+    cr_PkgIterator *iter = cbdata;
+
+    pkg->loadingflags |= CR_PACKAGE_FROM_XML;
+    pkg->loadingflags |= CR_PACKAGE_LOADED_PRI;
+    g_queue_push_tail(iter->queue, pkg);
+
+    return CR_CB_RET_OK;
+}
+
+/** Find the package which is expected in the filelists or other.
+ * If primary.xml is behind, parse it further.
+ */
+static int
+cr_pkg_iterator_newpkg(cr_PkgIterator *iter,
+                       cr_PkgIteratorFile type,
+                       cr_Package **pkg,
+                       const char *pkgId,
+                       GError **err)
+{
+    cr_PackageLoadingFlags flag = (type == ITER_FIL) ? CR_PACKAGE_LOADED_FIL
+                                                     : CR_PACKAGE_LOADED_OTH;
+
+    while (1) {
+        for (GList *elem = iter->queue->head; elem; elem = g_list_next(elem)) {
+            cr_Package *cur = elem->data;
+            if (cur->loadingflags & flag)
+                continue;
+
+            if (g_strcmp0(cur->pkgId, pkgId)) {
+                g_set_error(err, ERR_DOMAIN, CRE_XMLDATA,
+                            "Package %s from %s is not on the same position "
+                            "in primary.xml (expected %s) - "
+                            "The files must have the same order of packages",
+                            pkgId, file_names[type], cur->pkgId);
+                return CR_CB_RET_ERR;
+            }
+
+            *pkg = cur;
+            return CR_CB_RET_OK;
+        }
+
+        if (iter->parsers[ITER_PRI].finished)
+            break;
+
+        if (cr_pkg_iterator_feed(iter, ITER_PRI, err) != CRE_OK)
+            return CR_CB_RET_ERR;
+    }
+
+    g_set_error(err, ERR_DOMAIN, CRE_XMLDATA,
+                "Package %s from %s is missing in primary.xml",
+                pkgId, file_names[type]);
+    return CR_CB_RET_ERR;
+}
+
+static int
+cr_pkg_iterator_filelists_newpkgcb(cr_Package **pkg,
+                                   const char *pkgId,
+                                   G_GNUC_UNUSED const char *name,
+                                   G_GNUC_UNUSED const char *arch,
+                                   void *cbdata,
+                                   GError **err)
+{
+    return cr_pkg_iterator_newpkg(cbdata, ITER_FIL, pkg, pkgId, err);
+}
+
+static int
+cr_pkg_iterator_other_newpkgcb(cr_Package **pkg,
+                               const char *pkgId,
+                               G_GNUC_UNUSED const char *name,
+                               G_GNUC_UNUSED const char *arch,
+                               void *cbdata,
+                               GError **err)
+{
+    return cr_pkg_iterator_newpkg(cbdata, ITER_OTH, pkg, pkgId, err);
+}
+
+static int
+cr_pkg_iterator_filelists_pkgcb(cr_Package *pkg,
+                                G_GNUC_UNUSED void *cbdata,
+                                G_GNUC_UNUSED GError **err)
+{
+    pkg->loadingflags |= CR_PACKAGE_LOADED_FIL;
+    return CR_CB_RET_OK;
+}
+
+static int
+cr_pkg_iterator_other_pkgcb(cr_Package *pkg,
+                            G_GNUC_UNUSED void *cbdata,
+                            G_GNUC_UNUSED GError **err)
+{
+    pkg->loadingflags |= CR_PACKAGE_LOADED_OTH;
+    return CR_CB_RET_OK;
+}
+
+cr_PkgIterator *
+cr_pkg_iterator_new(const char *primary_path,
+                    const char *filelists_path,
+                    const char *other_path,
+                    cr_XmlParserWarningCb warningcb,
+                    void *warningcb_data,
+                    GError **err)
+{
+    cr_PkgIterator *iter;
+    const char *paths[ITER_SENTINEL] = {
+        primary_path, filelists_path, other_path
+    };
+
+    assert(primary_path);
+    assert(!err || *err == NULL);
+
+    iter = g_new0(cr_PkgIterator, 1);
+    iter->queue = g_queue_new();
+
+    for (int x = 0; x < ITER_SENTINEL; x++) {
+        cr_PkgIteratorParser *ip = &iter->parsers[x];
+        GError *tmp_err = NULL;
+
+        if (!paths[x]) {
+            ip->finished = TRUE;
+            continue;
+        }
+
+        ip->path = g_strdup(paths[x]);
+        ip->f = cr_open(paths[x],
+                        CR_CW_MODE_READ,
+                        CR_CW_AUTO_DETECT_COMPRESSION,
+                        &tmp_err);
+        if (tmp_err) {
+            g_propagate_prefixed_error(err, tmp_err,
+                                       "Cannot open %s: ", paths[x]);
+            cr_pkg_iterator_free(iter);
+            return NULL;
+        }
+
+        switch (x) {
+            case ITER_PRI:
+                ip->pd = cr_xml_parser_primary_new(&ip->parser,
+                                        NULL,
+                                        NULL,
+                                        cr_pkg_iterator_primary_pkgcb,
+                                        iter,
+                                        warningcb,
+                                        warningcb_data,
+                                        filelists_path ? 0 : 1);
+                break;
+            case ITER_FIL:
+                ip->pd = cr_xml_parser_filelists_new(&ip->parser,
+                                        cr_pkg_iterator_filelists_newpkgcb,
+                                        iter,
+                                        cr_pkg_iterator_filelists_pkgcb,
+                                        iter,
+                                        warningcb,
+                                        warningcb_data);
+                break;
+            default:
+                ip->pd = cr_xml_parser_other_new(&ip->parser,
+                                        cr_pkg_iterator_other_newpkgcb,
+                                        iter,
+                                        cr_pkg_iterator_other_pkgcb,
+                                        iter,
+                                        warningcb,
+                                        warningcb_data);
+                break;
+        }
+    }
+
+    return iter;
+}
+
+cr_Package *
+cr_pkg_iterator_next(cr_PkgIterator *iter, GError **err)
+{
+    assert(iter);
+    assert(!err || *err == NULL);
+
+    while (!iter->finished) {
+        cr_PkgIteratorFile type;
+        cr_Package *pkg = g_queue_peek_head(iter->queue);
+
+        if (!pkg) {
+            if (iter->parsers[ITER_PRI].finished) {
+                iter->finished = TRUE;
+                break;
+            }
+            type = ITER_PRI;
+        } else if (!(pkg->loadingflags & CR_PACKAGE_LOADED_FIL)
+                   && !iter->parsers[ITER_FIL].finished) {
+            type = ITER_FIL;
+        } else if (!(pkg->loadingflags & CR_PACKAGE_LOADED_OTH)
+                   && !iter->parsers[ITER_OTH].finished) {
+            type = ITER_OTH;
+        } else {
+            // The package is complete
+            return g_queue_pop_head(iter->queue);
+        }
+
+        if (cr_pkg_iterator_feed(iter, type, err) != CRE_OK) {
+            iter->finished = TRUE;
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+gboolean
+cr_pkg_iterator_is_finished(cr_PkgIterator *iter)
+{
+    assert(iter);
+    return iter->finished;
+}
+
+void
+cr_pkg_iterator_free(cr_PkgIterator *iter)
+{
+    if (!iter)
+        return;
+
+    for (int x = 0; x < ITER_SENTINEL; x++) {
+        cr_PkgIteratorParser *ip = &iter->parsers[x];
+
+        if (ip->pd) {
+            // Package in the middle of the primary.xml parsing is not
+            // in the queue yet. Filelists and other only point into the queue.
+            if (x == ITER_PRI)
+                cr_package_free(ip->pd->pkg);
+            g_clear_error(&ip->pd->err);
+            cr_xml_parser_data_free(ip->pd);
+            XML_ParserFree(ip->parser);
+        }
+        if (ip->f)
+            cr_close(ip->f, NULL);
+        g_free(ip->path);
+    }
+
+    for (GList *elem = iter->queue->head; elem; elem = g_list_next(elem))
+        cr_package_free(elem->data);
+    g_queue_free(iter->queue);
+    g_free(iter);
+}
@@ -29,6 +29,7 @@
 #include "error.h"
 #include "package.h"
 #include "misc.h"
+#include "string_pool.h"
 
 #define ERR_DOMAIN      CREATEREPO_C_ERROR
 #define ERR_CODE_XML    CRE_BADXMLPRIMARY
@@ -76,10 +77,8 @@ typedef enum {
 } cr_PriState;
 
 /* NOTE: Same states in the first column must be together!!!
- * Performance tip: More frequent elements shoud be listed
- * first in its group (eg: element "package" (STATE_PACKAGE)
- * has a "file" element listed first, because it is more frequent
- * than other elements). */
+ * Sub-tags of a state are found by a perfect hash built by
+ * cr_xml_parser_set_states(), their order doesn't matter. */
 static cr_StatesSwitch stateswitches[] = {
     { STATE_START,          "metadata",         STATE_METADATA,         0 },
     { STATE_METADATA,       "package",          STATE_PACKAGE,          0 },
@@ -121,6 +120,11 @@ static cr_StatesSwitch stateswitches[] = {
     { NUMSTATES,            NULL,               NUMSTATES,              0 },
 };
 
+/* Attributes looked up together by cr_find_attrs() */
+static const char * const version_attrs[] = { "epoch", "ver", "rel" };
+static const char * const entry_attrs[] = { "name", "flags", "epoch",
+                                            "ver", "rel", "pre" };
+
 static void XMLCALL
 cr_start_handler(void *pdata, const char *element, const char **attr)
 {
@@ -147,10 +151,8 @@ cr_start_handler(void *pdata, const char *element, const char **attr)
         return;  // Do not parse current package tag and its content
 
     // Find current state by its name
-    for (sw = pd->swtab[pd->state]; sw->from == pd->state; sw++)
-        if (!strcmp(element, sw->ename))
-            break;
-    if (sw->from != pd->state) {
+    sw = cr_xml_parser_find_state(pd, element);
+    if (!sw) {
         // No state for current element (unknown element)
         cr_xml_parser_warning(pd, CR_XML_WARNING_UNKNOWNTAG,
                               "Unknown element \"%s\"", element);
@@ -218,15 +220,19 @@ cr_start_handler(void *pdata, const char *element, const char **attr)
         // Version strings insert only if them don't already exists
         // They could be already filled by filelists or other parser.
 
-        if (!pd->pkg->epoch)
-            pd->pkg->epoch = cr_safe_string_chunk_insert(pd->pkg->chunk,
-                                            cr_find_attr("epoch", attr));
-        if (!pd->pkg->version)
-            pd->pkg->version = cr_safe_string_chunk_insert(pd->pkg->chunk,
-                                            cr_find_attr("ver", attr));
-        if (!pd->pkg->release)
-            pd->pkg->release = cr_safe_string_chunk_insert(pd->pkg->chunk,
-                                            cr_find_attr("rel", attr));
+        {
+            const char *vals[3];
+            cr_find_attrs(attr, version_attrs, vals, 3);
+            if (!pd->pkg->epoch)
+                pd->pkg->epoch = cr_string_pool_chunk_insert(pd->pkg->chunk,
+                                                             vals[0]);
+            if (!pd->pkg->version)
+                pd->pkg->version = cr_string_pool_chunk_insert(pd->pkg->chunk,
+                                                               vals[1]);
+            if (!pd->pkg->release)
+                pd->pkg->release = cr_string_pool_chunk_insert(pd->pkg->chunk,
+                                                               vals[2]);
+        }
         break;
 
     case STATE_CHECKSUM:
@@ -236,7 +242,7 @@ cr_start_handler(void *pdata, const char *element, const char **attr)
             cr_xml_parser_warning(pd, CR_XML_WARNING_MISSINGATTR,
                         "Missing attribute \"type\" of a checksum element");
         else
-            pd->pkg->checksum_type = g_string_chunk_insert(pd->pkg->chunk, val);
+            pd->pkg->checksum_type = cr_string_pool_chunk_insert(pd->pkg->chunk, val);
         break;
 
     case STATE_SUMMARY:
@@ -355,33 +361,31 @@ cr_start_handler(void *pdata, const char *element, const char **attr)
         assert(pd->pkg);
 
         cr_Dependency *dep = cr_dependency_new();
+        const char *vals[6];
 
-        val = cr_find_attr("name", attr);
-        if (!val)
+        cr_find_attrs(attr, entry_attrs, vals, 6);
+
+        if (!vals[0])
             cr_xml_parser_warning(pd, CR_XML_WARNING_MISSINGATTR,
                         "Missing attribute \"name\" of an entry element");
         else
-            dep->name = g_string_chunk_insert(pd->pkg->chunk, val);
+            dep->name = cr_string_pool_chunk_insert(pd->pkg->chunk, vals[0]);
 
         // Rest of attrs is optional
 
-        val = cr_find_attr("flags", attr);
-        if (val)
-            dep->flags = g_string_chunk_insert(pd->pkg->chunk, val);
+        if (vals[1])
+            dep->flags = cr_string_pool_chunk_insert(pd->pkg->chunk, vals[1]);
 
-        val = cr_find_attr("epoch", attr);
-        if (val)
-            dep->epoch = g_string_chunk_insert(pd->pkg->chunk, val);
+        if (vals[2])
+            dep->epoch = cr_string_pool_chunk_insert(pd->pkg->chunk, vals[2]);
 
-        val = cr_find_attr("ver", attr);
-        if (val)
-            dep->version = g_string_chunk_insert(pd->pkg->chunk, val);
+        if (vals[3])
+            dep->version = cr_string_pool_chunk_insert(pd->pkg->chunk, vals[3]);
 
-        val = cr_find_attr("rel", attr);
-        if (val)
-            dep->release = g_string_chunk_insert(pd->pkg->chunk, val);
+        if (vals[4])
+            dep->release = cr_string_pool_chunk_insert(pd->pkg->chunk, vals[4]);
 
-        val = cr_find_attr("pre", attr);
+        val = vals[5];
         if (val) {
             if (!strcmp(val, "0") ||
                 !strcmp(val, "FALSE") ||
@@ -550,7 +554,7 @@ cr_end_handler(void *pdata, G_GNUC_UNUSED const char *element)
 
     case STATE_PACKAGER:
         assert(pd->pkg);
-        pd->pkg->rpm_packager = cr_safe_string_chunk_insert_null(pd->pkg->chunk,
+        pd->pkg->rpm_packager = cr_string_pool_chunk_insert_null(pd->pkg->chunk,
                                                                  pd->content);
         break;
 
@@ -562,31 +566,31 @@ cr_end_handler(void *pdata, G_GNUC_UNUSED const char *element)
 
     case STATE_RPM_LICENSE:
         assert(pd->pkg);
-        pd->pkg->rpm_license = cr_safe_string_chunk_insert_null(pd->pkg->chunk,
+        pd->pkg->rpm_license = cr_string_pool_chunk_insert_null(pd->pkg->chunk,
                                                                 pd->content);
         break;
 
     case STATE_RPM_VENDOR:
         assert(pd->pkg);
-        pd->pkg->rpm_vendor = cr_safe_string_chunk_insert_null(pd->pkg->chunk,
+        pd->pkg->rpm_vendor = cr_string_pool_chunk_insert_null(pd->pkg->chunk,
                                                                pd->content);
         break;
 
     case STATE_RPM_GROUP:
         assert(pd->pkg);
-        pd->pkg->rpm_group = cr_safe_string_chunk_insert_null(pd->pkg->chunk,
+        pd->pkg->rpm_group = cr_string_pool_chunk_insert_null(pd->pkg->chunk,
                                                               pd->content);
         break;
 
     case STATE_RPM_BUILDHOST:
         assert(pd->pkg);
-        pd->pkg->rpm_buildhost = cr_safe_string_chunk_insert_null(pd->pkg->chunk,
+        pd->pkg->rpm_buildhost = cr_string_pool_chunk_insert_null(pd->pkg->chunk,
                                                                   pd->content);
         break;
 
     case STATE_RPM_SOURCERPM:
         assert(pd->pkg);
-        pd->pkg->rpm_sourcerpm = cr_safe_string_chunk_insert_null(pd->pkg->chunk,
+        pd->pkg->rpm_sourcerpm = cr_string_pool_chunk_insert_null(pd->pkg->chunk,
                                                                   pd->content);
         break;
 
@@ -635,8 +639,11 @@ cr_end_handler(void *pdata, G_GNUC_UNUSED const char *element)
         pkg_file->name = cr_safe_string_chunk_insert(pd->pkg->chunk,
                                                 cr_get_filename(pd->content));
         pd->content[pd->lcontent - strlen(pkg_file->name)] = '\0';
-        pkg_file->path = cr_safe_string_chunk_insert_const(pd->pkg->chunk,
-                                                           pd->content);
+        pkg_file->path = cr_string_pool_get_default()
+                         ? cr_string_pool_chunk_insert(pd->pkg->chunk,
+                                                       pd->content)
+                         : cr_safe_string_chunk_insert_const(pd->pkg->chunk,
+                                                             pd->content);
         switch (pd->last_file_type) {
             case FILE_FILE:  pkg_file->type = NULL;    break; // NULL => "file"
             case FILE_DIR:   pkg_file->type = "dir";   break;
@@ -653,37 +660,30 @@ cr_end_handler(void *pdata, G_GNUC_UNUSED const char *element)
     }
 }
 
-int
-cr_xml_parse_primary(const char *path,
-                     cr_XmlParserNewPkgCb newpkgcb,
-                     void *newpkgcb_data,
-                     cr_XmlParserPkgCb pkgcb,
-                     void *pkgcb_data,
-                     cr_XmlParserWarningCb warningcb,
-                     void *warningcb_data,
-                     int do_files,
-                     GError **err)
+cr_ParserData *
+cr_xml_parser_primary_new(XML_Parser *parser,
+                          cr_XmlParserNewPkgCb newpkgcb,
+                          void *newpkgcb_data,
+                          cr_XmlParserPkgCb pkgcb,
+                          void *pkgcb_data,
+                          cr_XmlParserWarningCb warningcb,
+                          void *warningcb_data,
+                          int do_files)
 {
-    int ret = CRE_OK;
     cr_ParserData *pd;
-    XML_Parser parser;
-    GError *tmp_err = NULL;
 
-    assert(path);
+    assert(parser);
     assert(newpkgcb || pkgcb);
-    assert(!err || *err == NULL);
 
     if (!newpkgcb)  // Use default newpkgcb
         newpkgcb = cr_newpkgcb;
 
-    // Init
-
-    parser = XML_ParserCreate(NULL);
-    XML_SetElementHandler(parser, cr_start_handler, cr_end_handler);
-    XML_SetCharacterDataHandler(parser, cr_char_handler);
+    *parser = XML_ParserCreate(NULL);
+    XML_SetElementHandler(*parser, cr_start_handler, cr_end_handler);
+    XML_SetCharacterDataHandler(*parser, cr_char_handler);
 
     pd = cr_xml_parser_data(NUMSTATES);
-    pd->parser = &parser;
+    pd->parser = parser;
     pd->state = STATE_START;
     pd->newpkgcb_data = newpkgcb_data;
     pd->newpkgcb = newpkgcb;
@@ -692,17 +692,52 @@ cr_xml_parse_primary(const char *path,
     pd->do_files = do_files;
     pd->warningcb = warningcb;
     pd->warningcb_data = warningcb_data;
-    for (cr_StatesSwitch *sw = stateswitches; sw->from != NUMSTATES; sw++) {
-        if (!pd->swtab[sw->from])
-            pd->swtab[sw->from] = sw;
-        pd->sbtab[sw->to] = sw->from;
-    }
+    cr_xml_parser_set_states(pd, stateswitches);
+
+    XML_SetUserData(*parser, pd);
+    cr_xml_parser_profile_attach(*parser, pd, cr_start_handler, cr_end_handler);
+
+    return pd;
+}
+
+static int
+cr_xml_parse_primary_internal(const char *target,
+                              cr_XmlParserNewPkgCb newpkgcb,
+                              void *newpkgcb_data,
+                              cr_XmlParserPkgCb pkgcb,
+                              void *pkgcb_data,
+                              cr_XmlParserWarningCb warningcb,
+                              void *warningcb_data,
+                              int do_files,
+                              cr_XmlParserGenericFunc parser_func,
+                              GError **err)
+{
+    int ret = CRE_OK;
+    cr_ParserData *pd;
+    XML_Parser parser;
+    GError *tmp_err = NULL;
+
+    assert(target);
+    assert(newpkgcb || pkgcb);
+    assert(!err || *err == NULL);
+
+    if (!newpkgcb)  // Use default newpkgcb
+        newpkgcb = cr_newpkgcb;
 
-    XML_SetUserData(parser, pd);
+    // Init
+
+    pd = cr_xml_parser_primary_new(&parser,
+                                   newpkgcb,
+                                   newpkgcb_data,
+                                   pkgcb,
+                                   pkgcb_data,
+                                   warningcb,
+                                   warningcb_data,
+                                   do_files);
 
     // Parsing
 
-    ret = cr_xml_parser_generic(parser, pd, path, &tmp_err);
+    ret = parser_func(parser, pd, target, &tmp_err);
     if (tmp_err)
         g_propagate_error(err, tmp_err);
 
@@ -731,3 +766,533 @@ cr_xml_parse_primary(const char *path,
 
     return ret;
 }
+
+int
+cr_xml_parse_primary(const char *path,
+                     cr_XmlParserNewPkgCb newpkgcb,
+                     void *newpkgcb_data,
+                     cr_XmlParserPkgCb pkgcb,
+                     void *pkgcb_data,
+                     cr_XmlParserWarningCb warningcb,
+                     void *warningcb_data,
+                     int do_files,
+                     GError **err)
+{
+    return cr_xml_parse_primary_internal(path,
+                                         newpkgcb,
+                                         newpkgcb_data,
+                                         pkgcb,
+                                         pkgcb_data,
+                                         warningcb,
+                                         warningcb_data,
+                                         do_files,
+                                         cr_xml_parser_generic,
+                                         err);
+}
+
+int
+cr_xml_parse_primary_snippet(const char *xml_string,
+                             cr_XmlParserNewPkgCb newpkgcb,
+                             void *newpkgcb_data,
+                             cr_XmlParserPkgCb pkgcb,
+                             void *pkgcb_data,
+                             cr_XmlParserWarningCb warningcb,
+                             void *warningcb_data,
+                             int do_files,
+                             GError **err)
+{
+    int ret;
+    gchar *wrapped;
+
+    assert(xml_string);
+
+    // The snippet contains only <package> elements, the parser
+    // expects them inside of the main element
+    wrapped = g_strconcat("<metadata>", xml_string, "</metadata>", NULL);
+    ret = cr_xml_parse_primary_internal(wrapped,
+                                        newpkgcb,
+                                        newpkgcb_data,
+                                        pkgcb,
+                                        pkgcb_data,
+                                        warningcb,
+                                        warningcb_data,
+                                        do_files,
+                                        cr_xml_parser_generic_from_string,
+                                        err);
+    g_free(wrapped);
+
+    return ret;
+}
+
+/* Parallel parsing
+ *
+ * The calling thread reads the (decompressed) document and splits it
+ * into segments at "<package" boundaries. Segments are parsed by
+ * independent expat parsers in a thread pool. Parsed packages and
+ * warnings are collected per segment and delivered to the user
+ * callbacks by the calling thread, segment after segment, so the user
+ * sees them in the document order and never from another thread.
+ */
+
+#define PARALLEL_SEGMENT_SIZE   (2*1024*1024)
+#define PARALLEL_READ_SIZE      (256*1024)
+#define PARALLEL_MAIN_TAG       "<metadata>"
+#define PARALLEL_MAIN_END_TAG   "</metadata>"
+
+typedef struct {
+    cr_Package *pkg;        /*!< Parsed package or NULL for a warning */
+    cr_XmlParserWarningType warning_type;
+    char *warning;
+} ParallelItem;
+
+typedef struct {
+    GString *data;          /*!< Text of the segment (<package> elements) */
+    gint64 offset;          /*!< Offset of the segment in the document */
+    GArray *items;          /*!< ParallelItem in the document order */
+    int ret;
+    GError *err;
+    gboolean done;
+} ParallelSegment;
+
+typedef struct {
+    int do_files;
+    gboolean abort;         /*!< Skip parsing of queued segments */
+    GMutex *mutex;
+    GCond *cond;
+    GQueue *segments;       /*!< Pushed but not yet delivered segments */
+
+    cr_XmlParserNewPkgCb newpkgcb;
+    void *newpkgcb_data;
+    cr_XmlParserPkgCb pkgcb;
+    void *pkgcb_data;
+    cr_XmlParserWarningCb warningcb;
+    void *warningcb_data;
+} ParallelCtx;
+
+static int
+parallel_pkgcb(cr_Package *pkg, void *cbdata, G_GNUC_UNUSED GError **err)
+{
+    ParallelSegment *seg = cbdata;
+    ParallelItem item = { pkg, 0, NULL };
+    g_array_append_val(seg->items, item);
+    return CR_CB_RET_OK;
+}
+
+static int
+parallel_warningcb(cr_XmlParserWarningType type,
+                   char *msg,
+                   void *cbdata,
+                   G_GNUC_UNUSED GError **err)
+{
+    ParallelSegment *seg = cbdata;
+    ParallelItem item = { NULL, type, g_strdup(msg) };
+    g_array_append_val(seg->items, item);
+    return CR_CB_RET_OK;
+}
+
+static int
+parallel_parse_segment(XML_Parser parser,
+                       cr_ParserData *pd,
+                       ParallelSegment *seg,
+                       GError **err)
+{
+    if (!XML_Parse(parser, PARALLEL_MAIN_TAG, strlen(PARALLEL_MAIN_TAG), 0)
+        || !XML_Parse(parser, seg->data->str, seg->data->len, 0)
+        || !XML_Parse(parser, PARALLEL_MAIN_END_TAG,
+                      strlen(PARALLEL_MAIN_END_TAG), 1))
+    {
+        g_set_error(err, ERR_DOMAIN, CRE_XMLPARSER,
+                    "Parse error at line: %d of a segment starting "
+                    "at offset %"G_GINT64_FORMAT" (%s)",
+                    (int) XML_GetCurrentLineNumber(parser),
+                    seg->offset,
+                    (char *) XML_ErrorString(XML_GetErrorCode(parser)));
+        return CRE_XMLPARSER;
+    }
+
+    if (pd->err) {
+        int ret = pd->err->code;
+        g_propagate_error(err, pd->err);
+        pd->err = NULL;
+        return ret;
+    }
+
+    return CRE_OK;
+}
+
+static void
+parallel_worker(gpointer data, gpointer user_data)
+{
+    ParallelSegment *seg = data;
+    ParallelCtx *ctx = user_data;
+
+    if (!g_atomic_int_get(&ctx->abort)) {
+        XML_Parser parser;
+        cr_ParserData *pd;
+
+        pd = cr_xml_parser_primary_new(&parser,
+                                       NULL,
+                                       NULL,
+                                       parallel_pkgcb,
+                                       seg,
+                                       parallel_warningcb,
+                                       seg,
+                                       ctx->do_files);
+        seg->ret = parallel_parse_segment(parser, pd, seg, &seg->err);
+        if (seg->ret != CRE_OK)
+            cr_package_free(pd->pkg);
+        cr_xml_parser_data_free(pd);
+        XML_ParserFree(parser);
+    }
+
+    g_string_free(seg->data, TRUE);
+    seg->data = NULL;
+
+    g_mutex_lock(ctx->mutex);
+    seg->done = TRUE;
+    g_cond_broadcast(ctx->cond);
+    g_mutex_unlock(ctx->mutex);
+}
+
+static void
+parallel_segment_free(ParallelSegment *seg)
+{
+    for (guint x = 0; x < seg->items->len; x++) {
+        ParallelItem *item = &g_array_index(seg->items, ParallelItem, x);
+        cr_package_free(item->pkg);
+        g_free(item->warning);
+    }
+    g_array_free(seg->items, TRUE);
+    g_clear_error(&seg->err);
+    g_free(seg);
+}
+
+static int
+parallel_interrupted(GError *tmp_err, GError **err)
+{
+    if (tmp_err)
+        g_propagate_prefixed_error(err, tmp_err, "Parsing interrupted: ");
+    else
+        g_set_error(err, ERR_DOMAIN, CRE_CBINTERRUPTED, "Parsing interrupted");
+    return CRE_CBINTERRUPTED;
+}
+
+static int
+parallel_deliver_item(ParallelCtx *ctx, ParallelItem *item, GError **err)
+{
+    GError *tmp_err = NULL;
+    cr_Package *pkg = item->pkg;
+
+    if (!pkg) {
+        if (ctx->warningcb && ctx->warningcb(item->warning_type,
+                                             item->warning,
+                                             ctx->warningcb_data,
+                                             &tmp_err))
+            return parallel_interrupted(tmp_err, err);
+        return CRE_OK;
+    }
+
+    item->pkg = NULL;
+
+    if (ctx->newpkgcb) {
+        // The package was parsed into a package of our own,
+        // copy it into the one provided by the user
+        cr_Package *user_pkg = NULL;
+
+        if (ctx->newpkgcb(&user_pkg, NULL, NULL, NULL,
+                          ctx->newpkgcb_data, &tmp_err))
+        {
+            cr_package_free(pkg);
+            return parallel_interrupted(tmp_err, err);
+        }
+
+        if (!user_pkg) {
+            // Skip the package
+            cr_package_free(pkg);
+            return CRE_OK;
+        }
+
+        if (cr_package_copy_into(user_pkg, pkg, &tmp_err) != CRE_OK) {
+            cr_package_free(pkg);
+            g_propagate_error(err, tmp_err);
+            return CRE_BADARG;
+        }
+        cr_package_free(pkg);
+        pkg = user_pkg;
+    }
+
+    if (ctx->pkgcb && ctx->pkgcb(pkg, ctx->pkgcb_data, &tmp_err))
+        return parallel_interrupted(tmp_err, err);
+
+    assert(tmp_err == NULL);
+    return CRE_OK;
+}
+
+/** Wait for the oldest segment and deliver its content.
+ */
+static int
+parallel_deliver(ParallelCtx *ctx, GError **err)
+{
+    int ret = CRE_OK;
+    ParallelSegment *seg = g_queue_pop_head(ctx->segments);
+
+    g_mutex_lock(ctx->mutex);
+    while (!seg->done)
+        g_cond_wait(ctx->cond, ctx->mutex);
+    g_mutex_unlock(ctx->mutex);
+
+    for (guint x = 0; x < seg->items->len && ret == CRE_OK; x++)
+        ret = parallel_deliver_item(ctx,
+                                    &g_array_index(seg->items, ParallelItem, x),
+                                    err);
+
+    if (ret == CRE_OK && seg->ret != CRE_OK) {
+        ret = seg->ret;
+        g_propagate_error(err, seg->err);
+        seg->err = NULL;
+    }
+
+    parallel_segment_free(seg);
+    return ret;
+}
+
+/** Return TRUE if the element at the position is a start tag of package.
+ */
+static inline gboolean
+parallel_is_boundary(const char *str, gsize pos, gsize len)
+{
+    static const char tag[] = "<package";
+    gsize taglen = sizeof(tag) - 1;
+
+    if (pos + taglen >= len || memcmp(str + pos, tag, taglen))
+        return FALSE;
+
+    // Do not match <packager>
+    char c = str[pos + taglen];
+    return c == '>' || c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static gssize
+parallel_first_boundary(const char *str, gsize len)
+{
+    for (const char *p = str; (p = memchr(p, '<', len - (p - str))); p++)
+        if (parallel_is_boundary(str, p - str, len))
+            return p - str;
+    return -1;
+}
+
+/** Return TRUE if only whitespaces are between the end of a previous
+ * package element and the position. Packages inside of unknown
+ * elements are not split this way.
+ */
+static inline gboolean
+parallel_follows_package(const char *str, gsize pos)
+{
+    static const char tag[] = "</package>";
+    gsize taglen = sizeof(tag) - 1;
+
+    while (pos > 0 && g_ascii_isspace(str[pos - 1]))
+        pos--;
+
+    return pos >= taglen && !memcmp(str + pos - taglen, tag, taglen);
+}
+
+static gssize
+parallel_last_boundary(const char *str, gsize len)
+{
+    for (gsize pos = len; pos-- > 0;)
+        if (str[pos] == '<' && parallel_is_boundary(str, pos, len)
+            && parallel_follows_package(str, pos))
+            return pos;
+    return -1;
+}
+
+static void
+parallel_push(ParallelCtx *ctx,
+              GThreadPool *pool,
+              GString *buf,
+              gsize len,
+              gint64 offset)
+{
+    ParallelSegment *seg = g_new0(ParallelSegment, 1);
+    seg->data = g_string_new_len(buf->str, len);
+    seg->offset = offset;
+    seg->items = g_array_new(FALSE, FALSE, sizeof(ParallelItem));
+    seg->ret = CRE_OK;
+    g_string_erase(buf, 0, len);
+
+    g_queue_push_tail(ctx->segments, seg);
+    g_thread_pool_push(pool, seg, NULL);
+}
+
+int
+cr_xml_parse_primary_parallel(const char *path,
+                              cr_XmlParserNewPkgCb newpkgcb,
+                              void *newpkgcb_data,
+                              cr_XmlParserPkgCb pkgcb,
+                              void *pkgcb_data,
+                              cr_XmlParserWarningCb warningcb,
+                              void *warningcb_data,
+                              int do_files,
+                              int workers,
+                              GError **err)
+{
+    int ret = CRE_OK;
+    CR_FILE *f;
+    GString *buf;
+    GThreadPool *pool;
+    ParallelCtx ctx;
+    gboolean header_done = FALSE;
+    gboolean fallback = FALSE;
+    gint64 offset = 0;
+    GError *tmp_err = NULL;
+
+    assert(path);
+    assert(newpkgcb || pkgcb);
+    assert(!err || *err == NULL);
+
+    if (workers < 2)
+        return cr_xml_parse_primary(path, newpkgcb, newpkgcb_data,
+                                    pkgcb, pkgcb_data,
+                                    warningcb, warningcb_data,
+                                    do_files, err);
+
+    f = cr_open(path, CR_CW_MODE_READ, CR_CW_AUTO_DETECT_COMPRESSION, &tmp_err);
+    if (tmp_err) {
+        int code = tmp_err->code;
+        g_propagate_prefixed_error(err, tmp_err, "Cannot open %s: ", path);
+        return code;
+    }
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.do_files        = do_files;
+    ctx.mutex           = g_mutex_new();
+    ctx.cond            = g_cond_new();
+    ctx.segments        = g_queue_new();
+    ctx.newpkgcb        = newpkgcb;
+    ctx.newpkgcb_data   = newpkgcb_data;
+    ctx.pkgcb           = pkgcb;
+    ctx.pkgcb_data      = pkgcb_data;
+    ctx.warningcb       = warningcb;
+    ctx.warningcb_data  = warningcb_data;
+
+    pool = g_thread_pool_new(parallel_worker, &ctx, workers, TRUE, NULL);
+    buf = g_string_sized_new(PARALLEL_SEGMENT_SIZE + PARALLEL_READ_SIZE);
+
+    while (ret == CRE_OK) {
+        gsize old_len = buf->len;
+        int len;
+
+        g_string_set_size(buf, old_len + PARALLEL_READ_SIZE);
+        len = cr_read(f, buf->str + old_len, PARALLEL_READ_SIZE, &tmp_err);
+        if (tmp_err) {
+            ret = tmp_err->code;
+            g_propagate_prefixed_error(err, tmp_err, "Read error: ");
+            break;
+        }
+        g_string_set_size(buf, old_len + len);
+
+        if (!header_done) {
+            gssize pos = parallel_first_boundary(buf->str, buf->len);
+
+            if (pos < 0) {
+                // No package yet - an empty repo or not a primary.xml,
+                // leave it to the sequential parser
+                if (len == 0 || buf->len > PARALLEL_SEGMENT_SIZE)
+                    fallback = TRUE;
+                if (fallback)
+                    break;
+                continue;
+            }
+
+            // Check the root element and deliver warnings of the header
+            // by the sequential parser
+            gchar *header = g_strndup(buf->str, pos);
+            if (!strstr(header, "<metadata")) {
+                g_free(header);
+                fallback = TRUE;
+                break;
+            }
+            gchar *wrapped = g_strconcat(header, PARALLEL_MAIN_END_TAG, NULL);
+            g_free(header);
+            ret = cr_xml_parse_primary_internal(wrapped,
+                                                newpkgcb,
+                                                newpkgcb_data,
+                                                pkgcb,
+                                                pkgcb_data,
+                                                warningcb,
+                                                warningcb_data,
+                                                do_files,
+                                                cr_xml_parser_generic_from_string,
+                                                err);
+            g_free(wrapped);
+            if (ret != CRE_OK)
+                break;
+
+            g_string_erase(buf, 0, pos);
+            offset += pos;
+            header_done = TRUE;
+        }
+
+        if (len == 0) {
+            // Last segment ends before the closing tag of the main element
+            gchar *end = g_strrstr_len(buf->str, buf->len,
+                                       PARALLEL_MAIN_END_TAG);
+            if (!end) {
+                ret = CRE_XMLPARSER;
+                g_set_error(err, ERR_DOMAIN, CRE_XMLPARSER,
+                            "Parse error '%s': Missing %s",
+                            path, PARALLEL_MAIN_END_TAG);
+                break;
+            }
+            if (end > buf->str)
+                parallel_push(&ctx, pool, buf, end - buf->str, offset);
+            break;
+        }
+
+        while (buf->len >= PARALLEL_SEGMENT_SIZE) {
+            gssize pos = parallel_last_boundary(buf->str, buf->len);
+            if (pos <= 0)
+                break;  // A package bigger than the segment size
+            parallel_push(&ctx, pool, buf, pos, offset);
+            offset += pos;
+        }
+
+        // Limit the number of segments in memory
+        while (ret == CRE_OK
+               && g_queue_get_length(ctx.segments) > (guint) workers * 2)
+            ret = parallel_deliver(&ctx, err);
+    }
+
+    while (ret == CRE_OK && !g_queue_is_empty(ctx.segments))
+        ret = parallel_deliver(&ctx, err);
+
+    // On error, let workers skip the rest and drop their results
+    g_atomic_int_set(&ctx.abort, TRUE);
+    g_thread_pool_free(pool, FALSE, TRUE);
+    while (!g_queue_is_empty(ctx.segments))
+        parallel_segment_free(g_queue_pop_head(ctx.segments));
+
+    g_queue_free(ctx.segments);
+    g_cond_free(ctx.cond);
+    g_mutex_free(ctx.mutex);
+    g_string_free(buf, TRUE);
+
+    if (ret != CRE_OK || fallback) {
+        cr_close(f, NULL);
+    } else {
+        cr_close(f, &tmp_err);
+        if (tmp_err) {
+            ret = tmp_err->code;
+            g_propagate_prefixed_error(err, tmp_err, "Error while closing: ");
+        }
+    }
+
+    if (fallback)
+        return cr_xml_parse_primary(path, newpkgcb, newpkgcb_data,
+                                    pkgcb, pkgcb_data,
+                                    warningcb, warningcb_data,
+                                    do_files, err);
+
+    return ret;
+}
@@ -57,10 +57,8 @@ typedef enum {
 } cr_RepomdState;
 
 /* NOTE: Same states in the first column must be together!!!
- * Performance tip: More frequent elements shoud be listed
- * first in its group (eg: element "package" (STATE_PACKAGE)
- * has a "file" element listed first, because it is more frequent
- * than a "version" element). */
+ * Sub-tags of a state are found by a perfect hash built by
+ * cr_xml_parser_set_states(), their order doesn't matter. */
 static cr_StatesSwitch stateswitches[] = {
     { STATE_START,      "repomd",              STATE_REPOMD,         0 },
     { STATE_REPOMD,     "revision",            STATE_REVISION,       1 },
@@ -105,10 +103,8 @@ cr_start_handler(void *pdata, const char *element, const char **attr)
     }
 
     // Find current state by its name
-    for (sw = pd->swtab[pd->state]; sw->from == pd->state; sw++)
-        if (!strcmp(element, sw->ename))
-            break;
-    if (sw->from != pd->state) {
+    sw = cr_xml_parser_find_state(pd, element);
+    if (!sw) {
         // No state for current element (unknown element)
         cr_xml_parser_warning(pd, CR_XML_WARNING_UNKNOWNTAG,
                               "Unknown element \"%s\"", element);
@@ -450,13 +446,10 @@ cr_xml_parse_repomd(const char *path,
     pd->repomd = repomd;
     pd->warningcb = warningcb;
     pd->warningcb_data = warningcb_data;
-    for (cr_StatesSwitch *sw = stateswitches; sw->from != NUMSTATES; sw++) {
-        if (!pd->swtab[sw->from])
-            pd->swtab[sw->from] = sw;
-        pd->sbtab[sw->to] = sw->from;
-    }
+    cr_xml_parser_set_states(pd, stateswitches);
 
     XML_SetUserData(parser, pd);
+    cr_xml_parser_profile_attach(parser, pd, cr_start_handler, cr_end_handler);
 
     // Parsing
 
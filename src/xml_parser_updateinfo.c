@@ -64,10 +64,8 @@ typedef enum {
 } cr_UpdateinfoState;
 
 /* NOTE: Same states in the first column must be together!!!
- * Performance tip: More frequent elements shoud be listed
- * first in its group (eg: element "package" (STATE_PACKAGE)
- * has a "file" element listed first, because it is more frequent
- * than a "version" element). */
+ * Sub-tags of a state are found by a perfect hash built by
+ * cr_xml_parser_set_states(), their order doesn't matter. */
 static cr_StatesSwitch stateswitches[] = {
     { STATE_START,      "updates",           STATE_UPDATES,           0 },
     { STATE_UPDATES,    "update",            STATE_UPDATE,            0 },
@@ -97,6 +95,10 @@ static cr_StatesSwitch stateswitches[] = {
     { NUMSTATES,        NULL, NUMSTATES, 0 }
 };
 
+/* Attributes looked up together by cr_find_attrs() */
+static const char * const package_attrs[] = { "name", "version", "release",
+                                              "epoch", "arch", "src" };
+
 static void XMLCALL
 cr_start_handler(void *pdata, const char *element, const char **attr)
 {
@@ -119,10 +121,8 @@ cr_start_handler(void *pdata, const char *element, const char **attr)
     }
 
     // Find current state by its name
-    for (sw = pd->swtab[pd->state]; sw->from == pd->state; sw++)
-        if (!strcmp(element, sw->ename))
-            break;
-    if (sw->from != pd->state) {
+    sw = cr_xml_parser_find_state(pd, element);
+    if (!sw) {
         // No state for current element (unknown element)
         cr_xml_parser_warning(pd, CR_XML_WARNING_UNKNOWNTAG,
                               "Unknown element \"%s\"", element);
@@ -170,13 +170,11 @@ cr_start_handler(void *pdata, const char *element, const char **attr)
         break;
 
     case STATE_UPDATE:
-        assert(pd->updateinfo);
         assert(!pd->updaterecord);
         assert(!pd->updatecollection);
         assert(!pd->updatecollectionpackage);
 
         rec = cr_updaterecord_new();
-        cr_updateinfo_apped_record(pd->updateinfo, rec);
         pd->updaterecord = rec;
 
         val = cr_find_attr("from", attr);
@@ -198,7 +196,6 @@ cr_start_handler(void *pdata, const char *element, const char **attr)
         break;
 
     case STATE_ISSUED:
-        assert(pd->updateinfo);
         assert(pd->updaterecord);
         assert(!pd->updatecollection);
         assert(!pd->updatecollectionpackage);
@@ -208,7 +205,6 @@ cr_start_handler(void *pdata, const char *element, const char **attr)
         break;
 
     case STATE_UPDATED:
-        assert(pd->updateinfo);
         assert(pd->updaterecord);
         assert(!pd->updatecollection);
         assert(!pd->updatecollectionpackage);
@@ -220,7 +216,6 @@ cr_start_handler(void *pdata, const char *element, const char **attr)
     case STATE_REFERENCE: {
         cr_UpdateReference *ref;
 
-        assert(pd->updateinfo);
         assert(pd->updaterecord);
         assert(!pd->updatecollection);
         assert(!pd->updatecollectionpackage);
@@ -248,7 +243,6 @@ cr_start_handler(void *pdata, const char *element, const char **attr)
     }
 
     case STATE_COLLECTION:
-        assert(pd->updateinfo);
         assert(pd->updaterecord);
         assert(!pd->updatecollection);
         assert(!pd->updatecollectionpackage);
@@ -264,7 +258,6 @@ cr_start_handler(void *pdata, const char *element, const char **attr)
         break;
 
     case STATE_PACKAGE:
-        assert(pd->updateinfo);
         assert(pd->updaterecord);
         assert(pd->updatecollection);
         assert(!pd->updatecollectionpackage);
@@ -273,34 +266,26 @@ cr_start_handler(void *pdata, const char *element, const char **attr)
         cr_updatecollection_append_package(collection, package);
         pd->updatecollectionpackage = package;
 
-        val = cr_find_attr("name", attr);
-        if (val)
-            package->name = g_string_chunk_insert(package->chunk, val);
-
-        val = cr_find_attr("version", attr);
-        if (val)
-            package->version = g_string_chunk_insert(package->chunk, val);
-
-        val = cr_find_attr("release", attr);
-        if (val)
-            package->release = g_string_chunk_insert(package->chunk, val);
-
-        val = cr_find_attr("epoch", attr);
-        if (val)
-            package->epoch = g_string_chunk_insert(package->chunk, val);
-
-        val = cr_find_attr("arch", attr);
-        if (val)
-            package->arch = g_string_chunk_insert(package->chunk, val);
-
-        val = cr_find_attr("src", attr);
-        if (val)
-            package->src = g_string_chunk_insert(package->chunk, val);
+        {
+            const char *vals[6];
+            cr_find_attrs(attr, package_attrs, vals, 6);
+            if (vals[0])
+                package->name = g_string_chunk_insert(package->chunk, vals[0]);
+            if (vals[1])
+                package->version = g_string_chunk_insert(package->chunk, vals[1]);
+            if (vals[2])
+                package->release = g_string_chunk_insert(package->chunk, vals[2]);
+            if (vals[3])
+                package->epoch = g_string_chunk_insert(package->chunk, vals[3]);
+            if (vals[4])
+                package->arch = g_string_chunk_insert(package->chunk, vals[4]);
+            if (vals[5])
+                package->src = g_string_chunk_insert(package->chunk, vals[5]);
+        }
 
         break;
 
     case STATE_SUM:
-        assert(pd->updateinfo);
         assert(pd->updaterecord);
         assert(pd->updatecollection);
         assert(pd->updatecollectionpackage);
@@ -310,7 +295,6 @@ cr_start_handler(void *pdata, const char *element, const char **attr)
         break;
 
     case STATE_REBOOTSUGGESTED:
-        assert(pd->updateinfo);
         assert(pd->updaterecord);
         assert(pd->updatecollection);
         assert(pd->updatecollectionpackage);
@@ -359,7 +343,6 @@ cr_end_handler(void *pdata, G_GNUC_UNUSED const char *element)
         break;
 
     case STATE_ID:
-        assert(pd->updateinfo);
         assert(pd->updaterecord);
         assert(!pd->updatecollection);
         assert(!pd->updatecollectionpackage);
@@ -367,7 +350,6 @@ cr_end_handler(void *pdata, G_GNUC_UNUSED const char *element)
         break;
 
     case STATE_TITLE:
-        assert(pd->updateinfo);
         assert(pd->updaterecord);
         assert(!pd->updatecollection);
         assert(!pd->updatecollectionpackage);
@@ -375,7 +357,6 @@ cr_end_handler(void *pdata, G_GNUC_UNUSED const char *element)
         break;
 
     case STATE_RIGHTS:
-        assert(pd->updateinfo);
         assert(pd->updaterecord);
         assert(!pd->updatecollection);
         assert(!pd->updatecollectionpackage);
@@ -383,7 +364,6 @@ cr_end_handler(void *pdata, G_GNUC_UNUSED const char *element)
         break;
 
     case STATE_RELEASE:
-        assert(pd->updateinfo);
         assert(pd->updaterecord);
         assert(!pd->updatecollection);
         assert(!pd->updatecollectionpackage);
@@ -391,7 +371,6 @@ cr_end_handler(void *pdata, G_GNUC_UNUSED const char *element)
         break;
 
     case STATE_PUSHCOUNT:
-        assert(pd->updateinfo);
         assert(pd->updaterecord);
         assert(!pd->updatecollection);
         assert(!pd->updatecollectionpackage);
@@ -399,7 +378,6 @@ cr_end_handler(void *pdata, G_GNUC_UNUSED const char *element)
         break;
 
     case STATE_SEVERITY:
-        assert(pd->updateinfo);
         assert(pd->updaterecord);
         assert(!pd->updatecollection);
         assert(!pd->updatecollectionpackage);
@@ -407,7 +385,6 @@ cr_end_handler(void *pdata, G_GNUC_UNUSED const char *element)
         break;
 
     case STATE_SUMMARY:
-        assert(pd->updateinfo);
         assert(pd->updaterecord);
         assert(!pd->updatecollection);
         assert(!pd->updatecollectionpackage);
@@ -415,7 +392,6 @@ cr_end_handler(void *pdata, G_GNUC_UNUSED const char *element)
         break;
 
     case STATE_DESCRIPTION:
-        assert(pd->updateinfo);
         assert(pd->updaterecord);
         assert(!pd->updatecollection);
         assert(!pd->updatecollectionpackage);
@@ -423,7 +399,6 @@ cr_end_handler(void *pdata, G_GNUC_UNUSED const char *element)
         break;
 
     case STATE_SOLUTION:
-        assert(pd->updateinfo);
         assert(pd->updaterecord);
         assert(!pd->updatecollection);
         assert(!pd->updatecollectionpackage);
@@ -431,7 +406,6 @@ cr_end_handler(void *pdata, G_GNUC_UNUSED const char *element)
         break;
 
     case STATE_NAME:
-        assert(pd->updateinfo);
         assert(pd->updaterecord);
         assert(pd->updatecollection);
         assert(!pd->updatecollectionpackage);
@@ -439,7 +413,6 @@ cr_end_handler(void *pdata, G_GNUC_UNUSED const char *element)
         break;
 
     case STATE_FILENAME:
-        assert(pd->updateinfo);
         assert(pd->updaterecord);
         assert(pd->updatecollection);
         assert(pd->updatecollectionpackage);
@@ -448,7 +421,6 @@ cr_end_handler(void *pdata, G_GNUC_UNUSED const char *element)
         break;
 
     case STATE_SUM:
-        assert(pd->updateinfo);
         assert(pd->updaterecord);
         assert(pd->updatecollection);
         assert(pd->updatecollectionpackage);
@@ -456,7 +428,6 @@ cr_end_handler(void *pdata, G_GNUC_UNUSED const char *element)
         break;
 
     case STATE_PACKAGE:
-        assert(pd->updateinfo);
         assert(pd->updaterecord);
         assert(pd->updatecollection);
         assert(pd->updatecollectionpackage);
@@ -464,32 +435,95 @@ cr_end_handler(void *pdata, G_GNUC_UNUSED const char *element)
         break;
 
     case STATE_COLLECTION:
-        assert(pd->updateinfo);
         assert(pd->updaterecord);
         assert(pd->updatecollection);
         assert(!pd->updatecollectionpackage);
         pd->updatecollection = NULL;
         break;
 
-    case STATE_UPDATE:
-        assert(pd->updateinfo);
+    case STATE_UPDATE: {
+        GError *tmp_err = NULL;
+
         assert(pd->updaterecord);
         assert(!pd->updatecollection);
         assert(!pd->updatecollectionpackage);
+
+        // The callback takes the record even if it fails
         pd->updaterecord = NULL;
+        if (pd->updaterecordcb(rec, pd->updaterecordcb_data, &tmp_err)) {
+            if (tmp_err)
+                g_propagate_prefixed_error(&pd->err,
+                                           tmp_err,
+                                           "Parsing interrupted: ");
+            else
+                g_set_error(&pd->err, ERR_DOMAIN, CRE_CBINTERRUPTED,
+                            "Parsing interrupted");
+        } else {
+            // If callback return CRE_OK but it simultaneously set
+            // the tmp_err then it's a programming error.
+            assert(tmp_err == NULL);
+        }
         break;
+    }
 
     default:
         break;
     }
 }
 
+/** Records collected by cr_xml_parse_updateinfo() */
+typedef struct {
+    GSList *updates;    /*!< Parsed records in the reversed order */
+} cr_UpdateinfoCollector;
+
+static int
+cr_updateinfo_collect_cb(cr_UpdateRecord *rec,
+                         void *cbdata,
+                         G_GNUC_UNUSED GError **err)
+{
+    cr_UpdateinfoCollector *collector = cbdata;
+    // Prepend and reverse at the end - appending is O(n) per record
+    collector->updates = g_slist_prepend(collector->updates, rec);
+    return CR_CB_RET_OK;
+}
+
 int
 cr_xml_parse_updateinfo(const char *path,
                         cr_UpdateInfo *updateinfo,
                         cr_XmlParserWarningCb warningcb,
                         void *warningcb_data,
                         GError **err)
+{
+    int ret;
+    cr_UpdateinfoCollector collector = { NULL };
+
+    assert(path);
+    assert(updateinfo);
+    assert(!err || *err == NULL);
+
+    ret = cr_xml_parse_updateinfo_records(path,
+                                          cr_updateinfo_collect_cb,
+                                          &collector,
+                                          warningcb,
+                                          warningcb_data,
+                                          err);
+
+    // Records parsed before an error are kept, as they always were
+    updateinfo->updates = g_slist_concat(updateinfo->updates,
+                                         g_slist_reverse(collector.updates));
+    if (updateinfo->index && collector.updates)
+        cr_updateinfo_build_index(updateinfo);
+
+    return ret;
+}
+
+int
+cr_xml_parse_updateinfo_records(const char *path,
+                                cr_XmlParserUpdateRecordCb recordcb,
+                                void *recordcb_data,
+                                cr_XmlParserWarningCb warningcb,
+                                void *warningcb_data,
+                                GError **err)
 {
     int ret = CRE_OK;
     cr_ParserData *pd;
@@ -497,7 +531,7 @@ cr_xml_parse_updateinfo(const char *path,
     GError *tmp_err = NULL;
 
     assert(path);
-    assert(updateinfo);
+    assert(recordcb);
     assert(!err || *err == NULL);
 
     // Init
@@ -509,16 +543,14 @@ cr_xml_parse_updateinfo(const char *path,
     pd = cr_xml_parser_data(NUMSTATES);
     pd->parser = &parser;
     pd->state = STATE_START;
-    pd->updateinfo = updateinfo;
+    pd->updaterecordcb = recordcb;
+    pd->updaterecordcb_data = recordcb_data;
     pd->warningcb = warningcb;
     pd->warningcb_data = warningcb_data;
-    for (cr_StatesSwitch *sw = stateswitches; sw->from != NUMSTATES; sw++) {
-        if (!pd->swtab[sw->from])
-            pd->swtab[sw->from] = sw;
-        pd->sbtab[sw->to] = sw->from;
-    }
+    cr_xml_parser_set_states(pd, stateswitches);
 
     XML_SetUserData(parser, pd);
+    cr_xml_parser_profile_attach(parser, pd, cr_start_handler, cr_end_handler);
 
     // Parsing
 
@@ -536,6 +568,10 @@ cr_xml_parse_updateinfo(const char *path,
 
     // Clean up
 
+    // Record which wasn't passed to the callback (parsing failed
+    // inside of its update element)
+    cr_updaterecord_free(pd->updaterecord);
+
     cr_xml_parser_data_free(pd);
     XML_ParserFree(parser);
 
@@ -0,0 +1,370 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2014  Tomas Mlcoch
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <glib.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef WITH_ZCHUNK
+#include <zck.h>
+#include <zdict.h>
+#endif
+#include "zck_writer.h"
+#include "compression_wrapper.h"
+#include "error.h"
+
+#define ERR_DOMAIN              CREATEREPO_C_ERROR
+#define ZCK_WRITER_MAX_PENDING  1024
+
+typedef struct {
+    gchar *xml;
+    gboolean end_chunk;
+} cr_ZckWriterTask;
+
+struct _cr_ZckWriter {
+    cr_XmlFile *f;
+    gchar *name;
+    GThreadPool *pool;          // Single thread - keeps the order of tasks
+    gboolean finished;
+
+    GMutex *mutex;              // Protects pending
+    GCond *cond;
+    int pending;                // Number of queued tasks
+
+    GError *err;                // First error (accessed only by the thread)
+
+    // Samples for dictionary training (accessed only by the thread)
+    gboolean collect_samples;
+    GByteArray *samples;        // Content of the chunks
+    GArray *sample_sizes;       // Sizes (size_t) of the samples
+    gsize sample_start;         // Offset of the current sample
+};
+
+static void
+cr_zck_writer_end_sample(cr_ZckWriter *w)
+{
+    size_t size = w->samples->len - w->sample_start;
+
+    if (size > 0)
+        g_array_append_val(w->sample_sizes, size);
+    w->sample_start = w->samples->len;
+}
+
+static void
+cr_zck_writer_thread(gpointer data, gpointer user_data)
+{
+    cr_ZckWriterTask *task = data;
+    cr_ZckWriter *w = user_data;
+    GError *tmp_err = NULL;
+
+    if (task->end_chunk) {
+        cr_end_chunk(w->f->f, &tmp_err);
+        if (tmp_err) {
+            g_critical("Unable to end %s zchunk: %s", w->name, tmp_err->message);
+            if (!w->err)
+                w->err = tmp_err;
+            else
+                g_error_free(tmp_err);
+            tmp_err = NULL;
+        }
+        if (w->collect_samples)
+            cr_zck_writer_end_sample(w);
+    }
+
+    cr_xmlfile_add_chunk(w->f, task->xml, &tmp_err);
+    if (tmp_err) {
+        g_critical("Cannot add %s zchunk:\n%s\nError: %s",
+                   w->name, task->xml, tmp_err->message);
+        if (!w->err)
+            w->err = tmp_err;
+        else
+            g_error_free(tmp_err);
+    }
+
+    if (w->collect_samples
+        && w->samples->len < CR_ZCK_TRAIN_MAX_SAMPLES_SIZE)
+        g_byte_array_append(w->samples,
+                            (const guint8 *) task->xml,
+                            strlen(task->xml));
+
+    g_free(task->xml);
+    g_free(task);
+
+    g_mutex_lock(w->mutex);
+    w->pending--;
+    g_cond_broadcast(w->cond);
+    g_mutex_unlock(w->mutex);
+}
+
+cr_ZckWriter *
+cr_zck_writer_new(cr_XmlFile *f,
+                  const char *name,
+                  gboolean collect_samples,
+                  GError **err)
+{
+    cr_ZckWriter *w;
+    GError *tmp_err = NULL;
+
+    assert(f);
+    assert(!err || *err == NULL);
+
+    w = g_new0(cr_ZckWriter, 1);
+    w->f = f;
+    w->name = g_strdup(name);
+    w->mutex = g_mutex_new();
+    w->cond = g_cond_new();
+    w->collect_samples = collect_samples;
+    if (collect_samples) {
+        w->samples = g_byte_array_new();
+        w->sample_sizes = g_array_new(FALSE, FALSE, sizeof(size_t));
+    }
+
+    w->pool = g_thread_pool_new(cr_zck_writer_thread, w, 1, TRUE, &tmp_err);
+    if (!w->pool) {
+        g_propagate_prefixed_error(err, tmp_err,
+                                   "Cannot create %s zchunk writer thread: ",
+                                   name);
+        w->finished = TRUE;
+        cr_zck_writer_free(w);
+        return NULL;
+    }
+
+    return w;
+}
+
+void
+cr_zck_writer_add(cr_ZckWriter *w, const char *xml, gboolean end_chunk)
+{
+    cr_ZckWriterTask *task;
+
+    assert(w);
+    assert(!w->finished);
+
+    g_mutex_lock(w->mutex);
+    while (w->pending >= ZCK_WRITER_MAX_PENDING)
+        g_cond_wait(w->cond, w->mutex);
+    w->pending++;
+    g_mutex_unlock(w->mutex);
+
+    task = g_new(cr_ZckWriterTask, 1);
+    task->xml = g_strdup(xml);
+    task->end_chunk = end_chunk;
+    g_thread_pool_push(w->pool, task, NULL);
+}
+
+gboolean
+cr_zck_writer_finish(cr_ZckWriter *w, GError **err)
+{
+    assert(w);
+    assert(!err || *err == NULL);
+
+    if (!w->finished) {
+        // Wait for all queued tasks
+        g_thread_pool_free(w->pool, FALSE, TRUE);
+        w->pool = NULL;
+        w->finished = TRUE;
+        if (w->collect_samples)
+            cr_zck_writer_end_sample(w);
+    }
+
+    if (w->err) {
+        g_propagate_error(err, w->err);
+        w->err = NULL;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+int
+cr_zck_writer_train_dict(cr_ZckWriter *w, const char *path, GError **err)
+{
+    assert(w);
+    assert(w->finished);
+    assert(!err || *err == NULL);
+
+#ifdef WITH_ZCHUNK
+    GError *tmp_err = NULL;
+    size_t dict_size;
+    void *dict;
+
+    if (!w->collect_samples || w->sample_sizes->len == 0) {
+        g_set_error(err, ERR_DOMAIN, CRE_ZCK,
+                    "No %s chunks available for dictionary training",
+                    w->name);
+        return CRE_ZCK;
+    }
+
+    dict = g_malloc(CR_ZCK_DICT_MAX_SIZE);
+    dict_size = ZDICT_trainFromBuffer(dict,
+                                      CR_ZCK_DICT_MAX_SIZE,
+                                      w->samples->data,
+                                      (const size_t *) w->sample_sizes->data,
+                                      w->sample_sizes->len);
+    if (ZDICT_isError(dict_size)) {
+        g_set_error(err, ERR_DOMAIN, CRE_ZCK,
+                    "Cannot train %s dictionary from %u chunks: %s",
+                    w->name, w->sample_sizes->len,
+                    ZDICT_getErrorName(dict_size));
+        g_free(dict);
+        return CRE_ZCK;
+    }
+
+    if (!g_file_set_contents(path, dict, dict_size, &tmp_err)) {
+        g_set_error(err, ERR_DOMAIN, CRE_IO,
+                    "Cannot write %s: %s", path, tmp_err->message);
+        g_error_free(tmp_err);
+        g_free(dict);
+        return CRE_IO;
+    }
+
+    g_debug("%s: %s dictionary (%zu bytes) trained from %u chunks",
+            __func__, w->name, dict_size, w->sample_sizes->len);
+    g_free(dict);
+    return CRE_OK;
+#else
+    g_set_error(err, ERR_DOMAIN, CRE_ZCK,
+                "createrepo_c wasn't compiled with zchunk support");
+    return CRE_ZCK;
+#endif // WITH_ZCHUNK
+}
+
+void
+cr_zck_writer_free(cr_ZckWriter *w)
+{
+    if (!w)
+        return;
+
+    if (!w->finished) {
+        GError *tmp_err = NULL;
+        cr_zck_writer_finish(w, &tmp_err);
+        g_clear_error(&tmp_err);
+    }
+
+    g_clear_error(&w->err);
+    if (w->samples)
+        g_byte_array_free(w->samples, TRUE);
+    if (w->sample_sizes)
+        g_array_free(w->sample_sizes, TRUE);
+    g_mutex_free(w->mutex);
+    g_cond_free(w->cond);
+    g_free(w->name);
+    g_free(w);
+}
+
+#ifdef WITH_ZCHUNK
+static zckCtx *
+cr_zck_open_read(const char *path, int *fd, GError **err)
+{
+    zckCtx *zck;
+
+    *fd = open(path, O_RDONLY);
+    if (*fd < 0) {
+        g_set_error(err, ERR_DOMAIN, CRE_IO,
+                    "Cannot open %s: %s", path, g_strerror(errno));
+        return NULL;
+    }
+
+    zck = zck_create();
+    if (!zck || !zck_init_read(zck, *fd)) {
+        g_set_error(err, ERR_DOMAIN, CRE_ZCK,
+                    "Cannot read zchunk header of %s: %s",
+                    path, zck ? zck_get_error(zck) : "zck_create() failed");
+        zck_free(&zck);
+        close(*fd);
+        return NULL;
+    }
+
+    return zck;
+}
+
+static void
+cr_zck_close_read(zckCtx *zck, int fd)
+{
+    zck_free(&zck);
+    close(fd);
+}
+#endif // WITH_ZCHUNK
+
+int
+cr_zck_count_reused_chunks(const char *old_path,
+                           const char *new_path,
+                           gint64 *reused,
+                           gint64 *total,
+                           GError **err)
+{
+    assert(old_path);
+    assert(new_path);
+    assert(reused);
+    assert(total);
+    assert(!err || *err == NULL);
+
+    *reused = 0;
+    *total = 0;
+
+#ifdef WITH_ZCHUNK
+    GHashTable *digests;
+    zckCtx *zck;
+    int fd;
+
+    zck = cr_zck_open_read(old_path, &fd, err);
+    if (!zck)
+        return (err && *err) ? (*err)->code : CRE_ZCK;
+
+    digests = g_hash_table_new_full(g_str_hash, g_str_equal, free, NULL);
+    // Skip the dictionary chunk
+    for (zckChunk *chunk = zck_get_next_chunk(zck_get_first_chunk(zck));
+         chunk;
+         chunk = zck_get_next_chunk(chunk))
+    {
+        char *digest = zck_get_chunk_digest(chunk);
+        if (digest)
+            g_hash_table_replace(digests, digest, NULL);
+    }
+    cr_zck_close_read(zck, fd);
+
+    zck = cr_zck_open_read(new_path, &fd, err);
+    if (!zck) {
+        g_hash_table_destroy(digests);
+        return (err && *err) ? (*err)->code : CRE_ZCK;
+    }
+
+    for (zckChunk *chunk = zck_get_next_chunk(zck_get_first_chunk(zck));
+         chunk;
+         chunk = zck_get_next_chunk(chunk))
+    {
+        char *digest = zck_get_chunk_digest(chunk);
+        (*total)++;
+        if (digest && g_hash_table_lookup_extended(digests, digest, NULL, NULL))
+            (*reused)++;
+        free(digest);
+    }
+    cr_zck_close_read(zck, fd);
+
+    g_hash_table_destroy(digests);
+    return CRE_OK;
+#else
+    g_set_error(err, ERR_DOMAIN, CRE_ZCK,
+                "createrepo_c wasn't compiled with zchunk support");
+    return CRE_ZCK;
+#endif // WITH_ZCHUNK
+}
@@ -0,0 +1,134 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2014  Tomas Mlcoch
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef __C_CREATEREPOLIB_ZCK_WRITER_H__
+#define __C_CREATEREPOLIB_ZCK_WRITER_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <glib.h>
+#include "xml_file.h"
+
+/** \defgroup   zck_writer  Asynchronous writing of zchunk xml files
+ *
+ * Compression of a zchunk chunk happens when the chunk is ended.
+ * The zck writer takes this work out of the dumper threads: the dumper
+ * only copies the xml snippet of the package into the writer's queue
+ * (in the order of the packages) and a dedicated thread per file appends
+ * the snippets and ends the chunks. So the three zchunk files are
+ * compressed concurrently with each other and with the dumping.
+ *
+ * The writer can also keep the content of the chunks as samples for
+ * training of a zstd dictionary (see cr_zck_writer_train_dict()).
+ *
+ *  \addtogroup zck_writer
+ *  @{
+ */
+
+/** Max total size of the samples kept for the dictionary training.
+ */
+#define CR_ZCK_TRAIN_MAX_SAMPLES_SIZE   (128*1024*1024)
+
+/** Max size of a trained dictionary.
+ */
+#define CR_ZCK_DICT_MAX_SIZE            (112*1024)
+
+typedef struct _cr_ZckWriter cr_ZckWriter;
+
+/** Create a new zck writer.
+ * @param f                 Opened zchunk xml file. The file is not closed
+ *                          by the writer.
+ * @param name              Name used in messages (e.g. "primary")
+ * @param collect_samples   Keep content of the chunks for the training
+ *                          of a dictionary
+ * @param err               GError **
+ * @return                  New writer or NULL on error
+ */
+cr_ZckWriter *
+cr_zck_writer_new(cr_XmlFile *f,
+                  const char *name,
+                  gboolean collect_samples,
+                  GError **err);
+
+/** Queue a package xml snippet. Snippets are written in the same order
+ * in which they were added. If too many snippets wait for the compression
+ * the call blocks.
+ * @param w                 Writer
+ * @param xml               Xml snippet (the string is copied)
+ * @param end_chunk         End the current chunk before the snippet
+ *                          is written
+ */
+void
+cr_zck_writer_add(cr_ZckWriter *w, const char *xml, gboolean end_chunk);
+
+/** Wait until all queued snippets are written.
+ * @param w                 Writer
+ * @param err               GError **
+ * @return                  FALSE if writing of any snippet failed
+ */
+gboolean
+cr_zck_writer_finish(cr_ZckWriter *w, GError **err);
+
+/** Train a zstd dictionary from the collected chunks and store it
+ * to the path. Must be called after cr_zck_writer_finish().
+ * @param w                 Writer created with collect_samples
+ * @param path              Output path of the dictionary
+ * @param err               GError **
+ * @return                  cr_Error code
+ */
+int
+cr_zck_writer_train_dict(cr_ZckWriter *w, const char *path, GError **err);
+
+/** Finish the writer (if not finished yet) and free it.
+ * @param w                 Writer
+ */
+void
+cr_zck_writer_free(cr_ZckWriter *w);
+
+/** Count data chunks of a new zchunk file which are present (with
+ * the same checksum) in an old zchunk file. Such chunks don't have to be
+ * downloaded by the clients which have the old file.
+ *
+ * Note: libzck cannot add already compressed chunks into a new file, so
+ * every chunk is compressed again. The chunk of an unchanged package group
+ * is byte-identical with the old one only if both files were compressed
+ * with the same dictionary (e.g. the same --zck-dict-dir).
+ * @param old_path          Path to the old zchunk file
+ * @param new_path          Path to the new zchunk file
+ * @param reused            Number of chunks which are in both files
+ * @param total             Number of data chunks in the new file
+ * @param err               GError **
+ * @return                  cr_Error code
+ */
+int
+cr_zck_count_reused_chunks(const char *old_path,
+                           const char *new_path,
+                           gint64 *reused,
+                           gint64 *total,
+                           GError **err);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __C_CREATEREPOLIB_ZCK_WRITER_H__ */
@@ -0,0 +1,165 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2013  Tomas Mlcoch
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+/* Benchmark of the heap allocations done per package.
+ *
+ * Counts calls of malloc/calloc/realloc done by:
+ *  - reading of the rpm header (cr_package_from_rpm_base)
+ *  - generating of the xml chunks as new strings (cr_xml_dump)
+ *  - generating of the xml chunks into reused buffers (cr_xml_dump_buffers),
+ *    which is what the createrepo_c workers do
+ *
+ * The allocator functions are interposed via the glibc __libc_* entry
+ * points, so the numbers include allocations done by glib, libxml2 and rpm.
+ *
+ * Usage: bench_alloc [rpm_path [iterations]]
+ */
+
+#include <glib.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "fixtures.h"
+#include "createrepo/package.h"
+#include "createrepo/parsepkg.h"
+#include "createrepo/xml_dump.h"
+
+#define DEFAULT_RPM             TEST_PACKAGES_PATH"Archer-3.4.5-6.x86_64.rpm"
+#define DEFAULT_ITERATIONS      1000
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static volatile gboolean counting = FALSE;
+static unsigned long allocations = 0;
+
+void *
+malloc(size_t size)
+{
+    if (counting)
+        allocations++;
+    return __libc_malloc(size);
+}
+
+void *
+calloc(size_t nmemb, size_t size)
+{
+    if (counting)
+        allocations++;
+    return __libc_calloc(nmemb, size);
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+    if (counting)
+        allocations++;
+    return __libc_realloc(ptr, size);
+}
+
+void
+free(void *ptr)
+{
+    __libc_free(ptr);
+}
+
+static void
+report(const char *name, unsigned long allocs, gint64 time_us, long iterations)
+{
+    printf("%-28s %14.1f %14.1f\n",
+           name,
+           (double) allocs / iterations,
+           (time_us * 1000.0) / iterations);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const char *path = DEFAULT_RPM;
+    long iterations = DEFAULT_ITERATIONS;
+    GError *tmp_err = NULL;
+    cr_Package *pkg;
+    struct cr_XmlBuffers *buffers;
+    gint64 start;
+
+    if (argc > 1)
+        path = argv[1];
+    if (argc > 2)
+        iterations = g_ascii_strtoll(argv[2], NULL, 10);
+    if (iterations < 1)
+        iterations = 1;
+
+    cr_xml_dump_init();
+    cr_package_parser_init();
+
+    // Warm up (rpm and libxml2 initialize their internal state lazily)
+    pkg = cr_package_from_rpm_base(path, -1, CR_HDRR_NONE, &tmp_err);
+    if (!pkg) {
+        g_printerr("Cannot load %s: %s\n", path, tmp_err->message);
+        g_clear_error(&tmp_err);
+        return EXIT_FAILURE;
+    }
+    cr_xml_dump_buffers(pkg, (buffers = cr_xml_buffers_new()), NULL);
+
+    printf("Package: %s\n", path);
+    printf("%-28s %14s %14s\n", "", "allocs/pkg", "ns/pkg");
+
+    // Header reading
+    allocations = 0;
+    start = g_get_monotonic_time();
+    counting = TRUE;
+    for (long x = 0; x < iterations; x++)
+        cr_package_free(cr_package_from_rpm_base(path, -1, CR_HDRR_NONE, NULL));
+    counting = FALSE;
+    report("cr_package_from_rpm_base", allocations,
+           g_get_monotonic_time() - start, iterations);
+
+    // Dump into new strings
+    allocations = 0;
+    start = g_get_monotonic_time();
+    counting = TRUE;
+    for (long x = 0; x < iterations; x++) {
+        struct cr_XmlStruct res = cr_xml_dump(pkg, NULL);
+        g_free(res.primary);
+        g_free(res.filelists);
+        g_free(res.other);
+    }
+    counting = FALSE;
+    report("cr_xml_dump", allocations,
+           g_get_monotonic_time() - start, iterations);
+
+    // Dump into reused buffers
+    allocations = 0;
+    start = g_get_monotonic_time();
+    counting = TRUE;
+    for (long x = 0; x < iterations; x++)
+        cr_xml_dump_buffers(pkg, buffers, NULL);
+    counting = FALSE;
+    report("cr_xml_dump_buffers", allocations,
+           g_get_monotonic_time() - start, iterations);
+
+    cr_xml_buffers_free(buffers);
+    cr_package_free(pkg);
+    cr_package_parser_cleanup();
+    cr_xml_dump_cleanup();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,193 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2013  Tomas Mlcoch
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+/* Micro-benchmark of the checksum paths.
+ *
+ * Compares the code cr_checksum_new/update/final used to run (legacy
+ * EVP_sha*() getter, i.e. an implicit digest fetch on every init with
+ * OpenSSL 3), the current generic path (cr_checksum_new/update/final
+ * with the cached digest) and the per-thread context fast path
+ * (cr_checksum_buffers) for data sizes createrepo_c typically hashes:
+ *  - cache keys (hdrid + signature header, tens to hundreds of bytes)
+ *  - small packages and metadata chunks (KiBs)
+ *  - regular and big packages (MiBs)
+ *
+ * Usage: bench_checksum [checksum_type [min_time_in_ms]]
+ */
+
+#include <glib.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <openssl/evp.h>
+#include "createrepo/checksum.h"
+
+#define DEFAULT_MIN_TIME_MS     200
+
+static const size_t sizes[] = {
+    40,                 // hdrid only
+    576,                // hdrid + RSA signature (typical cache key)
+    4 * 1024,
+    64 * 1024,
+    1024 * 1024,
+    16 * 1024 * 1024,
+};
+
+typedef double (*BenchFunc)(cr_ChecksumType type,
+                            const unsigned char *data,
+                            size_t size,
+                            gint64 min_time_us);
+
+static const EVP_MD *
+legacy_md(cr_ChecksumType type)
+{
+    switch (type) {
+        case CR_CHECKSUM_MD5:    return EVP_md5();
+        case CR_CHECKSUM_SHA:    return EVP_sha1();
+        case CR_CHECKSUM_SHA1:   return EVP_sha1();
+        case CR_CHECKSUM_SHA224: return EVP_sha224();
+        case CR_CHECKSUM_SHA256: return EVP_sha256();
+        case CR_CHECKSUM_SHA384: return EVP_sha384();
+        case CR_CHECKSUM_SHA512: return EVP_sha512();
+        default:                 return NULL;
+    }
+}
+
+/* The former cr_checksum_new() + cr_checksum_update() + cr_checksum_final()
+ */
+static double
+bench_legacy(cr_ChecksumType type,
+             const unsigned char *data,
+             size_t size,
+             gint64 min_time_us)
+{
+    long iterations = 0;
+    gint64 start = g_get_monotonic_time();
+    gint64 elapsed;
+
+    do {
+        unsigned int len;
+        unsigned char raw_checksum[EVP_MAX_MD_SIZE];
+        char *checksum;
+        EVP_MD_CTX *ctx = EVP_MD_CTX_create();
+
+        EVP_DigestInit_ex(ctx, legacy_md(type), NULL);
+        EVP_DigestUpdate(ctx, data, size);
+        EVP_DigestFinal_ex(ctx, raw_checksum, &len);
+        EVP_MD_CTX_destroy(ctx);
+
+        checksum = g_malloc0(sizeof(char) * (len * 2 + 1));
+        for (size_t x = 0; x < len; x++)
+            sprintf(checksum+(x*2), "%02x", raw_checksum[x]);
+        g_free(checksum);
+
+        iterations++;
+        elapsed = g_get_monotonic_time() - start;
+    } while (elapsed < min_time_us);
+
+    return (elapsed * 1000.0) / iterations;
+}
+
+static double
+bench_evp(cr_ChecksumType type,
+          const unsigned char *data,
+          size_t size,
+          gint64 min_time_us)
+{
+    long iterations = 0;
+    gint64 start = g_get_monotonic_time();
+    gint64 elapsed;
+
+    do {
+        cr_ChecksumCtx *ctx = cr_checksum_new(type, NULL);
+        cr_checksum_update(ctx, data, size, NULL);
+        g_free(cr_checksum_final(ctx, NULL));
+        iterations++;
+        elapsed = g_get_monotonic_time() - start;
+    } while (elapsed < min_time_us);
+
+    return (elapsed * 1000.0) / iterations;
+}
+
+static double
+bench_buffers(cr_ChecksumType type,
+              const unsigned char *data,
+              size_t size,
+              gint64 min_time_us)
+{
+    long iterations = 0;
+    gint64 start = g_get_monotonic_time();
+    gint64 elapsed;
+    const void *bufs[1] = { data };
+    size_t lens[1] = { size };
+
+    do {
+        g_free(cr_checksum_buffers(type, bufs, lens, 1, NULL));
+        iterations++;
+        elapsed = g_get_monotonic_time() - start;
+    } while (elapsed < min_time_us);
+
+    return (elapsed * 1000.0) / iterations;
+}
+
+int
+main(int argc, char *argv[])
+{
+    cr_ChecksumType type = CR_CHECKSUM_SHA256;
+    gint64 min_time_us = DEFAULT_MIN_TIME_MS * 1000;
+    size_t max_size = sizes[G_N_ELEMENTS(sizes) - 1];
+    unsigned char *data;
+
+    if (argc > 1) {
+        type = cr_checksum_type(argv[1]);
+        if (type == CR_CHECKSUM_UNKNOWN) {
+            g_printerr("Unknown checksum type: %s\n", argv[1]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (argc > 2)
+        min_time_us = g_ascii_strtoll(argv[2], NULL, 10) * 1000;
+
+    data = g_malloc(max_size);
+    for (size_t x = 0; x < max_size; x++)
+        data[x] = (unsigned char) (x * 2654435761u >> 24);
+
+    printf("Checksum: %s\n", cr_checksum_name_str(type));
+    printf("%10s %14s %14s %14s %12s %12s %8s\n",
+           "size", "legacy ns/op", "evp ns/op", "fast ns/op",
+           "legacy MiB/s", "fast MiB/s", "speedup");
+
+    for (size_t i = 0; i < G_N_ELEMENTS(sizes); i++) {
+        size_t size = sizes[i];
+        double legacy = bench_legacy(type, data, size, min_time_us);
+        double evp = bench_evp(type, data, size, min_time_us);
+        double fast = bench_buffers(type, data, size, min_time_us);
+
+        // Speedup of the fast path over the legacy one
+        printf("%10zu %14.1f %14.1f %14.1f %12.1f %12.1f %7.2fx\n",
+               size, legacy, evp, fast,
+               (size / (1024.0 * 1024.0)) / (legacy / 1e9),
+               (size / (1024.0 * 1024.0)) / (fast / 1e9),
+               legacy / fast);
+    }
+
+    g_free(data);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,177 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2013  Tomas Mlcoch
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+/* Benchmark of the header to cr_Package conversion.
+ *
+ * Headers of all given packages are read into memory first, so only
+ * cr_package_from_header() is measured (no I/O, no checksums).
+ * Use a corpus of packages with big file lists (kernel-devel, texlive,
+ * ...) to see the cost of the file and dependency processing.
+ *
+ * Usage: bench_parsehdr [min_time_in_ms] (rpm_file|directory)...
+ * Without packages, the packages from the test data are used.
+ */
+
+#include <glib.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <rpm/rpmlib.h>
+#include <rpm/rpmts.h>
+#include "fixtures.h"
+#include "createrepo/misc.h"
+#include "createrepo/package.h"
+#include "createrepo/parsehdr.h"
+
+#define DEFAULT_MIN_TIME_MS     200
+
+typedef struct {
+    gchar *path;
+    Header hdr;
+    guint files;
+} BenchPkg;
+
+static void
+add_package(rpmts ts, GPtrArray *pkgs, const char *path)
+{
+    Header hdr = NULL;
+    FD_t fd = Fopen(path, "r.ufdio");
+    if (!fd) {
+        g_printerr("Cannot open %s\n", path);
+        return;
+    }
+
+    rpmRC rc = rpmReadPackageFile(ts, fd, NULL, &hdr);
+    Fclose(fd);
+    if (rc != RPMRC_OK && rc != RPMRC_NOKEY && rc != RPMRC_NOTTRUSTED) {
+        g_printerr("Cannot read header of %s\n", path);
+        return;
+    }
+
+    BenchPkg *pkg = g_new0(BenchPkg, 1);
+    pkg->path = g_strdup(path);
+    pkg->hdr = hdr;
+    g_ptr_array_add(pkgs, pkg);
+}
+
+static void
+add_path(rpmts ts, GPtrArray *pkgs, const char *path)
+{
+    if (!g_file_test(path, G_FILE_TEST_IS_DIR)) {
+        add_package(ts, pkgs, path);
+        return;
+    }
+
+    GDir *dir = g_dir_open(path, 0, NULL);
+    if (!dir) {
+        g_printerr("Cannot open directory %s\n", path);
+        return;
+    }
+
+    const gchar *name;
+    while ((name = g_dir_read_name(dir))) {
+        if (!g_str_has_suffix(name, ".rpm"))
+            continue;
+        gchar *full = g_build_filename(path, name, NULL);
+        add_package(ts, pkgs, full);
+        g_free(full);
+    }
+    g_dir_close(dir);
+}
+
+static double
+bench_header(Header hdr, gint64 min_time_us)
+{
+    long iterations = 0;
+    gint64 start = g_get_monotonic_time();
+    gint64 elapsed;
+
+    do {
+        cr_package_free(cr_package_from_header(hdr, -1, CR_HDRR_NONE, NULL));
+        iterations++;
+        elapsed = g_get_monotonic_time() - start;
+    } while (elapsed < min_time_us);
+
+    return (double) elapsed / iterations;
+}
+
+int
+main(int argc, char *argv[])
+{
+    gint64 min_time_us = DEFAULT_MIN_TIME_MS * 1000;
+    GPtrArray *pkgs = g_ptr_array_new();
+    double total_us = 0;
+    guint64 total_files = 0;
+    int arg = 1;
+
+    if (argc > 1 && g_ascii_isdigit(argv[1][0])) {
+        min_time_us = g_ascii_strtoll(argv[1], NULL, 10) * 1000;
+        arg++;
+    }
+
+    rpmReadConfigFiles(NULL, NULL);
+    rpmts ts = rpmtsCreate();
+    rpmtsSetVSFlags(ts, _RPMVSF_NODIGESTS | _RPMVSF_NOSIGNATURES
+                        | RPMVSF_NOHDRCHK);
+
+    if (arg < argc) {
+        for (; arg < argc; arg++)
+            add_path(ts, pkgs, argv[arg]);
+    } else {
+        add_path(ts, pkgs, TEST_PACKAGES_PATH);
+    }
+
+    if (pkgs->len == 0) {
+        g_printerr("No packages\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("%-50s %10s %14s %12s\n", "package", "files", "us/pkg", "ns/file");
+
+    for (guint x = 0; x < pkgs->len; x++) {
+        BenchPkg *pkg = g_ptr_array_index(pkgs, x);
+        cr_Package *crpkg = cr_package_from_header(pkg->hdr, -1,
+                                                   CR_HDRR_NONE, NULL);
+        pkg->files = crpkg ? g_slist_length(crpkg->files) : 0;
+        cr_package_free(crpkg);
+
+        double us = bench_header(pkg->hdr, min_time_us);
+        total_us += us;
+        total_files += pkg->files;
+
+        printf("%-50s %10u %14.1f %12.1f\n",
+               cr_get_filename(pkg->path), pkg->files, us,
+               pkg->files ? (us * 1000.0) / pkg->files : 0.0);
+    }
+
+    printf("%-50s %10"G_GUINT64_FORMAT" %14.1f %12.1f\n",
+           "TOTAL", total_files, total_us,
+           total_files ? (total_us * 1000.0) / total_files : 0.0);
+
+    for (guint x = 0; x < pkgs->len; x++) {
+        BenchPkg *pkg = g_ptr_array_index(pkgs, x);
+        headerFree(pkg->hdr);
+        g_free(pkg->path);
+        g_free(pkg);
+    }
+    g_ptr_array_free(pkgs, TRUE);
+    rpmtsFree(ts);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,473 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2013  Tomas Mlcoch
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+/* Benchmark of the metadata pipeline on synthetic packages.
+ *
+ * Packages are generated in memory (see bench_synthetic.h) and pushed
+ * through the stages createrepo_c and its users run:
+ *  - dump of the xml chunks (cr_xml_dump_buffers)
+ *  - writing of the xml files (cr_xmlfile)
+ *  - parsing of primary, filelists and other xml
+ *    (primary also by cr_xml_parse_primary_parallel on all CPUs)
+ *  - sqlite databases (cr_db_add_pkg)
+ *  - compression of primary.xml by every compression backend
+ *
+ * Results are printed as a table or, with --json, as a JSON document
+ * which utils/run_bench.py collects and compares with a baseline.
+ *
+ * Usage: bench_pipeline [--json FILE] [--iterations N] [synthetic options]
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "bench_synthetic.h"
+#include "createrepo/error.h"
+#include "createrepo/misc.h"
+#include "createrepo/package.h"
+#include "createrepo/sqlite.h"
+#include "createrepo/xml_dump.h"
+#include "createrepo/xml_file.h"
+#include "createrepo/xml_parser.h"
+
+#define TMP_DIR_PATTERN         "/tmp/createrepo_bench_XXXXXX"
+
+typedef struct {
+    const char *name;
+    double seconds;     /*!< Best time of all iterations */
+    gint64 items;       /*!< Packages processed by one iteration */
+    gint64 bytes;       /*!< Bytes produced or consumed by one iteration */
+} BenchResult;
+
+typedef gboolean (*BenchStage)(GPtrArray *pkgs,
+                               const char *tmpdir,
+                               gint64 *bytes,
+                               GError **err);
+
+static gint64
+file_size(const char *path)
+{
+    struct stat st;
+    if (stat(path, &st))
+        return 0;
+    return st.st_size;
+}
+
+static gboolean
+stage_dump(GPtrArray *pkgs,
+           G_GNUC_UNUSED const char *tmpdir,
+           gint64 *bytes,
+           GError **err)
+{
+    struct cr_XmlBuffers *buffers = cr_xml_buffers_new();
+
+    *bytes = 0;
+    for (guint x = 0; x < pkgs->len; x++) {
+        if (cr_xml_dump_buffers(g_ptr_array_index(pkgs, x), buffers, err)) {
+            cr_xml_buffers_free(buffers);
+            return FALSE;
+        }
+        *bytes += buffers->primary->len + buffers->filelists->len
+                  + buffers->other->len;
+    }
+
+    cr_xml_buffers_free(buffers);
+    return TRUE;
+}
+
+static gboolean
+stage_xmlfile(GPtrArray *pkgs,
+              const char *tmpdir,
+              gint64 *bytes,
+              GError **err)
+{
+    const cr_XmlFileType types[] = { CR_XMLFILE_PRIMARY,
+                                     CR_XMLFILE_FILELISTS,
+                                     CR_XMLFILE_OTHER };
+    const char *names[] = { "primary.xml", "filelists.xml", "other.xml" };
+    cr_XmlFile *files[3] = { NULL, NULL, NULL };
+    struct cr_XmlBuffers *buffers = cr_xml_buffers_new();
+    gboolean ret = FALSE;
+
+    for (int i = 0; i < 3; i++) {
+        gchar *path = g_build_filename(tmpdir, names[i], NULL);
+        files[i] = cr_xmlfile_open(path, types[i], CR_CW_NO_COMPRESSION, err);
+        g_free(path);
+        if (!files[i])
+            goto cleanup;
+        cr_xmlfile_set_num_of_pkgs(files[i], pkgs->len, NULL);
+    }
+
+    for (guint x = 0; x < pkgs->len; x++) {
+        if (cr_xml_dump_buffers(g_ptr_array_index(pkgs, x), buffers, err)
+            || cr_xmlfile_add_chunk(files[0], buffers->primary->str, err)
+            || cr_xmlfile_add_chunk(files[1], buffers->filelists->str, err)
+            || cr_xmlfile_add_chunk(files[2], buffers->other->str, err))
+            goto cleanup;
+    }
+
+    ret = TRUE;
+
+cleanup:
+    *bytes = 0;
+    for (int i = 0; i < 3; i++) {
+        if (files[i] && cr_xmlfile_close(files[i], ret ? err : NULL))
+            ret = FALSE;
+        gchar *path = g_build_filename(tmpdir, names[i], NULL);
+        *bytes += file_size(path);
+        g_free(path);
+    }
+    cr_xml_buffers_free(buffers);
+    return ret;
+}
+
+static int
+free_pkgcb(cr_Package *pkg, void *cbdata, G_GNUC_UNUSED GError **err)
+{
+    (*((gint64 *) cbdata))++;
+    cr_package_free(pkg);
+    return CR_CB_RET_OK;
+}
+
+static gboolean
+check_parsed(gint64 parsed, GPtrArray *pkgs, GError **err)
+{
+    if (parsed == (gint64) pkgs->len)
+        return TRUE;
+    g_set_error(err, CREATEREPO_C_ERROR, CRE_ERROR,
+                "Parsed %"G_GINT64_FORMAT" packages instead of %u",
+                parsed, pkgs->len);
+    return FALSE;
+}
+
+static gboolean
+stage_parse_primary(GPtrArray *pkgs,
+                    const char *tmpdir,
+                    gint64 *bytes,
+                    GError **err)
+{
+    gint64 parsed = 0;
+    gchar *path = g_build_filename(tmpdir, "primary.xml", NULL);
+    int rc = cr_xml_parse_primary(path, NULL, NULL, free_pkgcb, &parsed,
+                                  NULL, NULL, 1, err);
+    *bytes = file_size(path);
+    g_free(path);
+    return rc == CRE_OK && check_parsed(parsed, pkgs, err);
+}
+
+static gboolean
+stage_parse_primary_parallel(GPtrArray *pkgs,
+                             const char *tmpdir,
+                             gint64 *bytes,
+                             GError **err)
+{
+    gint64 parsed = 0;
+    gchar *path = g_build_filename(tmpdir, "primary.xml", NULL);
+    int workers = MAX(sysconf(_SC_NPROCESSORS_ONLN), 2);
+    int rc = cr_xml_parse_primary_parallel(path, NULL, NULL, free_pkgcb,
+                                           &parsed, NULL, NULL, 1,
+                                           workers, err);
+    *bytes = file_size(path);
+    g_free(path);
+    return rc == CRE_OK && check_parsed(parsed, pkgs, err);
+}
+
+static gboolean
+stage_parse_filelists(GPtrArray *pkgs,
+                      const char *tmpdir,
+                      gint64 *bytes,
+                      GError **err)
+{
+    gint64 parsed = 0;
+    gchar *path = g_build_filename(tmpdir, "filelists.xml", NULL);
+    int rc = cr_xml_parse_filelists(path, NULL, NULL, free_pkgcb, &parsed,
+                                    NULL, NULL, err);
+    *bytes = file_size(path);
+    g_free(path);
+    return rc == CRE_OK && check_parsed(parsed, pkgs, err);
+}
+
+static gboolean
+stage_parse_other(GPtrArray *pkgs,
+                  const char *tmpdir,
+                  gint64 *bytes,
+                  GError **err)
+{
+    gint64 parsed = 0;
+    gchar *path = g_build_filename(tmpdir, "other.xml", NULL);
+    int rc = cr_xml_parse_other(path, NULL, NULL, free_pkgcb, &parsed,
+                                NULL, NULL, err);
+    *bytes = file_size(path);
+    g_free(path);
+    return rc == CRE_OK && check_parsed(parsed, pkgs, err);
+}
+
+static gboolean
+stage_sqlite(GPtrArray *pkgs, const char *tmpdir, cr_DatabaseType type,
+             gint64 *bytes, GError **err)
+{
+    const char *names[] = { "primary.sqlite", "filelists.sqlite",
+                            "other.sqlite" };
+    gchar *path = g_build_filename(tmpdir, names[type], NULL);
+    gboolean ret = FALSE;
+    cr_SqliteDb *db;
+
+    g_unlink(path);
+    db = cr_db_open(path, type, err);
+    if (!db)
+        goto cleanup;
+
+    for (guint x = 0; x < pkgs->len; x++)
+        if (cr_db_add_pkg(db, g_ptr_array_index(pkgs, x), err) != CRE_OK) {
+            cr_db_close(db, NULL);
+            goto cleanup;
+        }
+
+    ret = cr_db_close(db, err) == CRE_OK;
+
+cleanup:
+    *bytes = file_size(path);
+    g_free(path);
+    return ret;
+}
+
+static gboolean
+stage_sqlite_primary(GPtrArray *pkgs, const char *tmpdir,
+                     gint64 *bytes, GError **err)
+{
+    return stage_sqlite(pkgs, tmpdir, CR_DB_PRIMARY, bytes, err);
+}
+
+static gboolean
+stage_sqlite_filelists(GPtrArray *pkgs, const char *tmpdir,
+                       gint64 *bytes, GError **err)
+{
+    return stage_sqlite(pkgs, tmpdir, CR_DB_FILELISTS, bytes, err);
+}
+
+static gboolean
+stage_sqlite_other(GPtrArray *pkgs, const char *tmpdir,
+                   gint64 *bytes, GError **err)
+{
+    return stage_sqlite(pkgs, tmpdir, CR_DB_OTHER, bytes, err);
+}
+
+static gboolean
+stage_compress(const char *tmpdir, cr_CompressionType type,
+               gint64 *bytes, GError **err)
+{
+    gchar *src = g_build_filename(tmpdir, "primary.xml", NULL);
+    gchar *dst = g_strconcat(src, cr_compression_suffix(type), NULL);
+    int rc;
+
+    g_unlink(dst);
+    rc = cr_compress_file(src, &dst, type, NULL, FALSE, err);
+    *bytes = file_size(dst);
+    g_unlink(dst);
+    g_free(src);
+    g_free(dst);
+    return rc == CRE_OK;
+}
+
+#define COMPRESS_STAGE(NAME, TYPE) \
+static gboolean \
+stage_compress_##NAME(G_GNUC_UNUSED GPtrArray *pkgs, const char *tmpdir, \
+                      gint64 *bytes, GError **err) \
+{ \
+    return stage_compress(tmpdir, TYPE, bytes, err); \
+}
+
+COMPRESS_STAGE(gz, CR_CW_GZ_COMPRESSION)
+COMPRESS_STAGE(bz2, CR_CW_BZ2_COMPRESSION)
+COMPRESS_STAGE(xz, CR_CW_XZ_COMPRESSION)
+#ifdef WITH_ZCHUNK
+COMPRESS_STAGE(zck, CR_CW_ZCK_COMPRESSION)
+#endif
+
+static const struct {
+    const char *name;
+    BenchStage func;
+} stages[] = {
+    // Order matters, later stages use files written by "xmlfile"
+    { "dump",               stage_dump },
+    { "xmlfile",            stage_xmlfile },
+    { "parse_primary",      stage_parse_primary },
+    { "parse_primary_parallel", stage_parse_primary_parallel },
+    { "parse_filelists",    stage_parse_filelists },
+    { "parse_other",        stage_parse_other },
+    { "sqlite_primary",     stage_sqlite_primary },
+    { "sqlite_filelists",   stage_sqlite_filelists },
+    { "sqlite_other",       stage_sqlite_other },
+    { "compress_gz",        stage_compress_gz },
+    { "compress_bz2",       stage_compress_bz2 },
+    { "compress_xz",        stage_compress_xz },
+#ifdef WITH_ZCHUNK
+    { "compress_zck",       stage_compress_zck },
+#endif
+};
+
+static void
+print_json(FILE *out,
+           const BenchSynthParams *params,
+           double generate_seconds,
+           BenchResult *results,
+           gsize count)
+{
+    GString *json = g_string_new("{\n");
+
+    g_string_append(json, "  \"benchmark\": \"bench_pipeline\",\n");
+    g_string_append_printf(json, "  \"version\": \"%s\",\n",
+                           cr_version_string_with_features());
+    g_string_append(json, "  \"params\": { ");
+    bench_synth_params_json(json, params);
+    g_string_append(json, " },\n");
+    g_string_append_printf(json, "  \"generate_seconds\": %.6f,\n",
+                           generate_seconds);
+    g_string_append(json, "  \"results\": [\n");
+    for (gsize x = 0; x < count; x++) {
+        BenchResult *r = &results[x];
+        g_string_append_printf(json,
+            "    { \"name\": \"%s\", \"seconds\": %.6f, "
+            "\"items\": %"G_GINT64_FORMAT", \"bytes\": %"G_GINT64_FORMAT", "
+            "\"items_per_second\": %.1f }%s\n",
+            r->name, r->seconds, r->items, r->bytes,
+            r->seconds > 0 ? r->items / r->seconds : 0.0,
+            x + 1 < count ? "," : "");
+    }
+    g_string_append(json, "  ]\n}\n");
+
+    fputs(json->str, out);
+    g_string_free(json, TRUE);
+}
+
+int
+main(int argc, char *argv[])
+{
+    BenchSynthParams params = BENCH_SYNTH_DEFAULTS;
+    gint iterations = 3;
+    gchar *json_path = NULL;
+    gchar *only = NULL;
+    GError *tmp_err = NULL;
+    int ret = EXIT_SUCCESS;
+
+    GOptionEntry entries[] = {
+        { "iterations", 'i', 0, G_OPTION_ARG_INT, &iterations,
+          "Run every stage N times and report the best time.", "N" },
+        { "json", 'j', 0, G_OPTION_ARG_FILENAME, &json_path,
+          "Write results as JSON into FILE (\"-\" for stdout).", "FILE" },
+        { "stage", 's', 0, G_OPTION_ARG_STRING, &only,
+          "Run only stages whose name starts with PREFIX "
+          "(and the stages they depend on).", "PREFIX" },
+        { NULL },
+    };
+
+    GOptionContext *context = g_option_context_new(NULL);
+    g_option_context_set_summary(context,
+            "Benchmark of the metadata pipeline on synthetic packages.");
+    g_option_context_add_main_entries(context, entries, NULL);
+    bench_synth_add_options(context, &params);
+    if (!g_option_context_parse(context, &argc, &argv, &tmp_err)) {
+        g_printerr("%s\n", tmp_err->message);
+        g_clear_error(&tmp_err);
+        g_option_context_free(context);
+        return EXIT_FAILURE;
+    }
+    g_option_context_free(context);
+    iterations = MAX(iterations, 1);
+
+    cr_xml_dump_init();
+
+    gint64 start = g_get_monotonic_time();
+    GPtrArray *pkgs = bench_synth_packages(&params);
+    double generate_seconds = (g_get_monotonic_time() - start) / 1e6;
+
+    gchar *tmpdir = g_strdup(TMP_DIR_PATTERN);
+    if (!mkdtemp(tmpdir)) {
+        g_printerr("Cannot create a temporary directory\n");
+        return EXIT_FAILURE;
+    }
+
+    gsize count = G_N_ELEMENTS(stages);
+    BenchResult *results = g_new0(BenchResult, count);
+    gsize done = 0;
+
+    if (!json_path)
+        printf("%-20s %12s %14s %14s\n", "stage", "seconds", "pkgs/s", "MiB");
+
+    for (gsize x = 0; x < count; x++) {
+        // The xml files are needed by the later stages
+        gboolean needed = !only || g_str_has_prefix(stages[x].name, only)
+                          || !strcmp(stages[x].name, "xmlfile");
+        if (!needed)
+            continue;
+
+        BenchResult *r = &results[done++];
+        r->name = stages[x].name;
+        r->items = pkgs->len;
+        r->seconds = -1;
+
+        for (gint i = 0; i < iterations; i++) {
+            gint64 bytes = 0;
+            start = g_get_monotonic_time();
+            if (!stages[x].func(pkgs, tmpdir, &bytes, &tmp_err)) {
+                g_printerr("Stage %s failed: %s\n", r->name,
+                           tmp_err ? tmp_err->message : "unknown error");
+                g_clear_error(&tmp_err);
+                ret = EXIT_FAILURE;
+                goto cleanup;
+            }
+            double seconds = (g_get_monotonic_time() - start) / 1e6;
+            if (r->seconds < 0 || seconds < r->seconds)
+                r->seconds = seconds;
+            r->bytes = bytes;
+        }
+
+        if (!json_path)
+            printf("%-20s %12.4f %14.1f %14.2f\n", r->name, r->seconds,
+                   r->seconds > 0 ? r->items / r->seconds : 0.0,
+                   r->bytes / (1024.0 * 1024.0));
+    }
+
+    if (json_path) {
+        FILE *out = strcmp(json_path, "-") ? fopen(json_path, "w") : stdout;
+        if (!out) {
+            g_printerr("Cannot open %s\n", json_path);
+            ret = EXIT_FAILURE;
+            goto cleanup;
+        }
+        print_json(out, &params, generate_seconds, results, done);
+        if (out != stdout)
+            fclose(out);
+    }
+
+cleanup:
+    cr_remove_dir(tmpdir, NULL);
+    g_free(tmpdir);
+    g_free(results);
+    g_free(json_path);
+    g_free(only);
+    g_ptr_array_free(pkgs, TRUE);
+    cr_xml_dump_cleanup();
+
+    return ret;
+}
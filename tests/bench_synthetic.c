@@ -0,0 +1,227 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2013  Tomas Mlcoch
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <glib.h>
+#include <math.h>
+#include <string.h>
+#include "bench_synthetic.h"
+
+#define LOREM   "Lorem ipsum dolor sit amet, consectetur adipiscing elit, " \
+                "sed do eiusmod tempor incididunt ut labore et dolore magna " \
+                "aliqua. Ut enim ad minim veniam, quis nostrud exercitation. "
+
+void
+bench_synth_add_options(GOptionContext *context, BenchSynthParams *params)
+{
+    GOptionEntry entries[] = {
+        { "packages", 0, 0, G_OPTION_ARG_INT, &params->packages,
+          "Number of generated packages.", "N" },
+        { "files", 0, 0, G_OPTION_ARG_INT, &params->files,
+          "Mean number of files per package.", "N" },
+        { "files-max", 0, 0, G_OPTION_ARG_INT, &params->files_max,
+          "Maximal number of files per package.", "N" },
+        { "changelogs", 0, 0, G_OPTION_ARG_INT, &params->changelogs,
+          "Changelog entries per package.", "N" },
+        { "changelog-size", 0, 0, G_OPTION_ARG_INT, &params->changelog_size,
+          "Size of a changelog entry text in bytes.", "BYTES" },
+        { "deps", 0, 0, G_OPTION_ARG_INT, &params->deps,
+          "Requires on other generated packages per package.", "N" },
+        { "seed", 0, 0, G_OPTION_ARG_INT, &params->seed,
+          "Seed of the random generator.", "N" },
+        { NULL },
+    };
+
+    GOptionGroup *group = g_option_group_new("synthetic",
+                                             "Synthetic packages:",
+                                             "Show synthetic package options",
+                                             NULL, NULL);
+    g_option_group_add_entries(group, entries);
+    g_option_context_add_group(context, group);
+}
+
+static void
+add_dep(cr_Package *pkg,
+        GSList **list,
+        const char *name,
+        const char *flags,
+        const char *version)
+{
+    cr_Dependency *dep = cr_dependency_new();
+    dep->name = g_string_chunk_insert_const(pkg->chunk, name);
+    if (flags) {
+        dep->flags   = g_string_chunk_insert_const(pkg->chunk, flags);
+        dep->epoch   = g_string_chunk_insert_const(pkg->chunk, "0");
+        dep->version = g_string_chunk_insert_const(pkg->chunk, version);
+        dep->release = g_string_chunk_insert_const(pkg->chunk, "1");
+    }
+    *list = g_slist_prepend(*list, dep);
+}
+
+static void
+add_file(cr_Package *pkg, const char *type, const char *path)
+{
+    cr_PackageFile *file = cr_package_file_new();
+    const char *slash = strrchr(path, '/');
+
+    file->type = g_string_chunk_insert_const(pkg->chunk, type);
+    file->path = g_string_chunk_insert_len(pkg->chunk, path, slash - path + 1);
+    file->name = g_string_chunk_insert(pkg->chunk, slash + 1);
+    pkg->files = g_slist_prepend(pkg->files, file);
+}
+
+static gint
+files_count(const BenchSynthParams *params, GRand *rand)
+{
+    // Exponential distribution - most packages are small, a few are huge
+    double u = g_rand_double(rand);
+    gint count = (gint) (-params->files * log(1.0 - u)) + 1;
+    return MIN(count, MAX(params->files_max, 1));
+}
+
+static cr_Package *
+synth_package(const BenchSynthParams *params, GRand *rand, gint idx)
+{
+    cr_Package *pkg = cr_package_new();
+    GStringChunk *ch = pkg->chunk;
+    gchar *tmp;
+
+    gchar *name = g_strdup_printf("synth%06d", idx);
+    gchar *version = g_strdup_printf("1.%d", idx % 17);
+
+    pkg->pkgId = g_string_chunk_insert(ch, (tmp =
+                    g_compute_checksum_for_string(G_CHECKSUM_SHA256, name, -1)));
+    g_free(tmp);
+    pkg->checksum_type  = g_string_chunk_insert_const(ch, "sha256");
+    pkg->name           = g_string_chunk_insert(ch, name);
+    pkg->arch           = g_string_chunk_insert_const(ch, "x86_64");
+    pkg->epoch          = g_string_chunk_insert_const(ch, "0");
+    pkg->version        = g_string_chunk_insert(ch, version);
+    pkg->release        = g_string_chunk_insert_const(ch, "1.fc99");
+    pkg->summary        = g_string_chunk_insert(ch, (tmp =
+                            g_strdup_printf("Synthetic package %s", name)));
+    g_free(tmp);
+    pkg->description    = g_string_chunk_insert_const(ch, LOREM LOREM);
+    pkg->url            = g_string_chunk_insert(ch, (tmp =
+                            g_strdup_printf("https://example.com/%s", name)));
+    g_free(tmp);
+    pkg->time_file      = 1500000000 + idx;
+    pkg->time_build     = 1500000000 + idx;
+    pkg->rpm_license    = g_string_chunk_insert_const(ch, "MIT");
+    pkg->rpm_vendor     = g_string_chunk_insert_const(ch, "Synthetic");
+    pkg->rpm_group      = g_string_chunk_insert_const(ch, "Unspecified");
+    pkg->rpm_buildhost  = g_string_chunk_insert_const(ch, "builder.example.com");
+    pkg->rpm_sourcerpm  = g_string_chunk_insert(ch, (tmp =
+                            g_strdup_printf("%s-%s-1.fc99.src.rpm", name, version)));
+    g_free(tmp);
+    pkg->rpm_packager   = g_string_chunk_insert_const(ch, "Synthetic Packager");
+    pkg->rpm_header_start = 4504;
+    pkg->rpm_header_end   = 10000 + idx % 1000;
+    pkg->location_href  = g_string_chunk_insert(ch, (tmp =
+                            g_strdup_printf("Packages/%s-%s-1.fc99.x86_64.rpm",
+                                            name, version)));
+    g_free(tmp);
+
+    // Provides and requires
+    add_dep(pkg, &pkg->provides, name, "EQ", version);
+    tmp = g_strdup_printf("libsynth%06d.so.1()(64bit)", idx);
+    add_dep(pkg, &pkg->provides, tmp, NULL, NULL);
+    g_free(tmp);
+
+    add_dep(pkg, &pkg->requires, "libc.so.6()(64bit)", NULL, NULL);
+    add_dep(pkg, &pkg->requires, "rtld(GNU_HASH)", NULL, NULL);
+    add_dep(pkg, &pkg->requires, "/bin/sh", NULL, NULL);
+    for (gint x = 0; x < params->deps && params->packages > 1; x++) {
+        gint target = g_rand_int_range(rand, 0, params->packages);
+        if (target == idx)
+            continue;
+        tmp = g_strdup_printf("libsynth%06d.so.1()(64bit)", target);
+        add_dep(pkg, &pkg->requires, tmp, NULL, NULL);
+        g_free(tmp);
+    }
+
+    // Files
+    gint files = files_count(params, rand);
+    gint per_dir = 50;
+    tmp = g_strdup_printf("/usr/bin/%s", name);
+    add_file(pkg, "", tmp);
+    g_free(tmp);
+    for (gint x = 1; x < files; x++) {
+        if (x % per_dir == 1) {
+            tmp = g_strdup_printf("/usr/share/%s/d%04d", name, x / per_dir);
+            add_file(pkg, "dir", tmp);
+            g_free(tmp);
+        }
+        tmp = g_strdup_printf("/usr/share/%s/d%04d/file%06d.dat",
+                              name, x / per_dir, x);
+        add_file(pkg, x % 97 ? "" : "ghost", tmp);
+        g_free(tmp);
+    }
+    pkg->files = g_slist_reverse(pkg->files);
+
+    // Changelogs
+    GString *text = g_string_sized_new(params->changelog_size + 1);
+    while ((gint) text->len < params->changelog_size)
+        g_string_append(text, LOREM);
+    g_string_truncate(text, params->changelog_size);
+    for (gint x = 0; x < params->changelogs; x++) {
+        cr_ChangelogEntry *entry = cr_changelog_entry_new();
+        tmp = g_strdup_printf("Synthetic Packager <synth@example.com> - %s-%d",
+                              version, params->changelogs - x);
+        entry->author = g_string_chunk_insert(ch, tmp);
+        g_free(tmp);
+        entry->date = 1500000000 - x * 86400;
+        entry->changelog = g_string_chunk_insert(ch, text->str);
+        pkg->changelogs = g_slist_append(pkg->changelogs, entry);
+    }
+    g_string_free(text, TRUE);
+
+    pkg->size_package   = 1024 + files * 512;
+    pkg->size_installed = files * 4096;
+    pkg->size_archive   = files * 4096 + 1024;
+
+    g_free(name);
+    g_free(version);
+    return pkg;
+}
+
+GPtrArray *
+bench_synth_packages(const BenchSynthParams *params)
+{
+    GRand *rand = g_rand_new_with_seed(params->seed);
+    GPtrArray *pkgs = g_ptr_array_new_with_free_func(
+                                    (GDestroyNotify) cr_package_free);
+
+    for (gint x = 0; x < params->packages; x++)
+        g_ptr_array_add(pkgs, synth_package(params, rand, x));
+
+    g_rand_free(rand);
+    return pkgs;
+}
+
+void
+bench_synth_params_json(GString *out, const BenchSynthParams *params)
+{
+    g_string_append_printf(out,
+        "\"packages\": %d, \"files\": %d, \"files_max\": %d, "
+        "\"changelogs\": %d, \"changelog_size\": %d, \"deps\": %d, "
+        "\"seed\": %d",
+        params->packages, params->files, params->files_max,
+        params->changelogs, params->changelog_size, params->deps,
+        params->seed);
+}
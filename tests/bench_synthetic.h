@@ -0,0 +1,69 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2013  Tomas Mlcoch
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#ifndef __C_CREATEREPO_BENCH_SYNTHETIC_H__
+#define __C_CREATEREPO_BENCH_SYNTHETIC_H__
+
+#include <glib.h>
+#include "createrepo/package.h"
+
+/* Generator of synthetic packages for the benchmarks.
+ *
+ * The same knobs are used by utils/gen_synthetic_repo.py which builds
+ * real rpm files, so results of the in-memory benchmarks and of the
+ * whole createrepo_c runs are comparable.
+ */
+
+typedef struct {
+    gint packages;          /*!< Number of packages */
+    gint files;             /*!< Mean number of files per package
+                                 (exponential distribution) */
+    gint files_max;         /*!< Maximal number of files per package */
+    gint changelogs;        /*!< Changelog entries per package */
+    gint changelog_size;    /*!< Size of a changelog text in bytes */
+    gint deps;              /*!< Requires on other packages (fan-out) */
+    gint seed;              /*!< Seed of the random generator */
+} BenchSynthParams;
+
+/** Default parameters. */
+#define BENCH_SYNTH_DEFAULTS { 5000, 40, 20000, 10, 200, 8, 42 }
+
+/** Add the generator options into a GOptionContext.
+ * @param context       GOptionContext
+ * @param params        Parameters filled by the parser
+ */
+void
+bench_synth_add_options(GOptionContext *context, BenchSynthParams *params);
+
+/** Generate all packages.
+ * @param params        Parameters
+ * @return              GPtrArray of cr_Package (with cr_package_free
+ *                      as the free function)
+ */
+GPtrArray *
+bench_synth_packages(const BenchSynthParams *params);
+
+/** Print the parameters as members of a JSON object.
+ * @param out           Output string
+ * @param params        Parameters
+ */
+void
+bench_synth_params_json(GString *out, const BenchSynthParams *params);
+
+#endif /* __C_CREATEREPO_BENCH_SYNTHETIC_H__ */
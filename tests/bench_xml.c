@@ -0,0 +1,592 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2013  Tomas Mlcoch
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+/* Micro-benchmark of the XML parsers and dumpers.
+ *
+ * For every input (the repo_* fixtures and a synthetic repository
+ * generated by bench_synthetic.h) measures:
+ *  - cr_xml_parse_primary/filelists/other
+ *  - cr_xml_dump_primary/filelists/other
+ * and reports ns/package and heap allocations/package. Every stage is
+ * repeated until it ran at least --min-time milliseconds, so even
+ * the tiny fixtures give stable numbers.
+ *
+ * With --profile, the parsers are run once more with
+ * a cr_XmlParserProfile and the time is broken down per element
+ * handler. Start handler times include the newpkgcb, end handler
+ * times include the pkgcb (which only frees the package here).
+ *
+ * Allocations are counted like in bench_alloc.c via the glibc
+ * __libc_* entry points.
+ *
+ * Run from the tests/ directory (fixtures are referenced by relative
+ * paths). Usage: bench_xml [--profile] [--json FILE] [options]
+ */
+
+#include <glib.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "fixtures.h"
+#include "bench_synthetic.h"
+#include "createrepo/error.h"
+#include "createrepo/misc.h"
+#include "createrepo/package.h"
+#include "createrepo/xml_dump.h"
+#include "createrepo/xml_file.h"
+#include "createrepo/xml_parser.h"
+
+#define TMP_DIR_PATTERN         "/tmp/createrepo_bench_xml_XXXXXX"
+#define DEFAULT_PACKAGES        1000
+#define DEFAULT_MIN_TIME_MS     200
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static volatile gboolean counting = FALSE;
+static unsigned long allocations = 0;
+
+void *
+malloc(size_t size)
+{
+    if (counting)
+        allocations++;
+    return __libc_malloc(size);
+}
+
+void *
+calloc(size_t nmemb, size_t size)
+{
+    if (counting)
+        allocations++;
+    return __libc_calloc(nmemb, size);
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+    if (counting)
+        allocations++;
+    return __libc_realloc(ptr, size);
+}
+
+void
+free(void *ptr)
+{
+    __libc_free(ptr);
+}
+
+typedef struct {
+    const char *name;
+    gchar *paths[3];    /*!< primary, filelists and other xml */
+    GPtrArray *pkgs;    /*!< Complete packages for the dumpers */
+} BenchInput;
+
+typedef enum {
+    XML_PRIMARY,
+    XML_FILELISTS,
+    XML_OTHER,
+} XmlType;
+
+/** Run a stage once. Return number of processed packages or -1. */
+typedef gint64 (*BenchStage)(BenchInput *input, XmlType type, GError **err);
+
+typedef struct {
+    const char *input;
+    const char *stage;
+    gint64 packages;        /*!< Packages processed by all runs */
+    gint64 runs;
+    double ns_per_pkg;
+    double allocs_per_pkg;
+    GPtrArray *elements;    /*!< Copies of cr_XmlParserElementStats */
+    gint64 profiled_pkgs;   /*!< Packages processed by the profiled runs */
+} BenchResult;
+
+static const char *xml_names[] = { "primary", "filelists", "other" };
+
+static int
+free_pkgcb(cr_Package *pkg, void *cbdata, G_GNUC_UNUSED GError **err)
+{
+    (*((gint64 *) cbdata))++;
+    cr_package_free(pkg);
+    return CR_CB_RET_OK;
+}
+
+static gint64
+stage_parse(BenchInput *input, XmlType type, GError **err)
+{
+    gint64 parsed = 0;
+    int rc;
+
+    switch (type) {
+        case XML_PRIMARY:
+            rc = cr_xml_parse_primary(input->paths[type], NULL, NULL,
+                                      free_pkgcb, &parsed, NULL, NULL,
+                                      1, err);
+            break;
+        case XML_FILELISTS:
+            rc = cr_xml_parse_filelists(input->paths[type], NULL, NULL,
+                                        free_pkgcb, &parsed, NULL, NULL, err);
+            break;
+        default:
+            rc = cr_xml_parse_other(input->paths[type], NULL, NULL,
+                                    free_pkgcb, &parsed, NULL, NULL, err);
+            break;
+    }
+
+    return rc == CRE_OK ? parsed : -1;
+}
+
+static gint64
+stage_dump(BenchInput *input, XmlType type, GError **err)
+{
+    for (guint x = 0; x < input->pkgs->len; x++) {
+        cr_Package *pkg = g_ptr_array_index(input->pkgs, x);
+        char *chunk;
+
+        switch (type) {
+            case XML_PRIMARY:   chunk = cr_xml_dump_primary(pkg, err);   break;
+            case XML_FILELISTS: chunk = cr_xml_dump_filelists(pkg, err); break;
+            default:            chunk = cr_xml_dump_other(pkg, err);     break;
+        }
+
+        if (!chunk)
+            return -1;
+        g_free(chunk);
+    }
+
+    return input->pkgs->len;
+}
+
+static gint64
+now_ns(void)
+{
+    return g_get_monotonic_time() * 1000;
+}
+
+static gboolean
+measure(BenchInput *input,
+        BenchStage stage,
+        XmlType type,
+        gint64 min_ns,
+        BenchResult *r,
+        GError **err)
+{
+    gint64 start, elapsed, n;
+
+    // Warm up
+    if (stage(input, type, err) < 0)
+        return FALSE;
+
+    r->packages = 0;
+    r->runs = 0;
+    allocations = 0;
+    start = now_ns();
+    counting = TRUE;
+    do {
+        n = stage(input, type, err);
+        r->packages += n;
+        r->runs++;
+        elapsed = now_ns() - start;
+    } while (n >= 0 && elapsed < min_ns);
+    counting = FALSE;
+
+    if (n < 0)
+        return FALSE;
+
+    if (r->packages > 0) {
+        r->ns_per_pkg = (double) elapsed / r->packages;
+        r->allocs_per_pkg = (double) allocations / r->packages;
+    }
+
+    return TRUE;
+}
+
+static gboolean
+profile(BenchInput *input,
+        XmlType type,
+        gint64 runs,
+        BenchResult *r,
+        GError **err)
+{
+    cr_XmlParserProfile *prof = cr_xml_parser_profile_new();
+    gboolean ret = TRUE;
+
+    r->profiled_pkgs = 0;
+    cr_xml_parser_profile_set(prof);
+    for (gint64 x = 0; x < runs && ret; x++) {
+        gint64 n = stage_parse(input, type, err);
+        if (n < 0)
+            ret = FALSE;
+        else
+            r->profiled_pkgs += n;
+    }
+    cr_xml_parser_profile_set(NULL);
+
+    if (ret) {
+        GPtrArray *stats = cr_xml_parser_profile_stats(prof);
+        r->elements = g_ptr_array_new_with_free_func(g_free);
+        for (guint x = 0; x < stats->len; x++) {
+            cr_XmlParserElementStats *s;
+            s = g_memdup(g_ptr_array_index(stats, x),
+                         sizeof(cr_XmlParserElementStats));
+            s->element = g_strdup(s->element);
+            g_ptr_array_add(r->elements, s);
+        }
+        g_ptr_array_free(stats, TRUE);
+    }
+
+    cr_xml_parser_profile_free(prof);
+    return ret;
+}
+
+static void
+result_clear(BenchResult *r)
+{
+    if (!r->elements)
+        return;
+    for (guint x = 0; x < r->elements->len; x++)
+        g_free(((cr_XmlParserElementStats *)
+                g_ptr_array_index(r->elements, x))->element);
+    g_ptr_array_free(r->elements, TRUE);
+}
+
+static gboolean
+input_load_packages(BenchInput *input, GError **err)
+{
+    cr_PkgIterator *iter;
+    cr_Package *pkg;
+    GError *tmp_err = NULL;
+
+    input->pkgs = g_ptr_array_new_with_free_func((GDestroyNotify) cr_package_free);
+
+    iter = cr_pkg_iterator_new(input->paths[XML_PRIMARY],
+                               input->paths[XML_FILELISTS],
+                               input->paths[XML_OTHER],
+                               NULL, NULL, err);
+    if (!iter)
+        return FALSE;
+
+    while ((pkg = cr_pkg_iterator_next(iter, &tmp_err)))
+        g_ptr_array_add(input->pkgs, pkg);
+    cr_pkg_iterator_free(iter);
+
+    if (tmp_err) {
+        g_propagate_error(err, tmp_err);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static gboolean
+input_write_synthetic(BenchInput *input,
+                      const BenchSynthParams *params,
+                      const char *tmpdir,
+                      GError **err)
+{
+    const cr_XmlFileType types[] = { CR_XMLFILE_PRIMARY,
+                                     CR_XMLFILE_FILELISTS,
+                                     CR_XMLFILE_OTHER };
+    struct cr_XmlBuffers *buffers = cr_xml_buffers_new();
+    cr_XmlFile *files[3] = { NULL, NULL, NULL };
+    gboolean ret = FALSE;
+
+    input->pkgs = bench_synth_packages(params);
+
+    for (int i = 0; i < 3; i++) {
+        gchar *name = g_strconcat(xml_names[i], ".xml", NULL);
+        input->paths[i] = g_build_filename(tmpdir, name, NULL);
+        g_free(name);
+        files[i] = cr_xmlfile_open(input->paths[i], types[i],
+                                   CR_CW_NO_COMPRESSION, err);
+        if (!files[i])
+            goto cleanup;
+        cr_xmlfile_set_num_of_pkgs(files[i], input->pkgs->len, NULL);
+    }
+
+    for (guint x = 0; x < input->pkgs->len; x++) {
+        if (cr_xml_dump_buffers(g_ptr_array_index(input->pkgs, x),
+                                buffers, err)
+            || cr_xmlfile_add_chunk(files[0], buffers->primary->str, err)
+            || cr_xmlfile_add_chunk(files[1], buffers->filelists->str, err)
+            || cr_xmlfile_add_chunk(files[2], buffers->other->str, err))
+            goto cleanup;
+    }
+
+    ret = TRUE;
+
+cleanup:
+    for (int i = 0; i < 3; i++)
+        if (files[i] && cr_xmlfile_close(files[i], ret ? err : NULL))
+            ret = FALSE;
+    cr_xml_buffers_free(buffers);
+    return ret;
+}
+
+static void
+input_clear(BenchInput *input)
+{
+    for (int i = 0; i < 3; i++)
+        g_free(input->paths[i]);
+    if (input->pkgs)
+        g_ptr_array_free(input->pkgs, TRUE);
+}
+
+static void
+print_result(const BenchResult *r)
+{
+    if (r->packages > 0)
+        printf("%-10s %-16s %10"G_GINT64_FORMAT" %12.1f %12.2f\n",
+               r->input, r->stage, r->packages / r->runs,
+               r->ns_per_pkg, r->allocs_per_pkg);
+    else
+        printf("%-10s %-16s %10d %12s %12s\n",
+               r->input, r->stage, 0, "-", "-");
+
+    if (!r->elements || r->profiled_pkgs <= 0)
+        return;
+
+    gint64 total = 0;
+    for (guint x = 0; x < r->elements->len; x++) {
+        cr_XmlParserElementStats *s = g_ptr_array_index(r->elements, x);
+        total += s->start_ns + s->end_ns;
+    }
+
+    printf("    %-24s %12s %12s %12s %8s\n",
+           "element", "calls/pkg", "start ns/pkg", "end ns/pkg", "share");
+    for (guint x = 0; x < r->elements->len; x++) {
+        cr_XmlParserElementStats *s = g_ptr_array_index(r->elements, x);
+        printf("    %-24s %12.2f %12.1f %12.1f %7.1f%%\n",
+               s->element,
+               (double) s->start_calls / r->profiled_pkgs,
+               (double) s->start_ns / r->profiled_pkgs,
+               (double) s->end_ns / r->profiled_pkgs,
+               total ? 100.0 * (s->start_ns + s->end_ns) / total : 0.0);
+    }
+}
+
+static void
+print_json(FILE *out,
+           const BenchSynthParams *params,
+           BenchResult *results,
+           gsize count)
+{
+    GString *json = g_string_new("{\n");
+
+    g_string_append(json, "  \"benchmark\": \"bench_xml\",\n");
+    g_string_append_printf(json, "  \"version\": \"%s\",\n",
+                           cr_version_string_with_features());
+    g_string_append(json, "  \"params\": { ");
+    bench_synth_params_json(json, params);
+    g_string_append(json, " },\n");
+    g_string_append(json, "  \"results\": [\n");
+    for (gsize x = 0; x < count; x++) {
+        BenchResult *r = &results[x];
+        g_string_append_printf(json,
+            "    { \"input\": \"%s\", \"stage\": \"%s\", "
+            "\"packages\": %"G_GINT64_FORMAT", "
+            "\"ns_per_pkg\": %.1f, \"allocs_per_pkg\": %.2f",
+            r->input, r->stage,
+            r->runs ? r->packages / r->runs : 0,
+            r->ns_per_pkg, r->allocs_per_pkg);
+
+        if (r->elements && r->profiled_pkgs > 0) {
+            g_string_append(json, ",\n      \"elements\": [\n");
+            for (guint i = 0; i < r->elements->len; i++) {
+                cr_XmlParserElementStats *s = g_ptr_array_index(r->elements, i);
+                g_string_append_printf(json,
+                    "        { \"element\": \"%s\", \"calls_per_pkg\": %.2f, "
+                    "\"start_ns_per_pkg\": %.1f, \"end_ns_per_pkg\": %.1f }%s\n",
+                    s->element,
+                    (double) s->start_calls / r->profiled_pkgs,
+                    (double) s->start_ns / r->profiled_pkgs,
+                    (double) s->end_ns / r->profiled_pkgs,
+                    i + 1 < r->elements->len ? "," : "");
+            }
+            g_string_append(json, "      ] }");
+        } else {
+            g_string_append(json, " }");
+        }
+        g_string_append_printf(json, "%s\n", x + 1 < count ? "," : "");
+    }
+    g_string_append(json, "  ]\n}\n");
+
+    fputs(json->str, out);
+    g_string_free(json, TRUE);
+}
+
+int
+main(int argc, char *argv[])
+{
+    BenchSynthParams params = BENCH_SYNTH_DEFAULTS;
+    gint min_time = DEFAULT_MIN_TIME_MS;
+    gboolean do_profile = FALSE;
+    gboolean no_fixtures = FALSE;
+    gboolean no_synthetic = FALSE;
+    gchar *json_path = NULL;
+    gchar *tmpdir = NULL;
+    GError *tmp_err = NULL;
+    int ret = EXIT_SUCCESS;
+
+    params.packages = DEFAULT_PACKAGES;
+
+    GOptionEntry entries[] = {
+        { "min-time", 't', 0, G_OPTION_ARG_INT, &min_time,
+          "Repeat every stage for at least MS milliseconds.", "MS" },
+        { "profile", 'p', 0, G_OPTION_ARG_NONE, &do_profile,
+          "Break down the parser time per element handler.", NULL },
+        { "json", 'j', 0, G_OPTION_ARG_FILENAME, &json_path,
+          "Write results as JSON into FILE (\"-\" for stdout).", "FILE" },
+        { "no-fixtures", 0, 0, G_OPTION_ARG_NONE, &no_fixtures,
+          "Skip the testdata/repo_* inputs.", NULL },
+        { "no-synthetic", 0, 0, G_OPTION_ARG_NONE, &no_synthetic,
+          "Skip the synthetic input.", NULL },
+        { NULL },
+    };
+
+    GOptionContext *context = g_option_context_new(NULL);
+    g_option_context_set_summary(context,
+            "Micro-benchmark of the XML parsers and dumpers.");
+    g_option_context_add_main_entries(context, entries, NULL);
+    bench_synth_add_options(context, &params);
+    if (!g_option_context_parse(context, &argc, &argv, &tmp_err)) {
+        g_printerr("%s\n", tmp_err->message);
+        g_clear_error(&tmp_err);
+        g_option_context_free(context);
+        return EXIT_FAILURE;
+    }
+    g_option_context_free(context);
+
+    cr_xml_dump_init();
+
+    BenchInput inputs[] = {
+        { "repo_00", { g_strdup(TEST_REPO_00_PRIMARY),
+                       g_strdup(TEST_REPO_00_FILELISTS),
+                       g_strdup(TEST_REPO_00_OTHER) }, NULL },
+        { "repo_01", { g_strdup(TEST_REPO_01_PRIMARY),
+                       g_strdup(TEST_REPO_01_FILELISTS),
+                       g_strdup(TEST_REPO_01_OTHER) }, NULL },
+        { "repo_02", { g_strdup(TEST_REPO_02_PRIMARY),
+                       g_strdup(TEST_REPO_02_FILELISTS),
+                       g_strdup(TEST_REPO_02_OTHER) }, NULL },
+        { "synthetic", { NULL, NULL, NULL }, NULL },
+    };
+    gsize ninputs = G_N_ELEMENTS(inputs);
+    gsize synthetic = ninputs - 1;
+
+    static const struct {
+        const char *name;
+        BenchStage func;
+        XmlType type;
+    } stages[] = {
+        { "parse_primary",      stage_parse,    XML_PRIMARY },
+        { "parse_filelists",    stage_parse,    XML_FILELISTS },
+        { "parse_other",        stage_parse,    XML_OTHER },
+        { "dump_primary",       stage_dump,     XML_PRIMARY },
+        { "dump_filelists",     stage_dump,     XML_FILELISTS },
+        { "dump_other",         stage_dump,     XML_OTHER },
+    };
+    gsize nstages = G_N_ELEMENTS(stages);
+
+    BenchResult *results = g_new0(BenchResult, ninputs * nstages);
+    gsize done = 0;
+
+    if (!no_synthetic) {
+        tmpdir = g_strdup(TMP_DIR_PATTERN);
+        if (!mkdtemp(tmpdir)) {
+            g_printerr("Cannot create a temporary directory\n");
+            ret = EXIT_FAILURE;
+            goto cleanup;
+        }
+        if (!input_write_synthetic(&inputs[synthetic], &params,
+                                   tmpdir, &tmp_err)) {
+            g_printerr("Cannot write synthetic input: %s\n",
+                       tmp_err->message);
+            ret = EXIT_FAILURE;
+            goto cleanup;
+        }
+    }
+
+    if (!json_path)
+        printf("%-10s %-16s %10s %12s %12s\n",
+               "input", "stage", "packages", "ns/pkg", "allocs/pkg");
+
+    for (gsize i = 0; i < ninputs; i++) {
+        BenchInput *input = &inputs[i];
+
+        if (i == synthetic ? no_synthetic : no_fixtures)
+            continue;
+
+        if (!input->pkgs && !input_load_packages(input, &tmp_err)) {
+            g_printerr("Cannot load %s: %s\n", input->name, tmp_err->message);
+            ret = EXIT_FAILURE;
+            goto cleanup;
+        }
+
+        for (gsize s = 0; s < nstages; s++) {
+            BenchResult *r = &results[done++];
+            r->input = input->name;
+            r->stage = stages[s].name;
+
+            if (!measure(input, stages[s].func, stages[s].type,
+                         (gint64) min_time * 1000000, r, &tmp_err)
+                || (do_profile && stages[s].func == stage_parse
+                    && !profile(input, stages[s].type, r->runs, r, &tmp_err)))
+            {
+                g_printerr("%s %s failed: %s\n", r->input, r->stage,
+                           tmp_err ? tmp_err->message : "unknown error");
+                ret = EXIT_FAILURE;
+                goto cleanup;
+            }
+
+            if (!json_path)
+                print_result(r);
+        }
+    }
+
+    if (json_path) {
+        FILE *out = strcmp(json_path, "-") ? fopen(json_path, "w") : stdout;
+        if (!out) {
+            g_printerr("Cannot open %s\n", json_path);
+            ret = EXIT_FAILURE;
+            goto cleanup;
+        }
+        print_json(out, &params, results, done);
+        if (out != stdout)
+            fclose(out);
+    }
+
+cleanup:
+    g_clear_error(&tmp_err);
+    for (gsize x = 0; x < done; x++)
+        result_clear(&results[x]);
+    g_free(results);
+    for (gsize i = 0; i < ninputs; i++)
+        input_clear(&inputs[i]);
+    if (tmpdir)
+        cr_remove_dir(tmpdir, NULL);
+    g_free(tmpdir);
+    g_free(json_path);
+    cr_xml_dump_cleanup();
+
+    return ret;
+}
@@ -35,3 +35,12 @@ class TestCaseChecksum(unittest.TestCase):
 
         self.assertEqual(cr.checksum_type("foobar"), cr.UNKNOWN_CHECKSUM)
 
+    def test_checksum_file_multi(self):
+        checksums = cr.checksum_file_multi(FILE_TEXT, [cr.MD5, cr.SHA256])
+        self.assertEqual(checksums[cr.MD5], "d6d4da5c15f8fe7570ce6ab6b3503916")
+        self.assertEqual(checksums[cr.SHA256],
+            "2f395bdfa2750978965e4781ddf224c89646c7d7a1569b7ebb023b170f7bd8bb")
+        self.assertEqual(len(checksums), 2)
+
+        self.assertRaises(cr.CreaterepoCError, cr.checksum_file_multi,
+                          FILE_TEXT, [cr.UNKNOWN_CHECKSUM])
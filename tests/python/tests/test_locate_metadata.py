@@ -1,3 +1,9 @@
+import functools
+import http.server
+import os.path
+import shutil
+import tempfile
+import threading
 import unittest
 import createrepo_c as cr
 
@@ -13,7 +19,77 @@ class TestCaseMetadataLocation(unittest.TestCase):
         self.assertTrue(ml["primary_db"] is None)
         self.assertTrue(ml["filelists_db"] is None)
         self.assertTrue(ml["other_db"] is None)
+        self.assertTrue(ml["primary_zck"].endswith("/repodata/e0ac03cd77e95e724dbf90ded0dba664e233315a8940051dd8882c56b9878595-primary.xml.zck"))
+        self.assertTrue(ml["filelists_zck"].endswith("/repodata/2e7db4492173b6c437fd1299dc335e63d09f24cbdadeac5175a61b787c2f7a44-filelists.xml.zck"))
+        self.assertTrue(ml["other_zck"].endswith("/repodata/a939c4765106655c3f7a13fb41d0f239824efa66bcd6c1e6c044a854012bda75-other.xml.zck"))
         self.assertTrue(ml["group"] is None)
         self.assertTrue(ml["group_gz"] is None)
         self.assertTrue(ml["updateinfo"] is None)
         self.assertTrue(ml["foobarxyz"] is None)
+
+
+class LoggingHandler(http.server.SimpleHTTPRequestHandler):
+    """Serves the test repos and records (path, status) of every request"""
+
+    def log_request(self, code="-", size="-"):
+        self.server.requests.append((self.path, int(code)))
+
+    def log_message(self, format, *args):
+        pass
+
+class TestCaseRemoteMetadataLocation(unittest.TestCase):
+
+    def setUp(self):
+        handler = functools.partial(LoggingHandler, directory=REPOS_PATH)
+        self.server = http.server.ThreadingHTTPServer(("127.0.0.1", 0), handler)
+        self.server.requests = []
+        self.thread = threading.Thread(target=self.server.serve_forever)
+        self.thread.start()
+        self.url = "http://127.0.0.1:%d/repo_01/" % self.server.server_port
+        self.tmpdir = tempfile.mkdtemp(prefix="createrepo_ctest-")
+
+    def tearDown(self):
+        self.server.shutdown()
+        self.server.server_close()
+        self.thread.join()
+        shutil.rmtree(self.tmpdir)
+
+    def test_metadatalocation_remote(self):
+        ml = cr.MetadataLocation(self.url, 1)
+        self.assertTrue(os.path.isfile(ml["primary"]))
+        self.assertTrue(os.path.isfile(ml["filelists"]))
+        self.assertTrue(os.path.isfile(ml["other"]))
+        self.assertEqual(os.path.basename(ml["primary"]),
+                         os.path.basename(REPO_01_PRIXML))
+        self.assertEqual(len(self.server.requests), 4)
+        self.assertTrue(all(code == 200 for _, code in self.server.requests))
+
+        self.assertRaises(cr.CreaterepoCError, cr.MetadataLocation,
+                          self.url + "nonexistent/", 1)
+
+    def test_metadatalocation_remote_cache(self):
+        cache = os.path.join(self.tmpdir, "cache")
+
+        ml = cr.MetadataLocation(self.url, 1, cache)
+        primary = ml["primary"]
+        self.assertTrue(primary.startswith(cache))
+        self.assertTrue(os.path.isfile(primary))
+        self.assertEqual(len(self.server.requests), 4)
+        del ml
+
+        # Cached metadata are kept and repomd.xml is not modified,
+        # so nothing is downloaded again
+        self.server.requests = []
+        ml = cr.MetadataLocation(self.url, 1, cache)
+        self.assertEqual(ml["primary"], primary)
+        self.assertTrue(os.path.isfile(primary))
+        self.assertEqual(self.server.requests,
+                         [("/repo_01/repodata/repomd.xml", 304)])
+
+        # A missing file is downloaded again
+        os.remove(primary)
+        self.server.requests = []
+        ml = cr.MetadataLocation(self.url, 1, cache)
+        self.assertTrue(os.path.isfile(primary))
+        self.assertEqual(sorted(code for _, code in self.server.requests),
+                         [200, 304])
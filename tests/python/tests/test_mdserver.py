@@ -0,0 +1,64 @@
+import os
+import shutil
+import subprocess
+import tempfile
+import time
+import unittest
+import createrepo_c as cr
+
+from .fixtures import *
+
+def mdserver_binary():
+    # The python module is built in <build_dir>/src/python/createrepo_c/
+    path = os.path.normpath(os.path.join(
+        os.path.dirname(cr._createrepo_c.__file__), "../../mdserver_c"))
+    if os.path.isfile(path):
+        return path
+    return shutil.which("mdserver_c")
+
+class TestCaseMdClient(unittest.TestCase):
+
+    def setUp(self):
+        binary = mdserver_binary()
+        if not binary:
+            self.skipTest("mdserver_c not found")
+        self.tmpdir = tempfile.mkdtemp(prefix="createrepo_ctest-")
+        self.socket = os.path.join(self.tmpdir, "sock")
+        self.server = subprocess.Popen([binary, "--quiet",
+                                        "--socket", self.socket,
+                                        "--cache-dir",
+                                        os.path.join(self.tmpdir, "cache")])
+        for _ in range(100):
+            if os.path.exists(self.socket):
+                break
+            time.sleep(0.05)
+
+    def tearDown(self):
+        self.server.terminate()
+        self.server.wait()
+        shutil.rmtree(self.tmpdir)
+
+    def test_mdclient_find(self):
+        client = cr.MdClient(self.socket)
+
+        pkgs = client.find(REPO_02_PATH, cr.MD_KEY_NAME, "fake_bash")
+        self.assertEqual(len(pkgs), 1)
+        pkg = pkgs[0]
+        self.assertTrue(isinstance(pkg, cr.Package))
+        self.assertEqual(pkg.nevra(), "fake_bash-0:1.1.1-1.x86_64")
+        self.assertEqual(pkg.location_href, "fake_bash-1.1.1-1.x86_64.rpm")
+
+        pkgs = client.find(REPO_02_PATH, cr.MD_KEY_HASH, pkg.pkgId)
+        self.assertEqual([p.pkgId for p in pkgs], [pkg.pkgId])
+
+        pkgs = client.find(REPO_02_PATH, cr.MD_KEY_FILENAME,
+                           "fake_bash-1.1.1-1.x86_64.rpm")
+        self.assertEqual([p.pkgId for p in pkgs], [pkg.pkgId])
+
+        pkgs = client.find(REPO_02_PATH, cr.MD_KEY_NEVRA,
+                           "fake_bash-1.1.1-1.x86_64")
+        self.assertEqual([p.pkgId for p in pkgs], [pkg.pkgId])
+
+        self.assertEqual(client.find(REPO_02_PATH, cr.MD_KEY_NAME, "foo"), [])
+        self.assertRaises(cr.CreaterepoCError, client.find,
+                          self.tmpdir, cr.MD_KEY_NAME, "foo")
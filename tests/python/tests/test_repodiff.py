@@ -0,0 +1,48 @@
+import unittest
+import createrepo_c as cr
+
+from .fixtures import *
+
+class TestCaseRepodiff(unittest.TestCase):
+
+    def test_repodiff_same_repo(self):
+        self.assertEqual(cr.repodiff(REPO_02_PATH, REPO_02_PATH), [])
+
+    def test_repodiff_repo01_repo02(self):
+        diff = cr.repodiff(REPO_01_PATH, REPO_02_PATH)
+        self.assertEqual(len(diff), 2)
+
+        # Differences are reported in NEVRA order
+        dtype, old_pkg, new_pkg = diff[0]
+        self.assertEqual(dtype, cr.REPODIFF_ADDED)
+        self.assertTrue(old_pkg is None)
+        self.assertEqual(new_pkg[1:], ("fake_bash", "x86_64", "0", "1.1.1",
+                                       "1", "fake_bash-1.1.1-1.x86_64.rpm"))
+
+        dtype, old_pkg, new_pkg = diff[1]
+        self.assertEqual(dtype, cr.REPODIFF_CHANGED)
+        self.assertEqual(old_pkg[0], "152824bff2aa6d54f429d43e87a3ff3a0286505c6d93ec87692b5e3a9e3b97bf")
+        self.assertEqual(new_pkg[0], "6d43a638af70ef899933b1fd86a866f18f65b0e0e17dcbf2e42bfd0cdd7c63c3")
+        self.assertEqual(old_pkg[1:6], new_pkg[1:6])
+
+    def test_repodiff_primary_callback(self):
+        diffs = []
+
+        def diffcb(dtype, old_pkg, new_pkg):
+            diffs.append((dtype, (old_pkg or new_pkg)[1]))
+
+        ret = cr.repodiff(REPO_02_PRIXML, REPO_00_PRIXML, diffcb, primary=True)
+        self.assertTrue(ret is None)
+        self.assertEqual(diffs, [(cr.REPODIFF_REMOVED, "fake_bash"),
+                                 (cr.REPODIFF_REMOVED, "super_kernel")])
+
+    def test_repodiff_callback_exception(self):
+        def diffcb(dtype, old_pkg, new_pkg):
+            raise Exception("stop")
+
+        self.assertRaises(Exception, cr.repodiff,
+                          REPO_01_PATH, REPO_02_PATH, diffcb)
+
+    def test_repodiff_bad_repo(self):
+        self.assertRaises(cr.CreaterepoCError, cr.repodiff,
+                          REPO_01_PATH, "/nonexistent/repo/")
@@ -200,3 +200,53 @@ class TestCaseUpdateInfo(unittest.TestCase):
   </update>
 </updates>
 """ % {"now": now.strftime("%Y-%m-%d %H:%M:%S")})
+
+    def test_updateinfo_lookups(self):
+        def record(id, issued, packages):
+            col = cr.UpdateCollection()
+            for name, version, arch in packages:
+                pkg = cr.UpdateCollectionPackage()
+                pkg.name = name
+                pkg.version = version
+                pkg.release = "1"
+                pkg.epoch = "0"
+                pkg.arch = arch
+                col.append(pkg)
+            rec = cr.UpdateRecord()
+            rec.id = id
+            rec.issued_date = issued
+            rec.append_collection(col)
+            return rec
+
+        ui = cr.UpdateInfo()
+        ui.append(record("UPDATE-3", datetime(2014, 3, 1),
+                         [("foo", "1.2", "x86_64"), ("foo", "1.2", "i686")]))
+        ui.append(record("UPDATE-1", datetime(2014, 1, 1),
+                         [("foo", "1.0", "x86_64"), ("bar", "2.0", "x86_64")]))
+
+        self.assertEqual(ui.get_by_id("UPDATE-1").id, "UPDATE-1")
+        self.assertEqual(ui.get_by_id("UPDATE-2"), None)
+
+        # Records appended after the index was built are indexed too
+        ui.append(record("UPDATE-2", datetime(2014, 2, 1),
+                         [("bar", "2.1", "x86_64")]))
+        self.assertEqual(ui.get_by_id("UPDATE-2").id, "UPDATE-2")
+
+        ids = lambda recs: [rec.id for rec in recs]
+        self.assertEqual(ids(ui.get_by_package("foo")),
+                         ["UPDATE-3", "UPDATE-1"])
+        self.assertEqual(ids(ui.get_by_package("bar")),
+                         ["UPDATE-1", "UPDATE-2"])
+        self.assertEqual(ids(ui.get_by_package("foo", version="1.2",
+                                               release="1", arch="i686")),
+                         ["UPDATE-3"])
+        self.assertEqual(ids(ui.get_by_package("foo", "0", "1.0", "1",
+                                               "i686")), [])
+        self.assertEqual(ids(ui.get_by_package("baz")), [])
+
+        self.assertEqual(ids(ui.get_by_issued_date()),
+                         ["UPDATE-1", "UPDATE-2", "UPDATE-3"])
+        self.assertEqual(ids(ui.get_by_issued_date("2014-02", "2014-03")),
+                         ["UPDATE-2"])
+        self.assertEqual(ids(ui.get_by_issued_date(to="2014-02")),
+                         ["UPDATE-1"])
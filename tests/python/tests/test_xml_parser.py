@@ -550,6 +550,60 @@ class TestCaseXmlParserOther(unittest.TestCase):
                           OTHER_MULTI_WARN_00_PATH,
                           newpkgcb, None, warningcb)
 
+class TestCasePackageIterator(unittest.TestCase):
+
+    def test_package_iterator_repo02(self):
+        warnings = []
+        def warningcb(warn_type, msg):
+            warnings.append((warn_type, msg))
+
+        pkgs = list(cr.PackageIterator(REPO_02_PRIXML,
+                                       REPO_02_FILXML,
+                                       REPO_02_OTHXML,
+                                       warningcb))
+
+        self.assertEqual([pkg.name for pkg in pkgs],
+            ['fake_bash', 'super_kernel'])
+        self.assertEqual(warnings, [])
+
+        pkg = pkgs[1]
+        self.assertEqual(pkg.pkgId, "6d43a638af70ef899933b1fd86a866f18f65b0e0e17dcbf2e42bfd0cdd7c63c3")
+        self.assertEqual(pkg.files,
+            [(None, '/usr/bin/', 'super_kernel'),
+             (None, '/usr/share/man/', 'super_kernel.8.gz')])
+        self.assertEqual(len(pkg.changelogs), 2)
+        self.assertEqual(pkg.changelogs[1],
+            ('Tomas Mlcoch <tmlcoch@redhat.com> - 6.0.1-2', 1334664001, '- Second release'))
+
+    def test_package_iterator_repo02_only_primary(self):
+        pkgs = list(cr.PackageIterator(REPO_02_PRIXML))
+        self.assertEqual([pkg.name for pkg in pkgs],
+            ['fake_bash', 'super_kernel'])
+        self.assertEqual(pkgs[1].changelogs, [])
+
+    def test_package_iterator_mismatched_files(self):
+        def iterate():
+            return list(cr.PackageIterator(REPO_02_PRIXML,
+                                           REPO_01_FILXML,
+                                           REPO_02_OTHXML))
+        self.assertRaises(cr.CreaterepoCError, iterate)
+
+    def test_package_iterator_reentrant_next(self):
+        errors = []
+        def warningcb(warn_type, msg):
+            # Called from inside of next() of the same iterator
+            try:
+                next(pkg_iterator)
+            except ValueError as err:
+                errors.append(str(err))
+
+        pkg_iterator = cr.PackageIterator(PRIMARY_MULTI_WARN_00_PATH,
+                                          None, None, warningcb)
+        pkgs = list(pkg_iterator)
+        self.assertTrue(pkgs)
+        self.assertTrue(errors)
+        self.assertEqual(set(errors), set(["generator already executing"]))
+
 class TestCaseXmlParserRepomd(unittest.TestCase):
 
     def test_xml_parser_repomd_bad_repomd_object(self):
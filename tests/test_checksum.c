@@ -99,6 +99,68 @@ test_cr_checksum_file(void)
 }
 
 
+static void
+test_cr_checksum_file_big(void)
+{
+    // Files of this size are hashed via mmap()
+    const size_t size = 5 * 1024 * 1024 + 123;
+    char *checksum, *checksum_stream;
+    char *content;
+    int fd;
+    GError *tmp_err = NULL;
+
+    gchar *path = g_strdup(TMPDIR_TEMPLATE);
+    fd = g_mkstemp(path);
+    g_assert_cmpint(fd, >=, 0);
+
+    content = g_malloc(size);
+    for (size_t x = 0; x < size; x++)
+        content[x] = (char) (x % 251);
+    g_assert_cmpint(write(fd, content, size), ==, size);
+    close(fd);
+
+    cr_ChecksumCtx *ctx = cr_checksum_new(CR_CHECKSUM_SHA256, NULL);
+    cr_checksum_update(ctx, content, size, NULL);
+    checksum_stream = cr_checksum_final(ctx, NULL);
+
+    checksum = cr_checksum_file(path, CR_CHECKSUM_SHA256, &tmp_err);
+    g_assert(!tmp_err);
+    g_assert_cmpstr(checksum, ==, checksum_stream);
+
+    g_free(checksum);
+    g_free(checksum_stream);
+    g_free(content);
+    remove(path);
+    g_free(path);
+}
+
+
+static void
+test_cr_checksum_file_multi(void)
+{
+    char **checksums;
+    GError *tmp_err = NULL;
+    cr_ChecksumType types[] = { CR_CHECKSUM_MD5,
+                                CR_CHECKSUM_SHA256,
+                                CR_CHECKSUM_SHA1 };
+
+    checksums = cr_checksum_file_multi(TEST_TEXT_FILE, types, 3, &tmp_err);
+    g_assert(!tmp_err);
+    g_assert(checksums);
+    g_assert_cmpstr(checksums[0], ==, "d6d4da5c15f8fe7570ce6ab6b3503916");
+    g_assert_cmpstr(checksums[1], ==, TEST_TEXT_FILE_SHA256SUM);
+    g_assert_cmpstr(checksums[2], ==, "da048ee8fabfbef1b3d6d3f5a4be20029eecec77");
+    g_assert(!checksums[3]);
+    g_strfreev(checksums);
+
+    types[1] = 244;
+    checksums = cr_checksum_file_multi(TEST_TEXT_FILE, types, 3, &tmp_err);
+    g_assert(!checksums);
+    g_assert(tmp_err);
+    g_clear_error(&tmp_err);
+}
+
+
 static void
 test_cr_checksum_name_str(void)
 {
@@ -136,6 +198,10 @@ main(int argc, char *argv[])
 
     g_test_add_func("/checksum/test_cr_checksum_file",
             test_cr_checksum_file);
+    g_test_add_func("/checksum/test_cr_checksum_file_big",
+            test_cr_checksum_file_big);
+    g_test_add_func("/checksum/test_cr_checksum_file_multi",
+            test_cr_checksum_file_multi);
     g_test_add_func("/checksum/test_cr_checksum_name_str",
             test_cr_checksum_name_str);
 
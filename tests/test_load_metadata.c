@@ -20,11 +20,19 @@
 #include <glib.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <unistd.h>
 #include "fixtures.h"
+#include "createrepo/checksum.h"
 #include "createrepo/error.h"
 #include "createrepo/package.h"
 #include "createrepo/misc.h"
 #include "createrepo/load_metadata.h"
+#include "createrepo/locate_metadata.h"
+#include "createrepo/snapshot.h"
+#include "createrepo/string_pool.h"
+
+#define TMP_DIR_PATTERN         "/tmp/createrepo_test_XXXXXX"
 
 #define REPO_SIZE_00    0
 static const char *REPO_HASH_KEYS_00[] = {};
@@ -151,6 +159,433 @@ static void test_cr_metadata_locate_and_load_xml_detailed(void)
 }
 
 
+static void test_cr_metadata_lazy(void)
+{
+    int ret;
+    cr_Package *pkg;
+    cr_Metadata *metadata;
+    GError *tmp_err = NULL;
+
+    metadata = cr_metadata_new(CR_HT_KEY_NAME, 1, NULL);
+    cr_metadata_set_lazy(metadata, TRUE);
+    ret = cr_metadata_locate_and_load_xml(metadata, TEST_REPO_02, &tmp_err);
+    g_assert_cmpint(ret, ==, CRE_OK);
+    g_assert(!tmp_err);
+
+    // Nothing is parsed yet
+    g_assert_cmpuint(g_hash_table_size(cr_metadata_hashtable(metadata)), ==, 0);
+
+    pkg = cr_metadata_get(metadata, "super_kernel", &tmp_err);
+    g_assert(!tmp_err);
+    g_assert(pkg);
+    g_assert_cmpstr(pkg->pkgId, ==, REPO_HASH_KEYS_02[0]);
+    g_assert_cmpstr(pkg->location_href, ==, REPO_FILENAME_KEYS_02[0]);
+    g_assert(pkg->loadingflags & CR_PACKAGE_LOADED_FIL);
+    g_assert(pkg->loadingflags & CR_PACKAGE_LOADED_OTH);
+    g_assert(pkg->requires);
+    g_assert(pkg->changelogs);
+    g_assert_cmpuint(g_hash_table_size(cr_metadata_hashtable(metadata)), ==, 1);
+
+    // Second access returns the same object
+    g_assert(cr_metadata_get(metadata, "super_kernel", NULL) == pkg);
+
+    g_assert(!cr_metadata_get(metadata, "nonexistent", &tmp_err));
+    g_assert(!tmp_err);
+
+    cr_metadata_free(metadata);
+}
+
+
+static void test_cr_metadata_lazy_multiple_locations(void)
+{
+    int ret;
+    cr_Package *pkg;
+    cr_Metadata *metadata;
+    GError *tmp_err = NULL;
+
+    metadata = cr_metadata_new(CR_HT_KEY_NAME, 1, NULL);
+    cr_metadata_set_lazy(metadata, TRUE);
+    ret = cr_metadata_locate_and_load_xml(metadata, TEST_REPO_01, &tmp_err);
+    g_assert_cmpint(ret, ==, CRE_OK);
+    ret = cr_metadata_locate_and_load_xml(metadata, TEST_REPO_02, &tmp_err);
+    g_assert_cmpint(ret, ==, CRE_OK);
+    g_assert(!tmp_err);
+
+    // The first occurrence is kept
+    pkg = cr_metadata_get(metadata, "super_kernel", &tmp_err);
+    g_assert(!tmp_err);
+    g_assert(pkg);
+    g_assert_cmpstr(pkg->pkgId, ==, REPO_HASH_KEYS_01[0]);
+
+    // Packages of the second location are available too
+    pkg = cr_metadata_get(metadata, "fake_bash", &tmp_err);
+    g_assert(!tmp_err);
+    g_assert(pkg);
+    g_assert_cmpstr(pkg->name, ==, "fake_bash");
+    g_assert(pkg->loadingflags & CR_PACKAGE_LOADED_FIL);
+
+    g_assert_cmpuint(g_hash_table_size(cr_metadata_hashtable(metadata)), ==, 2);
+
+    cr_metadata_free(metadata);
+}
+
+
+static void test_cr_metadata_lazy_char_refs(void)
+{
+    int ret;
+    int fd;
+    gchar *path;
+    cr_Package *pkg;
+    cr_Metadata *metadata;
+    struct cr_MetadataLocation ml;
+    GError *tmp_err = NULL;
+    const char *primary =
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<metadata xmlns=\"http://linux.duke.edu/metadata/common\" "
+        "xmlns:rpm=\"http://linux.duke.edu/metadata/rpm\" packages=\"1\">\n"
+        "<package type=\"rpm\">\n"
+        "  <name>foo&#45;bar&#x2B;&amp;</name>\n"
+        "  <arch>noarch</arch>\n"
+        "  <version epoch=\"0\" ver=\"1\" rel=\"1\"/>\n"
+        "  <checksum type=\"sha256\" pkgid=\"YES\">abc</checksum>\n"
+        "  <summary>Caf&#xe9; &#169;</summary>\n"
+        "  <location href=\"foo&#45;bar-1-1.noarch.rpm\"/>\n"
+        "</package>\n"
+        "</metadata>\n";
+
+    fd = g_file_open_tmp("createrepo_ctest-XXXXXX.xml", &path, &tmp_err);
+    g_assert(!tmp_err);
+    close(fd);
+    g_assert(g_file_set_contents(path, primary, -1, &tmp_err));
+
+    memset(&ml, 0, sizeof(ml));
+    ml.pri_xml_href = path;
+
+    metadata = cr_metadata_new(CR_HT_KEY_NAME, 1, NULL);
+    cr_metadata_set_lazy(metadata, TRUE);
+    ret = cr_metadata_load_xml(metadata, &ml, &tmp_err);
+    g_assert_cmpint(ret, ==, CRE_OK);
+    g_assert(!tmp_err);
+
+    pkg = cr_metadata_get(metadata, "foo-bar+&", &tmp_err);
+    g_assert(!tmp_err);
+    g_assert(pkg);
+    g_assert_cmpstr(pkg->name, ==, "foo-bar+&");
+    g_assert_cmpstr(pkg->summary, ==, "Caf\xc3\xa9 \xc2\xa9");
+    g_assert_cmpstr(pkg->location_href, ==, "foo-bar-1-1.noarch.rpm");
+
+    cr_metadata_free(metadata);
+
+    // Filename keys are decoded the same way
+    metadata = cr_metadata_new(CR_HT_KEY_FILENAME, 1, NULL);
+    cr_metadata_set_lazy(metadata, TRUE);
+    ret = cr_metadata_load_xml(metadata, &ml, &tmp_err);
+    g_assert_cmpint(ret, ==, CRE_OK);
+    g_assert(cr_metadata_get(metadata, "foo-bar-1-1.noarch.rpm", NULL));
+    cr_metadata_free(metadata);
+
+    remove(path);
+    g_free(path);
+}
+
+
+static void test_cr_metadata_lazy_comments_cdata(void)
+{
+    int ret;
+    int fd;
+    gchar *path;
+    cr_Package *pkg;
+    cr_Metadata *metadata;
+    struct cr_MetadataLocation ml;
+    GError *tmp_err = NULL;
+    const char *primary =
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<metadata xmlns=\"http://linux.duke.edu/metadata/common\" "
+        "xmlns:rpm=\"http://linux.duke.edu/metadata/rpm\" packages=\"1\">\n"
+        "<!-- <package type=\"rpm\"><name>old</name></package> -->\n"
+        "<package type=\"rpm\">\n"
+        "  <name><![CDATA[foo]]></name>\n"
+        "  <arch>noarch</arch>\n"
+        "  <version epoch=\"0\" ver=\"1\" rel=\"1\"/>\n"
+        "  <!-- <checksum type=\"sha256\">bad</checksum> -->\n"
+        "  <checksum type=\"sha256\" pkgid=\"YES\">abc</checksum>\n"
+        "  <description><![CDATA[</package><package type=\"rpm\">"
+        "<checksum>xyz</checksum>]]></description>\n"
+        "  <location href=\"foo-1-1.noarch.rpm\"/>\n"
+        "</package>\n"
+        "</metadata>\n";
+
+    fd = g_file_open_tmp("createrepo_ctest-XXXXXX.xml", &path, &tmp_err);
+    g_assert(!tmp_err);
+    close(fd);
+    g_assert(g_file_set_contents(path, primary, -1, &tmp_err));
+
+    memset(&ml, 0, sizeof(ml));
+    ml.pri_xml_href = path;
+
+    metadata = cr_metadata_new(CR_HT_KEY_NAME, 1, NULL);
+    cr_metadata_set_lazy(metadata, TRUE);
+    ret = cr_metadata_load_xml(metadata, &ml, &tmp_err);
+    g_assert_cmpint(ret, ==, CRE_OK);
+    g_assert(!tmp_err);
+    g_assert_cmpuint(cr_metadata_count(metadata), ==, 1);
+
+    pkg = cr_metadata_get(metadata, "foo", &tmp_err);
+    g_assert(!tmp_err);
+    g_assert(pkg);
+    g_assert_cmpstr(pkg->pkgId, ==, "abc");
+    g_assert_cmpstr(pkg->description, ==,
+                    "</package><package type=\"rpm\"><checksum>xyz</checksum>");
+    g_assert(!cr_metadata_get(metadata, "old", NULL));
+
+    cr_metadata_free(metadata);
+
+    remove(path);
+    g_free(path);
+}
+
+
+static void test_cr_metadata_keep_xml(void)
+{
+    int ret;
+    gsize len;
+    const char *xml;
+    gchar *chunk;
+    cr_Metadata *metadata;
+    GError *tmp_err = NULL;
+
+    metadata = cr_metadata_new(CR_HT_KEY_FILENAME, 1, NULL);
+    cr_metadata_set_keep_xml(metadata, TRUE);
+    ret = cr_metadata_locate_and_load_xml(metadata, TEST_REPO_02, &tmp_err);
+    g_assert_cmpint(ret, ==, CRE_OK);
+    g_assert(!tmp_err);
+    g_assert_cmpuint(g_hash_table_size(cr_metadata_hashtable(metadata)), ==,
+                     REPO_SIZE_02);
+
+    xml = cr_metadata_get_xml(metadata, REPO_HASH_KEYS_02[0],
+                              CR_XMLFILE_FILELISTS, &len);
+    g_assert(xml);
+    chunk = g_strndup(xml, len);
+    g_assert(g_str_has_prefix(chunk, "<package "));
+    g_assert(g_str_has_suffix(chunk, "</package>"));
+    g_assert(strstr(chunk, REPO_HASH_KEYS_02[0]));
+    g_assert(strstr(chunk, "<file>"));
+    g_free(chunk);
+
+    xml = cr_metadata_get_xml(metadata, REPO_HASH_KEYS_02[1],
+                              CR_XMLFILE_OTHER, &len);
+    g_assert(xml);
+    chunk = g_strndup(xml, len);
+    g_assert(g_str_has_prefix(chunk, "<package "));
+    g_assert(g_str_has_suffix(chunk, "</package>"));
+    g_assert(strstr(chunk, REPO_HASH_KEYS_02[1]));
+    g_free(chunk);
+
+    g_assert(!cr_metadata_get_xml(metadata, REPO_HASH_KEYS_02[0],
+                                  CR_XMLFILE_PRIMARY, &len));
+    g_assert(!cr_metadata_get_xml(metadata, "nonexistent",
+                                  CR_XMLFILE_OTHER, &len));
+
+    cr_metadata_free(metadata);
+}
+
+static void test_cr_metadata_string_pool(void)
+{
+    int ret;
+    const char *str;
+    cr_Package *pkg;
+    cr_Metadata *metadata;
+    cr_StringPool *pool;
+    cr_StringPoolStats stats;
+    GError *tmp_err = NULL;
+
+    pool = cr_string_pool_new();
+
+    str = cr_string_pool_intern(pool, "libc.so.6()(64bit)");
+    g_assert_cmpstr(str, ==, "libc.so.6()(64bit)");
+    g_assert(cr_string_pool_intern(pool, "libc.so.6()(64bit)") == str);
+    g_assert(!cr_string_pool_intern(pool, NULL));
+    cr_string_pool_get_stats(pool, &stats);
+    g_assert_cmpint(stats.strings, ==, 1);
+    g_assert_cmpint(stats.hits, ==, 1);
+    g_assert_cmpint(stats.saved_bytes, ==, strlen(str) + 1);
+
+    cr_string_pool_set_default(pool);
+    metadata = cr_metadata_new(CR_HT_KEY_HASH, 1, NULL);
+    ret = cr_metadata_locate_and_load_xml(metadata, TEST_REPO_02, &tmp_err);
+    cr_string_pool_set_default(NULL);
+    g_assert_cmpint(ret, ==, CRE_OK);
+    g_assert(!tmp_err);
+    g_assert_cmpuint(g_hash_table_size(cr_metadata_hashtable(metadata)), ==,
+                     REPO_SIZE_02);
+
+    // Strings of the packages are owned by the pool
+    pkg = g_hash_table_lookup(cr_metadata_hashtable(metadata),
+                              REPO_HASH_KEYS_02[0]);
+    g_assert(pkg);
+    g_assert(cr_string_pool_intern(pool, pkg->epoch) == pkg->epoch);
+    g_assert(cr_string_pool_intern(pool, pkg->version) == pkg->version);
+    g_assert(cr_string_pool_intern(pool, pkg->rpm_license) == pkg->rpm_license);
+    g_assert(pkg->provides);
+    str = ((cr_Dependency *) pkg->provides->data)->name;
+    g_assert(cr_string_pool_intern(pool, str) == str);
+
+    cr_string_pool_get_stats(pool, &stats);
+    g_assert_cmpint(stats.strings, >, 1);
+    g_assert_cmpint(stats.hits, >, 1);
+
+    cr_metadata_free(metadata);
+    cr_string_pool_free(pool);
+    g_assert(!cr_string_pool_get_default());
+}
+
+static void test_cr_snapshot(void)
+{
+    int ret;
+    gboolean res;
+    gchar *tmp_dir, *path;
+    GArray *found;
+    GHashTableIter iter;
+    gpointer value;
+    cr_Package *pkg, *spkg;
+    cr_Metadata *metadata, *smetadata;
+    cr_SnapshotWriter *sw;
+    cr_Snapshot *snap;
+    GSList *pkglist = NULL;
+    GError *tmp_err = NULL;
+
+    tmp_dir = g_strdup(TMP_DIR_PATTERN);
+    g_assert(mkdtemp(tmp_dir));
+    path = g_build_filename(tmp_dir, CR_SNAPSHOT_FILENAME, NULL);
+
+    // Write snapshot of the repo
+    metadata = cr_metadata_new(CR_HT_KEY_HASH, 0, NULL);
+    ret = cr_metadata_locate_and_load_xml(metadata, TEST_REPO_02, NULL);
+    g_assert_cmpint(ret, ==, CRE_OK);
+
+    sw = cr_snapshot_writer_new();
+    g_hash_table_iter_init(&iter, cr_metadata_hashtable(metadata));
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        res = cr_snapshot_writer_add_pkg(sw, value, &tmp_err);
+        g_assert(res);
+        g_assert(!tmp_err);
+    }
+    res = cr_snapshot_writer_write(sw, path, &tmp_err);
+    g_assert(res);
+    g_assert(!tmp_err);
+    cr_snapshot_writer_free(sw);
+
+    // Lookups without materialization
+    snap = cr_snapshot_open(path, &tmp_err);
+    g_assert(snap);
+    g_assert(!tmp_err);
+    g_assert_cmpuint(cr_snapshot_count(snap), ==, REPO_SIZE_02);
+
+    found = cr_snapshot_find(snap, CR_HT_KEY_NAME, "fake_bash");
+    g_assert_cmpuint(found->len, ==, 1);
+    g_assert_cmpstr(cr_snapshot_package_key(snap,
+                            g_array_index(found, guint, 0), CR_HT_KEY_HASH),
+                    ==, REPO_HASH_KEYS_02[1]);
+    g_array_free(found, TRUE);
+
+    found = cr_snapshot_find(snap, CR_HT_KEY_FILENAME, REPO_FILENAME_KEYS_02[0]);
+    g_assert_cmpuint(found->len, ==, 1);
+    g_array_free(found, TRUE);
+
+    found = cr_snapshot_find(snap, CR_HT_KEY_NAME, "nonexistent");
+    g_assert_cmpuint(found->len, ==, 0);
+    g_array_free(found, TRUE);
+
+    // Materialization
+    found = cr_snapshot_find(snap, CR_HT_KEY_HASH, REPO_HASH_KEYS_02[0]);
+    g_assert_cmpuint(found->len, ==, 1);
+    spkg = cr_snapshot_package(snap, g_array_index(found, guint, 0),
+                               CR_PACKAGE_LOADED_FIL|CR_PACKAGE_LOADED_OTH,
+                               NULL);
+    g_array_free(found, TRUE);
+    g_assert(spkg);
+    g_assert(spkg->loadingflags & CR_PACKAGE_FROM_SNAPSHOT);
+
+    pkg = g_hash_table_lookup(cr_metadata_hashtable(metadata),
+                              REPO_HASH_KEYS_02[0]);
+    g_assert(pkg);
+    g_assert_cmpstr(spkg->name, ==, pkg->name);
+    g_assert_cmpstr(spkg->epoch, ==, pkg->epoch);
+    g_assert_cmpstr(spkg->rpm_vendor, ==, pkg->rpm_vendor);
+    g_assert_cmpstr(spkg->location_href, ==, pkg->location_href);
+    g_assert_cmpint(spkg->time_file, ==, pkg->time_file);
+    g_assert_cmpint(spkg->size_package, ==, pkg->size_package);
+    g_assert_cmpuint(g_slist_length(spkg->requires), ==,
+                     g_slist_length(pkg->requires));
+    g_assert_cmpuint(g_slist_length(spkg->provides), ==,
+                     g_slist_length(pkg->provides));
+    g_assert_cmpuint(g_slist_length(spkg->files), ==,
+                     g_slist_length(pkg->files));
+    g_assert_cmpuint(g_slist_length(spkg->changelogs), ==,
+                     g_slist_length(pkg->changelogs));
+    cr_package_free(spkg);
+    cr_snapshot_close(snap);
+
+    // Load into cr_Metadata with a pkglist
+    pkglist = g_slist_prepend(pkglist, (gpointer) REPO_FILENAME_KEYS_02[1]);
+    smetadata = cr_metadata_new(CR_HT_KEY_FILENAME, 1, pkglist);
+    ret = cr_metadata_load_snapshot(smetadata, path, &tmp_err);
+    g_assert_cmpint(ret, ==, CRE_OK);
+    g_assert(!tmp_err);
+    g_assert_cmpuint(g_hash_table_size(cr_metadata_hashtable(smetadata)), ==, 1);
+    g_assert(g_hash_table_lookup(cr_metadata_hashtable(smetadata),
+                                 REPO_FILENAME_KEYS_02[1]));
+    cr_metadata_free(smetadata);
+    g_slist_free(pkglist);
+
+    // Load through a metadata location
+    struct cr_MetadataLocation *ml = g_malloc0(sizeof(*ml));
+    ml->pri_xml_href = g_strdup(TEST_REPO_02_PRIMARY);
+    ml->fil_xml_href = g_strdup(TEST_REPO_02_FILELISTS);
+    ml->oth_xml_href = g_strdup(TEST_REPO_02_OTHER);
+    ml->snapshot_href = g_strdup(path);
+    ml->snapshot_checksum = cr_checksum_file(path, CR_CHECKSUM_SHA256, NULL);
+    ml->snapshot_checksum_type = g_strdup("sha256");
+
+    // The snapshot is ignored unless enabled
+    smetadata = cr_metadata_new(CR_HT_KEY_HASH, 0, NULL);
+    ret = cr_metadata_load_xml(smetadata, ml, &tmp_err);
+    g_assert_cmpint(ret, ==, CRE_OK);
+    g_assert(!tmp_err);
+    pkg = g_hash_table_lookup(cr_metadata_hashtable(smetadata),
+                              REPO_HASH_KEYS_02[0]);
+    g_assert(pkg);
+    g_assert(!(pkg->loadingflags & CR_PACKAGE_FROM_SNAPSHOT));
+    cr_metadata_free(smetadata);
+
+    // Enabled and matching the checksum from repomd.xml
+    smetadata = cr_metadata_new(CR_HT_KEY_HASH, 0, NULL);
+    cr_metadata_set_use_snapshot(smetadata, TRUE);
+    ret = cr_metadata_load_xml(smetadata, ml, &tmp_err);
+    g_assert_cmpint(ret, ==, CRE_OK);
+    g_assert(!tmp_err);
+    g_assert_cmpuint(g_hash_table_size(cr_metadata_hashtable(smetadata)),
+                     ==, REPO_SIZE_02);
+    pkg = g_hash_table_lookup(cr_metadata_hashtable(smetadata),
+                              REPO_HASH_KEYS_02[0]);
+    g_assert(pkg);
+    g_assert(pkg->loadingflags & CR_PACKAGE_FROM_SNAPSHOT);
+    cr_metadata_free(smetadata);
+    cr_metadatalocation_free(ml);
+
+    // Not a snapshot
+    snap = cr_snapshot_open(TEST_REPO_02_REPOMD, &tmp_err);
+    g_assert(!snap);
+    g_assert_cmpint(tmp_err->code, ==, CRE_BADSNAPSHOT);
+    g_clear_error(&tmp_err);
+
+    cr_metadata_free(metadata);
+    cr_remove_dir(tmp_dir, NULL);
+    g_free(path);
+    g_free(tmp_dir);
+}
+
+
 int main(int argc, char *argv[])
 {
     g_test_init(&argc, &argv, NULL);
@@ -158,6 +593,16 @@ int main(int argc, char *argv[])
     g_test_add_func("/load_metadata/test_cr_metadata_new", test_cr_metadata_new);
     g_test_add_func("/load_metadata/test_cr_metadata_locate_and_load_xml", test_cr_metadata_locate_and_load_xml);
     g_test_add_func("/load_metadata/test_cr_metadata_locate_and_load_xml_detailed", test_cr_metadata_locate_and_load_xml_detailed);
+    g_test_add_func("/load_metadata/test_cr_metadata_lazy", test_cr_metadata_lazy);
+    g_test_add_func("/load_metadata/test_cr_metadata_lazy_multiple_locations",
+                    test_cr_metadata_lazy_multiple_locations);
+    g_test_add_func("/load_metadata/test_cr_metadata_lazy_char_refs",
+                    test_cr_metadata_lazy_char_refs);
+    g_test_add_func("/load_metadata/test_cr_metadata_lazy_comments_cdata",
+                    test_cr_metadata_lazy_comments_cdata);
+    g_test_add_func("/load_metadata/test_cr_metadata_keep_xml", test_cr_metadata_keep_xml);
+    g_test_add_func("/load_metadata/test_cr_metadata_string_pool", test_cr_metadata_string_pool);
+    g_test_add_func("/load_metadata/test_cr_snapshot", test_cr_snapshot);
 
     return g_test_run();
 }
@@ -0,0 +1,303 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2013  Tomas Mlcoch
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "fixtures.h"
+#include "createrepo/error.h"
+#include "createrepo/mdserver.h"
+#include "createrepo/misc.h"
+#include "createrepo/package.h"
+
+#define TMP_DIR_PATTERN     "/tmp/createrepo_test_XXXXXX"
+
+#define REPO_01_KERNEL_ID   "152824bff2aa6d54f429d43e87a3ff3a0286505c6d93ec87692b5e3a9e3b97bf"
+#define REPO_02_KERNEL_ID   "6d43a638af70ef899933b1fd86a866f18f65b0e0e17dcbf2e42bfd0cdd7c63c3"
+
+typedef struct {
+    gchar *tmp_dir;
+    gchar *repo;
+    gchar *repodata;
+    gchar *socket;
+    cr_MdServer *srv;
+    GThread *thread;
+} TestData;
+
+static gpointer
+server_thread(gpointer data)
+{
+    TestData *testdata = data;
+    GError *err = NULL;
+
+    g_assert(cr_mdserver_run(testdata->srv, &err));
+    g_assert(!err);
+    return NULL;
+}
+
+/** Copy the repodata of a test repo. repomd.xml is replaced atomically,
+ * like createrepo_c does.
+ */
+static void
+copy_repodata(TestData *testdata,
+              const char *repomd,
+              const char *primary,
+              const char *filelists,
+              const char *other)
+{
+    GError *err = NULL;
+    gchar *tmp_repomd, *dst_repomd;
+
+    g_assert(cr_copy_file(primary, testdata->repodata, &err));
+    g_assert(cr_copy_file(filelists, testdata->repodata, &err));
+    g_assert(cr_copy_file(other, testdata->repodata, &err));
+    g_assert(!err);
+
+    tmp_repomd = g_build_filename(testdata->tmp_dir, "repomd.xml.new", NULL);
+    dst_repomd = g_build_filename(testdata->repodata, "repomd.xml", NULL);
+    g_assert(cr_copy_file(repomd, tmp_repomd, &err));
+    g_assert(!err);
+    g_assert_cmpint(g_rename(tmp_repomd, dst_repomd), ==, 0);
+    g_free(tmp_repomd);
+    g_free(dst_repomd);
+}
+
+static void
+testdata_setup(TestData *testdata,
+               G_GNUC_UNUSED gconstpointer test_data)
+{
+    GError *err = NULL;
+    gchar *cache_dir;
+
+    testdata->tmp_dir = g_strdup(TMP_DIR_PATTERN);
+    g_assert(mkdtemp(testdata->tmp_dir));
+
+    testdata->repo = g_build_filename(testdata->tmp_dir, "repo", NULL);
+    testdata->repodata = g_build_filename(testdata->repo, "repodata", NULL);
+    g_assert_cmpint(g_mkdir_with_parents(testdata->repodata, 0755), ==, 0);
+    copy_repodata(testdata, TEST_REPO_01_REPOMD, TEST_REPO_01_PRIMARY,
+                  TEST_REPO_01_FILELISTS, TEST_REPO_01_OTHER);
+
+    testdata->socket = g_build_filename(testdata->tmp_dir, "sock", NULL);
+    cache_dir = g_build_filename(testdata->tmp_dir, "cache", NULL);
+    testdata->srv = cr_mdserver_new(testdata->socket, cache_dir, &err);
+    g_assert(testdata->srv);
+    g_assert(!err);
+    g_free(cache_dir);
+
+    testdata->thread = g_thread_new("mdserver", server_thread, testdata);
+}
+
+static void
+testdata_teardown(TestData *testdata,
+                  G_GNUC_UNUSED gconstpointer test_data)
+{
+    cr_mdserver_stop(testdata->srv);
+    g_thread_join(testdata->thread);
+    cr_mdserver_free(testdata->srv);
+    g_assert(!g_file_test(testdata->socket, G_FILE_TEST_EXISTS));
+
+    cr_remove_dir(testdata->tmp_dir, NULL);
+    g_free(testdata->tmp_dir);
+    g_free(testdata->repo);
+    g_free(testdata->repodata);
+    g_free(testdata->socket);
+}
+
+static guint
+count_found(cr_MdClient *client,
+            const char *repo,
+            cr_MdKey key,
+            const char *value,
+            const char *pkgid)
+{
+    GError *err = NULL;
+    GSList *pkgs;
+    guint count;
+
+    pkgs = cr_mdclient_find(client, repo, key, value,
+                            CR_PACKAGE_LOADED_PRI, &err);
+    g_assert(!err);
+
+    count = g_slist_length(pkgs);
+    for (GSList *elem = pkgs; elem && pkgid; elem = g_slist_next(elem))
+        g_assert_cmpstr(((cr_Package *) elem->data)->pkgId, ==, pkgid);
+
+    g_slist_free_full(pkgs, (GDestroyNotify) cr_package_free);
+    return count;
+}
+
+static void
+test_cr_mdclient_find(TestData *testdata,
+                      G_GNUC_UNUSED gconstpointer test_data)
+{
+    GError *err = NULL;
+    cr_MdClient *client;
+    gchar *cwd;
+    const char *repo = testdata->repo;
+
+    client = cr_mdclient_new(testdata->socket, &err);
+    g_assert(client);
+    g_assert(!err);
+
+    g_assert_cmpint(count_found(client, repo, CR_MD_KEY_NAME,
+                        "super_kernel", REPO_01_KERNEL_ID), ==, 1);
+    g_assert_cmpint(count_found(client, repo, CR_MD_KEY_HASH,
+                        REPO_01_KERNEL_ID, REPO_01_KERNEL_ID), ==, 1);
+    g_assert_cmpint(count_found(client, repo, CR_MD_KEY_FILENAME,
+                        "super_kernel-6.0.1-2.x86_64.rpm",
+                        REPO_01_KERNEL_ID), ==, 1);
+    g_assert_cmpint(count_found(client, repo, CR_MD_KEY_NEVRA,
+                        "super_kernel-6.0.1-2.x86_64",
+                        REPO_01_KERNEL_ID), ==, 1);
+    g_assert_cmpint(count_found(client, repo, CR_MD_KEY_NEVRA,
+                        "super_kernel-0:6.0.1-2.x86_64",
+                        REPO_01_KERNEL_ID), ==, 1);
+    g_assert_cmpint(count_found(client, repo, CR_MD_KEY_NEVRA,
+                        "super_kernel-6.0.1-3.x86_64", NULL), ==, 0);
+    g_assert_cmpint(count_found(client, repo, CR_MD_KEY_NAME,
+                        "fake_bash", NULL), ==, 0);
+
+    // Bad NEVRA
+    g_assert(!cr_mdclient_find(client, repo, CR_MD_KEY_NEVRA, "foo",
+                               CR_PACKAGE_LOADED_PRI, &err));
+    g_assert(err);
+    g_assert_cmpint(err->code, ==, CRE_BADARG);
+    g_clear_error(&err);
+
+    // Not a repository
+    g_assert(!cr_mdclient_find(client, testdata->tmp_dir, CR_MD_KEY_NAME,
+                               "foo", CR_PACKAGE_LOADED_PRI, &err));
+    g_assert(err);
+    g_assert_cmpint(err->code, ==, CRE_MDSERVER);
+    g_clear_error(&err);
+
+    // Relative path is resolved in the working directory of the client
+    cwd = g_get_current_dir();
+    g_assert_cmpint(g_chdir(testdata->tmp_dir), ==, 0);
+    g_assert_cmpint(count_found(client, "repo", CR_MD_KEY_NAME,
+                        "super_kernel", REPO_01_KERNEL_ID), ==, 1);
+    g_assert_cmpint(g_chdir(cwd), ==, 0);
+    g_free(cwd);
+
+    cr_mdclient_free(client);
+}
+
+static void
+test_cr_mdclient_reload(TestData *testdata,
+                        G_GNUC_UNUSED gconstpointer test_data)
+{
+    GError *err = NULL;
+    cr_MdClient *client, *client2;
+    cr_Snapshot *snap, *snap2;
+    const char *repo = testdata->repo;
+
+    client = cr_mdclient_new(testdata->socket, &err);
+    g_assert(client);
+    g_assert(!err);
+
+    snap = cr_mdclient_snapshot(client, repo, &err);
+    g_assert(snap);
+    g_assert(!err);
+    g_assert_cmpint(cr_snapshot_count(snap), ==, 1);
+
+    // The same revision - the mapped snapshot is reused
+    snap2 = cr_mdclient_snapshot(client, repo, &err);
+    g_assert(snap2 == snap);
+
+    // New revision of the repository
+    copy_repodata(testdata, TEST_REPO_02_REPOMD, TEST_REPO_02_PRIMARY,
+                  TEST_REPO_02_FILELISTS, TEST_REPO_02_OTHER);
+
+    g_assert_cmpint(count_found(client, repo, CR_MD_KEY_NAME,
+                        "fake_bash", NULL), ==, 1);
+    g_assert_cmpint(count_found(client, repo, CR_MD_KEY_NAME,
+                        "super_kernel", REPO_02_KERNEL_ID), ==, 1);
+
+    snap = cr_mdclient_snapshot(client, repo, &err);
+    g_assert(snap);
+    g_assert_cmpint(cr_snapshot_count(snap), ==, 2);
+
+    // Other clients get the same snapshot
+    client2 = cr_mdclient_new(testdata->socket, &err);
+    g_assert(client2);
+    g_assert_cmpint(count_found(client2, repo, CR_MD_KEY_HASH,
+                        REPO_02_KERNEL_ID, REPO_02_KERNEL_ID), ==, 1);
+
+    cr_mdclient_free(client2);
+    cr_mdclient_free(client);
+}
+
+typedef struct {
+    cr_MdClient *client;
+    const char *repo;
+} FindThreadData;
+
+static gpointer
+find_thread(gpointer data)
+{
+    FindThreadData *ftd = data;
+
+    for (int x = 0; x < 50; x++)
+        g_assert_cmpint(count_found(ftd->client, ftd->repo, CR_MD_KEY_NAME,
+                            "super_kernel", REPO_01_KERNEL_ID), ==, 1);
+    return NULL;
+}
+
+static void
+test_cr_mdclient_threads(TestData *testdata,
+                         G_GNUC_UNUSED gconstpointer test_data)
+{
+    GError *err = NULL;
+    GThread *threads[4];
+    FindThreadData ftd;
+
+    ftd.client = cr_mdclient_new(testdata->socket, &err);
+    ftd.repo = testdata->repo;
+    g_assert(ftd.client);
+    g_assert(!err);
+
+    // One client shared by more threads
+    for (guint x = 0; x < G_N_ELEMENTS(threads); x++)
+        threads[x] = g_thread_new("find", find_thread, &ftd);
+    for (guint x = 0; x < G_N_ELEMENTS(threads); x++)
+        g_thread_join(threads[x]);
+
+    cr_mdclient_free(ftd.client);
+}
+
+int
+main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add("/mdserver/test_cr_mdclient_find",
+               TestData, NULL, testdata_setup,
+               test_cr_mdclient_find, testdata_teardown);
+    g_test_add("/mdserver/test_cr_mdclient_reload",
+               TestData, NULL, testdata_setup,
+               test_cr_mdclient_reload, testdata_teardown);
+    g_test_add("/mdserver/test_cr_mdclient_threads",
+               TestData, NULL, testdata_setup,
+               test_cr_mdclient_threads, testdata_teardown);
+
+    return g_test_run();
+}
@@ -0,0 +1,127 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2013  Tomas Mlcoch
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <glib.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "createrepo/error.h"
+#include "createrepo/package.h"
+
+static cr_Package *
+package_with_lists(void)
+{
+    cr_Package *pkg = cr_package_new();
+    const char *paths[] = { "/usr/bin/a", "/usr/bin/b", "/usr/bin/c" };
+
+    pkg->name = g_string_chunk_insert(pkg->chunk, "foo");
+    pkg->pkgId = g_string_chunk_insert(pkg->chunk, "abc");
+
+    for (int x = 2; x >= 0; x--) {
+        cr_PackageFile *file = cr_package_file_new();
+        file->path = g_string_chunk_insert(pkg->chunk, paths[x]);
+        pkg->files = g_slist_prepend(pkg->files, file);
+
+        cr_ChangelogEntry *log = cr_changelog_entry_new();
+        log->date = x;
+        pkg->changelogs = g_slist_prepend(pkg->changelogs, log);
+    }
+
+    return pkg;
+}
+
+static void
+test_cr_package_copy_into(void)
+{
+    GError *err = NULL;
+    cr_Package *orig = package_with_lists();
+    cr_Package *pkg = cr_package_new();
+
+    int ret = cr_package_copy_into(pkg, orig, &err);
+    g_assert_cmpint(ret, ==, CRE_OK);
+    g_assert_no_error(err);
+    g_assert_cmpstr(pkg->name, ==, "foo");
+    g_assert_cmpstr(pkg->pkgId, ==, "abc");
+    g_assert(pkg->name != orig->name);
+
+    // Lists keep the order of the source package
+    g_assert_cmpint(g_slist_length(pkg->files), ==, 3);
+    g_assert_cmpstr(((cr_PackageFile *) pkg->files->data)->path, ==,
+                    "/usr/bin/a");
+    g_assert_cmpstr(((cr_PackageFile *) g_slist_last(pkg->files)->data)->path,
+                    ==, "/usr/bin/c");
+    g_assert_cmpint(((cr_ChangelogEntry *) pkg->changelogs->data)->date, ==, 0);
+    g_assert_cmpint(((cr_ChangelogEntry *)
+                     g_slist_last(pkg->changelogs)->data)->date, ==, 2);
+
+    cr_package_free(pkg);
+    cr_package_free(orig);
+}
+
+static void
+test_cr_package_copy_into_without_chunk(void)
+{
+    GError *err = NULL;
+    cr_Package *orig = package_with_lists();
+    cr_Package *pkg = cr_package_new_without_chunk();
+
+    int ret = cr_package_copy_into(pkg, orig, &err);
+    g_assert_cmpint(ret, ==, CRE_BADARG);
+    g_assert(err);
+    g_assert_cmpint(err->code, ==, CRE_BADARG);
+    g_assert(pkg->name == NULL);
+    g_assert(pkg->files == NULL);
+    g_clear_error(&err);
+
+    cr_package_free(pkg);
+    cr_package_free(orig);
+}
+
+static void
+test_cr_package_copy(void)
+{
+    cr_Package *orig = package_with_lists();
+    cr_Package *pkg = cr_package_copy(orig);
+
+    g_assert_cmpstr(pkg->name, ==, "foo");
+
+    // cr_package_copy() has always returned the lists reversed
+    g_assert_cmpint(g_slist_length(pkg->files), ==, 3);
+    g_assert_cmpstr(((cr_PackageFile *) pkg->files->data)->path, ==,
+                    "/usr/bin/c");
+    g_assert_cmpint(((cr_ChangelogEntry *) pkg->changelogs->data)->date, ==, 2);
+
+    cr_package_free(pkg);
+    cr_package_free(orig);
+}
+
+int
+main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/package/test_cr_package_copy_into",
+                    test_cr_package_copy_into);
+    g_test_add_func("/package/test_cr_package_copy_into_without_chunk",
+                    test_cr_package_copy_into_without_chunk);
+    g_test_add_func("/package/test_cr_package_copy",
+                    test_cr_package_copy);
+
+    return g_test_run();
+}
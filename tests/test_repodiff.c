@@ -0,0 +1,190 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2013  Tomas Mlcoch
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <glib.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "fixtures.h"
+#include "createrepo/error.h"
+#include "createrepo/repodiff.h"
+#include "createrepo/xml_parser.h"
+
+typedef struct {
+    const char *name;
+    const char *release;
+    const char *pkgId;
+} TestPkg;
+
+/** Write a minimal primary.xml with the packages into a temporary file.
+ */
+static gchar *
+write_primary(const TestPkg *pkgs, int count)
+{
+    int fd;
+    gchar *path;
+    GError *err = NULL;
+    GString *xml = g_string_new(
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<metadata xmlns=\"http://linux.duke.edu/metadata/common\" "
+        "xmlns:rpm=\"http://linux.duke.edu/metadata/rpm\">\n");
+
+    for (int x = 0; x < count; x++)
+        g_string_append_printf(xml,
+            "<package type=\"rpm\">\n"
+            "  <name>%s</name>\n"
+            "  <arch>x86_64</arch>\n"
+            "  <version epoch=\"0\" ver=\"1.0\" rel=\"%s\"/>\n"
+            "  <checksum type=\"sha256\" pkgid=\"YES\">%s</checksum>\n"
+            "  <location href=\"%s-1.0-%s.x86_64.rpm\"/>\n"
+            "</package>\n",
+            pkgs[x].name, pkgs[x].release, pkgs[x].pkgId,
+            pkgs[x].name, pkgs[x].release);
+    g_string_append(xml, "</metadata>\n");
+
+    fd = g_file_open_tmp("createrepo_ctest-XXXXXX-primary.xml", &path, &err);
+    g_assert(!err);
+    close(fd);
+    g_assert(g_file_set_contents(path, xml->str, -1, &err));
+    g_string_free(xml, TRUE);
+
+    return path;
+}
+
+static int
+diffcb(cr_RepodiffType type,
+       const cr_RepodiffPackage *old_pkg,
+       const cr_RepodiffPackage *new_pkg,
+       void *cbdata,
+       G_GNUC_UNUSED GError **err)
+{
+    GString *out = cbdata;
+    g_string_append_printf(out, "%s %s %s %s\n",
+                           cr_repodiff_type_to_str(type),
+                           (new_pkg ? new_pkg : old_pkg)->name,
+                           old_pkg ? old_pkg->pkgId : "-",
+                           new_pkg ? new_pkg->pkgId : "-");
+    return CR_CB_RET_OK;
+}
+
+static gchar *
+diff(const TestPkg *old_pkgs, int old_count,
+     const TestPkg *new_pkgs, int new_count,
+     cr_RepodiffStats *stats)
+{
+    int ret;
+    GError *err = NULL;
+    GString *out = g_string_new(NULL);
+    gchar *old_path = write_primary(old_pkgs, old_count);
+    gchar *new_path = write_primary(new_pkgs, new_count);
+
+    ret = cr_repodiff_primary(old_path, new_path, diffcb, out, stats, &err);
+    g_assert_cmpint(ret, ==, CRE_OK);
+    g_assert(!err);
+
+    remove(old_path);
+    remove(new_path);
+    g_free(old_path);
+    g_free(new_path);
+
+    return g_string_free(out, FALSE);
+}
+
+static void
+test_cr_repodiff_changed(void)
+{
+    gchar *out;
+    cr_RepodiffStats stats;
+    TestPkg old_pkgs[] = {
+        {"bar", "1", "b1"},
+        {"foo", "1", "f1"},
+        {"qux", "1", "q1"},
+    };
+    TestPkg new_pkgs[] = {
+        {"baz", "1", "z1"},
+        {"foo", "1", "f2"},
+        {"qux", "1", "q1"},
+    };
+
+    out = diff(old_pkgs, 3, new_pkgs, 3, &stats);
+    g_assert_cmpstr(out, ==,
+                    "removed bar b1 -\n"
+                    "added baz - z1\n"
+                    "changed foo f1 f2\n");
+    g_assert_cmpint(stats.old_packages, ==, 3);
+    g_assert_cmpint(stats.new_packages, ==, 3);
+    g_assert_cmpint(stats.added, ==, 1);
+    g_assert_cmpint(stats.removed, ==, 1);
+    g_assert_cmpint(stats.changed, ==, 1);
+    g_free(out);
+}
+
+static void
+test_cr_repodiff_duplicate_nevra(void)
+{
+    gchar *out;
+    cr_RepodiffStats stats;
+    TestPkg old_pkgs[] = {
+        {"foo", "1", "a"},
+        {"foo", "1", "b"},
+        {"foo", "2", "c"},
+        {"foo", "2", "d"},
+    };
+    TestPkg new_pkgs[] = {
+        {"foo", "1", "b"},
+        {"foo", "1", "e"},
+        {"foo", "2", "d"},
+    };
+
+    // Identical pkgIds are paired first, only the rebuild is changed
+    out = diff(old_pkgs, 4, new_pkgs, 3, &stats);
+    g_assert_cmpstr(out, ==,
+                    "changed foo a e\n"
+                    "removed foo c -\n");
+    g_assert_cmpint(stats.added, ==, 0);
+    g_assert_cmpint(stats.removed, ==, 1);
+    g_assert_cmpint(stats.changed, ==, 1);
+    g_free(out);
+
+    // Identical packages are never reported
+    out = diff(old_pkgs, 4, old_pkgs + 2, 2, &stats);
+    g_assert_cmpstr(out, ==,
+                    "removed foo a -\n"
+                    "removed foo b -\n");
+    g_free(out);
+
+    out = diff(new_pkgs, 3, new_pkgs, 3, &stats);
+    g_assert_cmpstr(out, ==, "");
+    g_assert_cmpint(stats.changed, ==, 0);
+    g_free(out);
+}
+
+int
+main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/repodiff/test_cr_repodiff_changed",
+                    test_cr_repodiff_changed);
+    g_test_add_func("/repodiff/test_cr_repodiff_duplicate_nevra",
+                    test_cr_repodiff_duplicate_nevra);
+
+    return g_test_run();
+}
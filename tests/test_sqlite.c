@@ -24,6 +24,7 @@
 #include <unistd.h>
 #include <sqlite3.h>
 #include "fixtures.h"
+#include "createrepo/error.h"
 #include "createrepo/misc.h"
 #include "createrepo/package.h"
 #include "createrepo/sqlite.h"
@@ -292,6 +293,67 @@ test_cr_db_dbinfo_update(TestData *testdata,
 
 
 
+static void
+test_cr_db_index(TestData *testdata,
+                 G_GNUC_UNUSED gconstpointer test_data)
+{
+    GError *err = NULL;
+    gchar *path;
+    cr_SqliteDb *db;
+    cr_Package *pkg;
+    sqlite3 *check_db;
+    sqlite3_stmt *stmt;
+    int rc;
+
+    // Create new db and add a package
+
+    path = g_strconcat(testdata->tmp_dir, "/", TMP_PRIMARY_NAME, NULL);
+    db = cr_db_open_primary(path, &err);
+    g_assert(db);
+    g_assert(!err);
+
+    pkg = get_package();
+    cr_db_add_pkg(db, pkg, &err);
+    g_assert(!err);
+
+    // Build the indexes before the dbinfo is known
+
+    g_assert(!db->indexed);
+    g_assert_cmpint(cr_db_index(db, &err), ==, CRE_OK);
+    g_assert(!err);
+    g_assert(db->indexed);
+
+    // Second call does nothing
+
+    g_assert_cmpint(cr_db_index(db, &err), ==, CRE_OK);
+    g_assert(!err);
+
+    cr_db_dbinfo_update(db, "foochecksum", &err);
+    g_assert(!err);
+    cr_db_close(db, &err);
+    g_assert(!err);
+
+    // Check the index exists
+
+    rc = sqlite3_open(path, &check_db);
+    g_assert_cmpint(rc, ==, SQLITE_OK);
+    rc = sqlite3_prepare_v2(check_db,
+                            "SELECT name FROM sqlite_master WHERE "
+                            "type = 'index' AND name = 'packagename'",
+                            -1, &stmt, NULL);
+    g_assert_cmpint(rc, ==, SQLITE_OK);
+    g_assert_cmpint(sqlite3_step(stmt), ==, SQLITE_ROW);
+    sqlite3_finalize(stmt);
+    sqlite3_close(check_db);
+
+    // Cleanup
+
+    cr_package_free(pkg);
+    g_free(path);
+}
+
+
+
 static void
 test_all(TestData *testdata,
          G_GNUC_UNUSED gconstpointer test_data)
@@ -356,6 +418,7 @@ main(int argc, char *argv[])
     g_test_add("/sqlite/test_cr_open_db", TestData, NULL, testdata_setup, test_cr_open_db, testdata_teardown);
     g_test_add("/sqlite/test_cr_db_add_primary_pkg", TestData, NULL, testdata_setup, test_cr_db_add_primary_pkg, testdata_teardown);
     g_test_add("/sqlite/test_cr_db_dbinfo_update", TestData, NULL, testdata_setup, test_cr_db_dbinfo_update, testdata_teardown);
+    g_test_add("/sqlite/test_cr_db_index", TestData, NULL, testdata_setup, test_cr_db_index, testdata_teardown);
     g_test_add("/sqlite/test_all", TestData, NULL, testdata_setup, test_all, testdata_teardown);
 
     return g_test_run();
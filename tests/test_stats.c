@@ -0,0 +1,196 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2014  Tomas Mlcoch
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <glib.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "createrepo/error.h"
+#include "createrepo/misc.h"
+#include "createrepo/stats.h"
+
+#define TMP_DIR_PATTERN         "/tmp/createrepo_test_XXXXXX"
+
+typedef struct {
+    gchar *tmp_dir;
+    gchar *path;
+} TestData;
+
+static void
+testdata_setup(TestData *testdata,
+               G_GNUC_UNUSED gconstpointer test_data)
+{
+    testdata->tmp_dir = g_strdup(TMP_DIR_PATTERN);
+    g_assert(mkdtemp(testdata->tmp_dir));
+    testdata->path = g_build_filename(testdata->tmp_dir, "stats.json", NULL);
+}
+
+static void
+testdata_teardown(TestData *testdata,
+                  G_GNUC_UNUSED gconstpointer test_data)
+{
+    cr_remove_dir(testdata->tmp_dir, NULL);
+    g_free(testdata->tmp_dir);
+    g_free(testdata->path);
+}
+
+static gpointer
+worker_thread(gpointer data)
+{
+    cr_WorkerStats *ws = cr_stats_worker(data);
+
+    g_assert(ws);
+    g_assert(ws == cr_stats_worker(data));
+    ws->packages            = 3;
+    ws->cache_hits          = 1;
+    ws->checksum_cache_hits = 1;
+    ws->bytes_read          = 2048;
+    return NULL;
+}
+
+static gchar *
+read_report(const char *path)
+{
+    gchar *content = NULL;
+    g_assert(g_file_get_contents(path, &content, NULL, NULL));
+    return content;
+}
+
+static void
+test_cr_stats_write_json(TestData *testdata,
+                         G_GNUC_UNUSED gconstpointer test_data)
+{
+    GError *tmp_err = NULL;
+    cr_Stats *stats = cr_stats_new();
+    GThread *threads[2];
+    gchar *report;
+
+    cr_stats_set_int(stats, "workers", 2);
+    cr_stats_set_int(stats, "package_count", 5);
+    cr_stats_set_int(stats, "package_count", 6);
+    cr_stats_phase_begin(stats, "walk");
+    cr_stats_phase_end(stats, "walk");
+    cr_stats_phase_begin(stats, "dump");
+    for (int x = 0; x < 2; x++)
+        threads[x] = g_thread_new("worker", worker_thread, stats);
+    for (int x = 0; x < 2; x++)
+        g_thread_join(threads[x]);
+    cr_stats_phase_end(stats, "dump");
+    cr_stats_phase_begin(stats, "unfinished");
+
+    g_assert(cr_stats_write_json(stats, testdata->path, &tmp_err));
+    g_assert_no_error(tmp_err);
+    report = read_report(testdata->path);
+
+    g_assert(g_str_has_prefix(report, "{\n  \"version\": 1,\n"));
+    g_assert(g_str_has_suffix(report, "}\n"));
+    g_assert(strstr(report, "\n  \"workers\": 2,\n"));
+    g_assert(strstr(report, "\n  \"package_count\": 6,\n"));
+    g_assert(!strstr(report, "\"package_count\": 5"));
+
+    // Phases in the order they were started
+    g_assert(strstr(report, "{\"name\": \"walk\""));
+    g_assert(strstr(report, "{\"name\": \"dump\"")
+             > strstr(report, "{\"name\": \"walk\""));
+    g_assert(strstr(report, "\"unfinished\", \"start\": "));
+    g_assert(strstr(report, ", \"duration\": null}"));
+
+    // Per worker counters and their sum
+    g_assert(strstr(report, "\n      \"bytes_read\": 2048,\n"));
+    g_assert(strstr(report, "\n      \"checksum_cache_hits\": 1,\n"));
+    g_assert(strstr(report, "\n    \"packages\": 6,\n"));
+    g_assert(strstr(report, "\n    \"cache_hits\": 2,\n"));
+    g_assert(strstr(report, "\n    \"checksum_cache_hits\": 2,\n"));
+    g_assert(strstr(report, "\n    \"bytes_read\": 4096,\n"));
+    g_assert(strstr(report, "\n  \"cache_hit_ratio\": 0.333,\n"));
+
+    g_free(report);
+    cr_stats_free(stats);
+}
+
+static void
+test_cr_stats_write_json_empty(TestData *testdata,
+                               G_GNUC_UNUSED gconstpointer test_data)
+{
+    GError *tmp_err = NULL;
+    cr_Stats *stats = cr_stats_new();
+    gchar *report;
+
+    g_assert(cr_stats_write_json(stats, testdata->path, &tmp_err));
+    g_assert_no_error(tmp_err);
+    report = read_report(testdata->path);
+
+    g_assert(strstr(report, "\n  \"phases\": [],\n"));
+    g_assert(strstr(report, "\n  \"workers\": [],\n"));
+    g_assert(strstr(report, "\n  \"cache_hit_ratio\": 0.000,\n"));
+    g_assert(strstr(report, "\n  \"packages_per_second\": 0.000,\n"));
+    g_assert(strstr(report, "\n  \"bytes_read_per_second\": 0.000\n}\n"));
+
+    g_free(report);
+    cr_stats_free(stats);
+}
+
+static void
+test_cr_stats_write_json_bad_path(TestData *testdata,
+                                  G_GNUC_UNUSED gconstpointer test_data)
+{
+    GError *tmp_err = NULL;
+    cr_Stats *stats = cr_stats_new();
+    gchar *path = g_build_filename(testdata->tmp_dir, "no_such_dir",
+                                   "stats.json", NULL);
+
+    g_assert(!cr_stats_write_json(stats, path, &tmp_err));
+    g_assert(tmp_err);
+    g_assert_cmpint(tmp_err->code, ==, CRE_IO);
+    g_clear_error(&tmp_err);
+
+    g_free(path);
+    cr_stats_free(stats);
+}
+
+static void
+test_cr_stats_null(void)
+{
+    // All the instrumentation calls are no-ops without stats
+    cr_stats_phase_begin(NULL, "dump");
+    cr_stats_phase_end(NULL, "dump");
+    cr_stats_set_int(NULL, "workers", 1);
+    g_assert(cr_stats_worker(NULL) == NULL);
+    cr_stats_free(NULL);
+}
+
+int
+main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add("/stats/test_cr_stats_write_json",
+               TestData, NULL, testdata_setup,
+               test_cr_stats_write_json, testdata_teardown);
+    g_test_add("/stats/test_cr_stats_write_json_empty",
+               TestData, NULL, testdata_setup,
+               test_cr_stats_write_json_empty, testdata_teardown);
+    g_test_add("/stats/test_cr_stats_write_json_bad_path",
+               TestData, NULL, testdata_setup,
+               test_cr_stats_write_json_bad_path, testdata_teardown);
+    g_test_add_func("/stats/test_cr_stats_null",
+                    test_cr_stats_null);
+
+    return g_test_run();
+}
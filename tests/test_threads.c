@@ -0,0 +1,148 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2013  Tomas Mlcoch
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <glib.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "fixtures.h"
+#include "createrepo/error.h"
+#include "createrepo/threads.h"
+
+#define THREADS     4
+
+typedef struct {
+    GMutex *mutex;
+    GString *order;     // Names of the finished tasks
+} Log;
+
+typedef struct {
+    const char *name;
+    gboolean fail;
+    Log *log;
+} Job;
+
+static gboolean
+job_func(gpointer data, GError **err)
+{
+    Job *job = data;
+
+    // Give the tasks which don't wait for this one a chance to run
+    g_usleep(1000);
+
+    g_mutex_lock(job->log->mutex);
+    g_string_append(job->log->order, job->name);
+    g_mutex_unlock(job->log->mutex);
+
+    if (job->fail) {
+        g_set_error(err, CREATEREPO_C_ERROR, CRE_ERROR, "%s failed", job->name);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void
+test_cr_taskgraph_order(void)
+{
+    GError *tmp_err = NULL;
+    Log log = { g_mutex_new(), g_string_new(NULL) };
+    Job a = { "a", FALSE, &log }, b = { "b", FALSE, &log };
+    Job c = { "c", FALSE, &log }, d = { "d", FALSE, &log };
+
+    // d depends on b and c, both depend on a
+    cr_TaskGraph *graph = cr_taskgraph_new();
+    cr_TaskGraphTask *ta = cr_taskgraph_add(graph, "a", job_func, &a);
+    cr_TaskGraphTask *tb = cr_taskgraph_add(graph, "b", job_func, &b);
+    cr_TaskGraphTask *tc = cr_taskgraph_add(graph, "c", job_func, &c);
+    cr_TaskGraphTask *td = cr_taskgraph_add(graph, "d", job_func, &d);
+    cr_taskgraph_depends(tb, ta);
+    cr_taskgraph_depends(tc, ta);
+    cr_taskgraph_depends(td, tb);
+    cr_taskgraph_depends(td, tc);
+    cr_taskgraph_depends(td, NULL);
+
+    g_assert(cr_taskgraph_run(graph, THREADS, &tmp_err));
+    g_assert(tmp_err == NULL);
+
+    g_assert_cmpint(log.order->len, ==, 4);
+    g_assert_cmpint(log.order->str[0], ==, 'a');
+    g_assert_cmpint(log.order->str[3], ==, 'd');
+
+    cr_taskgraph_free(graph);
+    g_string_free(log.order, TRUE);
+    g_mutex_free(log.mutex);
+}
+
+static void
+test_cr_taskgraph_failure(void)
+{
+    GError *tmp_err = NULL;
+    Log log = { g_mutex_new(), g_string_new(NULL) };
+    Job a = { "a", TRUE, &log }, b = { "b", FALSE, &log };
+    Job c = { "c", FALSE, &log }, d = { "d", FALSE, &log };
+
+    // b and d (through b) depend on the failing a, c is independent
+    cr_TaskGraph *graph = cr_taskgraph_new();
+    cr_TaskGraphTask *ta = cr_taskgraph_add(graph, "a", job_func, &a);
+    cr_TaskGraphTask *tb = cr_taskgraph_add(graph, "b", job_func, &b);
+    cr_TaskGraphTask *tc = cr_taskgraph_add(graph, "c", job_func, &c);
+    cr_TaskGraphTask *td = cr_taskgraph_add(graph, "d", job_func, &d);
+    cr_taskgraph_depends(tb, ta);
+    cr_taskgraph_depends(td, tb);
+    cr_taskgraph_depends(td, tc);
+
+    g_assert(!cr_taskgraph_run(graph, THREADS, &tmp_err));
+    g_assert(tmp_err != NULL);
+    g_assert_cmpstr(tmp_err->message, ==, "a: a failed");
+    g_error_free(tmp_err);
+
+    g_assert_cmpint(log.order->len, ==, 2);
+    g_assert(strchr(log.order->str, 'a'));
+    g_assert(strchr(log.order->str, 'c'));
+
+    cr_taskgraph_free(graph);
+    g_string_free(log.order, TRUE);
+    g_mutex_free(log.mutex);
+}
+
+static void
+test_cr_taskgraph_empty(void)
+{
+    GError *tmp_err = NULL;
+    cr_TaskGraph *graph = cr_taskgraph_new();
+    g_assert(cr_taskgraph_run(graph, THREADS, &tmp_err));
+    g_assert(tmp_err == NULL);
+    cr_taskgraph_free(graph);
+}
+
+int
+main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/threads/test_cr_taskgraph_order",
+                    test_cr_taskgraph_order);
+    g_test_add_func("/threads/test_cr_taskgraph_failure",
+                    test_cr_taskgraph_failure);
+    g_test_add_func("/threads/test_cr_taskgraph_empty",
+                    test_cr_taskgraph_empty);
+
+    return g_test_run();
+}
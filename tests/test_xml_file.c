@@ -28,6 +28,8 @@
 #include "createrepo/misc.h"
 #include "createrepo/xml_file.h"
 #include "createrepo/compression_wrapper.h"
+#include "createrepo/error.h"
+#include "createrepo/zck_writer.h"
 
 typedef struct {
     gchar *tmpdir;
@@ -94,12 +96,127 @@ test_no_packages(TestFixtures *fixtures,
 }
 
 
+#ifdef WITH_ZCHUNK
+static void
+test_zck_writer(TestFixtures *fixtures,
+                G_GNUC_UNUSED gconstpointer test_data)
+{
+    cr_XmlFile *f;
+    cr_ZckWriter *w;
+    gchar *path;
+    gchar contents[2048];
+    int ret;
+    GError *err = NULL;
+
+    path = g_build_filename(fixtures->tmpdir, "primary.xml.zck", NULL);
+    f = cr_xmlfile_open_primary(path, CR_CW_ZCK_COMPRESSION, &err);
+    g_assert(f);
+    g_assert(err == NULL);
+    cr_xmlfile_set_num_of_pkgs(f, 3, NULL);
+
+    w = cr_zck_writer_new(f, "primary", TRUE, &err);
+    g_assert(w);
+    g_assert(err == NULL);
+    cr_zck_writer_add(w, "<package>a</package>\n", TRUE);
+    cr_zck_writer_add(w, "<package>b</package>\n", FALSE);
+    cr_zck_writer_add(w, "<package>c</package>\n", TRUE);
+    g_assert(cr_zck_writer_finish(w, &err));
+    g_assert(err == NULL);
+    cr_zck_writer_free(w);
+    cr_xmlfile_close(f, &err);
+    g_assert(err == NULL);
+
+    CR_FILE *crf = cr_open(path,
+                           CR_CW_MODE_READ,
+                           CR_CW_AUTO_DETECT_COMPRESSION,
+                           NULL);
+    g_assert(crf);
+    ret = cr_read(crf, &contents, 2047, NULL);
+    g_assert(ret != CR_CW_ERR);
+    contents[ret] = '\0';
+    cr_close(crf, NULL);
+    g_assert_cmpstr(contents, ==, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+            "<metadata xmlns=\"http://linux.duke.edu/metadata/common\" "
+            "xmlns:rpm=\"http://linux.duke.edu/metadata/rpm\" "
+            "packages=\"3\">\n"
+            "<package>a</package>\n"
+            "<package>b</package>\n"
+            "<package>c</package>\n"
+            "</metadata>");
+
+    g_free(path);
+}
+
+
+static gchar *
+write_zck_primary(const char *tmpdir, const char *name, const char **chunks)
+{
+    cr_XmlFile *f;
+    cr_ZckWriter *w;
+    GError *err = NULL;
+    gchar *path = g_build_filename(tmpdir, name, NULL);
+
+    f = cr_xmlfile_open_primary(path, CR_CW_ZCK_COMPRESSION, &err);
+    g_assert(f);
+    w = cr_zck_writer_new(f, "primary", FALSE, &err);
+    g_assert(w);
+    for (int x = 0; chunks[x]; x++)
+        cr_zck_writer_add(w, chunks[x], TRUE);
+    g_assert(cr_zck_writer_finish(w, &err));
+    cr_zck_writer_free(w);
+    cr_xmlfile_close(f, &err);
+    g_assert(err == NULL);
+
+    return path;
+}
+
+
+static void
+test_zck_reused_chunks(TestFixtures *fixtures,
+                       G_GNUC_UNUSED gconstpointer test_data)
+{
+    const char *old_chunks[] = { "<package>a</package>\n",
+                                 "<package>b</package>\n",
+                                 "<package>c</package>\n", NULL };
+    const char *new_chunks[] = { "<package>a</package>\n",
+                                 "<package>B</package>\n",
+                                 "<package>c</package>\n", NULL };
+    gchar *old_path, *new_path;
+    gint64 reused, total;
+    int ret;
+    GError *err = NULL;
+
+    old_path = write_zck_primary(fixtures->tmpdir, "old.xml.zck", old_chunks);
+    new_path = write_zck_primary(fixtures->tmpdir, "new.xml.zck", new_chunks);
+
+    ret = cr_zck_count_reused_chunks(old_path, old_path, &reused, &total, &err);
+    g_assert_cmpint(ret, ==, CRE_OK);
+    g_assert(err == NULL);
+    g_assert_cmpint(reused, ==, total);
+
+    // Only the chunk of the "b" package differs
+    ret = cr_zck_count_reused_chunks(old_path, new_path, &reused, &total, &err);
+    g_assert_cmpint(ret, ==, CRE_OK);
+    g_assert(err == NULL);
+    g_assert_cmpint(total, ==, 3);
+    g_assert_cmpint(reused, ==, 2);
+
+    g_free(old_path);
+    g_free(new_path);
+}
+#endif
+
+
 int
 main(int argc, char *argv[])
 {
     g_test_init(&argc, &argv, NULL);
 
     g_test_add("/xml_file/test_no_packages", TestFixtures, NULL, fixtures_setup, test_no_packages, fixtures_teardown);
+#ifdef WITH_ZCHUNK
+    g_test_add("/xml_file/test_zck_writer", TestFixtures, NULL, fixtures_setup, test_zck_writer, fixtures_teardown);
+    g_test_add("/xml_file/test_zck_reused_chunks", TestFixtures, NULL, fixtures_setup, test_zck_reused_chunks, fixtures_teardown);
+#endif
 
     return g_test_run();
 }
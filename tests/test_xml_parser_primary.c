@@ -0,0 +1,291 @@
+/* createrepo_c - Library of routines for manipulation with repodata
+ * Copyright (C) 2013  Tomas Mlcoch
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+
+#include <glib.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "fixtures.h"
+#include "createrepo/error.h"
+#include "createrepo/package.h"
+#include "createrepo/misc.h"
+#include "createrepo/xml_dump.h"
+#include "createrepo/xml_file.h"
+#include "createrepo/xml_parser.h"
+
+#define TMP_DIR_PATTERN         "/tmp/createrepo_test_XXXXXX"
+#define WORKERS                 4
+#define BIG_PACKAGES            5000
+
+// Callbacks
+
+static int
+pkgcb_nevra(cr_Package *pkg, void *cbdata, GError **err)
+{
+    g_assert(pkg);
+    g_assert(!err || *err == NULL);
+    GString *out = cbdata;
+    gchar *nevra = cr_package_nevra(pkg);
+    g_string_append_printf(out, "%s %s %d;", nevra, pkg->pkgId,
+                           g_slist_length(pkg->files));
+    g_free(nevra);
+    cr_package_free(pkg);
+    return CR_CB_RET_OK;
+}
+
+static int
+pkgcb_interrupt(cr_Package *pkg, void *cbdata, GError **err)
+{
+    g_assert(pkg);
+    g_assert(!err || *err == NULL);
+    if (cbdata) *((int *)cbdata) += 1;
+    cr_package_free(pkg);
+    return CR_CB_RET_ERR;
+}
+
+static int
+newpkgcb_skip_odd(cr_Package **pkg,
+                  G_GNUC_UNUSED const char *pkgId,
+                  G_GNUC_UNUSED const char *name,
+                  G_GNUC_UNUSED const char *arch,
+                  void *cbdata,
+                  GError **err)
+{
+    g_assert(pkg != NULL);
+    g_assert(*pkg == NULL);
+    g_assert(!err || *err == NULL);
+
+    if ((*((int *) cbdata))++ % 2)
+        return CR_CB_RET_OK;
+
+    *pkg = cr_package_new();
+    return CR_CB_RET_OK;
+}
+
+static int
+warningcb(G_GNUC_UNUSED cr_XmlParserWarningType type,
+          char *msg,
+          void *cbdata,
+          G_GNUC_UNUSED GError **err)
+{
+    g_assert(type < CR_XML_WARNING_SENTINEL);
+    g_assert(!err || *err == NULL);
+
+    g_string_append((GString *) cbdata, msg);
+    g_string_append((GString *) cbdata, ";");
+
+    return CR_CB_RET_OK;
+}
+
+// Helpers
+
+/* Parse the file sequentially and in parallel and compare
+ * the delivered packages (and warnings) */
+static void
+compare_with_sequential(const char *path,
+                        cr_XmlParserNewPkgCb newpkgcb,
+                        int do_files,
+                        int expected_packages)
+{
+    int ret, counter;
+    GString *seq = g_string_new(NULL), *par = g_string_new(NULL);
+    GString *seq_warn = g_string_new(NULL), *par_warn = g_string_new(NULL);
+    GError *tmp_err = NULL;
+
+    counter = 0;
+    ret = cr_xml_parse_primary(path,
+                               newpkgcb, &counter,
+                               pkgcb_nevra, seq,
+                               warningcb, seq_warn,
+                               do_files, &tmp_err);
+    g_assert(!tmp_err);
+    g_assert_cmpint(ret, ==, CRE_OK);
+
+    counter = 0;
+    ret = cr_xml_parse_primary_parallel(path,
+                                        newpkgcb, &counter,
+                                        pkgcb_nevra, par,
+                                        warningcb, par_warn,
+                                        do_files, WORKERS, &tmp_err);
+    g_assert(!tmp_err);
+    g_assert_cmpint(ret, ==, CRE_OK);
+
+    if (expected_packages >= 0) {
+        int count = 0;
+        for (const char *c = par->str; *c; c++)
+            if (*c == ';')
+                count++;
+        g_assert_cmpint(count, ==, expected_packages);
+    }
+
+    g_assert_cmpstr(par->str, ==, seq->str);
+    g_assert_cmpstr(par_warn->str, ==, seq_warn->str);
+
+    g_string_free(seq, TRUE);
+    g_string_free(par, TRUE);
+    g_string_free(seq_warn, TRUE);
+    g_string_free(par_warn, TRUE);
+}
+
+/* Write primary.xml with many copies of the packages from repo_02 */
+static gchar *
+write_big_primary(const char *tmp_dir)
+{
+    GError *tmp_err = NULL;
+    GSList *pkgs = NULL;
+    gchar *path = g_build_filename(tmp_dir, "primary.xml.gz", NULL);
+    cr_XmlFile *f;
+
+    cr_xml_dump_init();
+
+    cr_PkgIterator *iter = cr_pkg_iterator_new(TEST_REPO_02_PRIMARY, NULL,
+                                               NULL, NULL, NULL, &tmp_err);
+    g_assert(iter);
+    cr_Package *pkg;
+    while ((pkg = cr_pkg_iterator_next(iter, &tmp_err)))
+        pkgs = g_slist_append(pkgs, pkg);
+    g_assert(!tmp_err);
+    cr_pkg_iterator_free(iter);
+    g_assert_cmpint(g_slist_length(pkgs), ==, 2);
+
+    f = cr_xmlfile_open(path, CR_XMLFILE_PRIMARY, CR_CW_GZ_COMPRESSION,
+                        &tmp_err);
+    g_assert(f);
+    cr_xmlfile_set_num_of_pkgs(f, BIG_PACKAGES, NULL);
+
+    for (int x = 0; x < BIG_PACKAGES; x++) {
+        cr_Package *orig = g_slist_nth_data(pkgs, x % 2);
+        cr_Package *copy = cr_package_copy(orig);
+        gchar *name = g_strdup_printf("%s_%05d", orig->name, x);
+        gchar *pkgId = g_strdup_printf("%s%05d", orig->pkgId, x);
+        copy->name = g_string_chunk_insert(copy->chunk, name);
+        copy->pkgId = g_string_chunk_insert(copy->chunk, pkgId);
+        g_free(name);
+        g_free(pkgId);
+        char *chunk = cr_xml_dump_primary(copy, &tmp_err);
+        g_assert(chunk);
+        cr_xmlfile_add_chunk(f, chunk, &tmp_err);
+        g_assert(!tmp_err);
+        g_free(chunk);
+        cr_package_free(copy);
+    }
+
+    cr_xmlfile_close(f, &tmp_err);
+    g_assert(!tmp_err);
+    g_slist_free_full(pkgs, (GDestroyNotify) cr_package_free);
+    cr_xml_dump_cleanup();
+
+    return path;
+}
+
+// Tests
+
+static void
+test_cr_xml_parse_primary_parallel_00(void)
+{
+    compare_with_sequential(TEST_REPO_00_PRIMARY, NULL, 1, 0);
+}
+
+static void
+test_cr_xml_parse_primary_parallel_02(void)
+{
+    compare_with_sequential(TEST_REPO_02_PRIMARY, NULL, 1, 2);
+    compare_with_sequential(TEST_REPO_02_PRIMARY, NULL, 0, 2);
+}
+
+static void
+test_cr_xml_parse_primary_parallel_unknown_element(void)
+{
+    compare_with_sequential(TEST_MRF_UE_PRI_00, NULL, 1, -1);
+    compare_with_sequential(TEST_MRF_UE_PRI_01, NULL, 1, -1);
+    compare_with_sequential(TEST_MRF_UE_PRI_02, NULL, 1, -1);
+}
+
+static void
+test_cr_xml_parse_primary_parallel_different_md_type(void)
+{
+    compare_with_sequential(TEST_REPO_01_FILELISTS, NULL, 1, 0);
+}
+
+static void
+test_cr_xml_parse_primary_parallel_big(void)
+{
+    gchar *tmp_dir = g_strdup(TMP_DIR_PATTERN);
+    g_assert(mkdtemp(tmp_dir));
+    gchar *path = write_big_primary(tmp_dir);
+
+    compare_with_sequential(path, NULL, 1, BIG_PACKAGES);
+    compare_with_sequential(path, newpkgcb_skip_odd, 1, BIG_PACKAGES / 2);
+
+    cr_remove_dir(tmp_dir, NULL);
+    g_free(path);
+    g_free(tmp_dir);
+}
+
+static void
+test_cr_xml_parse_primary_parallel_pkgcb_interrupt(void)
+{
+    int parsed = 0;
+    GError *tmp_err = NULL;
+    int ret = cr_xml_parse_primary_parallel(TEST_REPO_02_PRIMARY, NULL, NULL,
+                                            pkgcb_interrupt, &parsed,
+                                            NULL, NULL, 1, WORKERS, &tmp_err);
+    g_assert(tmp_err != NULL);
+    g_error_free(tmp_err);
+    g_assert_cmpint(ret, ==, CRE_CBINTERRUPTED);
+    g_assert_cmpint(parsed, ==, 1);
+}
+
+static void
+test_cr_xml_parse_primary_parallel_no_file(void)
+{
+    int parsed = 0;
+    GError *tmp_err = NULL;
+    int ret = cr_xml_parse_primary_parallel(TEST_DATA_PATH"no_such_file.xml",
+                                            NULL, NULL,
+                                            pkgcb_interrupt, &parsed,
+                                            NULL, NULL, 1, WORKERS, &tmp_err);
+    g_assert(tmp_err != NULL);
+    g_error_free(tmp_err);
+    g_assert_cmpint(ret, !=, CRE_OK);
+    g_assert_cmpint(parsed, ==, 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/xml_parser_primary/test_cr_xml_parse_primary_parallel_00",
+                    test_cr_xml_parse_primary_parallel_00);
+    g_test_add_func("/xml_parser_primary/test_cr_xml_parse_primary_parallel_02",
+                    test_cr_xml_parse_primary_parallel_02);
+    g_test_add_func("/xml_parser_primary/test_cr_xml_parse_primary_parallel_unknown_element",
+                    test_cr_xml_parse_primary_parallel_unknown_element);
+    g_test_add_func("/xml_parser_primary/test_cr_xml_parse_primary_parallel_different_md_type",
+                    test_cr_xml_parse_primary_parallel_different_md_type);
+    g_test_add_func("/xml_parser_primary/test_cr_xml_parse_primary_parallel_big",
+                    test_cr_xml_parse_primary_parallel_big);
+    g_test_add_func("/xml_parser_primary/test_cr_xml_parse_primary_parallel_pkgcb_interrupt",
+                    test_cr_xml_parse_primary_parallel_pkgcb_interrupt);
+    g_test_add_func("/xml_parser_primary/test_cr_xml_parse_primary_parallel_no_file",
+                    test_cr_xml_parse_primary_parallel_no_file);
+
+    return g_test_run();
+}
@@ -23,8 +23,40 @@
 #include "fixtures.h"
 #include "createrepo/error.h"
 #include "createrepo/misc.h"
+#include "createrepo/xml_file.h"
 #include "createrepo/xml_parser.h"
 #include "createrepo/updateinfo.h"
+#include "createrepo/updateinfo_writer.h"
+
+#define TMP_DIR_PATTERN         "/tmp/createrepo_test_XXXXXX"
+#define WRITER_RECORDS          1000
+#define WRITER_WORKERS          4
+
+// Callbacks
+
+static int
+recordcb_collect(cr_UpdateRecord *rec, void *cbdata, G_GNUC_UNUSED GError **err)
+{
+    GSList **records = cbdata;
+    *records = g_slist_prepend(*records, rec);
+    return CR_CB_RET_OK;
+}
+
+static int
+recordcb_interrupt(cr_UpdateRecord *rec, void *cbdata, G_GNUC_UNUSED GError **err)
+{
+    int *parsed = cbdata;
+    (*parsed)++;
+    cr_updaterecord_free(rec);
+    return CR_CB_RET_ERR;
+}
+
+static int
+recordcb_write(cr_UpdateRecord *rec, void *cbdata, G_GNUC_UNUSED GError **err)
+{
+    cr_updateinfo_writer_add(cbdata, rec);
+    return CR_CB_RET_OK;
+}
 
 // Tests
 
@@ -168,6 +200,135 @@ test_cr_xml_parse_updateinfo_02(void)
     cr_updateinfo_free(ui);
 }
 
+static void
+test_cr_xml_parse_updateinfo_records_01(void)
+{
+    GError *tmp_err = NULL;
+    GSList *records = NULL;
+    cr_UpdateRecord *update;
+
+    int ret = cr_xml_parse_updateinfo_records(TEST_UPDATEINFO_01,
+                                              recordcb_collect, &records,
+                                              NULL, NULL, &tmp_err);
+
+    g_assert(tmp_err == NULL);
+    g_assert_cmpint(ret, ==, CRE_OK);
+
+    g_assert_cmpint(g_slist_length(records), ==, 1);
+    update = records->data;
+    g_assert_cmpstr(update->id, ==, "foobarupdate_1");
+    g_assert_cmpint(g_slist_length(update->references), ==, 1);
+    g_assert_cmpint(g_slist_length(update->collections), ==, 1);
+
+    cr_slist_free_full(records, (GDestroyNotify) cr_updaterecord_free);
+}
+
+static void
+test_cr_xml_parse_updateinfo_records_interrupt(void)
+{
+    int parsed = 0;
+    GError *tmp_err = NULL;
+
+    int ret = cr_xml_parse_updateinfo_records(TEST_UPDATEINFO_01,
+                                              recordcb_interrupt, &parsed,
+                                              NULL, NULL, &tmp_err);
+
+    g_assert(tmp_err != NULL);
+    g_error_free(tmp_err);
+    g_assert_cmpint(ret, ==, CRE_CBINTERRUPTED);
+    g_assert_cmpint(parsed, ==, 1);
+}
+
+static cr_UpdateRecord *
+new_record(int idx)
+{
+    cr_UpdateRecord *rec = cr_updaterecord_new();
+    cr_UpdateCollection *col = cr_updatecollection_new();
+    cr_UpdateCollectionPackage *pkg = cr_updatecollectionpackage_new();
+    gchar *id = g_strdup_printf("UPDATE-%06d", idx);
+
+    rec->id = g_string_chunk_insert(rec->chunk, id);
+    rec->type = g_string_chunk_insert(rec->chunk, "bugfix");
+    rec->title = g_string_chunk_insert(rec->chunk, id);
+    col->shortname = g_string_chunk_insert(col->chunk, "synthetic");
+    pkg->name = g_string_chunk_insert(pkg->chunk, id);
+    pkg->version = g_string_chunk_insert(pkg->chunk, "1.0");
+    cr_updatecollection_append_package(col, pkg);
+    cr_updaterecord_append_collection(rec, col);
+
+    g_free(id);
+    return rec;
+}
+
+static void
+check_written_records(const char *path, int count)
+{
+    GError *tmp_err = NULL;
+    cr_UpdateInfo *ui = cr_updateinfo_new();
+
+    int ret = cr_xml_parse_updateinfo(path, ui, NULL, NULL, &tmp_err);
+    g_assert(tmp_err == NULL);
+    g_assert_cmpint(ret, ==, CRE_OK);
+    g_assert_cmpint(g_slist_length(ui->updates), ==, count);
+
+    int idx = 0;
+    for (GSList *elem = ui->updates; elem; elem = g_slist_next(elem), idx++) {
+        cr_UpdateRecord *rec = elem->data;
+        gchar *id = g_strdup_printf("UPDATE-%06d", idx);
+        g_assert_cmpstr(rec->id, ==, id);
+        g_assert_cmpint(g_slist_length(rec->collections), ==, 1);
+        g_free(id);
+    }
+
+    cr_updateinfo_free(ui);
+}
+
+static void
+test_cr_updateinfo_writer(void)
+{
+    GError *tmp_err = NULL;
+    gchar *tmp_dir = g_strdup(TMP_DIR_PATTERN);
+    g_assert(mkdtemp(tmp_dir));
+    gchar *path = g_build_filename(tmp_dir, "updateinfo.xml.gz", NULL);
+    gchar *path2 = g_build_filename(tmp_dir, "updateinfo2.xml", NULL);
+
+    // Records are written in the order in which they were added
+    cr_XmlFile *f = cr_xmlfile_open_updateinfo(path, CR_CW_GZ_COMPRESSION,
+                                               &tmp_err);
+    g_assert(f);
+    cr_UpdateinfoWriter *w = cr_updateinfo_writer_new(f, WRITER_WORKERS,
+                                                      &tmp_err);
+    g_assert(w);
+    for (int x = 0; x < WRITER_RECORDS; x++)
+        cr_updateinfo_writer_add(w, new_record(x));
+    g_assert(cr_updateinfo_writer_finish(w, &tmp_err));
+    g_assert(tmp_err == NULL);
+    cr_updateinfo_writer_free(w);
+    g_assert_cmpint(cr_xmlfile_close(f, &tmp_err), ==, CRE_OK);
+
+    check_written_records(path, WRITER_RECORDS);
+
+    // Stream the file through the parser to the writer
+    f = cr_xmlfile_open_updateinfo(path2, CR_CW_NO_COMPRESSION, &tmp_err);
+    g_assert(f);
+    w = cr_updateinfo_writer_new(f, WRITER_WORKERS, &tmp_err);
+    g_assert(w);
+    int ret = cr_xml_parse_updateinfo_records(path, recordcb_write, w,
+                                              NULL, NULL, &tmp_err);
+    g_assert(tmp_err == NULL);
+    g_assert_cmpint(ret, ==, CRE_OK);
+    g_assert(cr_updateinfo_writer_finish(w, &tmp_err));
+    cr_updateinfo_writer_free(w);
+    g_assert_cmpint(cr_xmlfile_close(f, &tmp_err), ==, CRE_OK);
+
+    check_written_records(path2, WRITER_RECORDS);
+
+    cr_remove_dir(tmp_dir, NULL);
+    g_free(path);
+    g_free(path2);
+    g_free(tmp_dir);
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -179,6 +340,12 @@ main(int argc, char *argv[])
                     test_cr_xml_parse_updateinfo_01);
     g_test_add_func("/xml_parser_updateinfo/test_cr_xml_parse_updateinfo_02",
                     test_cr_xml_parse_updateinfo_02);
+    g_test_add_func("/xml_parser_updateinfo/test_cr_xml_parse_updateinfo_records_01",
+                    test_cr_xml_parse_updateinfo_records_01);
+    g_test_add_func("/xml_parser_updateinfo/test_cr_xml_parse_updateinfo_records_interrupt",
+                    test_cr_xml_parse_updateinfo_records_interrupt);
+    g_test_add_func("/xml_parser_updateinfo/test_cr_updateinfo_writer",
+                    test_cr_updateinfo_writer);
 
     return g_test_run();
 }
@@ -0,0 +1,203 @@
+#!/usr/bin/env python3
+
+"""Generator of synthetic rpm trees for benchmarks.
+
+Builds a directory of small rpm packages with configurable number
+of packages, distribution of file counts, changelog sizes and dependency
+fan-out. The knobs and their defaults are the same as the ones
+of the in-memory generator in tests/bench_synthetic.c.
+
+With --bump, a fraction of the packages of an existing tree is rebuilt
+with an increased release, which is what a typical --update run sees.
+
+Requires rpmbuild.
+"""
+
+import glob
+import math
+import os
+import random
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+from concurrent.futures import ThreadPoolExecutor
+from optparse import OptionParser
+
+LOREM = ("Lorem ipsum dolor sit amet, consectetur adipiscing elit, "
+         "sed do eiusmod tempor incididunt ut labore et dolore magna "
+         "aliqua. Ut enim ad minim veniam, quis nostrud exercitation. ")
+
+FILES_PER_DIR = 50
+
+
+def pkg_name(idx):
+    return "synth%06d" % idx
+
+
+def files_count(opts, rnd):
+    # Exponential distribution - most packages are small, a few are huge
+    count = int(-opts.files * math.log(1.0 - rnd.random())) + 1
+    return min(count, max(opts.files_max, 1))
+
+
+def gen_spec(opts, idx, release):
+    # Per package generator - the same package is generated for the same
+    # seed regardless of the number of packages or the build order
+    rnd = random.Random("%d-%d" % (opts.seed, idx))
+    name = pkg_name(idx)
+    version = "1.%d" % (idx % 17)
+
+    requires = set()
+    for _ in range(opts.deps):
+        target = rnd.randrange(opts.packages)
+        if target != idx:
+            requires.add("libsynth%06d.so.1()(64bit)" % target)
+
+    files = ["/usr/bin/%s" % name]
+    dirs = []
+    for x in range(1, files_count(opts, rnd)):
+        d = "/usr/share/%s/d%04d" % (name, x // FILES_PER_DIR)
+        if x % FILES_PER_DIR == 1:
+            dirs.append(d)
+        files.append("%s/file%06d.dat" % (d, x))
+
+    text = (LOREM * (opts.changelog_size // len(LOREM) + 1))
+    text = text[:opts.changelog_size].strip()
+
+    spec = []
+    spec.append("%global debug_package %{nil}")
+    spec.append("%global __os_install_post %{nil}")
+    spec.append("Name: %s" % name)
+    spec.append("Version: %s" % version)
+    spec.append("Release: %d" % release)
+    spec.append("License: MIT")
+    spec.append("Summary: Synthetic package %s" % name)
+    spec.append("Group: Unspecified")
+    spec.append("Url: https://example.com/%s" % name)
+    spec.append("BuildArch: noarch")
+    spec.append("Provides: libsynth%06d.so.1()(64bit)" % idx)
+    for req in sorted(requires):
+        spec.append("Requires: %s" % req)
+    spec.append("")
+    spec.append("%description")
+    spec.append(LOREM + LOREM)
+    spec.append("")
+    spec.append("%install")
+    spec.append("while read f; do")
+    spec.append('    mkdir -p "$RPM_BUILD_ROOT$(dirname "$f")"')
+    spec.append('    echo "$f" > "$RPM_BUILD_ROOT$f"')
+    spec.append("done <<'EOF'")
+    spec.extend(files)
+    spec.append("EOF")
+    spec.append("")
+    spec.append("%files")
+    for d in dirs:
+        spec.append("%%dir %s" % d)
+    spec.extend(files)
+    spec.append("")
+    spec.append("%changelog")
+    day = 24 * 60 * 60
+    for x in range(opts.changelogs):
+        date = time.strftime("%a %b %d %Y",
+                             time.gmtime(1500000000 - x * day))
+        spec.append("* %s Synthetic Packager <synth@example.com> - %s-%d"
+                    % (date, version, opts.changelogs - x))
+        spec.append("- %s" % text)
+        spec.append("")
+
+    return "\n".join(spec) + "\n"
+
+
+def build(opts, idx, release):
+    topdir = tempfile.mkdtemp(prefix="cr_synth_")
+    try:
+        spec_path = os.path.join(topdir, "%s.spec" % pkg_name(idx))
+        with open(spec_path, "w") as f:
+            f.write(gen_spec(opts, idx, release))
+        cmd = ["rpmbuild", "-bb", "--nodeps", "--quiet",
+               "--define", "_topdir %s" % topdir,
+               "--define", "_rpmdir %s" % opts.outdir,
+               "--define", "_build_name_fmt %%{NAME}-%%{VERSION}-%%{RELEASE}.%%{ARCH}.rpm",
+               "--define", "_binary_payload w1.gzdio",
+               spec_path]
+        with open(os.devnull, "w") as devnull:
+            return subprocess.call(cmd, stdout=devnull, stderr=devnull) == 0
+    finally:
+        shutil.rmtree(topdir, ignore_errors=True)
+
+
+def existing_release(outdir, idx):
+    """Return (path, release) of an already built package or (None, 0)"""
+    for path in glob.glob(os.path.join(outdir, "%s-*.rpm" % pkg_name(idx))):
+        m = re.match(r".*-(\d+)\.noarch\.rpm$", path)
+        if m:
+            return path, int(m.group(1))
+    return None, 0
+
+
+def main():
+    parser = OptionParser("usage: %prog [options] <output_dir>")
+    parser.add_option("--packages", type="int", default=5000,
+                      help="Number of generated packages (default: %default)")
+    parser.add_option("--files", type="int", default=40,
+                      help="Mean number of files per package (default: %default)")
+    parser.add_option("--files-max", type="int", default=20000,
+                      help="Maximal number of files per package (default: %default)")
+    parser.add_option("--changelogs", type="int", default=10,
+                      help="Changelog entries per package (default: %default)")
+    parser.add_option("--changelog-size", type="int", default=200,
+                      help="Size of a changelog entry text (default: %default)")
+    parser.add_option("--deps", type="int", default=8,
+                      help="Requires on other packages (default: %default)")
+    parser.add_option("--seed", type="int", default=42,
+                      help="Seed of the random generator (default: %default)")
+    parser.add_option("--bump", type="float", default=0.0,
+                      help="Rebuild this fraction (0.0-1.0) of the packages "
+                           "of an existing tree with a new release")
+    parser.add_option("-j", "--jobs", type="int", default=os.cpu_count() or 1,
+                      help="Number of parallel rpmbuilds (default: %default)")
+    opts, args = parser.parse_args()
+
+    if len(args) != 1:
+        parser.error("Must specify exactly one output directory")
+    opts.outdir = os.path.abspath(args[0])
+
+    if not shutil.which("rpmbuild"):
+        print("rpmbuild not found", file=sys.stderr)
+        return 1
+
+    if not os.path.isdir(opts.outdir):
+        os.makedirs(opts.outdir)
+
+    jobs = []
+    if opts.bump:
+        rnd = random.Random(opts.seed)
+        count = int(round(opts.packages * opts.bump))
+        for idx in rnd.sample(range(opts.packages), count):
+            path, release = existing_release(opts.outdir, idx)
+            if path:
+                os.unlink(path)
+            jobs.append((idx, release + 1))
+    else:
+        for idx in range(opts.packages):
+            if not existing_release(opts.outdir, idx)[0]:
+                jobs.append((idx, 1))
+
+    with ThreadPoolExecutor(max_workers=max(opts.jobs, 1)) as executor:
+        results = list(executor.map(lambda job: build(opts, *job), jobs))
+
+    failed = results.count(False)
+    if failed:
+        print("%d of %d packages failed to build" % (failed, len(jobs)),
+              file=sys.stderr)
+        return 1
+
+    print("Built %d packages in %s" % (len(jobs), opts.outdir))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,193 @@
+#!/usr/bin/env python3
+
+"""Run the createrepo_c benchmarks and write the results as JSON.
+
+Collects:
+ - results of tests/bench_pipeline (dumper, xml parsers, sqlite,
+   compression backends) on in-memory synthetic packages
+ - times of whole createrepo_c runs on a synthetic rpm tree generated
+   by utils/gen_synthetic_repo.py: a full run, --update without changes
+   (with and without --xml-passthrough) and --update after a part
+   of the packages was rebuilt
+   (skipped with --no-rpm or when rpmbuild is not available)
+
+With --baseline, the results are compared with a previous JSON output
+and the script fails if any result is slower than the threshold allows.
+"""
+
+import json
+import os
+import platform
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+from optparse import OptionParser
+
+UTILS_DIR = os.path.dirname(os.path.abspath(__file__))
+SYNTH_OPTIONS = ("packages", "files", "files_max", "changelogs",
+                 "changelog_size", "deps", "seed")
+
+
+def synth_args(opts):
+    args = []
+    for name in SYNTH_OPTIONS:
+        value = getattr(opts, name)
+        if value is not None:
+            args += ["--%s" % name.replace("_", "-"), str(value)]
+    return args
+
+
+def run_pipeline(opts):
+    cmd = [os.path.join(opts.build_dir, "tests", "bench_pipeline"),
+           "--json", "-", "--iterations", str(opts.iterations)]
+    cmd += synth_args(opts)
+    out = subprocess.check_output(cmd)
+    return json.loads(out.decode("utf-8"))
+
+
+def timed(cmd):
+    start = time.time()
+    with open(os.devnull, "w") as devnull:
+        subprocess.check_call(cmd, stdout=devnull)
+    return time.time() - start
+
+
+def run_createrepo(opts, workdir):
+    gen = [sys.executable, os.path.join(UTILS_DIR, "gen_synthetic_repo.py")]
+    gen += synth_args(opts)
+    createrepo = [os.path.join(opts.build_dir, "src", "createrepo_c"),
+                  "--workers", str(opts.workers)]
+    repo = os.path.join(workdir, "repo")
+    packages = opts.packages or 5000
+
+    subprocess.check_call(gen + [repo])
+
+    results = []
+    results.append({"name": "createrepo_c_full",
+                    "seconds": timed(createrepo + [repo]),
+                    "items": packages})
+    results.append({"name": "createrepo_c_update_nochange",
+                    "seconds": timed(createrepo + ["--update", repo]),
+                    "items": packages})
+    results.append({"name": "createrepo_c_update_nochange_xml_passthrough",
+                    "seconds": timed(createrepo + ["--update",
+                                                   "--xml-passthrough", repo]),
+                    "items": packages})
+
+    subprocess.check_call(gen + ["--bump", str(opts.bump), repo])
+    results.append({"name": "createrepo_c_update",
+                    "seconds": timed(createrepo + ["--update", repo]),
+                    "items": packages})
+
+    for res in results:
+        res["items_per_second"] = res["items"] / res["seconds"]
+    return results
+
+
+def git_revision():
+    try:
+        out = subprocess.check_output(["git", "rev-parse", "HEAD"],
+                                      cwd=UTILS_DIR, stderr=subprocess.STDOUT)
+        return out.decode("utf-8").strip()
+    except (OSError, subprocess.CalledProcessError):
+        return None
+
+
+def compare(results, baseline_path, threshold):
+    """Return list of regression descriptions"""
+    with open(baseline_path) as f:
+        baseline = dict((r["name"], r) for r in json.load(f)["results"])
+
+    regressions = []
+    for res in results:
+        base = baseline.get(res["name"])
+        if not base or base["seconds"] <= 0:
+            continue
+        change = (res["seconds"] / base["seconds"] - 1.0) * 100.0
+        res["baseline_seconds"] = base["seconds"]
+        res["change_percent"] = change
+        if change > threshold:
+            regressions.append("%s: %.4fs -> %.4fs (+%.1f%%)"
+                               % (res["name"], base["seconds"],
+                                  res["seconds"], change))
+    return regressions
+
+
+def main():
+    parser = OptionParser("usage: %prog [options]")
+    parser.add_option("--build-dir", default=".",
+                      help="CMake build directory (default: %default)")
+    parser.add_option("-o", "--output", default="bench.json",
+                      help="Output JSON file (default: %default)")
+    parser.add_option("--baseline",
+                      help="JSON output of a previous run to compare with")
+    parser.add_option("--threshold", type="float", default=10.0,
+                      help="Maximal allowed slowdown against the baseline "
+                           "in percent (default: %default)")
+    parser.add_option("--iterations", type="int", default=3,
+                      help="Iterations of the pipeline stages (default: %default)")
+    parser.add_option("--no-rpm", action="store_true",
+                      help="Skip the createrepo_c runs on a synthetic rpm tree")
+    parser.add_option("--bump", type="float", default=0.1,
+                      help="Fraction of packages rebuilt before the --update "
+                           "run (default: %default)")
+    parser.add_option("--workers", type="int", default=os.cpu_count() or 1,
+                      help="Number of createrepo_c workers (default: %default)")
+    parser.add_option("--workdir",
+                      help="Directory for the synthetic rpm tree "
+                           "(default: a temporary directory)")
+    for name in SYNTH_OPTIONS:
+        parser.add_option("--%s" % name.replace("_", "-"), type="int",
+                          dest=name, help="See bench_pipeline --help-synthetic")
+    opts, _ = parser.parse_args()
+
+    pipeline = run_pipeline(opts)
+    results = list(pipeline["results"])
+
+    if not opts.no_rpm and shutil.which("rpmbuild"):
+        workdir = opts.workdir or tempfile.mkdtemp(prefix="cr_bench_")
+        try:
+            results += run_createrepo(opts, workdir)
+        finally:
+            if not opts.workdir:
+                shutil.rmtree(workdir, ignore_errors=True)
+    elif not opts.no_rpm:
+        print("rpmbuild not found - skipping createrepo_c runs",
+              file=sys.stderr)
+
+    regressions = []
+    if opts.baseline:
+        regressions = compare(results, opts.baseline, opts.threshold)
+
+    output = {
+        "timestamp": int(time.time()),
+        "host": platform.node(),
+        "machine": platform.machine(),
+        "cpus": os.cpu_count(),
+        "git": git_revision(),
+        "version": pipeline.get("version"),
+        "params": pipeline.get("params"),
+        "results": results,
+        "regressions": regressions,
+    }
+
+    with open(opts.output, "w") as f:
+        json.dump(output, f, indent=2, sort_keys=True)
+        f.write("\n")
+
+    for res in results:
+        print("%-32s %10.4fs" % (res["name"], res["seconds"]))
+    print("Results written to %s" % opts.output)
+
+    if regressions:
+        print("Regressions against %s:" % opts.baseline, file=sys.stderr)
+        for reg in regressions:
+            print("  %s" % reg, file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())